@@ -23,6 +23,8 @@
 #include "../PrecompiledHeaders.h"
 #include "MemoryStringCache.h"
 
+#include "../OrthancException.h"
+
 namespace Orthanc
 {
   class MemoryStringCache::StringValue : public ICacheable
@@ -70,4 +72,31 @@ namespace Orthanc
       return false;
     }
   }
+
+
+  bool MemoryStringCache::FetchRange(std::string& value,
+                                     const std::string& key,
+                                     size_t start,
+                                     size_t end)
+  {
+    MemoryObjectCache::Accessor reader(cache_, key, false /* multiple readers are allowed */);
+
+    if (reader.IsValid())
+    {
+      const std::string& content = dynamic_cast<StringValue&>(reader.GetValue()).GetContent();
+
+      if (start > end ||
+          end > content.size())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      value.assign(content, start, end - start);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
 }
@@ -58,5 +58,11 @@ namespace Orthanc
 
     bool Fetch(std::string& value,
                const std::string& key);
+
+    // Only copies the range [start, end[ of the cached value
+    bool FetchRange(std::string& value,
+                    const std::string& key,
+                    size_t start /* inclusive */,
+                    size_t end /* exclusive */);
   };
 }
@@ -148,9 +148,17 @@ namespace Orthanc
     writer_.Open();
   }
 
+  HierarchicalZipWriter::HierarchicalZipWriter(ZipWriter::IOutputStream& stream)
+  {
+    // Don't open the archive yet, as the ZIP64 flag can only be
+    // changed before the first byte is written to the stream
+    writer_.SetOutputStream(stream);
+  }
+
   HierarchicalZipWriter::~HierarchicalZipWriter()
   {
-    writer_.Close();
+    // The destructor of "writer_" closes the archive, unless it is
+    // written to a stream
   }
 
   void HierarchicalZipWriter::OpenFile(const char* name)
@@ -159,6 +167,13 @@ namespace Orthanc
     writer_.OpenFile(p.c_str());
   }
 
+  void HierarchicalZipWriter::WriteCompressedFile(const char* name,
+                                                  const ZipWriter::CompressedFile& file)
+  {
+    std::string p = indexer_.OpenFile(name);
+    writer_.WriteCompressedFile(p.c_str(), file);
+  }
+
   void HierarchicalZipWriter::OpenDirectory(const char* name)
   {
     indexer_.OpenDirectory(name);
@@ -86,8 +86,16 @@ namespace Orthanc
   public:
     HierarchicalZipWriter(const char* path);
 
+    // The archive is streamed, "Close()" must be invoked once done
+    HierarchicalZipWriter(ZipWriter::IOutputStream& stream);
+
     ~HierarchicalZipWriter();
 
+    void Close()
+    {
+      writer_.Close();
+    }
+
     void SetZip64(bool isZip64)
     {
       writer_.SetZip64(isZip64);
@@ -138,5 +146,8 @@ namespace Orthanc
     {
       writer_.Write(data);
     }
+
+    void WriteCompressedFile(const char* name,
+                             const ZipWriter::CompressedFile& file);
   };
 }
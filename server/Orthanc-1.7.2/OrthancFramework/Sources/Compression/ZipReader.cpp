@@ -0,0 +1,667 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ZipReader.h"
+
+#include "../OrthancException.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/thread/mutex.hpp>
+#include <limits>
+#include <string.h>
+#include <zlib.h>
+
+
+namespace Orthanc
+{
+  static const uint32_t SIGNATURE_LOCAL_FILE_HEADER = 0x04034b50u;
+  static const uint32_t SIGNATURE_CENTRAL_DIRECTORY = 0x02014b50u;
+  static const uint32_t SIGNATURE_END_OF_CENTRAL_DIRECTORY = 0x06054b50u;
+  static const uint32_t SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY = 0x06064b50u;
+  static const uint32_t SIGNATURE_ZIP64_LOCATOR = 0x07064b50u;
+
+  static const size_t LOCAL_FILE_HEADER_SIZE = 30;
+  static const size_t CENTRAL_DIRECTORY_HEADER_SIZE = 46;
+  static const size_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+  static const size_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE = 56;
+  static const size_t ZIP64_LOCATOR_SIZE = 20;
+  static const size_t MAX_COMMENT_SIZE = 65535;
+
+  static const uint16_t METHOD_STORED = 0;
+  static const uint16_t METHOD_DEFLATE = 8;
+
+  static const size_t CHUNK_SIZE = 1024 * 1024;
+
+  // Maximum compression ratio of the deflate algorithm
+  static const uint64_t MAX_DEFLATE_RATIO = 1032;
+  static const uint64_t DEFLATE_RATIO_SLACK = 1024;
+
+
+  static uint16_t ReadUInt16(const std::string& buffer,
+                             size_t offset)
+  {
+    if (offset + 2 > buffer.size())
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Truncated ZIP archive");
+    }
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer.c_str()) + offset;
+    return (static_cast<uint16_t>(p[0]) |
+            (static_cast<uint16_t>(p[1]) << 8));
+  }
+
+
+  static uint32_t ReadUInt32(const std::string& buffer,
+                             size_t offset)
+  {
+    if (offset + 4 > buffer.size())
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Truncated ZIP archive");
+    }
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer.c_str()) + offset;
+    return (static_cast<uint32_t>(p[0]) |
+            (static_cast<uint32_t>(p[1]) << 8) |
+            (static_cast<uint32_t>(p[2]) << 16) |
+            (static_cast<uint32_t>(p[3]) << 24));
+  }
+
+
+  static uint64_t ReadUInt64(const std::string& buffer,
+                             size_t offset)
+  {
+    return (static_cast<uint64_t>(ReadUInt32(buffer, offset)) |
+            (static_cast<uint64_t>(ReadUInt32(buffer, offset + 4)) << 32));
+  }
+
+
+  class ZipReader::ISource : public boost::noncopyable
+  {
+  public:
+    virtual ~ISource()
+    {
+    }
+
+    virtual uint64_t GetSize() const = 0;
+
+    // Must be thread-safe
+    virtual void Read(std::string& target,
+                      uint64_t offset,
+                      size_t size) = 0;
+  };
+
+
+  class ZipReader::MemorySource : public ISource
+  {
+  private:
+    const uint8_t*  buffer_;
+    size_t          size_;
+
+  public:
+    MemorySource(const void* buffer,
+                 size_t size) :
+      buffer_(reinterpret_cast<const uint8_t*>(buffer)),
+      size_(size)
+    {
+      if (buffer_ == NULL &&
+          size_ != 0)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+    }
+
+    virtual uint64_t GetSize() const ORTHANC_OVERRIDE
+    {
+      return size_;
+    }
+
+    virtual void Read(std::string& target,
+                      uint64_t offset,
+                      size_t size) ORTHANC_OVERRIDE
+    {
+      if (offset > static_cast<uint64_t>(size_) ||
+          static_cast<uint64_t>(size) > static_cast<uint64_t>(size_) - offset)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Truncated ZIP archive");
+      }
+
+      target.assign(reinterpret_cast<const char*>(buffer_) + static_cast<size_t>(offset), size);
+    }
+  };
+
+
+  class ZipReader::FileSource : public ISource
+  {
+  private:
+    boost::mutex                 mutex_;
+    boost::filesystem::ifstream  stream_;
+    uint64_t                     size_;
+
+  public:
+    explicit FileSource(const std::string& path)
+    {
+      stream_.open(path, std::ifstream::in | std::ifstream::binary);
+      if (!stream_.good())
+      {
+        throw OrthancException(ErrorCode_InexistentFile, "Cannot open ZIP archive: " + path);
+      }
+
+      stream_.seekg(0, std::ios::end);
+      std::streamoff size = stream_.tellg();
+      if (size < 0)
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile);
+      }
+
+      size_ = static_cast<uint64_t>(size);
+    }
+
+    virtual uint64_t GetSize() const ORTHANC_OVERRIDE
+    {
+      return size_;
+    }
+
+    virtual void Read(std::string& target,
+                      uint64_t offset,
+                      size_t size) ORTHANC_OVERRIDE
+    {
+      if (offset > size_ ||
+          static_cast<uint64_t>(size) > size_ - offset)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Truncated ZIP archive");
+      }
+
+      target.resize(size);
+
+      if (size != 0)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        stream_.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        stream_.read(&target[0], static_cast<std::streamsize>(size));
+
+        if (!stream_.good())
+        {
+          stream_.clear();
+          throw OrthancException(ErrorCode_CorruptedFile);
+        }
+      }
+    }
+  };
+
+
+  struct ZipReader::Entry
+  {
+    std::string  name_;
+    uint16_t     flags_;
+    uint16_t     method_;
+    uint32_t     crc32_;
+    uint64_t     compressedSize_;
+    uint64_t     uncompressedSize_;
+    uint64_t     localHeaderOffset_;
+  };
+
+
+  ZipReader::ZipReader(ISource* source) :
+    source_(source)
+  {
+    if (source == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    try
+    {
+      ReadCentralDirectory();
+    }
+    catch (OrthancException&)
+    {
+      for (size_t i = 0; i < entries_.size(); i++)
+      {
+        delete entries_[i];
+      }
+
+      throw;
+    }
+  }
+
+
+  ZipReader::~ZipReader()
+  {
+    for (size_t i = 0; i < entries_.size(); i++)
+    {
+      assert(entries_[i] != NULL);
+      delete entries_[i];
+    }
+  }
+
+
+  void ZipReader::ReadCentralDirectory()
+  {
+    const uint64_t fileSize = source_->GetSize();
+
+    // Look for the "end of central directory record", that is
+    // followed by a comment of at most 64KB
+    const size_t tailSize = static_cast<size_t>(
+      std::min(fileSize, static_cast<uint64_t>(END_OF_CENTRAL_DIRECTORY_SIZE + MAX_COMMENT_SIZE)));
+
+    if (tailSize < END_OF_CENTRAL_DIRECTORY_SIZE)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Not a ZIP archive");
+    }
+
+    std::string tail;
+    source_->Read(tail, fileSize - tailSize, tailSize);
+
+    size_t eocd = tailSize - END_OF_CENTRAL_DIRECTORY_SIZE;
+    while (ReadUInt32(tail, eocd) != SIGNATURE_END_OF_CENTRAL_DIRECTORY)
+    {
+      if (eocd == 0)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Not a ZIP archive");
+      }
+
+      eocd--;
+    }
+
+    uint64_t countEntries = ReadUInt16(tail, eocd + 10);
+    uint64_t directorySize = ReadUInt32(tail, eocd + 12);
+    uint64_t directoryOffset = ReadUInt32(tail, eocd + 16);
+
+    if (countEntries == 0xffffu ||
+        directorySize == 0xffffffffu ||
+        directoryOffset == 0xffffffffu)
+    {
+      // ZIP64 archive: Use the "ZIP64 end of central directory locator"
+      if (eocd < ZIP64_LOCATOR_SIZE ||
+          ReadUInt32(tail, eocd - ZIP64_LOCATOR_SIZE) != SIGNATURE_ZIP64_LOCATOR)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Missing ZIP64 end of central directory");
+      }
+
+      const uint64_t zip64Offset = ReadUInt64(tail, eocd - ZIP64_LOCATOR_SIZE + 8);
+
+      std::string zip64;
+      source_->Read(zip64, zip64Offset, ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE);
+
+      if (ReadUInt32(zip64, 0) != SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Bad ZIP64 end of central directory");
+      }
+
+      countEntries = ReadUInt64(zip64, 32);
+      directorySize = ReadUInt64(zip64, 40);
+      directoryOffset = ReadUInt64(zip64, 48);
+    }
+
+    if (directoryOffset > fileSize ||
+        directorySize > fileSize - directoryOffset ||
+        directorySize > static_cast<uint64_t>(std::numeric_limits<size_t>::max()) ||
+        countEntries > directorySize / CENTRAL_DIRECTORY_HEADER_SIZE)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Bad central directory in ZIP archive");
+    }
+
+    std::string directory;
+    source_->Read(directory, directoryOffset, static_cast<size_t>(directorySize));
+
+    entries_.reserve(static_cast<size_t>(countEntries));
+
+    size_t pos = 0;
+    for (uint64_t i = 0; i < countEntries; i++)
+    {
+      if (ReadUInt32(directory, pos) != SIGNATURE_CENTRAL_DIRECTORY)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Bad central directory in ZIP archive");
+      }
+
+      const size_t nameLength = ReadUInt16(directory, pos + 28);
+      const size_t extraLength = ReadUInt16(directory, pos + 30);
+      const size_t commentLength = ReadUInt16(directory, pos + 32);
+
+      const size_t name = pos + CENTRAL_DIRECTORY_HEADER_SIZE;
+      const size_t extra = name + nameLength;
+      const size_t next = extra + extraLength + commentLength;
+
+      if (next > directory.size())
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Truncated ZIP archive");
+      }
+
+      std::unique_ptr<Entry> entry(new Entry);
+      entry->name_.assign(directory, name, nameLength);
+      entry->flags_ = ReadUInt16(directory, pos + 8);
+      entry->method_ = ReadUInt16(directory, pos + 10);
+      entry->crc32_ = ReadUInt32(directory, pos + 16);
+      entry->compressedSize_ = ReadUInt32(directory, pos + 20);
+      entry->uncompressedSize_ = ReadUInt32(directory, pos + 24);
+      entry->localHeaderOffset_ = ReadUInt32(directory, pos + 42);
+
+      // Look for the "ZIP64 extended information extra field", whose
+      // values are only present if the 32bit fields are saturated
+      size_t field = extra;
+      while (field + 4 <= extra + extraLength)
+      {
+        const uint16_t id = ReadUInt16(directory, field);
+        const size_t size = ReadUInt16(directory, field + 2);
+
+        if (field + 4 + size > extra + extraLength)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat, "Bad extra field in ZIP archive");
+        }
+
+        if (id == 0x0001)
+        {
+          std::string values = directory.substr(field + 4, size);
+          size_t value = 0;
+
+          if (entry->uncompressedSize_ == 0xffffffffu)
+          {
+            entry->uncompressedSize_ = ReadUInt64(values, value);
+            value += 8;
+          }
+
+          if (entry->compressedSize_ == 0xffffffffu)
+          {
+            entry->compressedSize_ = ReadUInt64(values, value);
+            value += 8;
+          }
+
+          if (entry->localHeaderOffset_ == 0xffffffffu)
+          {
+            entry->localHeaderOffset_ = ReadUInt64(values, value);
+          }
+        }
+
+        field += 4 + size;
+      }
+
+      entries_.push_back(entry.release());
+      pos = next;
+    }
+  }
+
+
+  const ZipReader::Entry& ZipReader::GetEntry(size_t index) const
+  {
+    if (index >= entries_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      assert(entries_[index] != NULL);
+      return *entries_[index];
+    }
+  }
+
+
+  bool ZipReader::IsZipMemoryBuffer(const void* buffer,
+                                    size_t size)
+  {
+    if (size < 4)
+    {
+      return false;
+    }
+    else
+    {
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer);
+      return (p[0] == 'P' &&
+              p[1] == 'K' &&
+              p[2] == 0x03 &&
+              p[3] == 0x04);
+    }
+  }
+
+
+  bool ZipReader::IsZipMemoryBuffer(const std::string& buffer)
+  {
+    return IsZipMemoryBuffer(buffer.empty() ? NULL : buffer.c_str(), buffer.size());
+  }
+
+
+  bool ZipReader::IsZipFile(const std::string& path)
+  {
+    boost::filesystem::ifstream f;
+    f.open(path, std::ifstream::in | std::ifstream::binary);
+
+    char header[4];
+    f.read(header, sizeof(header));
+
+    return (f.good() &&
+            IsZipMemoryBuffer(header, sizeof(header)));
+  }
+
+
+  ZipReader* ZipReader::CreateFromMemory(const void* buffer,
+                                         size_t size)
+  {
+    return new ZipReader(new MemorySource(buffer, size));
+  }
+
+
+  ZipReader* ZipReader::CreateFromMemory(const std::string& buffer)
+  {
+    return CreateFromMemory(buffer.empty() ? NULL : buffer.c_str(), buffer.size());
+  }
+
+
+  ZipReader* ZipReader::CreateFromFile(const std::string& path)
+  {
+    return new ZipReader(new FileSource(path));
+  }
+
+
+  const std::string& ZipReader::GetEntryName(size_t index) const
+  {
+    return GetEntry(index).name_;
+  }
+
+
+  bool ZipReader::IsDirectory(size_t index) const
+  {
+    const std::string& name = GetEntry(index).name_;
+    return (!name.empty() &&
+            name[name.size() - 1] == '/');
+  }
+
+
+  uint64_t ZipReader::GetUncompressedSize(size_t index) const
+  {
+    return GetEntry(index).uncompressedSize_;
+  }
+
+
+  void ZipReader::ReadEntry(std::string& content,
+                            size_t index) const
+  {
+    const Entry& entry = GetEntry(index);
+
+    if (entry.flags_ & 0x0001)
+    {
+      throw OrthancException(ErrorCode_NotImplemented,
+                             "Encrypted ZIP archives are not supported: " + entry.name_);
+    }
+
+    if (entry.uncompressedSize_ > static_cast<uint64_t>(std::numeric_limits<size_t>::max()) ||
+        entry.compressedSize_ > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    std::string header;
+    source_->Read(header, entry.localHeaderOffset_, LOCAL_FILE_HEADER_SIZE);
+
+    if (ReadUInt32(header, 0) != SIGNATURE_LOCAL_FILE_HEADER)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Bad local file header in ZIP archive");
+    }
+
+    // The data follows the name and the extra field of the local
+    // header, whose lengths can differ from the central directory
+    uint64_t offset = (entry.localHeaderOffset_ + LOCAL_FILE_HEADER_SIZE +
+                       ReadUInt16(header, 26) + ReadUInt16(header, 28));
+
+    if (offset > source_->GetSize() ||
+        entry.compressedSize_ > source_->GetSize() - offset)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Truncated ZIP archive: " + entry.name_);
+    }
+
+    // The sizes of the central directory cannot be trusted before
+    // inflating: Reject the entries whose uncompressed size cannot be
+    // reached by deflate, before allocating the memory buffer
+    if (entry.method_ == METHOD_DEFLATE &&
+        entry.uncompressedSize_ > entry.compressedSize_ * MAX_DEFLATE_RATIO + DEFLATE_RATIO_SLACK)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat,
+                             "Bad uncompressed size in ZIP archive: " + entry.name_);
+    }
+
+    const size_t uncompressedSize = static_cast<size_t>(entry.uncompressedSize_);
+
+    switch (entry.method_)
+    {
+      case METHOD_STORED:
+        if (entry.compressedSize_ != entry.uncompressedSize_)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat, "Bad stored entry in ZIP archive");
+        }
+
+        source_->Read(content, offset, uncompressedSize);
+        break;
+
+      case METHOD_DEFLATE:
+      {
+        try
+        {
+          content.resize(uncompressedSize);
+        }
+        catch (...)
+        {
+          throw OrthancException(ErrorCode_NotEnoughMemory);
+        }
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+
+        // Raw deflate stream, without zlib header
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        char dummy = '\0';  // zlib does not like NULL output buffers
+        stream.next_out = reinterpret_cast<Bytef*>(uncompressedSize == 0 ? &dummy : &content[0]);
+
+        uint64_t remaining = entry.compressedSize_;
+        size_t written = 0;
+        bool done = false;
+        std::string chunk;
+
+        try
+        {
+          // Inflate the compressed data by chunks, in order not to
+          // load the full compressed entry in memory
+          while (!done)
+          {
+            if (stream.avail_in == 0)
+            {
+              if (remaining == 0)
+              {
+                throw OrthancException(ErrorCode_BadFileFormat, "Truncated deflate stream in ZIP archive");
+              }
+
+              const size_t size = static_cast<size_t>(std::min(remaining, static_cast<uint64_t>(CHUNK_SIZE)));
+              source_->Read(chunk, offset, size);
+              offset += size;
+              remaining -= size;
+
+              stream.next_in = reinterpret_cast<Bytef*>(&chunk[0]);
+              stream.avail_in = static_cast<uInt>(size);
+            }
+
+            // Never produce more than the announced uncompressed size
+            const size_t available = std::min(uncompressedSize - written,
+                                              static_cast<size_t>(std::numeric_limits<uInt>::max()));
+            stream.avail_out = static_cast<uInt>(available);
+
+            int error = inflate(&stream, Z_NO_FLUSH);
+            written += available - stream.avail_out;
+
+            if (error == Z_STREAM_END)
+            {
+              done = true;
+            }
+            else if (error != Z_OK &&
+                     !(error == Z_BUF_ERROR && stream.avail_in == 0))
+            {
+              throw OrthancException(ErrorCode_BadFileFormat, "Corrupted deflate stream in ZIP archive");
+            }
+            else if (available == 0 &&
+                     stream.avail_in != 0)
+            {
+              throw OrthancException(ErrorCode_BadFileFormat, "Bad uncompressed size in ZIP archive");
+            }
+          }
+        }
+        catch (OrthancException&)
+        {
+          inflateEnd(&stream);
+          content.clear();
+          throw;
+        }
+
+        inflateEnd(&stream);
+
+        if (written != uncompressedSize)
+        {
+          content.clear();
+          throw OrthancException(ErrorCode_BadFileFormat, "Bad uncompressed size in ZIP archive");
+        }
+
+        break;
+      }
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented,
+                               "Unsupported compression method in ZIP archive: " + entry.name_);
+    }
+
+    // Check the integrity of the uncompressed data (the CRC-32 is
+    // computed by chunks, as "uInt" can be 32bit)
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (size_t pos = 0; pos < content.size(); pos += CHUNK_SIZE)
+    {
+      const size_t size = std::min(CHUNK_SIZE, content.size() - pos);
+      crc = crc32(crc, reinterpret_cast<const Bytef*>(content.c_str()) + pos, static_cast<uInt>(size));
+    }
+
+    if (static_cast<uint32_t>(crc) != entry.crc32_)
+    {
+      content.clear();
+      throw OrthancException(ErrorCode_CorruptedFile, "Bad CRC-32 in ZIP archive: " + entry.name_);
+    }
+  }
+}
@@ -0,0 +1,112 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#if !defined(ORTHANC_ENABLE_ZLIB)
+#  error The macro ORTHANC_ENABLE_ZLIB must be defined
+#endif
+
+#if ORTHANC_ENABLE_ZLIB != 1
+#  error ZLIB support must be enabled to include this file
+#endif
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class ZipReader cannot be used in sandboxed environments
+#endif
+
+#include "../Compatibility.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Reader of ZIP archives that are stored either in memory, or in a
+   * file. Only the central directory is loaded in memory: The entries
+   * are read and uncompressed one at a time, which bounds the memory
+   * usage whatever the size of the archive. The "stored" and
+   * "deflate" methods are supported, as well as ZIP64. The entries
+   * can be read concurrently from several threads.
+   **/
+  class ORTHANC_PUBLIC ZipReader : public boost::noncopyable
+  {
+  private:
+    class ISource;
+    class MemorySource;
+    class FileSource;
+    struct Entry;
+
+    std::unique_ptr<ISource>  source_;
+    std::vector<Entry*>       entries_;
+
+    explicit ZipReader(ISource* source);  // Takes ownership
+
+    void ReadCentralDirectory();
+
+    const Entry& GetEntry(size_t index) const;
+
+  public:
+    ~ZipReader();
+
+    // Checks the signature of the first local file header
+    static bool IsZipMemoryBuffer(const void* buffer,
+                                  size_t size);
+
+    static bool IsZipMemoryBuffer(const std::string& buffer);
+
+    static bool IsZipFile(const std::string& path);
+
+    // The buffer must outlive the reader
+    static ZipReader* CreateFromMemory(const void* buffer,
+                                       size_t size);
+
+    static ZipReader* CreateFromMemory(const std::string& buffer);
+
+    static ZipReader* CreateFromFile(const std::string& path);
+
+    size_t GetEntriesCount() const
+    {
+      return entries_.size();
+    }
+
+    const std::string& GetEntryName(size_t index) const;
+
+    bool IsDirectory(size_t index) const;
+
+    uint64_t GetUncompressedSize(size_t index) const;
+
+    // Thread-safe
+    void ReadEntry(std::string& content,
+                   size_t index) const;
+  };
+}
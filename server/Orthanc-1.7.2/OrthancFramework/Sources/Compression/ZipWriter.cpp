@@ -28,11 +28,15 @@
 
 #include "ZipWriter.h"
 
+#include <algorithm>
 #include <limits>
+#include <list>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "../../Resources/ThirdParty/minizip/zip.h"
+#include "../Compatibility.h"
 #include "../OrthancException.h"
 #include "../Logging.h"
 
@@ -63,12 +67,559 @@ static void PrepareFileInfo(zip_fileinfo& zfi)
 }
 
 
+static uint32_t GetDosDateTime()
+{
+  // Same conversion as "zip64local_TmzDateToDosDate()" in minizip
+  zip_fileinfo zfi;
+  PrepareFileInfo(zfi);
+
+  const tm_zip& t = zfi.tmz_date;
+
+  uint32_t year = static_cast<uint32_t>(t.tm_year);
+  if (year >= 1980)
+  {
+    year -= 1980;
+  }
+  else if (year >= 80)
+  {
+    year -= 80;
+  }
+
+  return (((t.tm_mday + 32 * (t.tm_mon + 1) + 512 * year) << 16) |
+          (t.tm_sec / 2 + 32 * t.tm_min + 2048 * t.tm_hour));
+}
+
+
 
 namespace Orthanc
 {
+  static const char* const ZIP_COMMENT = "Created by Orthanc";
+
+
+  /**
+   * Writer of ZIP archives that never seeks backward, which is not
+   * possible with minizip. Each file that is compressed on the fly
+   * is followed by a data descriptor (bit 3 of the general purpose
+   * flags), and the ZIP64 extensions are used if "isZip64" is set.
+   * https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+   **/
+  class ZipWriter::StreamWriter : public boost::noncopyable
+  {
+  private:
+    static const uint32_t SIGNATURE_LOCAL_HEADER = 0x04034b50;
+    static const uint32_t SIGNATURE_DATA_DESCRIPTOR = 0x08074b50;
+    static const uint32_t SIGNATURE_CENTRAL_HEADER = 0x02014b50;
+    static const uint32_t SIGNATURE_ZIP64_END = 0x06064b50;
+    static const uint32_t SIGNATURE_ZIP64_LOCATOR = 0x07064b50;
+    static const uint32_t SIGNATURE_END = 0x06054b50;
+
+    static const uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+    static const uint16_t METHOD_STORED = 0;
+    static const uint16_t ZIP64_EXTRA_FIELD = 0x0001;
+    static const uint16_t VERSION_ZIP32 = 20;
+    static const uint16_t VERSION_ZIP64 = 45;
+
+    static const size_t   BUFFER_SIZE = 64 * 1024;
+
+    struct Entry
+    {
+      std::string  filename_;
+      uint16_t     flags_;
+      uint16_t     method_;
+      uint32_t     dosDateTime_;
+      uint32_t     crc32_;
+      uint64_t     compressedSize_;
+      uint64_t     uncompressedSize_;
+      uint64_t     offset_;
+    };
+
+    IOutputStream&      stream_;
+    bool                isZip64_;
+    uint64_t            position_;
+    std::list<Entry>    entries_;
+    bool                hasFileInZip_;
+    z_stream            deflate_;
+    std::vector<Bytef>  buffer_;
+
+    static void AddUInt16(std::string& target,
+                          uint16_t value)
+    {
+      target.push_back(static_cast<char>(value & 0xff));
+      target.push_back(static_cast<char>((value >> 8) & 0xff));
+    }
+
+    static void AddUInt32(std::string& target,
+                          uint32_t value)
+    {
+      AddUInt16(target, static_cast<uint16_t>(value & 0xffff));
+      AddUInt16(target, static_cast<uint16_t>(value >> 16));
+    }
+
+    static void AddUInt64(std::string& target,
+                          uint64_t value)
+    {
+      AddUInt32(target, static_cast<uint32_t>(value & 0xffffffffu));
+      AddUInt32(target, static_cast<uint32_t>(value >> 32));
+    }
+
+    uint16_t GetVersion() const
+    {
+      return (isZip64_ ? VERSION_ZIP64 : VERSION_ZIP32);
+    }
+
+    // Returns the value to be stored in a 32bit field, the actual
+    // value being stored in the ZIP64 extra field
+    uint32_t Get32bitValue(uint64_t value) const
+    {
+      if (isZip64_)
+      {
+        return 0xffffffffu;
+      }
+      else if (value >= 0xffffffffu)
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile,
+                               "The ZIP archive is too large, ZIP64 must be enabled");
+      }
+      else
+      {
+        return static_cast<uint32_t>(value);
+      }
+    }
+
+    void Send(const void* data,
+              size_t size)
+    {
+      if (size > 0)
+      {
+        stream_.Write(data, size);
+        position_ += size;
+      }
+    }
+
+    void Send(const std::string& data)
+    {
+      Send(data.empty() ? NULL : data.c_str(), data.size());
+    }
+
+    void Deflate(int flush)
+    {
+      assert(hasFileInZip_ && !entries_.empty());
+      Entry& entry = entries_.back();
+
+      for (;;)
+      {
+        deflate_.next_out = &buffer_[0];
+        deflate_.avail_out = static_cast<uInt>(buffer_.size());
+
+        int result = deflate(&deflate_, flush);
+        if (result != Z_OK &&
+            result != Z_STREAM_END &&
+            result != Z_BUF_ERROR)
+        {
+          throw OrthancException(ErrorCode_InternalError,
+                                 "Error while compressing a file in a ZIP stream");
+        }
+
+        const size_t produced = buffer_.size() - deflate_.avail_out;
+        Send(&buffer_[0], produced);
+        entry.compressedSize_ += produced;
+
+        if (flush == Z_FINISH)
+        {
+          if (result == Z_STREAM_END)
+          {
+            return;
+          }
+        }
+        else if (deflate_.avail_out != 0)
+        {
+          return;  // All the input has been consumed
+        }
+      }
+    }
+
+    void AddEntry(const char* path,
+                  uint16_t flags,
+                  uint16_t method)
+    {
+      const size_t length = strlen(path);
+      if (length == 0 ||
+          length > 0xffffu)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange,
+                               "Invalid filename inside ZIP archive: " + std::string(path));
+      }
+
+      if (!isZip64_ &&
+          entries_.size() >= 0xffffu)
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile,
+                               "Too many files in the ZIP archive, ZIP64 must be enabled");
+      }
+
+      Entry entry;
+      entry.filename_.assign(path, length);
+      entry.flags_ = flags;
+      entry.method_ = method;
+      entry.dosDateTime_ = GetDosDateTime();
+      entry.crc32_ = crc32(0L, Z_NULL, 0);
+      entry.compressedSize_ = 0;
+      entry.uncompressedSize_ = 0;
+      entry.offset_ = position_;
+      Get32bitValue(entry.offset_);  // Check the size of a ZIP32 archive
+
+      entries_.push_back(entry);
+    }
+
+    // If the entry is followed by a data descriptor, its CRC and
+    // sizes are not known yet, and are set to zero
+    void SendLocalHeader(const Entry& entry)
+    {
+      std::string header;
+      AddUInt32(header, SIGNATURE_LOCAL_HEADER);
+      AddUInt16(header, GetVersion());
+      AddUInt16(header, entry.flags_);
+      AddUInt16(header, entry.method_);
+      AddUInt32(header, entry.dosDateTime_);  // Time, then date
+      AddUInt32(header, entry.crc32_);
+
+      if (isZip64_)
+      {
+        // The ZIP64 extra field also tells the readers that the data
+        // descriptor, if any, contains 64bit sizes
+        AddUInt32(header, 0xffffffffu);
+        AddUInt32(header, 0xffffffffu);
+        AddUInt16(header, static_cast<uint16_t>(entry.filename_.size()));
+        AddUInt16(header, 20);
+        header += entry.filename_;
+        AddUInt16(header, ZIP64_EXTRA_FIELD);
+        AddUInt16(header, 16);
+        AddUInt64(header, entry.uncompressedSize_);
+        AddUInt64(header, entry.compressedSize_);
+      }
+      else
+      {
+        AddUInt32(header, Get32bitValue(entry.compressedSize_));
+        AddUInt32(header, Get32bitValue(entry.uncompressedSize_));
+        AddUInt16(header, static_cast<uint16_t>(entry.filename_.size()));
+        AddUInt16(header, 0);
+        header += entry.filename_;
+      }
+
+      Send(header);
+    }
+
+    void CloseFile()
+    {
+      if (!hasFileInZip_)
+      {
+        return;
+      }
+
+      Deflate(Z_FINISH);
+      deflateEnd(&deflate_);
+      hasFileInZip_ = false;
+
+      const Entry& entry = entries_.back();
+
+      std::string descriptor;
+      AddUInt32(descriptor, SIGNATURE_DATA_DESCRIPTOR);
+      AddUInt32(descriptor, entry.crc32_);
+
+      if (isZip64_)
+      {
+        AddUInt64(descriptor, entry.compressedSize_);
+        AddUInt64(descriptor, entry.uncompressedSize_);
+      }
+      else
+      {
+        AddUInt32(descriptor, Get32bitValue(entry.compressedSize_));
+        AddUInt32(descriptor, Get32bitValue(entry.uncompressedSize_));
+      }
+
+      Send(descriptor);
+    }
+
+  public:
+    StreamWriter(IOutputStream& stream,
+                 bool isZip64) :
+      stream_(stream),
+      isZip64_(isZip64),
+      position_(0),
+      hasFileInZip_(false),
+      buffer_(BUFFER_SIZE)
+    {
+    }
+
+    ~StreamWriter()
+    {
+      if (hasFileInZip_)
+      {
+        deflateEnd(&deflate_);
+      }
+    }
+
+    void OpenFile(const char* path,
+                  uint8_t compressionLevel)
+    {
+      CloseFile();
+      AddEntry(path, FLAG_DATA_DESCRIPTOR, Z_DEFLATED);
+
+      memset(&deflate_, 0, sizeof(deflate_));
+      if (deflateInit2(&deflate_, compressionLevel, Z_DEFLATED,
+                       -MAX_WBITS /* raw deflate */, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+        entries_.pop_back();
+        throw OrthancException(ErrorCode_InternalError,
+                               "Cannot initialize the compression of a ZIP stream");
+      }
+
+      hasFileInZip_ = true;
+
+      Entry entry = entries_.back();
+      entry.crc32_ = 0;  // In the data descriptor
+      SendLocalHeader(entry);
+    }
+
+    void WriteCompressedFile(const char* path,
+                             const CompressedFile& file)
+    {
+      // No data descriptor is needed, as the CRC and the sizes are
+      // already known
+      CloseFile();
+      AddEntry(path, 0, file.IsDeflated() ? Z_DEFLATED : METHOD_STORED);
+
+      Entry& entry = entries_.back();
+      entry.crc32_ = file.GetCrc32();
+      entry.compressedSize_ = file.GetContent().size();
+      entry.uncompressedSize_ = file.GetUncompressedSize();
+
+      SendLocalHeader(entry);
+      Send(file.GetContent());
+    }
+
+    void Write(const void* data,
+               size_t length)
+    {
+      if (!hasFileInZip_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls, "Call first OpenFile()");
+      }
+
+      Entry& entry = entries_.back();
+
+      const size_t maxBytesInAStep = std::numeric_limits<int32_t>::max();
+
+      const Bytef* p = reinterpret_cast<const Bytef*>(data);
+
+      while (length > 0)
+      {
+        uInt bytes = static_cast<uInt>(length <= maxBytesInAStep ? length : maxBytesInAStep);
+
+        entry.crc32_ = crc32(entry.crc32_, p, bytes);
+        entry.uncompressedSize_ += bytes;
+
+        deflate_.next_in = const_cast<Bytef*>(p);
+        deflate_.avail_in = bytes;
+        Deflate(Z_NO_FLUSH);
+
+        p += bytes;
+        length -= bytes;
+      }
+    }
+
+    void Close()
+    {
+      CloseFile();
+
+      const uint64_t centralDirectoryOffset = position_;
+
+      for (std::list<Entry>::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+      {
+        std::string header;
+        AddUInt32(header, SIGNATURE_CENTRAL_HEADER);
+        AddUInt16(header, GetVersion());  // Version made by (MS-DOS)
+        AddUInt16(header, GetVersion());  // Version needed to extract
+        AddUInt16(header, it->flags_);
+        AddUInt16(header, it->method_);
+        AddUInt32(header, it->dosDateTime_);
+        AddUInt32(header, it->crc32_);
+        AddUInt32(header, Get32bitValue(it->compressedSize_));
+        AddUInt32(header, Get32bitValue(it->uncompressedSize_));
+        AddUInt16(header, static_cast<uint16_t>(it->filename_.size()));
+        AddUInt16(header, isZip64_ ? 28 : 0);  // Length of the extra field
+        AddUInt16(header, 0);  // Comment length
+        AddUInt16(header, 0);  // Disk number
+        AddUInt16(header, 0);  // Internal attributes
+        AddUInt32(header, 0);  // External attributes
+        AddUInt32(header, Get32bitValue(it->offset_));
+        header += it->filename_;
+
+        if (isZip64_)
+        {
+          AddUInt16(header, ZIP64_EXTRA_FIELD);
+          AddUInt16(header, 24);
+          AddUInt64(header, it->uncompressedSize_);
+          AddUInt64(header, it->compressedSize_);
+          AddUInt64(header, it->offset_);
+        }
+
+        Send(header);
+      }
+
+      const uint64_t centralDirectorySize = position_ - centralDirectoryOffset;
+
+      std::string trailer;
+
+      if (isZip64_)
+      {
+        const uint64_t zip64EndOffset = position_;
+
+        AddUInt32(trailer, SIGNATURE_ZIP64_END);
+        AddUInt64(trailer, 44);  // Size of the remaining record
+        AddUInt16(trailer, VERSION_ZIP64);
+        AddUInt16(trailer, VERSION_ZIP64);
+        AddUInt32(trailer, 0);   // Number of this disk
+        AddUInt32(trailer, 0);   // Disk of the central directory
+        AddUInt64(trailer, entries_.size());
+        AddUInt64(trailer, entries_.size());
+        AddUInt64(trailer, centralDirectorySize);
+        AddUInt64(trailer, centralDirectoryOffset);
+
+        AddUInt32(trailer, SIGNATURE_ZIP64_LOCATOR);
+        AddUInt32(trailer, 0);   // Disk of the ZIP64 end of central directory
+        AddUInt64(trailer, zip64EndOffset);
+        AddUInt32(trailer, 1);   // Total number of disks
+      }
+
+      const uint16_t count = (isZip64_ ? 0xffffu : static_cast<uint16_t>(entries_.size()));
+
+      AddUInt32(trailer, SIGNATURE_END);
+      AddUInt16(trailer, 0);   // Number of this disk
+      AddUInt16(trailer, 0);   // Disk of the central directory
+      AddUInt16(trailer, count);
+      AddUInt16(trailer, count);
+      AddUInt32(trailer, Get32bitValue(centralDirectorySize));
+      AddUInt32(trailer, Get32bitValue(centralDirectoryOffset));
+      AddUInt16(trailer, static_cast<uint16_t>(strlen(ZIP_COMMENT)));
+      trailer += ZIP_COMMENT;
+
+      Send(trailer);
+    }
+  };
+
+
+  ZipWriter::CompressedFile::CompressedFile(const void* data,
+                                            size_t size,
+                                            uint8_t compressionLevel) :
+    uncompressedSize_(size),
+    isDeflated_(compressionLevel != 0)
+  {
+    if (compressionLevel >= 10)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "ZIP compression level must be between 0 (no compression) "
+                             "and 9 (highest compression)");
+    }
+
+    // zlib takes the sizes as "uInt": Files larger than 4GB are
+    // processed by chunks
+    const size_t maxStep = static_cast<size_t>(std::numeric_limits<uInt>::max());
+
+    const Bytef* p = (size == 0 ? NULL : reinterpret_cast<const Bytef*>(data));
+
+    {
+      uLong crc = crc32(0L, Z_NULL, 0);
+
+      for (size_t pos = 0; pos < size; )
+      {
+        const size_t step = std::min(size - pos, maxStep);
+        crc = crc32(crc, p + pos, static_cast<uInt>(step));
+        pos += step;
+      }
+
+      crc32_ = crc;
+    }
+
+    if (!isDeflated_)
+    {
+      content_.assign(reinterpret_cast<const char*>(p), size);
+      return;
+    }
+
+    z_stream deflater;
+    memset(&deflater, 0, sizeof(deflater));
+    if (deflateInit2(&deflater, compressionLevel, Z_DEFLATED,
+                     -MAX_WBITS /* raw deflate */, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      throw OrthancException(ErrorCode_InternalError,
+                             "Cannot initialize the compression of a file in a ZIP archive");
+    }
+
+    // "deflateBound()" is sufficient for one single call to
+    // "deflate()" if the file fits in one chunk, otherwise the
+    // buffer is grown as needed
+    content_.resize(deflateBound(&deflater, static_cast<uLong>(std::min(size, maxStep))));
+
+    size_t consumed = 0;
+    size_t written = 0;
+    int result;
+
+    for (;;)
+    {
+      if (deflater.avail_in == 0 &&
+          consumed < size)
+      {
+        const size_t step = std::min(size - consumed, maxStep);
+        deflater.next_in = const_cast<Bytef*>(p + consumed);
+        deflater.avail_in = static_cast<uInt>(step);
+        consumed += step;
+      }
+
+      if (written == content_.size())
+      {
+        content_.resize(2 * content_.size());
+      }
+
+      const size_t available = std::min(content_.size() - written, maxStep);
+      deflater.next_out = reinterpret_cast<Bytef*>(&content_[written]);
+      deflater.avail_out = static_cast<uInt>(available);
+
+      result = deflate(&deflater, (consumed == size ? Z_FINISH : Z_NO_FLUSH));
+      written += available - deflater.avail_out;
+
+      if (result != Z_OK)
+      {
+        break;
+      }
+    }
+
+    content_.resize(written);
+    deflateEnd(&deflater);
+
+    if (result != Z_STREAM_END)
+    {
+      throw OrthancException(ErrorCode_InternalError,
+                             "Error while compressing a file in a ZIP archive");
+    }
+  }
+
+
+  ZipWriter::CompressedFile::CompressedFile(const std::string& data,
+                                            uint8_t compressionLevel)
+  {
+    CompressedFile tmp(data.empty() ? NULL : data.c_str(), data.size(), compressionLevel);
+    content_.swap(tmp.content_);
+    crc32_ = tmp.crc32_;
+    uncompressedSize_ = tmp.uncompressedSize_;
+    isDeflated_ = tmp.isDeflated_;
+  }
+
+
   struct ZipWriter::PImpl
   {
-    zipFile file_;
+    zipFile                        file_;
+    std::unique_ptr<StreamWriter>  streamWriter_;
 
     PImpl() : file_(NULL)
     {
@@ -80,20 +631,35 @@ namespace Orthanc
     isZip64_(false),
     hasFileInZip_(false),
     append_(false),
-    compressionLevel_(6)
+    compressionLevel_(6),
+    stream_(NULL)
   {
   }
 
   ZipWriter::~ZipWriter()
   {
-    Close();
+    if (stream_ == NULL)
+    {
+      Close();
+    }
+    else
+    {
+      // An unfinished streamed archive is discarded, as writing to
+      // the stream might fail in a destructor (cf. "SetOutputStream()")
+    }
   }
 
   void ZipWriter::Close()
   {
-    if (IsOpen())
+    if (pimpl_->streamWriter_.get() != NULL)
+    {
+      std::unique_ptr<StreamWriter> writer(pimpl_->streamWriter_.release());
+      hasFileInZip_ = false;
+      writer->Close();
+    }
+    else if (IsOpen())
     {
-      zipClose(pimpl_->file_, "Created by Orthanc");
+      zipClose(pimpl_->file_, ZIP_COMMENT);
       pimpl_->file_ = NULL;
       hasFileInZip_ = false;
     }
@@ -101,7 +667,8 @@ namespace Orthanc
 
   bool ZipWriter::IsOpen() const
   {
-    return pimpl_->file_ != NULL;
+    return (pimpl_->file_ != NULL ||
+            pimpl_->streamWriter_.get() != NULL);
   }
 
   void ZipWriter::Open()
@@ -111,6 +678,19 @@ namespace Orthanc
       return;
     }
 
+    if (stream_ != NULL)
+    {
+      if (append_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                               "Cannot append to an existing archive if writing to a stream");
+      }
+
+      hasFileInZip_ = false;
+      pimpl_->streamWriter_.reset(new StreamWriter(*stream_, isZip64_));
+      return;
+    }
+
     if (path_.size() == 0)
     {
       throw OrthancException(ErrorCode_BadSequenceOfCalls,
@@ -146,10 +726,25 @@ namespace Orthanc
   {
     Close();
     path_ = path;
+    stream_ = NULL;
+  }
+
+  void ZipWriter::SetOutputStream(IOutputStream& stream)
+  {
+    Close();
+    path_.clear();
+    stream_ = &stream;
   }
 
   void ZipWriter::SetZip64(bool isZip64)
   {
+    if (stream_ != NULL &&
+        IsOpen())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                             "Cannot change the format of a ZIP stream that is being written");
+    }
+
     Close();
     isZip64_ = isZip64;
   }
@@ -163,7 +758,16 @@ namespace Orthanc
                              "and 9 (highest compression)");
     }
 
-    Close();
+    if (stream_ == NULL)
+    {
+      Close();
+    }
+    else
+    {
+      // Streams can mix compression levels, that are applied to the
+      // next call to "OpenFile()"
+    }
+
     compressionLevel_ = level;
   }
 
@@ -171,6 +775,13 @@ namespace Orthanc
   {
     Open();
 
+    if (pimpl_->streamWriter_.get() != NULL)
+    {
+      pimpl_->streamWriter_->OpenFile(path, compressionLevel_);
+      hasFileInZip_ = true;
+      return;
+    }
+
     zip_fileinfo zfi;
     PrepareFileInfo(zfi);
 
@@ -223,6 +834,12 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadSequenceOfCalls, "Call first OpenFile()");
     }
 
+    if (pimpl_->streamWriter_.get() != NULL)
+    {
+      pimpl_->streamWriter_->Write(data, length);
+      return;
+    }
+
     const size_t maxBytesInAStep = std::numeric_limits<int32_t>::max();
 
     const char* p = reinterpret_cast<const char*>(data);
@@ -243,6 +860,52 @@ namespace Orthanc
   }
 
 
+  void ZipWriter::WriteCompressedFile(const char* path,
+                                      const CompressedFile& file)
+  {
+    Open();
+
+    if (pimpl_->streamWriter_.get() != NULL)
+    {
+      pimpl_->streamWriter_->WriteCompressedFile(path, file);
+      hasFileInZip_ = false;
+      return;
+    }
+
+    zip_fileinfo zfi;
+    PrepareFileInfo(zfi);
+
+    // With "raw == 1", minizip stores the content as such, and does
+    // not compute the CRC nor the uncompressed size
+    int result = zipOpenNewFileInZip2_64(pimpl_->file_, path,
+                                         &zfi,
+                                         NULL,   0,
+                                         NULL,   0,
+                                         "",  // Comment
+                                         file.IsDeflated() ? Z_DEFLATED : 0,
+                                         compressionLevel_,
+                                         1 /* raw */,
+                                         isZip64_ ? 1 : 0);
+
+    if (result != 0)
+    {
+      throw OrthancException(ErrorCode_CannotWriteFile,
+                             "Cannot add new file inside ZIP archive: " + std::string(path));
+    }
+
+    hasFileInZip_ = true;
+    Write(file.GetContent());
+
+    if (zipCloseFileInZipRaw64(pimpl_->file_, file.GetUncompressedSize(), file.GetCrc32()) != 0)
+    {
+      throw OrthancException(ErrorCode_CannotWriteFile,
+                             "Cannot write data to ZIP archive: " + path_);
+    }
+
+    hasFileInZip_ = false;
+  }
+
+
   void ZipWriter::SetAppendToExisting(bool append)
   {
     Close();
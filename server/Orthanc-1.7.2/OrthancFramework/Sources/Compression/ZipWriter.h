@@ -42,8 +42,66 @@ namespace Orthanc
 {
   class ORTHANC_PUBLIC ZipWriter : public boost::noncopyable
   {
+  public:
+    // Receives the bytes of an archive that is written as a stream
+    class ORTHANC_PUBLIC IOutputStream : public boost::noncopyable
+    {
+    public:
+      virtual ~IOutputStream()
+      {
+      }
+
+      virtual void Write(const void* data,
+                         size_t size) = 0;
+    };
+
+    /**
+     * Content of one file that is compressed independently of the
+     * archive, typically by another thread, before being appended by
+     * "WriteCompressedFile()". The compression level 0 stores the
+     * content as such, without the deflate method.
+     **/
+    class ORTHANC_PUBLIC CompressedFile : public boost::noncopyable
+    {
+    private:
+      std::string  content_;
+      uint32_t     crc32_;
+      uint64_t     uncompressedSize_;
+      bool         isDeflated_;
+
+    public:
+      CompressedFile(const void* data,
+                     size_t size,
+                     uint8_t compressionLevel);
+
+      CompressedFile(const std::string& data,
+                     uint8_t compressionLevel);
+
+      const std::string& GetContent() const
+      {
+        return content_;
+      }
+
+      uint32_t GetCrc32() const
+      {
+        return crc32_;
+      }
+
+      uint64_t GetUncompressedSize() const
+      {
+        return uncompressedSize_;
+      }
+
+      bool IsDeflated() const
+      {
+        return isDeflated_;
+      }
+    };
+
   private:
     struct PImpl;
+    class StreamWriter;
+
     boost::shared_ptr<PImpl> pimpl_;
 
     bool isZip64_;
@@ -51,6 +109,7 @@ namespace Orthanc
     bool append_;
     uint8_t compressionLevel_;
     std::string path_;
+    IOutputStream* stream_;
 
   public:
     ZipWriter();
@@ -91,10 +150,30 @@ namespace Orthanc
       return path_;
     }
 
+    /**
+     * Writes the archive to a stream instead of a file, without ever
+     * seeking backward: The CRC and the sizes of each file are stored
+     * in a data descriptor that follows its compressed content. The
+     * stream must outlive the writer. "Close()" must be called
+     * explicitly to write the central directory, as the destructor
+     * leaves an unfinished archive untouched in this mode.
+     **/
+    void SetOutputStream(IOutputStream& stream);
+
+    bool IsOutputStream() const
+    {
+      return stream_ != NULL;
+    }
+
     void OpenFile(const char* path);
 
     void Write(const void* data, size_t length);
 
     void Write(const std::string& data);
+
+    // Adds a new file whose content is already compressed, which
+    // closes the file that was created by "OpenFile()", if any
+    void WriteCompressedFile(const char* path,
+                             const CompressedFile& file);
   };
 }
@@ -0,0 +1,580 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomStreamReader.h"
+
+#include "DicomMap.h"
+#include "../Endianness.h"
+#include "../OrthancException.h"
+
+#include <string.h>
+
+
+namespace Orthanc
+{
+  static const uint32_t UNDEFINED_LENGTH = 0xffffffffu;
+
+  // Protection against malformed files with deeply nested sequences
+  static const unsigned int MAX_SEQUENCE_DEPTH = 64;
+
+  static const DicomTag DICOM_TAG_ITEM(0xfffe, 0xe000);
+  static const DicomTag DICOM_TAG_ITEM_DELIMITATION(0xfffe, 0xe00d);
+  static const DicomTag DICOM_TAG_SEQUENCE_DELIMITATION(0xfffe, 0xe0dd);
+  static const DicomTag DICOM_TAG_META_GROUP_LENGTH(0x0002, 0x0000);
+
+
+  static bool HasLongLength(ValueRepresentation vr)
+  {
+    // http://dicom.nema.org/medical/dicom/current/output/chtml/part05/chapter_7.html#table_7.1-1
+    switch (vr)
+    {
+      case ValueRepresentation_OtherByte:
+      case ValueRepresentation_OtherDouble:
+      case ValueRepresentation_OtherFloat:
+      case ValueRepresentation_OtherLong:
+      case ValueRepresentation_OtherWord:
+      case ValueRepresentation_Sequence:
+      case ValueRepresentation_UnlimitedCharacters:
+      case ValueRepresentation_UniversalResource:
+      case ValueRepresentation_UnlimitedText:
+      case ValueRepresentation_Unknown:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+
+  static bool IsImplicitContent(ValueRepresentation vr,
+                                bool explicitVR)
+  {
+    /**
+     * The content of an element with "UN" value representation and
+     * undefined length is encoded using the Implicit VR Little Endian
+     * transfer syntax, whatever the transfer syntax of the file:
+     * http://dicom.nema.org/medical/dicom/current/output/chtml/part05/sect_6.2.2.html
+     * In implicit VR, "vr" is always "ValueRepresentation_Unknown",
+     * which is consistent.
+     **/
+    return (!explicitVR ||
+            vr == ValueRepresentation_Unknown);
+  }
+
+
+  uint16_t DicomStreamReader::ReadUnsignedInteger16(size_t position,
+                                                    bool littleEndian) const
+  {
+    assert(position + 2 <= size_);
+
+    uint16_t value;
+    memcpy(&value, buffer_ + position, sizeof(value));
+    return (littleEndian ? le16toh(value) : be16toh(value));
+  }
+
+
+  uint32_t DicomStreamReader::ReadUnsignedInteger32(size_t position,
+                                                    bool littleEndian) const
+  {
+    assert(position + 4 <= size_);
+
+    uint32_t value;
+    memcpy(&value, buffer_ + position, sizeof(value));
+    return (littleEndian ? le32toh(value) : be32toh(value));
+  }
+
+
+  bool DicomStreamReader::ReadElementHeader(DicomTag& tag,
+                                            ValueRepresentation& vr,
+                                            uint32_t& length,
+                                            size_t& headerSize,
+                                            size_t position,
+                                            bool littleEndian,
+                                            bool explicitVR) const
+  {
+    // http://dicom.nema.org/medical/dicom/current/output/chtml/part05/chapter_7.html#sect_7.1.2
+    if (position + 8 > size_)
+    {
+      return false;
+    }
+
+    tag = DicomTag(ReadUnsignedInteger16(position, littleEndian),
+                   ReadUnsignedInteger16(position + 2, littleEndian));
+
+    if (tag.GetGroup() == 0xfffe ||  // Items and delimiters never have a VR
+        !explicitVR)
+    {
+      vr = ValueRepresentation_Unknown;
+      length = ReadUnsignedInteger32(position + 4, littleEndian);
+      headerSize = 8;
+      return true;
+    }
+
+    vr = StringToValueRepresentation(std::string(reinterpret_cast<const char*>(buffer_) + position + 4, 2), false);
+
+    if (vr == ValueRepresentation_NotSupported)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Unknown value representation in DICOM file");
+    }
+    else if (HasLongLength(vr))
+    {
+      if (position + 12 > size_)
+      {
+        return false;
+      }
+
+      length = ReadUnsignedInteger32(position + 8, littleEndian);
+      headerSize = 12;
+    }
+    else
+    {
+      length = ReadUnsignedInteger16(position + 6, littleEndian);
+      headerSize = 8;
+    }
+
+    return true;
+  }
+
+
+  bool DicomStreamReader::SkipSequence(size_t& position,
+                                       unsigned int depth,
+                                       bool littleEndian,
+                                       bool explicitVR) const
+  {
+    // "position" points right after the header of an element with
+    // undefined length, that contains a list of items (either a
+    // sequence, or encapsulated pixel data). "littleEndian" and
+    // "explicitVR" describe the encoding of the content of the items.
+
+    if (depth > MAX_SEQUENCE_DEPTH)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Too deeply nested sequences in DICOM file");
+    }
+
+    for (;;)
+    {
+      DicomTag tag(0, 0);
+      ValueRepresentation vr;
+      uint32_t length;
+      size_t headerSize;
+
+      if (!ReadElementHeader(tag, vr, length, headerSize, position, littleEndian, explicitVR))
+      {
+        return false;
+      }
+
+      position += headerSize;
+
+      if (tag == DICOM_TAG_SEQUENCE_DELIMITATION)
+      {
+        return true;
+      }
+      else if (tag != DICOM_TAG_ITEM)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Badly formatted sequence in DICOM file");
+      }
+      else if (length == UNDEFINED_LENGTH)
+      {
+        if (!SkipItem(position, depth + 1, littleEndian, explicitVR))
+        {
+          return false;
+        }
+      }
+      else
+      {
+        position += length;
+      }
+    }
+  }
+
+
+  bool DicomStreamReader::SkipItem(size_t& position,
+                                   unsigned int depth,
+                                   bool littleEndian,
+                                   bool explicitVR) const
+  {
+    // "position" points right after the header of an item with
+    // undefined length, whose end is marked by an item delimitation
+
+    for (;;)
+    {
+      DicomTag tag(0, 0);
+      ValueRepresentation vr;
+      uint32_t length;
+      size_t headerSize;
+
+      if (!ReadElementHeader(tag, vr, length, headerSize, position, littleEndian, explicitVR))
+      {
+        return false;
+      }
+
+      position += headerSize;
+
+      if (tag == DICOM_TAG_ITEM_DELIMITATION)
+      {
+        return true;
+      }
+      else if (length == UNDEFINED_LENGTH)
+      {
+        bool ok;
+        if (IsImplicitContent(vr, explicitVR))
+        {
+          ok = SkipSequence(position, depth, true, false);
+        }
+        else
+        {
+          ok = SkipSequence(position, depth, littleEndian, explicitVR);
+        }
+
+        if (!ok)
+        {
+          return false;
+        }
+      }
+      else
+      {
+        position += length;
+      }
+    }
+  }
+
+
+  namespace
+  {
+    class PixelDataVisitor : public DicomStreamReader::IVisitor
+    {
+    private:
+      bool      found_;
+      uint64_t  offset_;
+      uint32_t  length_;
+
+    public:
+      PixelDataVisitor() :
+        found_(false),
+        offset_(0),
+        length_(0)
+      {
+      }
+
+      bool IsFound() const
+      {
+        return found_;
+      }
+
+      uint64_t GetOffset() const
+      {
+        return offset_;
+      }
+
+      uint32_t GetLength() const
+      {
+        return length_;
+      }
+
+      virtual void VisitMetaHeaderTag(const DicomTag& tag,
+                                      ValueRepresentation vr,
+                                      const std::string& value) ORTHANC_OVERRIDE
+      {
+      }
+
+      virtual void VisitTransferSyntax(DicomTransferSyntax transferSyntax) ORTHANC_OVERRIDE
+      {
+      }
+
+      virtual bool VisitDatasetTag(const DicomTag& tag,
+                                   ValueRepresentation vr,
+                                   const std::string& value,
+                                   bool isLittleEndian) ORTHANC_OVERRIDE
+      {
+        return true;
+      }
+
+      virtual void VisitPixelData(uint64_t offset,
+                                  uint32_t length) ORTHANC_OVERRIDE
+      {
+        found_ = true;
+        offset_ = offset;
+        length_ = length;
+      }
+    };
+  }
+
+
+  bool DicomStreamReader::ReadMetaHeader(IVisitor& visitor,
+                                         size_t& position)
+  {
+    /**
+     * The DICOM File Meta Information must be encoded using the
+     * Explicit VR Little Endian Transfer Syntax
+     * (UID=1.2.840.10008.1.2.1).
+     **/
+
+    DicomTag tag(0, 0);
+    ValueRepresentation vr;
+    uint32_t length;
+    size_t headerSize;
+
+    position = 132;
+
+    if (!ReadElementHeader(tag, vr, length, headerSize, position, true, true))
+    {
+      return false;
+    }
+
+    if (tag != DICOM_TAG_META_GROUP_LENGTH ||
+        vr != ValueRepresentation_UnsignedLong ||
+        length != 4)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "No group length in the DICOM meta header");
+    }
+
+    if (position + headerSize + 4 > size_)
+    {
+      return false;
+    }
+
+    const size_t stop = position + headerSize + 4 + ReadUnsignedInteger32(position + headerSize, true);
+    position += headerSize + 4;
+
+    std::string transferSyntaxUid;
+
+    while (position < stop)
+    {
+      if (!ReadElementHeader(tag, vr, length, headerSize, position, true, true))
+      {
+        return false;
+      }
+
+      if (length == UNDEFINED_LENGTH ||
+          tag.GetGroup() != 0x0002)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat, "Badly formatted DICOM meta header");
+      }
+
+      if (position + headerSize + length > size_)
+      {
+        return false;
+      }
+
+      std::string value(reinterpret_cast<const char*>(buffer_) + position + headerSize, length);
+      position += headerSize + length;
+
+      visitor.VisitMetaHeaderTag(tag, vr, value);
+
+      if (tag == DICOM_TAG_TRANSFER_SYNTAX_UID)
+      {
+        // Remove the padding (NULL or space characters)
+        while (!value.empty() &&
+               (value[value.size() - 1] == '\0' ||
+                value[value.size() - 1] == ' '))
+        {
+          value.resize(value.size() - 1);
+        }
+
+        transferSyntaxUid = value;
+      }
+    }
+
+    DicomTransferSyntax transferSyntax;
+    if (!LookupTransferSyntax(transferSyntax, transferSyntaxUid))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat,
+                             "Unknown transfer syntax in DICOM file: " + transferSyntaxUid);
+    }
+
+    switch (transferSyntax)
+    {
+      case DicomTransferSyntax_LittleEndianImplicit:
+        isLittleEndian_ = true;
+        isExplicitVR_ = false;
+        break;
+
+      case DicomTransferSyntax_BigEndianExplicit:
+        isLittleEndian_ = false;
+        isExplicitVR_ = true;
+        break;
+
+      case DicomTransferSyntax_DeflatedLittleEndianExplicit:
+        throw OrthancException(ErrorCode_NotImplemented,
+                               "Cannot parse a deflated DICOM file without DCMTK");
+
+      default:
+        // All the other transfer syntaxes (including the
+        // encapsulated ones) use explicit VR little endian
+        isLittleEndian_ = true;
+        isExplicitVR_ = true;
+        break;
+    }
+
+    visitor.VisitTransferSyntax(transferSyntax);
+
+    return true;
+  }
+
+  
+  DicomStreamReader::DicomStreamReader(const void* buffer,
+                                       size_t size) :
+    buffer_(reinterpret_cast<const uint8_t*>(buffer)),
+    size_(size),
+    isLittleEndian_(true),
+    isExplicitVR_(true)
+  {
+    if (size_ != 0 &&
+        buffer_ == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+  }
+
+
+  bool DicomStreamReader::Consume(IVisitor& visitor)
+  {
+    if (size_ < 132)
+    {
+      return false;
+    }
+    else if (!DicomMap::IsDicomFile(buffer_, size_))
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Not a DICOM file");
+    }
+
+    size_t position;
+    if (!ReadMetaHeader(visitor, position))
+    {
+      return false;
+    }
+
+    for (;;)
+    {
+      DicomTag tag(0, 0);
+      ValueRepresentation vr;
+      uint32_t length;
+      size_t headerSize;
+
+      if (!ReadElementHeader(tag, vr, length, headerSize, position, isLittleEndian_, isExplicitVR_))
+      {
+        return false;
+      }
+
+      if (tag == DICOM_TAG_PIXEL_DATA)
+      {
+        visitor.VisitPixelData(position + headerSize, length);
+        return true;
+      }
+
+      position += headerSize;
+
+      if (length == UNDEFINED_LENGTH)
+      {
+        // Sequence, or element with "UN" value representation
+        bool ok;
+        if (IsImplicitContent(vr, isExplicitVR_))
+        {
+          ok = SkipSequence(position, 0, true, false);
+        }
+        else
+        {
+          ok = SkipSequence(position, 0, isLittleEndian_, isExplicitVR_);
+        }
+
+        if (!ok)
+        {
+          return false;
+        }
+        else if (!visitor.VisitDatasetTag(tag, vr, "", isLittleEndian_))
+        {
+          return true;
+        }
+      }
+      else if (position + length > size_)
+      {
+        return false;
+      }
+      else
+      {
+        std::string value;
+        if (vr != ValueRepresentation_Sequence)
+        {
+          value.assign(reinterpret_cast<const char*>(buffer_) + position, length);
+        }
+
+        position += length;
+
+        if (!visitor.VisitDatasetTag(tag, vr, value, isLittleEndian_))
+        {
+          return true;
+        }
+      }
+    }
+  }
+
+
+  bool DicomStreamReader::LookupPixelData(uint64_t& elementStart,
+                                          uint64_t& elementEnd)
+  {
+    PixelDataVisitor visitor;
+    if (!Consume(visitor) ||
+        !visitor.IsFound())
+    {
+      return false;
+    }
+
+    // In explicit VR, "PixelData" is either "OB" or "OW", whose
+    // header is 12 bytes long
+    const size_t headerSize = (isExplicitVR_ ? 12 : 8);
+    size_t position = static_cast<size_t>(visitor.GetOffset());
+
+    DicomTag tag(0, 0);
+    ValueRepresentation vr;
+    uint32_t length;
+    size_t size;
+
+    if (position < headerSize ||
+        !ReadElementHeader(tag, vr, length, size, position - headerSize, isLittleEndian_, isExplicitVR_) ||
+        tag != DICOM_TAG_PIXEL_DATA ||
+        size != headerSize)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat, "Badly formatted pixel data in DICOM file");
+    }
+
+    elementStart = position - headerSize;
+
+    if (visitor.GetLength() == UNDEFINED_LENGTH)
+    {
+      // Encapsulated pixel data: Skip the fragments
+      if (!SkipSequence(position, 0, isLittleEndian_, isExplicitVR_))
+      {
+        return false;
+      }
+
+      elementEnd = position;
+    }
+    else
+    {
+      elementEnd = visitor.GetOffset() + visitor.GetLength();
+    }
+
+    return (elementEnd <= size_);
+  }
+}
@@ -0,0 +1,137 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "DicomTag.h"
+#include "../Enumerations.h"
+
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <string>
+
+namespace Orthanc
+{
+  /**
+   * Lightweight parser of a DICOM file that is stored in a memory
+   * buffer, that does not rely on DCMTK. Only the top-level
+   * elements of the dataset are reported (sequences are skipped),
+   * and the parsing stops as soon as the "PixelData" tag is
+   * reached. The buffer may only contain the beginning of the DICOM
+   * file: This allows to locate the pixel data of the uncompressed
+   * images by reading only the header of the file.
+   **/
+  class ORTHANC_PUBLIC DicomStreamReader : public boost::noncopyable
+  {
+  public:
+    class IVisitor : public boost::noncopyable
+    {
+    public:
+      virtual ~IVisitor()
+      {
+      }
+
+      virtual void VisitMetaHeaderTag(const DicomTag& tag,
+                                      ValueRepresentation vr,
+                                      const std::string& value) = 0;
+
+      virtual void VisitTransferSyntax(DicomTransferSyntax transferSyntax) = 0;
+
+      // "vr" is "ValueRepresentation_Unknown" if the transfer syntax
+      // uses implicit VR. The value is provided as stored in the
+      // file (i.e. binary values are not converted to strings, and
+      // have the endianness of the transfer syntax). Return "false"
+      // to stop the parsing.
+      virtual bool VisitDatasetTag(const DicomTag& tag,
+                                   ValueRepresentation vr,
+                                   const std::string& value,
+                                   bool isLittleEndian) = 0;
+
+      // "offset" is the position of the value of the "PixelData"
+      // element in the file. "length" is "0xFFFFFFFF" if the pixel
+      // data is encapsulated (i.e. compressed transfer syntaxes).
+      virtual void VisitPixelData(uint64_t offset,
+                                  uint32_t length) = 0;
+    };
+
+  private:
+    const uint8_t*  buffer_;
+    size_t          size_;
+    bool            isLittleEndian_;
+    bool            isExplicitVR_;
+
+    uint16_t ReadUnsignedInteger16(size_t position,
+                                   bool littleEndian) const;
+
+    uint32_t ReadUnsignedInteger32(size_t position,
+                                   bool littleEndian) const;
+
+    bool ReadElementHeader(DicomTag& tag,
+                           ValueRepresentation& vr,
+                           uint32_t& length,
+                           size_t& headerSize,
+                           size_t position,
+                           bool littleEndian,
+                           bool explicitVR) const;
+
+    bool SkipSequence(size_t& position,
+                      unsigned int depth,
+                      bool littleEndian,
+                      bool explicitVR) const;
+
+    bool SkipItem(size_t& position,
+                  unsigned int depth,
+                  bool littleEndian,
+                  bool explicitVR) const;
+
+    bool ReadMetaHeader(IVisitor& visitor,
+                        size_t& position);
+
+  public:
+    DicomStreamReader(const void* buffer,
+                      size_t size);
+
+    /**
+     * Returns "true" iff. the parsing has come to its end, either
+     * because the "PixelData" tag was reached, or because the
+     * visitor has stopped the parsing. Returns "false" if the end of
+     * the buffer was reached, which means that more bytes of the
+     * DICOM file are needed (or that the dataset has no pixel data
+     * if the buffer contains the full file). An exception is thrown
+     * if the file is not a DICOM file, or if the transfer syntax is
+     * not supported (deflated transfer syntax).
+     **/
+    bool Consume(IVisitor& visitor);
+
+    /**
+     * Locates the "PixelData" element, including its header and, in
+     * the case of encapsulated pixel data, all of its fragments. The
+     * positions are relative to the beginning of the buffer, and
+     * "elementEnd" equals the size of the file iff. the pixel data is
+     * the last element of the dataset. Returns "false" if the dataset
+     * has no pixel data, or if the buffer is too short.
+     **/
+    bool LookupPixelData(uint64_t& elementStart,
+                         uint64_t& elementEnd);
+  };
+}
@@ -24,6 +24,7 @@
 #include "DicomServer.h"
 
 #include "../Logging.h"
+#include "../MetricsRegistry.h"
 #include "../MultiThreading/RunnableWorkersPool.h"
 #include "../OrthancException.h"
 #include "../Toolbox.h"
@@ -43,9 +44,31 @@ namespace Orthanc
     boost::thread  thread_;
     T_ASC_Network *network_;
     std::unique_ptr<RunnableWorkersPool>  workers_;
+
+    // Number of active associations, indexed by calling AET
+    boost::mutex                          associationsMutex_;
+    std::map<std::string, unsigned int>   associations_;
   };
 
 
+  void DicomServer::UpdateMetrics()
+  {
+    if (metrics_ != NULL)
+    {
+      size_t countWorkers = 0, countRunnables = 0, countWaiting = 0;
+
+      if (pimpl_->workers_.get() != NULL)
+      {
+        pimpl_->workers_->GetStatistics(countWorkers, countRunnables, countWaiting);
+      }
+
+      metrics_->SetValue("orthanc_dicom_threads_count", static_cast<float>(countWorkers));
+      metrics_->SetValue("orthanc_dicom_associations_active", static_cast<float>(countRunnables));
+      metrics_->SetValue("orthanc_dicom_associations_queued", static_cast<float>(countWaiting));
+    }
+  }
+
+
   void DicomServer::ServerThread(DicomServer* server)
   {
     LOG(INFO) << "DICOM server started";
@@ -67,6 +90,8 @@ namespace Orthanc
       {
         LOG(ERROR) << "Exception in the DICOM server thread: " << e.What();
       }
+
+      server->UpdateMetrics();
     }
 
     LOG(INFO) << "DICOM server stopping";
@@ -89,6 +114,10 @@ namespace Orthanc
     checkCalledAet_ = true;
     associationTimeout_ = 30;
     continue_ = false;
+    minThreads_ = 4;
+    maxThreads_ = 4;
+    maxAssociationsPerAet_ = 0;
+    metrics_ = NULL;
   }
 
   DicomServer::~DicomServer()
@@ -349,6 +378,67 @@ namespace Orthanc
     }
   }
 
+  void DicomServer::SetThreadsCount(unsigned int minThreads,
+                                    unsigned int maxThreads)
+  {
+    if (minThreads == 0 ||
+        minThreads > maxThreads)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "Invalid number of threads for the DICOM server: " +
+                             boost::lexical_cast<std::string>(minThreads) + " to " +
+                             boost::lexical_cast<std::string>(maxThreads));
+    }
+
+    Stop();
+    minThreads_ = minThreads;
+    maxThreads_ = maxThreads;
+  }
+
+  unsigned int DicomServer::GetMinimumThreadsCount() const
+  {
+    return minThreads_;
+  }
+
+  unsigned int DicomServer::GetMaximumThreadsCount() const
+  {
+    return maxThreads_;
+  }
+
+  void DicomServer::SetMaximumAssociationsPerAETitle(unsigned int count)
+  {
+    Stop();
+    maxAssociationsPerAet_ = count;
+  }
+
+  unsigned int DicomServer::GetMaximumAssociationsPerAETitle() const
+  {
+    return maxAssociationsPerAet_;
+  }
+
+  void DicomServer::SetMetricsRegistry(MetricsRegistry& metrics)
+  {
+    Stop();
+    metrics_ = &metrics;
+  }
+
+  bool DicomServer::HasMetricsRegistry() const
+  {
+    return (metrics_ != NULL);
+  }
+
+  MetricsRegistry& DicomServer::GetMetricsRegistry() const
+  {
+    if (HasMetricsRegistry())
+    {
+      return *metrics_;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
   void DicomServer::Start()
   {
     if (modalities_ == NULL)
@@ -369,7 +459,7 @@ namespace Orthanc
     }
 
     continue_ = true;
-    pimpl_->workers_.reset(new RunnableWorkersPool(4));   // Use 4 workers - TODO as a parameter?
+    pimpl_->workers_.reset(new RunnableWorkersPool(minThreads_, maxThreads_));
     pimpl_->thread_ = boost::thread(ServerThread, this);
   }
 
@@ -386,6 +476,7 @@ namespace Orthanc
       }
 
       pimpl_->workers_.reset(NULL);
+      UpdateMetrics();
 
       /* drop the network, i.e. free memory of T_ASC_Network* structure. This call */
       /* is the counterpart of ASC_initializeNetwork(...) which was called above. */
@@ -415,4 +506,49 @@ namespace Orthanc
       return modalities_->IsSameAETitle(aet, GetApplicationEntityTitle());
     }
   }
+
+
+  bool DicomServer::RegisterAssociation(const std::string& remoteAet) const
+  {
+    boost::mutex::scoped_lock lock(pimpl_->associationsMutex_);
+
+    std::map<std::string, unsigned int>::iterator found = pimpl_->associations_.find(remoteAet);
+
+    if (found == pimpl_->associations_.end())
+    {
+      pimpl_->associations_[remoteAet] = 1;
+      return true;
+    }
+    else if (maxAssociationsPerAet_ != 0 &&
+             found->second >= maxAssociationsPerAet_)
+    {
+      return false;
+    }
+    else
+    {
+      found->second++;
+      return true;
+    }
+  }
+
+
+  void DicomServer::UnregisterAssociation(const std::string& remoteAet) const
+  {
+    boost::mutex::scoped_lock lock(pimpl_->associationsMutex_);
+
+    std::map<std::string, unsigned int>::iterator found = pimpl_->associations_.find(remoteAet);
+
+    if (found == pimpl_->associations_.end())
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+    else if (found->second == 1)
+    {
+      pimpl_->associations_.erase(found);
+    }
+    else
+    {
+      found->second--;
+    }
+  }
 }
@@ -41,6 +41,8 @@
 
 namespace Orthanc
 {
+  class MetricsRegistry;
+
   class DicomServer : public boost::noncopyable
   {
   public:
@@ -76,9 +78,15 @@ namespace Orthanc
     IWorklistRequestHandlerFactory* worklistRequestHandlerFactory_;
     IStorageCommitmentRequestHandlerFactory* storageCommitmentFactory_;
     IApplicationEntityFilter* applicationEntityFilter_;
+    unsigned int minThreads_;
+    unsigned int maxThreads_;
+    unsigned int maxAssociationsPerAet_;
+    MetricsRegistry* metrics_;
 
     static void ServerThread(DicomServer* server);
 
+    void UpdateMetrics();
+
   public:
     DicomServer();
 
@@ -127,11 +135,33 @@ namespace Orthanc
     bool HasApplicationEntityFilter() const;
     IApplicationEntityFilter& GetApplicationEntityFilter() const;
 
+    // The pool of threads that handle the DICOM associations grows
+    // from "min" up to "max" threads depending on the load
+    void SetThreadsCount(unsigned int minThreads,
+                         unsigned int maxThreads);
+    unsigned int GetMinimumThreadsCount() const;
+    unsigned int GetMaximumThreadsCount() const;
+
+    // Maximum number of simultaneous associations from the same
+    // calling AET ("0" means no limit)
+    void SetMaximumAssociationsPerAETitle(unsigned int count);
+    unsigned int GetMaximumAssociationsPerAETitle() const;
+
+    void SetMetricsRegistry(MetricsRegistry& metrics);
+    bool HasMetricsRegistry() const;
+    MetricsRegistry& GetMetricsRegistry() const;
+
     void Start();
   
     void Stop();
 
     bool IsMyAETitle(const std::string& aet) const;
+
+    // Reserves one association slot for the given calling AET, returns
+    // "false" if the limit on the simultaneous associations is reached
+    bool RegisterAssociation(const std::string& remoteAet) const;
+
+    void UnregisterAssociation(const std::string& remoteAet) const;
   };
 
 }
@@ -83,6 +83,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../../Compatibility.h"
 #include "../../Toolbox.h"
 #include "../../Logging.h"
+#include "../../MetricsRegistry.h"
 #include "../../OrthancException.h"
 
 #include <dcmtk/dcmdata/dcdeftag.h>     /* for storage commitment */
@@ -669,11 +670,29 @@ namespace Orthanc
         return NULL;
       }
 
+      if (!server.RegisterAssociation(remoteAet))
+      {
+        /* reject: too many simultaneous associations from this AET, the modality can retry later */
+        LOG(WARNING) << "Rejected association for remote AET " << remoteAet << " on IP " << remoteIp
+                     << ", as it has reached the maximum number of simultaneous associations ("
+                     << server.GetMaximumAssociationsPerAETitle() << ")";
+        T_ASC_RejectParameters rej =
+          {
+            ASC_RESULT_REJECTEDTRANSIENT,
+            ASC_SOURCE_SERVICEPROVIDER_PRESENTATION_RELATED,
+            ASC_REASON_SP_PRES_LOCALLIMITEXCEEDED
+          };
+        ASC_rejectAssociation(assoc, &rej);
+        AssociationCleanup(assoc);
+        return NULL;
+      }
+
       {
         cond = ASC_acknowledgeAssociation(assoc);
         if (cond.bad())
         {
           LOG(ERROR) << cond.text();
+          server.UnregisterAssociation(remoteAet);
           AssociationCleanup(assoc);
           return NULL;
         }
@@ -715,6 +734,15 @@ namespace Orthanc
       {
         LOG(ERROR) << "Some association was not cleanly aborted";
       }
+
+      try
+      {
+        server_.UnregisterAssociation(remoteAet_);
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Internal error in the count of the DICOM associations";
+      }
     }
 
 
@@ -829,6 +857,15 @@ namespace Orthanc
           // If anything goes wrong, there will be a "BADCOMMANDTYPE" answer
           cond = DIMSE_BADCOMMANDTYPE;
 
+          // Latency of the DIMSE command, labeled by the type of request
+          std::unique_ptr<MetricsRegistry::HistogramTimer> timer;
+          if (server_.HasMetricsRegistry())
+          {
+            timer.reset(new MetricsRegistry::HistogramTimer(
+                          server_.GetMetricsRegistry(), "orthanc_dicom_command_duration_ms{command=\"" +
+                          std::string(EnumerationToString(request)) + "\"}"));
+          }
+
           switch (request)
           {
             case DicomRequestType_Echo:
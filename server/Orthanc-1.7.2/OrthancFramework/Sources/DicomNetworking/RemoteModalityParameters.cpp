@@ -44,6 +44,7 @@ static const char* KEY_ALLOW_TRANSCODING = "AllowTranscoding";
 static const char* KEY_HOST = "Host";
 static const char* KEY_MANUFACTURER = "Manufacturer";
 static const char* KEY_PORT = "Port";
+static const char* KEY_STORE_ASSOCIATIONS_COUNT = "StoreAssociationsCount";
 
 
 namespace Orthanc
@@ -62,6 +63,7 @@ namespace Orthanc
     allowNAction_ = true;  // For storage commitment
     allowNEventReport_ = true;  // For storage commitment
     allowTranscoding_ = true;
+    storeAssociationsCount_ = 1;
   }
 
 
@@ -128,6 +130,29 @@ namespace Orthanc
   }
 
 
+  const unsigned int RemoteModalityParameters::MAX_STORE_ASSOCIATIONS;
+
+
+  void RemoteModalityParameters::SetStoreAssociationsCount(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "At least one association is needed to send instances to a modality");
+    }
+    else if (count > MAX_STORE_ASSOCIATIONS)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "At most " + boost::lexical_cast<std::string>(MAX_STORE_ASSOCIATIONS) +
+                             " associations can be used to send instances to a modality");
+    }
+    else
+    {
+      storeAssociationsCount_ = count;
+    }
+  }
+
+
   void RemoteModalityParameters::UnserializeArray(const Json::Value& serialized)
   {
     assert(serialized.type() == Json::arrayValue);
@@ -229,6 +254,11 @@ namespace Orthanc
     {
       allowTranscoding_ = SerializationToolbox::ReadBoolean(serialized, KEY_ALLOW_TRANSCODING);
     }
+
+    if (serialized.isMember(KEY_STORE_ASSOCIATIONS_COUNT))
+    {
+      SetStoreAssociationsCount(SerializationToolbox::ReadUnsignedInteger(serialized, KEY_STORE_ASSOCIATIONS_COUNT));
+    }
   }
 
 
@@ -311,7 +341,8 @@ namespace Orthanc
             !allowMove_ ||
             !allowNAction_ ||
             !allowNEventReport_ ||
-            !allowTranscoding_);
+            !allowTranscoding_ ||
+            storeAssociationsCount_ != 1);
   }
 
   
@@ -334,6 +365,7 @@ namespace Orthanc
       target[KEY_ALLOW_N_ACTION] = allowNAction_;
       target[KEY_ALLOW_N_EVENT_REPORT] = allowNEventReport_;
       target[KEY_ALLOW_TRANSCODING] = allowTranscoding_;
+      target[KEY_STORE_ASSOCIATIONS_COUNT] = storeAssociationsCount_;
     }
     else
     {
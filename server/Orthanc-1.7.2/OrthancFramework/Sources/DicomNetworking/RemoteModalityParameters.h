@@ -45,6 +45,7 @@ namespace Orthanc
     bool                  allowNAction_;
     bool                  allowNEventReport_;
     bool                  allowTranscoding_;
+    unsigned int          storeAssociationsCount_;
     
     void Clear();
 
@@ -53,6 +54,9 @@ namespace Orthanc
     void UnserializeObject(const Json::Value& serialized);
 
   public:
+    // Each association comes with a thread of the job
+    static const unsigned int MAX_STORE_ASSOCIATIONS = 16;
+
     RemoteModalityParameters()
     {
       Clear();
@@ -131,5 +135,14 @@ namespace Orthanc
     {
       allowTranscoding_ = allowed;
     }
+
+    // Number of associations that are opened in parallel to send
+    // instances to this modality by C-STORE (defaults to 1)
+    unsigned int GetStoreAssociationsCount() const
+    {
+      return storeAssociationsCount_;
+    }
+
+    void SetStoreAssociationsCount(unsigned int count);
   };
 }
@@ -149,6 +149,19 @@ namespace Orthanc
   }
 
 
+  void FilesystemStorage::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType type,
+                                    uint64_t start /* inclusive */,
+                                    uint64_t end /* exclusive */)
+  {
+    LOG(INFO) << "Reading range [" << start << "," << end << "[ of attachment \"" << uuid
+              << "\" of \"" << GetDescriptionInternal(type) << "\" content type";
+
+    SystemToolbox::ReadFileRange(content, GetPath(uuid).string(), start, end, true /* throw if overflow */);
+  }
+
+
   uintmax_t FilesystemStorage::GetSize(const std::string& uuid) const
   {
     boost::filesystem::path path = GetPath(uuid);
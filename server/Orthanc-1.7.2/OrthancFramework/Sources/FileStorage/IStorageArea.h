@@ -24,6 +24,7 @@
 
 #include "../Enumerations.h"
 
+#include <stdint.h>
 #include <string>
 #include <boost/noncopyable.hpp>
 
@@ -45,6 +46,18 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type) = 0;
 
+    // Whether "ReadRange()" is able to read a part of the file
+    // without reading the file as a whole
+    virtual bool HasReadRange() const = 0;
+
+    // Reads the bytes in the range [start, end[ of the file. An
+    // exception is thrown if "end" goes beyond the size of the file.
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start /* inclusive */,
+                           uint64_t end /* exclusive */) = 0;
+
     virtual void Remove(const std::string& uuid,
                         FileContentType type) = 0;
   };
@@ -49,6 +49,17 @@ namespace Orthanc
                       const std::string& uuid,
                       FileContentType type);
 
+    virtual bool HasReadRange() const
+    {
+      return true;
+    }
+
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start /* inclusive */,
+                           uint64_t end /* exclusive */);
+
     virtual void Remove(const std::string& uuid,
                         FileContentType type);
   };
@@ -23,6 +23,7 @@
 #include "../PrecompiledHeaders.h"
 #include "StorageAccessor.h"
 
+#include "../Cache/MemoryStringCache.h"
 #include "../Compatibility.h"
 #include "../Compression/ZlibCompressor.h"
 #include "../MetricsRegistry.h"
@@ -30,6 +31,7 @@
 #include "../Toolbox.h"
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+#  include "../HttpServer/FilesystemHttpSender.h"
 #  include "../HttpServer/HttpStreamTranscoder.h"
 #endif
 
@@ -38,26 +40,65 @@ static const std::string METRICS_CREATE = "orthanc_storage_create_duration_ms";
 static const std::string METRICS_READ = "orthanc_storage_read_duration_ms";
 static const std::string METRICS_REMOVE = "orthanc_storage_remove_duration_ms";
 
+static const std::string HISTOGRAM_CREATE = "orthanc_storage_latency_ms{operation=\"create\"}";
+static const std::string HISTOGRAM_READ = "orthanc_storage_latency_ms{operation=\"read\"}";
+static const std::string HISTOGRAM_REMOVE = "orthanc_storage_latency_ms{operation=\"remove\"}";
+
 
 namespace Orthanc
 {
   class StorageAccessor::MetricsTimer : public boost::noncopyable
   {
   private:
-    std::unique_ptr<MetricsRegistry::Timer>  timer_;
+    std::unique_ptr<MetricsRegistry::Timer>           timer_;
+    std::unique_ptr<MetricsRegistry::HistogramTimer>  histogram_;
 
   public:
     MetricsTimer(StorageAccessor& that,
-                 const std::string& name)
+                 const std::string& name,
+                 const std::string& histogram)
     {
       if (that.metrics_ != NULL)
       {
         timer_.reset(new MetricsRegistry::Timer(*that.metrics_, name));
+        histogram_.reset(new MetricsRegistry::HistogramTimer(*that.metrics_, histogram));
       }
     }
   };
 
 
+  bool StorageAccessor::FetchFromCache(std::string& content,
+                                       const FileInfo& info)
+  {
+    return (cache_ != NULL &&
+            cache_->Fetch(content, info.GetUuid()));
+  }
+
+
+  bool StorageAccessor::FetchRangeFromCache(std::string& content,
+                                            const FileInfo& info,
+                                            uint64_t start,
+                                            uint64_t end)
+  {
+    // Only the requested range is copied out of the cache, which
+    // matters for the partial reads of large attachments
+    return (cache_ != NULL &&
+            cache_->FetchRange(content, info.GetUuid(), static_cast<size_t>(start), static_cast<size_t>(end)));
+  }
+
+
+  void StorageAccessor::AddToCache(const FileInfo& info,
+                                   const std::string& content)
+  {
+    // Attachments that could not fit in the cache are not copied
+    if (cache_ != NULL &&
+        content.size() <= cache_->GetMaximumSize())
+    {
+      cache_->Add(info.GetUuid(), content);
+    }
+  }
+
+
   FileInfo StorageAccessor::Write(const void* data,
                                   size_t size,
                                   FileContentType type,
@@ -77,7 +118,7 @@ namespace Orthanc
     {
       case CompressionType_None:
       {
-        MetricsTimer timer(*this, METRICS_CREATE);
+        MetricsTimer timer(*this, METRICS_CREATE, HISTOGRAM_CREATE);
 
         area_.Create(uuid, data, size, type);
         return FileInfo(uuid, type, size, md5);
@@ -98,7 +139,7 @@ namespace Orthanc
         }
 
         {
-          MetricsTimer timer(*this, METRICS_CREATE);
+          MetricsTimer timer(*this, METRICS_CREATE, HISTOGRAM_CREATE);
 
           if (compressed.size() > 0)
           {
@@ -123,11 +164,16 @@ namespace Orthanc
   void StorageAccessor::Read(std::string& content,
                              const FileInfo& info)
   {
+    if (FetchFromCache(content, info))
+    {
+      return;
+    }
+
     switch (info.GetCompressionType())
     {
       case CompressionType_None:
       {
-        MetricsTimer timer(*this, METRICS_READ);
+        MetricsTimer timer(*this, METRICS_READ, HISTOGRAM_READ);
         area_.Read(content, info.GetUuid(), info.GetContentType());
         break;
       }
@@ -139,7 +185,7 @@ namespace Orthanc
         std::string compressed;
 
         {
-          MetricsTimer timer(*this, METRICS_READ);
+          MetricsTimer timer(*this, METRICS_READ, HISTOGRAM_READ);
           area_.Read(compressed, info.GetUuid(), info.GetContentType());
         }
 
@@ -154,37 +200,73 @@ namespace Orthanc
     }
 
     // TODO Check the validity of the uncompressed MD5?
+
+    AddToCache(info, content);
   }
 
 
   void StorageAccessor::ReadRaw(std::string& content,
                                 const FileInfo& info)
   {
-    MetricsTimer timer(*this, METRICS_READ);
+    MetricsTimer timer(*this, METRICS_READ, HISTOGRAM_READ);
     area_.Read(content, info.GetUuid(), info.GetContentType());
   }
 
 
-  void StorageAccessor::Remove(const std::string& fileUuid,
-                               FileContentType type)
+  void StorageAccessor::ReadRange(std::string& content,
+                                  const FileInfo& info,
+                                  uint64_t start /* inclusive */,
+                                  uint64_t end /* exclusive */)
   {
-    MetricsTimer timer(*this, METRICS_REMOVE);
-    area_.Remove(fileUuid, type);
+    if (start > end ||
+        end > info.GetUncompressedSize())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (FetchRangeFromCache(content, info, start, end))
+    {
+      return;
+    }
+    else if (info.GetCompressionType() == CompressionType_None &&
+             area_.HasReadRange())
+    {
+      MetricsTimer timer(*this, METRICS_READ, HISTOGRAM_READ);
+      area_.ReadRange(content, info.GetUuid(), info.GetContentType(), start, end);
+    }
+    else
+    {
+      std::string whole;
+      Read(whole, info);
+
+      if (end > whole.size())
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+      else
+      {
+        content.assign(whole, static_cast<size_t>(start), static_cast<size_t>(end - start));
+      }
+    }
   }
 
 
-#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
-  void StorageAccessor::SetupSender(BufferHttpSender& sender,
-                                    const FileInfo& info,
-                                    const std::string& mime)
+  void StorageAccessor::Remove(const std::string& fileUuid,
+                               FileContentType type)
   {
+    if (cache_ != NULL)
     {
-      MetricsTimer timer(*this, METRICS_READ);
-      area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
+      cache_->Invalidate(fileUuid);
     }
 
-    sender.SetContentType(mime);
+    MetricsTimer timer(*this, METRICS_REMOVE, HISTOGRAM_REMOVE);
+    area_.Remove(fileUuid, type);
+  }
 
+
+#if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
+  static std::string GetContentFilename(const FileInfo& info)
+  {
     const char* extension;
     switch (info.GetContentType())
     {
@@ -201,7 +283,55 @@ namespace Orthanc
         extension = "";
     }
 
-    sender.SetContentFilename(info.GetUuid() + std::string(extension));
+    return info.GetUuid() + std::string(extension);
+  }
+
+
+  void StorageAccessor::SetupSender(BufferHttpSender& sender,
+                                    const FileInfo& info,
+                                    const std::string& mime)
+  {
+    {
+      MetricsTimer timer(*this, METRICS_READ, HISTOGRAM_READ);
+      area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
+    }
+
+    sender.SetContentType(mime);
+    sender.SetContentFilename(GetContentFilename(info));
+  }
+
+
+  HttpFileSender* StorageAccessor::CreateStreamingSender(const FileInfo& info,
+                                                         const std::string& mime)
+  {
+    /**
+     * If the attachment is stored uncompressed on the filesystem, it
+     * can be streamed by chunks directly from the disk to the HTTP
+     * client, which avoids loading the full file in memory. Returns
+     * NULL if streaming is not possible.
+     **/
+
+    if (info.GetCompressionType() != CompressionType_None)
+    {
+      return NULL;
+    }
+
+    const FilesystemStorage* filesystem = dynamic_cast<const FilesystemStorage*>(&area_);
+    if (filesystem == NULL)
+    {
+      return NULL;
+    }
+
+    std::unique_ptr<FilesystemHttpSender> sender;
+
+    {
+      MetricsTimer timer(*this, METRICS_READ, HISTOGRAM_READ);
+      sender.reset(new FilesystemHttpSender(*filesystem, info.GetUuid()));
+    }
+
+    sender->SetContentType(mime);
+    sender->SetContentFilename(GetContentFilename(info));
+    return sender.release();
   }
 #endif
 
@@ -211,6 +341,24 @@ namespace Orthanc
                                    const FileInfo& info,
                                    const std::string& mime)
   {
+    {
+      BufferHttpSender cached;
+      if (FetchFromCache(cached.GetBuffer(), info))
+      {
+        cached.SetContentType(mime);
+        cached.SetContentFilename(GetContentFilename(info));
+        output.Answer(cached);
+        return;
+      }
+    }
+
+    std::unique_ptr<HttpFileSender> streaming(CreateStreamingSender(info, mime));
+    if (streaming.get() != NULL)
+    {
+      output.Answer(*streaming);
+      return;
+    }
+
     BufferHttpSender sender;
     SetupSender(sender, info, mime);
   
@@ -225,6 +373,24 @@ namespace Orthanc
                                    const FileInfo& info,
                                    const std::string& mime)
   {
+    {
+      BufferHttpSender cached;
+      if (FetchFromCache(cached.GetBuffer(), info))
+      {
+        cached.SetContentType(mime);
+        cached.SetContentFilename(GetContentFilename(info));
+        output.AnswerStream(cached);
+        return;
+      }
+    }
+
+    std::unique_ptr<HttpFileSender> streaming(CreateStreamingSender(info, mime));
+    if (streaming.get() != NULL)
+    {
+      output.AnswerStream(*streaming);
+      return;
+    }
+
     BufferHttpSender sender;
     SetupSender(sender, info, mime);
   
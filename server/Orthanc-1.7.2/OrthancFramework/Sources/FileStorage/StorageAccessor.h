@@ -53,30 +53,49 @@
 
 namespace Orthanc
 {
+  class MemoryStringCache;
   class MetricsRegistry;
 
   /**
    * This class handles the compression/decompression of the raw files
    * contained in the storage area, and monitors timing metrics (if
-   * enabled).
+   * enabled). If a cache is provided, the uncompressed content of the
+   * attachments that are read is kept in memory, indexed by the UUID
+   * of the attachment (as attachments are never modified in place).
    **/
   class ORTHANC_PUBLIC StorageAccessor : boost::noncopyable
   {
   private:
     class MetricsTimer;
 
-    IStorageArea&     area_;
-    MetricsRegistry*  metrics_;
+    IStorageArea&       area_;
+    MemoryStringCache*  cache_;
+    MetricsRegistry*    metrics_;
+
+    bool FetchFromCache(std::string& content,
+                        const FileInfo& info);
+
+    bool FetchRangeFromCache(std::string& content,
+                             const FileInfo& info,
+                             uint64_t start,
+                             uint64_t end);
+
+    void AddToCache(const FileInfo& info,
+                    const std::string& content);
 
 #if ORTHANC_ENABLE_CIVETWEB == 1 || ORTHANC_ENABLE_MONGOOSE == 1
     void SetupSender(BufferHttpSender& sender,
                      const FileInfo& info,
                      const std::string& mime);
+
+    HttpFileSender* CreateStreamingSender(const FileInfo& info,
+                                          const std::string& mime);
 #endif
 
   public:
     StorageAccessor(IStorageArea& area) : 
       area_(area),
+      cache_(NULL),
       metrics_(NULL)
     {
     }
@@ -84,6 +103,17 @@ namespace Orthanc
     StorageAccessor(IStorageArea& area,
                     MetricsRegistry& metrics) : 
       area_(area),
+      cache_(NULL),
+      metrics_(&metrics)
+    {
+    }
+
+    // The cache can be NULL, which disables caching
+    StorageAccessor(IStorageArea& area,
+                    MemoryStringCache* cache,
+                    MetricsRegistry& metrics) : 
+      area_(area),
+      cache_(cache),
       metrics_(&metrics)
     {
     }
@@ -109,6 +139,16 @@ namespace Orthanc
     void ReadRaw(std::string& content,
                  const FileInfo& info);
 
+    /**
+     * Reads the bytes [start, end[ of the uncompressed attachment. If
+     * the attachment is not compressed, only the requested range is
+     * read from the storage area (if supported by the latter).
+     **/
+    void ReadRange(std::string& content,
+                   const FileInfo& info,
+                   uint64_t start /* inclusive */,
+                   uint64_t end /* exclusive */);
+
     void Remove(const std::string& fileUuid,
                 FileContentType type);
 
@@ -33,6 +33,7 @@
 #include <curl/curl.h>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/thread/mutex.hpp>
+#include <list>
 
 // Default timeout = 60 seconds (in Orthanc <= 1.5.6, it was 10 seconds)
 static const unsigned int DEFAULT_HTTP_TIMEOUT = 60;
@@ -446,6 +447,7 @@ namespace Orthanc
     std::string     proxy_;
     long            timeout_;
     bool            verbose_;
+    std::list<CURL*>  idleHandles_;
 
     GlobalParameters() : 
       httpsVerifyPeers_(true),
@@ -535,6 +537,71 @@ namespace Orthanc
     {
       verbose_ = verbose;
     }
+
+    /**
+     * Pool of cURL handles. A cURL handle keeps its connections open
+     * after a request (keep-alive, TLS sessions and DNS cache), so
+     * reusing the handles of the HTTP clients that were destroyed
+     * avoids one TCP/TLS handshake per request to the same server.
+     **/
+    CURL* AcquireHandle()
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (!idleHandles_.empty())
+        {
+          CURL* handle = idleHandles_.front();
+          idleHandles_.pop_front();
+          return handle;
+        }
+      }
+
+      CURL* handle = curl_easy_init();
+      if (handle == NULL)
+      {
+        throw OrthancException(ErrorCode_InternalError,
+                               "Cannot initialize a cURL handle");
+      }
+      
+      return handle;
+    }
+
+    void ReleaseHandle(CURL* handle)
+    {
+      // Reset all the options, but keep the open connections
+      curl_easy_reset(handle);
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (idleHandles_.size() < HttpClient::MAX_IDLE_HANDLES)
+        {
+          idleHandles_.push_back(handle);
+          return;
+        }
+      }
+
+      curl_easy_cleanup(handle);
+    }
+
+    size_t GetIdleHandlesCount()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return idleHandles_.size();
+    }
+
+    void ClearIdleHandles()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      for (std::list<CURL*>::iterator it = idleHandles_.begin(); it != idleHandles_.end(); ++it)
+      {
+        curl_easy_cleanup(*it);
+      }
+
+      idleHandles_.clear();
+    }
   };
 
 
@@ -604,7 +671,7 @@ namespace Orthanc
     pimpl_->defaultChunkedHeaders_.AddHeader("Expect", "");
     pimpl_->defaultChunkedHeaders_.AddHeader("Transfer-Encoding", "chunked");
 
-    pimpl_->curl_ = curl_easy_init();
+    pimpl_->curl_ = GlobalParameters::GetInstance().AcquireHandle();
 
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HEADERFUNCTION, &CurlAnswer::HeaderCallback));
     CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_WRITEFUNCTION, &CurlAnswer::BodyCallback));
@@ -675,7 +742,17 @@ namespace Orthanc
 
   HttpClient::~HttpClient()
   {
-    curl_easy_cleanup(pimpl_->curl_);
+    if (pkcs11Enabled_ ||
+        !clientCertificateFile_.empty())
+    {
+      // Never share the connections that are authenticated by a
+      // client certificate with other HTTP clients
+      curl_easy_cleanup(pimpl_->curl_);
+    }
+    else
+    {
+      GlobalParameters::GetInstance().ReleaseHandle(pimpl_->curl_);
+    }
   }
 
 
@@ -1075,8 +1152,18 @@ namespace Orthanc
   }
 
 
+  const size_t HttpClient::MAX_IDLE_HANDLES;
+
+
+  size_t HttpClient::GetIdleHandlesCount()
+  {
+    return GlobalParameters::GetInstance().GetIdleHandlesCount();
+  }
+
+
   void HttpClient::GlobalFinalize()
   {
+    GlobalParameters::GetInstance().ClearIdleHandles();
     curl_global_cleanup();
 
 #if ORTHANC_ENABLE_PKCS11 == 1
@@ -296,10 +296,16 @@ namespace Orthanc
       return redirectionFollowed_;
     }
 
+    // Maximum number of idle cURL handles that are kept to be reused
+    // by the next HTTP clients, together with their open connections
+    static const size_t MAX_IDLE_HANDLES = 16;
+
     static void GlobalInitialize();
   
     static void GlobalFinalize();
 
+    static size_t GetIdleHandlesCount();
+
     static void InitializePkcs11(const std::string& module,
                                  const std::string& pin,
                                  bool verbose);
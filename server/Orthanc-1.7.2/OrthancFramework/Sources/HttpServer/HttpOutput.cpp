@@ -33,9 +33,18 @@
 #include <iostream>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 #include <boost/lexical_cast.hpp>
 
 
+/**
+ * Compressing a stream on-the-fly requires buffering it as a whole
+ * in memory. Above this size, the stream is sent uncompressed, which
+ * allows to serve large files by chunks without memory spikes.
+ **/
+static const uint64_t MAX_SIZE_FOR_STREAM_COMPRESSION = 64 * 1024 * 1024;  // 64MB
+
+
 #if ORTHANC_ENABLE_CIVETWEB == 1
 #  if !defined(CIVETWEB_HAS_DISABLE_KEEP_ALIVE)
 #    error Macro CIVETWEB_HAS_DISABLE_KEEP_ALIVE must be defined
@@ -154,7 +163,8 @@ namespace Orthanc
       }
     }
 
-    if (state_ == State_WritingMultipart)
+    if (state_ == State_WritingMultipart ||
+        state_ == State_WritingStream)
     {
       throw OrthancException(ErrorCode_InternalError);
     }
@@ -245,6 +255,10 @@ namespace Orthanc
         throw OrthancException(ErrorCode_BadSequenceOfCalls,
                                "Cannot invoke CloseBody() with multipart outputs");
 
+      case State_WritingStream:
+        throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                               "Cannot invoke CloseBody() with chunked outputs");
+
       case State_Done:
         return;  // Ignore
 
@@ -471,34 +485,21 @@ namespace Orthanc
   }
 
 
-  void HttpOutput::StateMachine::StartMultipart(const std::string& subType,
-                                                const std::string& contentType)
+  void HttpOutput::StateMachine::AddConnectionHeaderWithoutLength(std::string& header)
   {
-    if (state_ != State_WritingHeader)
-    {
-      throw OrthancException(ErrorCode_BadSequenceOfCalls);
-    }
-
-    if (status_ != HttpStatus_200_Ok)
-    {
-      SendBody(NULL, 0);
-      return;
-    }
-
-    stream_.OnHttpStatusReceived(status_);
-
-    std::string header = "HTTP/1.1 200 OK\r\n";
-
+    // This is used by the answers whose "Content-Length" is unknown
+    // when sending the HTTP header (multipart and chunked streams)
+    
     if (keepAlive_)
     {
 #if ORTHANC_ENABLE_MONGOOSE == 1
       throw OrthancException(ErrorCode_NotImplemented,
-                             "Multipart answers are not implemented together "
-                             "with keep-alive connections if using Mongoose");
+                             "Multipart and chunked answers are not implemented "
+                             "together with keep-alive connections if using Mongoose");
       
 #elif ORTHANC_ENABLE_CIVETWEB == 1
 #  if CIVETWEB_HAS_DISABLE_KEEP_ALIVE == 1
-      // Turn off Keep-Alive for multipart answers
+      // Turn off Keep-Alive for multipart and chunked answers
       // https://github.com/civetweb/civetweb/issues/727
       stream_.DisableKeepAlive();
       header += "Connection: close\r\n";
@@ -517,6 +518,27 @@ namespace Orthanc
     {
       header += "Connection: close\r\n";
     }
+  }
+
+
+  void HttpOutput::StateMachine::StartMultipart(const std::string& subType,
+                                                const std::string& contentType)
+  {
+    if (state_ != State_WritingHeader)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (status_ != HttpStatus_200_Ok)
+    {
+      SendBody(NULL, 0);
+      return;
+    }
+
+    stream_.OnHttpStatusReceived(status_);
+
+    std::string header = "HTTP/1.1 200 OK\r\n";
+    AddConnectionHeaderWithoutLength(header);
 
     // Possibly add the cookies
     CheckHeadersCompatibilityWithMultipart();
@@ -634,6 +656,80 @@ namespace Orthanc
   }
 
 
+  void HttpOutput::StateMachine::StartStream(const std::string& contentType)
+  {
+    if (state_ != State_WritingHeader)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (status_ != HttpStatus_200_Ok)
+    {
+      SendBody(NULL, 0);
+      return;
+    }
+
+    stream_.OnHttpStatusReceived(status_);
+
+    std::string header = "HTTP/1.1 200 OK\r\n";
+    AddConnectionHeaderWithoutLength(header);
+
+    for (std::list<std::string>::const_iterator
+           it = headers_.begin(); it != headers_.end(); ++it)
+    {
+      header += *it;
+    }
+
+    header += ("Content-Type: " + contentType + "\r\n" +
+               "Transfer-Encoding: chunked\r\n\r\n");
+
+    stream_.Send(true, header.c_str(), header.size());
+    state_ = State_WritingStream;
+  }
+
+
+  void HttpOutput::StateMachine::SendStreamItem(const void* data,
+                                                size_t size)
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (size > 0)  // An empty chunk would mark the end of the stream
+    {
+      char prefix[32];
+      sprintf(prefix, "%lx\r\n", static_cast<unsigned long>(size));
+
+      stream_.Send(false, prefix, strlen(prefix));
+      stream_.Send(false, data, size);
+      stream_.Send(false, "\r\n", 2);
+    }
+  }
+
+
+  void HttpOutput::StateMachine::CloseStream()
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // The line below might throw an exception, if the client has
+    // closed the connection. Such an error is ignored.
+    try
+    {
+      static const char* const LAST_CHUNK = "0\r\n\r\n";
+      stream_.Send(false, LAST_CHUNK, strlen(LAST_CHUNK));
+    }
+    catch (OrthancException&)
+    {
+    }
+
+    state_ = State_Done;
+  }
+
+
   static void AnswerStreamAsBuffer(HttpOutput& output,
                                    IHttpStreamAnswer& stream)
   {
@@ -670,7 +766,8 @@ namespace Orthanc
     {
       case HttpCompression_None:
       {
-        if (isGzipAllowed_ || isDeflateAllowed_)
+        if ((isGzipAllowed_ || isDeflateAllowed_) &&
+            stream.GetContentLength() <= MAX_SIZE_FOR_STREAM_COMPRESSION)
         {
           // New in Orthanc 1.5.7: Compress streams without built-in
           // compression, if requested by the "Accept-Encoding" HTTP
@@ -47,6 +47,7 @@ namespace Orthanc
         State_WritingHeader,      
         State_WritingBody,
         State_WritingMultipart,
+        State_WritingStream,
         State_Done
       };
 
@@ -64,6 +65,8 @@ namespace Orthanc
       std::string multipartBoundary_;
       std::string multipartContentType_;
 
+      void AddConnectionHeaderWithoutLength(std::string& header);
+
     public:
       StateMachine(IHttpOutputStream& stream,
                    bool isKeepAlive);
@@ -97,6 +100,13 @@ namespace Orthanc
 
       void CloseMultipart();
 
+      void StartStream(const std::string& contentType);
+
+      void SendStreamItem(const void* data,
+                          size_t size);
+
+      void CloseStream();
+
       void CloseBody();
 
       State GetState() const
@@ -220,6 +230,32 @@ namespace Orthanc
       return stateMachine_.GetState() == StateMachine::State_WritingMultipart;
     }
 
+    /**
+     * Streams a body whose size is not known in advance, using the
+     * chunked transfer encoding of HTTP/1.1. Contrarily to multipart
+     * answers, the headers (e.g. "Content-Disposition") are kept.
+     **/
+    void StartStream(const std::string& contentType)
+    {
+      stateMachine_.StartStream(contentType);
+    }
+
+    void SendStreamItem(const void* data,
+                        size_t size)
+    {
+      stateMachine_.SendStreamItem(data, size);
+    }
+
+    void CloseStream()
+    {
+      stateMachine_.CloseStream();
+    }
+
+    bool IsWritingStream() const
+    {
+      return stateMachine_.GetState() == StateMachine::State_WritingStream;
+    }
+
     void Answer(IHttpStreamAnswer& stream);
 
     /**
@@ -383,17 +383,41 @@ namespace Orthanc
 
     if (contentLength != headers.end())
     {
-      // "Content-Length" is available
-      std::string body;
-      PostDataStatus status = ReadBodyWithContentLength(body, connection, contentLength->second);
+      // "Content-Length" is available: Forward the body to the stream
+      // by chunks, so that the full body is never stored in memory
+      int64_t length;
+      try
+      {
+        length = boost::lexical_cast<int64_t>(contentLength->second);
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        return PostDataStatus_NoLength;
+      }
 
-      if (status == PostDataStatus_Success &&
-          !body.empty())
+      if (length < 0)
       {
-        stream.AddBodyChunk(body.c_str(), body.size());
+        return PostDataStatus_NoLength;
       }
 
-      return status;
+      std::string tmp(1024 * 1024, 0);
+
+      while (length > 0)
+      {
+        const size_t size = static_cast<size_t>(std::min(length, static_cast<int64_t>(tmp.size())));
+        
+        int r = mg_read(connection, &tmp[0], size);
+        if (r <= 0)
+        {
+          return PostDataStatus_Failure;
+        }
+
+        assert(static_cast<size_t>(r) <= size);
+        stream.AddBodyChunk(tmp.c_str(), r);
+        length -= r;
+      }
+
+      return PostDataStatus_Success;
     }
     else
     {
@@ -24,10 +24,20 @@
 #include "ImageProcessing.h"
 
 #include "Image.h"
+#include "ImageProcessingSimd.h"
 #include "ImageTraits.h"
 #include "PixelTraits.h"
 #include "../OrthancException.h"
 
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 0
+#  include "../MultiThreading/ThreadPool.h"
+#  include <boost/shared_ptr.hpp>
+#endif
+
 #ifdef __EMSCRIPTEN__
 /* 
    Avoid this error:
@@ -49,6 +59,168 @@
 
 namespace Orthanc
 {
+  namespace
+  {
+    // Processing of a range of rows, that must be thread-safe if
+    // applied simultaneously on disjoint ranges
+    class IRowsProcessor : public boost::noncopyable
+    {
+    public:
+      virtual ~IRowsProcessor()
+      {
+      }
+
+      virtual void Apply(unsigned int startRow,
+                         unsigned int endRow) = 0;
+    };
+  }
+
+
+#if ORTHANC_SANDBOXED == 0
+  // Below this size, the overhead of the threads is not worth it
+  static const size_t MIN_PIXELS_FOR_PARALLEL_PROCESSING = 128 * 128;
+
+  static boost::mutex                    threadPoolMutex_;
+  static boost::shared_ptr<ThreadPool>   threadPool_;
+
+  namespace
+  {
+    class RowsTask : public ThreadPool::ITask
+    {
+    private:
+      IRowsProcessor&  processor_;
+      unsigned int     startRow_;
+      unsigned int     endRow_;
+
+    public:
+      RowsTask(IRowsProcessor& processor,
+               unsigned int startRow,
+               unsigned int endRow) :
+        processor_(processor),
+        startRow_(startRow),
+        endRow_(endRow)
+      {
+      }
+
+      virtual void Execute() ORTHANC_OVERRIDE
+      {
+        processor_.Apply(startRow_, endRow_);
+      }
+    };
+  }
+#endif
+
+
+  static void ProcessRows(IRowsProcessor& processor,
+                          unsigned int height,
+                          unsigned int width)
+  {
+#if ORTHANC_SANDBOXED == 0
+    boost::shared_ptr<ThreadPool> pool;
+
+    {
+      boost::mutex::scoped_lock lock(threadPoolMutex_);
+      pool = threadPool_;
+    }
+
+    if (pool.get() != NULL &&
+        height > 1 &&
+        static_cast<size_t>(width) * static_cast<size_t>(height) >= MIN_PIXELS_FOR_PARALLEL_PROCESSING)
+    {
+      // One band of consecutive rows per thread. As the rows are
+      // processed independently, the output is the same as with a
+      // serial processing.
+      const unsigned int countBands = static_cast<unsigned int>(
+        std::min(static_cast<size_t>(height), pool->GetWorkersCount() + 1));
+
+      std::vector<RowsTask*> bands;
+      bands.reserve(countBands);
+
+      try
+      {
+        for (unsigned int i = 0; i < countBands; i++)
+        {
+          const unsigned int start = static_cast<unsigned int>(
+            static_cast<uint64_t>(height) * i / countBands);
+          const unsigned int end = static_cast<unsigned int>(
+            static_cast<uint64_t>(height) * (i + 1) / countBands);
+          bands.push_back(new RowsTask(processor, start, end));
+        }
+
+        std::vector<ThreadPool::ITask*> tasks(bands.begin(), bands.end());
+        pool->Execute(tasks);
+      }
+      catch (...)
+      {
+        for (size_t i = 0; i < bands.size(); i++)
+        {
+          delete bands[i];
+        }
+
+        throw;
+      }
+
+      for (size_t i = 0; i < bands.size(); i++)
+      {
+        delete bands[i];
+      }
+
+      return;
+    }
+#else
+    (void) width;  // Remove warning about unused parameter in sandboxed environments
+#endif
+
+    processor.Apply(0, height);
+  }
+
+
+  void ImageProcessing::SetThreadsCount(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+#if ORTHANC_SANDBOXED == 0
+    boost::shared_ptr<ThreadPool> pool;
+
+    if (count > 1)
+    {
+      // The thread that calls "ProcessRows()" is also a worker
+      pool.reset(new ThreadPool(count - 1));
+    }
+
+    {
+      boost::mutex::scoped_lock lock(threadPoolMutex_);
+      threadPool_.swap(pool);
+    }
+
+    // The previous pool (if any) is stopped here, outside of the
+    // mutex, once the processings that use it are over
+#else
+    if (count != 1)
+    {
+      throw OrthancException(ErrorCode_NotImplemented, "Threads are not available in sandboxed environments");
+    }
+#endif
+  }
+
+
+  unsigned int ImageProcessing::GetThreadsCount()
+  {
+#if ORTHANC_SANDBOXED == 0
+    boost::mutex::scoped_lock lock(threadPoolMutex_);
+    if (threadPool_.get() != NULL)
+    {
+      return static_cast<unsigned int>(threadPool_->GetWorkersCount() + 1);
+    }
+#endif
+
+    return 1;
+  }
+
+
   void ImageProcessing::ImagePoint::ClipTo(int32_t minX, int32_t maxX, int32_t minY, int32_t maxY)
   {
     x_ = std::max(minX, std::min(maxX, x_));
@@ -85,7 +257,11 @@ namespace Orthanc
       TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
       const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < width; x++, t++, s++)
+      const unsigned int start = ImageProcessingSimd::ConvertGrayscaleRow(t, s, width);
+      t += start;
+      s += start;
+
+      for (unsigned int x = start; x < width; x++, t++, s++)
       {
         if (static_cast<int32_t>(*s) < static_cast<int32_t>(minValue))
         {
@@ -170,7 +346,11 @@ namespace Orthanc
       TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
       const uint8_t* s = reinterpret_cast<const uint8_t*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < width; x++, t++, s += 3)
+      const unsigned int start = ImageProcessingSimd::ConvertRGB24ToGrayscaleRow(t, s, width);
+      t += start;
+      s += 3 * start;
+
+      for (unsigned int x = start; x < width; x++, t++, s += 3)
       {
         // Y = 0.2126 R + 0.7152 G + 0.0722 B
         int32_t v = (2126 * static_cast<int32_t>(s[0]) +
@@ -266,7 +446,10 @@ namespace Orthanc
     {
       const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < width; x++, p++)
+      const unsigned int start = ImageProcessingSimd::GetMinMaxValueRow(minValue, maxValue, p, width);
+      p += start;
+
+      for (unsigned int x = start; x < width; x++, p++)
       {
         if (*p < minValue)
         {
@@ -420,7 +603,11 @@ namespace Orthanc
       TargetType* p = reinterpret_cast<TargetType*>(target.GetRow(y));
       const SourceType* q = reinterpret_cast<const SourceType*>(source.GetRow(y));
 
-      for (unsigned int x = 0; x < width; x++, p++, q++)
+      const unsigned int start = ImageProcessingSimd::ShiftScaleRow(p, q, width, a, b, UseRound, Invert);
+      p += start;
+      q += start;
+
+      for (unsigned int x = start; x < width; x++, p++, q++)
       {
         float v = a * static_cast<float>(*q) + b;
 
@@ -826,7 +1013,12 @@ namespace Orthanc
       {
         const uint8_t* p = reinterpret_cast<const uint8_t*>(source.GetConstRow(y));
         uint8_t* q = reinterpret_cast<uint8_t*>(target.GetRow(y));
-        for (unsigned int x = 0; x < width; x++)
+
+        const unsigned int start = ImageProcessingSimd::ConvertGrayscaleToRGB24Row(q, p, width);
+        p += start;
+        q += 3 * start;
+
+        for (unsigned int x = start; x < width; x++)
         {
           q[0] = *p;
           q[1] = *p;
@@ -1509,7 +1701,10 @@ namespace Orthanc
         {
           uint16_t* p = reinterpret_cast<uint16_t*>(image.GetRow(y));
 
-          for (unsigned int x = 0; x < width; x++, p++)
+          const unsigned int start = ImageProcessingSimd::InvertRow(p, width, maxValueUint16);
+          p += start;
+
+          for (unsigned int x = start; x < width; x++, p++)
           {
             *p = maxValueUint16 - (*p);
           }
@@ -1525,7 +1720,10 @@ namespace Orthanc
         {
           uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
 
-          for (unsigned int x = 0; x < width; x++, p++)
+          const unsigned int start = ImageProcessingSimd::InvertRow(p, width, maxValueUint8);
+          p += start;
+
+          for (unsigned int x = start; x < width; x++, p++)
           {
             *p = maxValueUint8 - (*p);
           }
@@ -1954,6 +2152,52 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    template <PixelFormat Format>
+    class ResizeRows : public IRowsProcessor
+    {
+    private:
+      ImageAccessor&                    target_;
+      const ImageAccessor&              source_;
+      const std::vector<unsigned int>&  lookupX_;
+      const std::vector<unsigned int>&  lookupY_;
+
+    public:
+      ResizeRows(ImageAccessor& target,
+                 const ImageAccessor& source,
+                 const std::vector<unsigned int>& lookupX,
+                 const std::vector<unsigned int>& lookupY) :
+        target_(target),
+        source_(source),
+        lookupX_(lookupX),
+        lookupY_(lookupY)
+      {
+      }
+
+      virtual void Apply(unsigned int startRow,
+                         unsigned int endRow) ORTHANC_OVERRIDE
+      {
+        const unsigned int targetWidth = target_.GetWidth();
+
+        for (unsigned int targetY = startRow; targetY < endRow; targetY++)
+        {
+          unsigned int sourceY = lookupY_[targetY];
+
+          for (unsigned int targetX = 0; targetX < targetWidth; targetX++)
+          {
+            unsigned int sourceX = lookupX_[targetX];
+
+            typename ImageTraits<Format>::PixelType pixel;
+            ImageTraits<Format>::GetPixel(pixel, source_, sourceX, sourceY);
+            ImageTraits<Format>::SetPixel(target_, pixel, targetX, targetY);
+          }
+        }
+      }
+    };
+  }
+
+
   template <PixelFormat Format>
   static void ResizeInternal(ImageAccessor& target,
                              const ImageAccessor& source)
@@ -2026,20 +2270,9 @@ namespace Orthanc
     /**
      * Actual resizing
      **/
-      
-    for (unsigned int targetY = 0; targetY < targetHeight; targetY++)
-    {
-      unsigned int sourceY = lookupY[targetY];
-
-      for (unsigned int targetX = 0; targetX < targetWidth; targetX++)
-      {
-        unsigned int sourceX = lookupX[targetX];
 
-        typename ImageTraits<Format>::PixelType pixel;
-        ImageTraits<Format>::GetPixel(pixel, source, sourceX, sourceY);
-        ImageTraits<Format>::SetPixel(target, pixel, targetX, targetY);
-      }
-    }            
+    ResizeRows<Format> processor(target, source, lookupX, lookupY);
+    ProcessRows(processor, targetHeight, targetWidth);
   }
 
 
@@ -2211,160 +2444,243 @@ namespace Orthanc
   
 
   
-  // This is an implementation of separable convolution that uses
-  // floating-point arithmetics, and an intermediate Float32
-  // image. The out-of-image values are taken as the border
-  // value. Further optimization is possible.
-  template <typename RawPixel, unsigned int ChannelsCount, bool UseRound>
-  static void SeparableConvolutionFloat(ImageAccessor& image /* inplace */,
-                                        const std::vector<float>& horizontal,
-                                        size_t horizontalAnchor,
-                                        const std::vector<float>& vertical,
-                                        size_t verticalAnchor,
-                                        float normalization)
+  namespace
   {
-    // WARNING - "::min()" should be replaced by "::lowest()" if
-    // dealing with float or double (which is not the case so far)
-    assert(sizeof(RawPixel) <= 2);  // Safeguard to remember about "float/double"
-
-    const unsigned int width = image.GetWidth();
-    const unsigned int height = image.GetHeight();
-    
-
-    /**
-     * Horizontal convolution
-     **/
-
-    Image tmp(PixelFormat_Float32, ChannelsCount * width, height, false);
-
-    for (unsigned int y = 0; y < height; y++)
+    template <typename RawPixel, unsigned int ChannelsCount>
+    class HorizontalConvolutionRows : public IRowsProcessor
     {
-      const RawPixel* row = reinterpret_cast<const RawPixel*>(image.GetConstRow(y));
+    private:
+      const ImageAccessor&       image_;
+      ImageAccessor&             tmp_;
+      const std::vector<float>&  horizontal_;
+      size_t                     horizontalAnchor_;
 
-      float leftBorder[ChannelsCount], rightBorder[ChannelsCount];
-      
-      for (unsigned int c = 0; c < ChannelsCount; c++)
+    public:
+      HorizontalConvolutionRows(const ImageAccessor& image,
+                                ImageAccessor& tmp,
+                                const std::vector<float>& horizontal,
+                                size_t horizontalAnchor) :
+        image_(image),
+        tmp_(tmp),
+        horizontal_(horizontal),
+        horizontalAnchor_(horizontalAnchor)
       {
-        leftBorder[c] = row[c];
-        rightBorder[c] = row[ChannelsCount * (width - 1) + c];
       }
 
-      float* p = static_cast<float*>(tmp.GetRow(y));
-
-      if (width < horizontal.size())
-      {
-        // It is not possible to have the full kernel within the image, use the direct implementation
-        for (unsigned int x = 0; x < width; x++)
-        {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
-          {
-            *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
-              (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
-          }
-        }
-      }
-      else
+      virtual void Apply(unsigned int startRow,
+                         unsigned int endRow) ORTHANC_OVERRIDE
       {
-        // Deal with the left border
-        for (unsigned int x = 0; x < horizontalAnchor; x++)
+        const ImageAccessor& image = image_;
+        const std::vector<float>& horizontal = horizontal_;
+        const size_t horizontalAnchor = horizontalAnchor_;
+        const unsigned int width = image.GetWidth();
+
+        for (unsigned int y = startRow; y < endRow; y++)
         {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+          const RawPixel* row = reinterpret_cast<const RawPixel*>(image.GetConstRow(y));
+
+          float leftBorder[ChannelsCount], rightBorder[ChannelsCount];
+      
+          for (unsigned int c = 0; c < ChannelsCount; c++)
           {
-            *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
-              (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
+            leftBorder[c] = row[c];
+            rightBorder[c] = row[ChannelsCount * (width - 1) + c];
           }
-        }
 
-        // Deal with the central portion of the image (all pixel values
-        // scanned by the kernel lie inside the image)
+          float* p = static_cast<float*>(tmp_.GetRow(y));
 
-        for (unsigned int x = 0; x < width - horizontal.size() + 1; x++)
-        {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+          if (width < horizontal.size())
           {
-            *p = 0;
-            for (unsigned int k = 0; k < horizontal.size(); k++)
+            // It is not possible to have the full kernel within the image, use the direct implementation
+            for (unsigned int x = 0; x < width; x++)
             {
-              *p += static_cast<float>(row[(x + k) * ChannelsCount + c]) * horizontal[k];
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
+                  (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
+              }
             }
           }
-        }
-
-        // Deal with the right border
-        for (unsigned int x = static_cast<unsigned int>(
-               horizontalAnchor + width - horizontal.size() + 1); x < width; x++)
-        {
-          for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+          else
           {
-            *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
-              (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
+            // Deal with the left border
+            for (unsigned int x = 0; x < horizontalAnchor; x++)
+            {
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
+                  (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
+              }
+            }
+
+            // Deal with the central portion of the image (all pixel values
+            // scanned by the kernel lie inside the image)
+
+            for (unsigned int x = 0; x < width - horizontal.size() + 1; x++)
+            {
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = 0;
+                for (unsigned int k = 0; k < horizontal.size(); k++)
+                {
+                  *p += static_cast<float>(row[(x + k) * ChannelsCount + c]) * horizontal[k];
+                }
+              }
+            }
+
+            // Deal with the right border
+            for (unsigned int x = static_cast<unsigned int>(
+                   horizontalAnchor + width - horizontal.size() + 1); x < width; x++)
+            {
+              for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+              {
+                *p = GetHorizontalConvolutionFloatSecure<RawPixel, ChannelsCount>
+                  (image, horizontal, horizontalAnchor, x, y, leftBorder[c], rightBorder[c], c);
+              }
+            }
           }
         }
       }
-    }
-
-
-    /**
-     * Vertical convolution
-     **/
+    };
 
-    std::vector<const float*> rows(vertical.size());
 
-    for (unsigned int y = 0; y < height; y++)
+    template <typename RawPixel, unsigned int ChannelsCount, bool UseRound>
+    class VerticalConvolutionRows : public IRowsProcessor
     {
-      for (unsigned int k = 0; k < vertical.size(); k++)
+    private:
+      ImageAccessor&             image_;
+      const ImageAccessor&       tmp_;
+      const std::vector<float>&  vertical_;
+      size_t                     verticalAnchor_;
+      float                      normalization_;
+
+    public:
+      VerticalConvolutionRows(ImageAccessor& image,
+                              const ImageAccessor& tmp,
+                              const std::vector<float>& vertical,
+                              size_t verticalAnchor,
+                              float normalization) :
+        image_(image),
+        tmp_(tmp),
+        vertical_(vertical),
+        verticalAnchor_(verticalAnchor),
+        normalization_(normalization)
       {
-        if (y + k < verticalAnchor)
-        {
-          rows[k] = reinterpret_cast<const float*>(tmp.GetConstRow(0));   // Use top border
-        }
-        else if (y + k >= height + verticalAnchor)
-        {
-          rows[k] = reinterpret_cast<const float*>(tmp.GetConstRow(height - 1));  // Use bottom border
-        }
-        else
-        {
-          rows[k] = reinterpret_cast<const float*>(tmp.GetConstRow(static_cast<unsigned int>(y + k - verticalAnchor)));
-        }
       }
 
-      RawPixel* p = reinterpret_cast<RawPixel*>(image.GetRow(y));
-        
-      for (unsigned int x = 0; x < width; x++)
+      virtual void Apply(unsigned int startRow,
+                         unsigned int endRow) ORTHANC_OVERRIDE
       {
-        for (unsigned int c = 0; c < ChannelsCount; c++, p++)
-        {
-          float accumulator = 0;
-        
-          for (unsigned int k = 0; k < vertical.size(); k++)
-          {
-            accumulator += rows[k][ChannelsCount * x + c] * vertical[k];
-          }
+        const std::vector<float>& vertical = vertical_;
+        const size_t verticalAnchor = verticalAnchor_;
+        const unsigned int width = image_.GetWidth();
+        const unsigned int height = image_.GetHeight();
 
-          accumulator *= normalization;
+        std::vector<const float*> rows(vertical.size());
 
-          if (accumulator <= static_cast<float>(std::numeric_limits<RawPixel>::min()))
-          {
-            *p = std::numeric_limits<RawPixel>::min();
-          }
-          else if (accumulator >= static_cast<float>(std::numeric_limits<RawPixel>::max()))
-          {
-            *p = std::numeric_limits<RawPixel>::max();
-          }
-          else
+        for (unsigned int y = startRow; y < endRow; y++)
+        {
+          for (unsigned int k = 0; k < vertical.size(); k++)
           {
-            if (UseRound)
+            if (y + k < verticalAnchor)
+            {
+              rows[k] = reinterpret_cast<const float*>(tmp_.GetConstRow(0));   // Use top border
+            }
+            else if (y + k >= height + verticalAnchor)
             {
-              assert(sizeof(RawPixel) < sizeof(int));
-              *p = static_cast<RawPixel>(boost::math::iround(accumulator));
+              rows[k] = reinterpret_cast<const float*>(tmp_.GetConstRow(height - 1));  // Use bottom border
             }
             else
             {
-              *p = static_cast<RawPixel>(accumulator);
+              rows[k] = reinterpret_cast<const float*>(tmp_.GetConstRow(static_cast<unsigned int>(y + k - verticalAnchor)));
+            }
+          }
+
+          RawPixel* p = reinterpret_cast<RawPixel*>(image_.GetRow(y));
+        
+          for (unsigned int x = 0; x < width; x++)
+          {
+            for (unsigned int c = 0; c < ChannelsCount; c++, p++)
+            {
+              float accumulator = 0;
+        
+              for (unsigned int k = 0; k < vertical.size(); k++)
+              {
+                accumulator += rows[k][ChannelsCount * x + c] * vertical[k];
+              }
+
+              accumulator *= normalization_;
+
+              if (accumulator <= static_cast<float>(std::numeric_limits<RawPixel>::min()))
+              {
+                *p = std::numeric_limits<RawPixel>::min();
+              }
+              else if (accumulator >= static_cast<float>(std::numeric_limits<RawPixel>::max()))
+              {
+                *p = std::numeric_limits<RawPixel>::max();
+              }
+              else
+              {
+                if (UseRound)
+                {
+                  assert(sizeof(RawPixel) < sizeof(int));
+                  *p = static_cast<RawPixel>(boost::math::iround(accumulator));
+                }
+                else
+                {
+                  *p = static_cast<RawPixel>(accumulator);
+                }
+              }
             }
           }
         }
       }
+    };
+  }
+
+
+  // This is an implementation of separable convolution that uses
+  // floating-point arithmetics, and an intermediate Float32
+  // image. The out-of-image values are taken as the border
+  // value. Further optimization is possible. Both passes are done
+  // by bands of rows, possibly in parallel.
+  template <typename RawPixel, unsigned int ChannelsCount, bool UseRound>
+  static void SeparableConvolutionFloat(ImageAccessor& image /* inplace */,
+                                        const std::vector<float>& horizontal,
+                                        size_t horizontalAnchor,
+                                        const std::vector<float>& vertical,
+                                        size_t verticalAnchor,
+                                        float normalization)
+  {
+    // WARNING - "::min()" should be replaced by "::lowest()" if
+    // dealing with float or double (which is not the case so far)
+    assert(sizeof(RawPixel) <= 2);  // Safeguard to remember about "float/double"
+
+    const unsigned int width = image.GetWidth();
+    const unsigned int height = image.GetHeight();
+    
+
+    /**
+     * Horizontal convolution
+     **/
+
+    Image tmp(PixelFormat_Float32, ChannelsCount * width, height, false);
+
+    {
+      HorizontalConvolutionRows<RawPixel, ChannelsCount> processor(image, tmp, horizontal, horizontalAnchor);
+      ProcessRows(processor, height, width);
+    }
+
+
+    /**
+     * Vertical convolution, that can only start once the horizontal
+     * convolution is over
+     **/
+
+    {
+      VerticalConvolutionRows<RawPixel, ChannelsCount, UseRound> processor(
+        image, tmp, vertical, verticalAnchor, normalization);
+      ProcessRows(processor, height, width);
     }
   }
 
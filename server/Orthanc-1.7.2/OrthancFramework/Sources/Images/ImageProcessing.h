@@ -205,5 +205,13 @@ namespace Orthanc
     static ImageAccessor* FitSizeKeepAspectRatio(const ImageAccessor& source,
                                                  unsigned int width,
                                                  unsigned int height);
+
+    // Number of threads that process large images by bands of rows
+    // in "Resize()", "FitSize()", "SeparableConvolution()" and
+    // "SmoothGaussian5x5()". The output does not depend on this
+    // value. The default value "1" corresponds to serial processing.
+    static void SetThreadsCount(unsigned int count);
+
+    static unsigned int GetThreadsCount();
   };
 }
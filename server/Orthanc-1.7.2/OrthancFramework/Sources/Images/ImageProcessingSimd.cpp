@@ -0,0 +1,1442 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ImageProcessingSimd.h"
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+
+/**
+ * SSE2 is part of the baseline of x86_64, so the SSE2 kernels are
+ * enabled at compile time. The AVX2 kernels are compiled using
+ * function-level target attributes, and are only used if the CPU
+ * supports AVX2 (runtime dispatch).
+ **/
+
+#if !defined(__EMSCRIPTEN__) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define ORTHANC_SIMD_SSE2 1
+#  include <emmintrin.h>
+#else
+#  define ORTHANC_SIMD_SSE2 0
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1 && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5) || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#  define ORTHANC_SIMD_AVX2 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#    define ORTHANC_AVX2_FUNCTION
+#  else
+#    define ORTHANC_AVX2_FUNCTION __attribute__((target("avx2")))
+#  endif
+#else
+#  define ORTHANC_SIMD_AVX2 0
+#endif
+
+
+namespace Orthanc
+{
+  namespace ImageProcessingSimd
+  {
+    static InstructionSet DetectInstructionSet()
+    {
+#if ORTHANC_SIMD_AVX2 == 1
+#  if defined(_MSC_VER)
+      int info[4];
+      __cpuid(info, 0);
+
+      if (info[0] >= 7)
+      {
+        __cpuid(info, 1);
+
+        // The OS must save the AVX registers on context switches (OSXSAVE + XCR0)
+        if ((info[2] & (1 << 27)) != 0 &&
+            (info[2] & (1 << 28)) != 0 &&
+            (_xgetbv(0) & 6) == 6)
+        {
+          __cpuidex(info, 7, 0);
+          if ((info[1] & (1 << 5)) != 0)
+          {
+            return InstructionSet_AVX2;
+          }
+        }
+      }
+#  else
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+      {
+        return InstructionSet_AVX2;
+      }
+#  endif
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+      return InstructionSet_SSE2;
+#else
+      return InstructionSet_None;
+#endif
+    }
+
+
+    static const InstructionSet supportedInstructionSet_ = DetectInstructionSet();
+    static InstructionSet instructionSet_ = supportedInstructionSet_;
+
+
+    InstructionSet GetInstructionSet()
+    {
+      return instructionSet_;
+    }
+
+
+    InstructionSet GetSupportedInstructionSet()
+    {
+      return supportedInstructionSet_;
+    }
+
+
+    void SetInstructionSet(InstructionSet instructionSet)
+    {
+      if (instructionSet > supportedInstructionSet_)
+      {
+        instructionSet_ = supportedInstructionSet_;
+      }
+      else
+      {
+        instructionSet_ = instructionSet;
+      }
+    }
+
+
+    const char* EnumerationToString(InstructionSet instructionSet)
+    {
+      switch (instructionSet)
+      {
+        case InstructionSet_None:
+          return "None";
+
+        case InstructionSet_SSE2:
+          return "SSE2";
+
+        case InstructionSet_AVX2:
+          return "AVX2";
+
+        default:
+          return "?";
+      }
+    }
+  }
+}
+
+
+#if ORTHANC_SIMD_SSE2 == 1
+namespace
+{
+  /**
+   * SSE2 kernels
+   **/
+
+  inline __m128i LoadSse2(const void* p)
+  {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+
+  inline void StoreSse2(void* p, __m128i v)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+
+  // SSE2 has no unsigned 16-bit minimum: "min(v, m) == v - saturate(v - m)"
+  inline __m128i MinUnsigned16Sse2(__m128i v, __m128i m)
+  {
+    return _mm_sub_epi16(v, _mm_subs_epu16(v, m));
+  }
+
+  unsigned int ConvertGrayscale16ToGrayscale8Sse2(uint8_t* target,
+                                                  const uint16_t* source,
+                                                  unsigned int width)
+  {
+    const __m128i maxValue = _mm_set1_epi16(255);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m128i a = MinUnsigned16Sse2(LoadSse2(source + x), maxValue);
+      const __m128i b = MinUnsigned16Sse2(LoadSse2(source + x + 8), maxValue);
+      StoreSse2(target + x, _mm_packus_epi16(a, b));
+    }
+
+    return x;
+  }
+
+  unsigned int ConvertSignedGrayscale16ToGrayscale8Sse2(uint8_t* target,
+                                                        const int16_t* source,
+                                                        unsigned int width)
+  {
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      StoreSse2(target + x, _mm_packus_epi16(LoadSse2(source + x), LoadSse2(source + x + 8)));
+    }
+
+    return x;
+  }
+
+  template <typename TargetType>
+  unsigned int ConvertGrayscale8ToGrayscale16Sse2(TargetType* target,
+                                                  const uint8_t* source,
+                                                  unsigned int width)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m128i v = LoadSse2(source + x);
+      StoreSse2(target + x, _mm_unpacklo_epi8(v, zero));
+      StoreSse2(target + x + 8, _mm_unpackhi_epi8(v, zero));
+    }
+
+    return x;
+  }
+
+  unsigned int ConvertSignedGrayscale16ToGrayscale16Sse2(uint16_t* target,
+                                                         const int16_t* source,
+                                                         unsigned int width)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      StoreSse2(target + x, _mm_max_epi16(LoadSse2(source + x), zero));
+    }
+
+    return x;
+  }
+
+  unsigned int ConvertGrayscale16ToSignedGrayscale16Sse2(int16_t* target,
+                                                         const uint16_t* source,
+                                                         unsigned int width)
+  {
+    const __m128i maxValue = _mm_set1_epi16(32767);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      StoreSse2(target + x, MinUnsigned16Sse2(LoadSse2(source + x), maxValue));
+    }
+
+    return x;
+  }
+
+
+  // Loading of 4 pixels as floating-point values
+  inline __m128 LoadFloatSse2(const uint8_t* p)
+  {
+    int32_t tmp;
+    memcpy(&tmp, p, sizeof(tmp));
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(tmp), zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+  }
+
+  inline __m128 LoadFloatSse2(const uint16_t* p)
+  {
+    const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+  }
+
+  inline __m128 LoadFloatSse2(const int16_t* p)
+  {
+    const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+  }
+
+  inline __m128 LoadFloatSse2(const float* p)
+  {
+    return _mm_loadu_ps(p);
+  }
+
+
+  // Storage of 4 integers that are known to be in the range of the target type
+  inline void StoreIntegersSse2(uint8_t* p, __m128i v)
+  {
+    v = _mm_packs_epi32(v, v);
+    const int32_t tmp = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    memcpy(p, &tmp, sizeof(tmp));
+  }
+
+  inline void StoreIntegersSse2(uint16_t* p, __m128i v)
+  {
+    // SSE2 has no unsigned saturation from 32 to 16 bits, shift to the signed range
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(-32768);
+    v = _mm_packs_epi32(_mm_sub_epi32(v, bias32), _mm_sub_epi32(v, bias32));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_xor_si128(v, bias16));
+  }
+
+  inline void StoreIntegersSse2(int16_t* p, __m128i v)
+  {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(v, v));
+  }
+
+
+  /**
+   * Rounding of floating-point values that are in the range of
+   * 16-bit integers. The results are exactly those of
+   * "boost::math::iround()" (round half away from zero) and of
+   * "std::floor()". The subtractions are exact (Sterbenz lemma).
+   **/
+  inline __m128i RoundSse2(__m128 v)
+  {
+    const __m128i t = _mm_cvttps_epi32(v);
+    const __m128 fraction = _mm_sub_ps(v, _mm_cvtepi32_ps(t));
+    const __m128 up = _mm_cmpge_ps(fraction, _mm_set1_ps(0.5f));
+    const __m128 down = _mm_cmple_ps(fraction, _mm_set1_ps(-0.5f));
+    return _mm_add_epi32(_mm_sub_epi32(t, _mm_castps_si128(up)), _mm_castps_si128(down));
+  }
+
+  inline __m128i FloorSse2(__m128 v)
+  {
+    const __m128i t = _mm_cvttps_epi32(v);
+    const __m128 above = _mm_cmpgt_ps(_mm_cvtepi32_ps(t), v);
+    return _mm_add_epi32(t, _mm_castps_si128(above));
+  }
+
+
+  template <typename TargetType,
+            typename SourceType,
+            bool UseRound,
+            bool Invert>
+  unsigned int ShiftScaleSse2(TargetType* target,
+                              const SourceType* source,
+                              unsigned int width,
+                              float a,
+                              float b)
+  {
+    const __m128 va = _mm_set1_ps(a);
+    const __m128 vb = _mm_set1_ps(b);
+    const __m128 minValue = _mm_set1_ps(static_cast<float>(std::numeric_limits<TargetType>::min()));
+    const __m128 maxValue = _mm_set1_ps(static_cast<float>(std::numeric_limits<TargetType>::max()));
+    const __m128i maxInteger = _mm_set1_epi32(std::numeric_limits<TargetType>::max());
+
+    unsigned int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+      __m128 v = _mm_add_ps(_mm_mul_ps(va, LoadFloatSse2(source + x)), vb);
+
+      // Saturation, which is a no-op on the values that are not
+      // saturated by the scalar code (NaN is mapped to the minimum)
+      v = _mm_min_ps(_mm_max_ps(v, minValue), maxValue);
+
+      __m128i t = (UseRound ? RoundSse2(v) : FloorSse2(v));
+
+      if (Invert)
+      {
+        t = _mm_sub_epi32(maxInteger, t);
+      }
+
+      StoreIntegersSse2(target + x, t);
+    }
+
+    return x;
+  }
+
+
+  // Version for "Float32" targets, that only implements "std::floor()"
+  unsigned int ShiftScaleFloatSse2(float* target,
+                                   const float* source,
+                                   unsigned int width,
+                                   float a,
+                                   float b)
+  {
+    const __m128 va = _mm_set1_ps(a);
+    const __m128 vb = _mm_set1_ps(b);
+    const __m128 maxValue = _mm_set1_ps(std::numeric_limits<float>::max());
+    const __m128 minValue = _mm_set1_ps(-std::numeric_limits<float>::max());
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 integral = _mm_set1_ps(8388608.0f);  // 2^23, above which all floats are integers
+
+    unsigned int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+      const __m128 v = _mm_add_ps(_mm_mul_ps(va, _mm_loadu_ps(source + x)), vb);
+
+      // Floor of the values whose magnitude is below 2^23 (this is false for NaN)
+      const __m128 small = _mm_cmplt_ps(_mm_andnot_ps(signMask, v), integral);
+      __m128 f = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+      f = _mm_sub_ps(f, _mm_and_ps(_mm_cmpgt_ps(f, v), one));
+      f = _mm_or_ps(f, _mm_and_ps(v, signMask));  // "floor(-0.0) == -0.0"
+      f = _mm_or_ps(_mm_and_ps(small, f), _mm_andnot_ps(small, v));
+
+      const __m128 above = _mm_cmpge_ps(v, maxValue);
+      const __m128 below = _mm_cmple_ps(v, minValue);
+      f = _mm_or_ps(_mm_and_ps(below, minValue), _mm_andnot_ps(below, f));
+      f = _mm_or_ps(_mm_and_ps(above, maxValue), _mm_andnot_ps(above, f));
+
+      _mm_storeu_ps(target + x, f);
+    }
+
+    return x;
+  }
+
+
+  unsigned int GetMinMaxGrayscale8Sse2(uint8_t& minValue,
+                                       uint8_t& maxValue,
+                                       const uint8_t* row,
+                                       unsigned int width)
+  {
+    __m128i a = _mm_set1_epi8(static_cast<char>(minValue));
+    __m128i b = _mm_set1_epi8(static_cast<char>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m128i v = LoadSse2(row + x);
+      a = _mm_min_epu8(a, v);
+      b = _mm_max_epu8(b, v);
+    }
+
+    uint8_t tmpMin[16], tmpMax[16];
+    StoreSse2(tmpMin, a);
+    StoreSse2(tmpMax, b);
+
+    for (unsigned int i = 0; i < 16; i++)
+    {
+      minValue = std::min(minValue, tmpMin[i]);
+      maxValue = std::max(maxValue, tmpMax[i]);
+    }
+
+    return x;
+  }
+
+  unsigned int GetMinMaxSignedGrayscale16Sse2(int16_t& minValue,
+                                              int16_t& maxValue,
+                                              const int16_t* row,
+                                              unsigned int width)
+  {
+    __m128i a = _mm_set1_epi16(minValue);
+    __m128i b = _mm_set1_epi16(maxValue);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      const __m128i v = LoadSse2(row + x);
+      a = _mm_min_epi16(a, v);
+      b = _mm_max_epi16(b, v);
+    }
+
+    int16_t tmpMin[8], tmpMax[8];
+    StoreSse2(tmpMin, a);
+    StoreSse2(tmpMax, b);
+
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      minValue = std::min(minValue, tmpMin[i]);
+      maxValue = std::max(maxValue, tmpMax[i]);
+    }
+
+    return x;
+  }
+
+  unsigned int GetMinMaxGrayscale16Sse2(uint16_t& minValue,
+                                        uint16_t& maxValue,
+                                        const uint16_t* row,
+                                        unsigned int width)
+  {
+    // SSE2 has no unsigned 16-bit comparison, flip the sign bit to
+    // work in the signed range
+    const __m128i bias = _mm_set1_epi16(-32768);
+
+    __m128i a = _mm_xor_si128(_mm_set1_epi16(static_cast<int16_t>(minValue)), bias);
+    __m128i b = _mm_xor_si128(_mm_set1_epi16(static_cast<int16_t>(maxValue)), bias);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      const __m128i v = _mm_xor_si128(LoadSse2(row + x), bias);
+      a = _mm_min_epi16(a, v);
+      b = _mm_max_epi16(b, v);
+    }
+
+    uint16_t tmpMin[8], tmpMax[8];
+    StoreSse2(tmpMin, _mm_xor_si128(a, bias));
+    StoreSse2(tmpMax, _mm_xor_si128(b, bias));
+
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      minValue = std::min(minValue, tmpMin[i]);
+      maxValue = std::max(maxValue, tmpMax[i]);
+    }
+
+    return x;
+  }
+
+
+  unsigned int InvertGrayscale8Sse2(uint8_t* row,
+                                    unsigned int width,
+                                    uint8_t maxValue)
+  {
+    const __m128i m = _mm_set1_epi8(static_cast<char>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      StoreSse2(row + x, _mm_sub_epi8(m, LoadSse2(row + x)));
+    }
+
+    return x;
+  }
+
+  unsigned int InvertGrayscale16Sse2(uint16_t* row,
+                                     unsigned int width,
+                                     uint16_t maxValue)
+  {
+    const __m128i m = _mm_set1_epi16(static_cast<int16_t>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      StoreSse2(row + x, _mm_sub_epi16(m, LoadSse2(row + x)));
+    }
+
+    return x;
+  }
+}
+#endif
+
+
+#if ORTHANC_SIMD_AVX2 == 1
+namespace
+{
+  /**
+   * AVX2 kernels. Note that the 256-bit pack/unpack instructions work
+   * separately on the two 128-bit lanes.
+   **/
+
+  ORTHANC_AVX2_FUNCTION inline __m256i LoadAvx2(const void* p)
+  {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+
+  ORTHANC_AVX2_FUNCTION inline void StoreAvx2(void* p, __m256i v)
+  {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+
+  // Packing of two vectors of 16 words into 32 bytes, preserving the order
+  ORTHANC_AVX2_FUNCTION inline __m256i PackUnsignedSaturate16Avx2(__m256i a, __m256i b)
+  {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ConvertGrayscale16ToGrayscale8Avx2(uint8_t* target,
+                                                  const uint16_t* source,
+                                                  unsigned int width)
+  {
+    const __m256i maxValue = _mm256_set1_epi16(255);
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+      const __m256i a = _mm256_min_epu16(LoadAvx2(source + x), maxValue);
+      const __m256i b = _mm256_min_epu16(LoadAvx2(source + x + 16), maxValue);
+      StoreAvx2(target + x, PackUnsignedSaturate16Avx2(a, b));
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ConvertSignedGrayscale16ToGrayscale8Avx2(uint8_t* target,
+                                                        const int16_t* source,
+                                                        unsigned int width)
+  {
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+      StoreAvx2(target + x, PackUnsignedSaturate16Avx2(LoadAvx2(source + x), LoadAvx2(source + x + 16)));
+    }
+
+    return x;
+  }
+
+  template <typename TargetType>
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ConvertGrayscale8ToGrayscale16Avx2(TargetType* target,
+                                                  const uint8_t* source,
+                                                  unsigned int width)
+  {
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+      StoreAvx2(target + x, _mm256_cvtepu8_epi16(v));
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ConvertSignedGrayscale16ToGrayscale16Avx2(uint16_t* target,
+                                                         const int16_t* source,
+                                                         unsigned int width)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      StoreAvx2(target + x, _mm256_max_epi16(LoadAvx2(source + x), zero));
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ConvertGrayscale16ToSignedGrayscale16Avx2(int16_t* target,
+                                                         const uint16_t* source,
+                                                         unsigned int width)
+  {
+    const __m256i maxValue = _mm256_set1_epi16(32767);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      StoreAvx2(target + x, _mm256_min_epu16(LoadAvx2(source + x), maxValue));
+    }
+
+    return x;
+  }
+
+
+  /**
+   * Conversion from RGB24 to Grayscale8. The three channels of 16
+   * pixels are deinterleaved with byte shuffles, then the luminance
+   * "(2126 R + 7152 G + 0722 B) / 10000" is computed on 32-bit
+   * integers. WARNING: "0722" is an octal literal in the scalar code
+   * (i.e. 466), which is reproduced here to get the same output. The
+   * division by 10000 is done in single precision, which is exact
+   * as the numerator is below 2^24 and as the IEEE division is
+   * correctly rounded.
+   **/
+  ORTHANC_AVX2_FUNCTION inline __m128i ShuffleChannelAvx2(__m128i a, __m128i b, __m128i c,
+                                                          __m128i maskA, __m128i maskB, __m128i maskC)
+  {
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, maskA),
+                                     _mm_shuffle_epi8(b, maskB)),
+                        _mm_shuffle_epi8(c, maskC));
+  }
+
+  ORTHANC_AVX2_FUNCTION inline __m256i DivideBy10000Avx2(__m256i v)
+  {
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(10000.0f)));
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ConvertRGB24ToGrayscale8Avx2(uint8_t* target,
+                                            const uint8_t* source,
+                                            unsigned int width)
+  {
+    const __m128i r0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i r1 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14, -128, -128, -128, -128, -128);
+    const __m128i r2 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1, 4, 7, 10, 13);
+    const __m128i g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i g1 = _mm_setr_epi8(-128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15, -128, -128, -128, -128, -128);
+    const __m128i g2 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 5, 8, 11, 14);
+    const __m128i b0 = _mm_setr_epi8(2, 5, 8, 11, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i b1 = _mm_setr_epi8(-128, -128, -128, -128, -128, 1, 4, 7, 10, 13, -128, -128, -128, -128, -128, -128);
+    const __m128i b2 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 3, 6, 9, 12, 15);
+
+    // Pairs of 16-bit coefficients, for "_mm256_madd_epi16()"
+    const __m256i coefficientsRG = _mm256_set1_epi32((7152 << 16) | 2126);
+    const __m256i coefficientsB = _mm256_set1_epi32(466);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const uint8_t* p = source + 3 * x;
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+      const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+
+      const __m256i red = _mm256_cvtepu8_epi16(ShuffleChannelAvx2(a, b, c, r0, r1, r2));
+      const __m256i green = _mm256_cvtepu8_epi16(ShuffleChannelAvx2(a, b, c, g0, g1, g2));
+      const __m256i blue = _mm256_cvtepu8_epi16(ShuffleChannelAvx2(a, b, c, b0, b1, b2));
+      const __m256i zero = _mm256_setzero_si256();
+
+      __m256i low = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(red, green), coefficientsRG),
+                                     _mm256_madd_epi16(_mm256_unpacklo_epi16(blue, zero), coefficientsB));
+      __m256i high = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(red, green), coefficientsRG),
+                                      _mm256_madd_epi16(_mm256_unpackhi_epi16(blue, zero), coefficientsB));
+
+      // The pack reverts the lane interleaving of the unpack
+      const __m256i v = _mm256_packs_epi32(DivideBy10000Avx2(low), DivideBy10000Avx2(high));
+      const __m128i result = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target + x), result);
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ConvertGrayscale8ToRGB24Avx2(uint8_t* target,
+                                            const uint8_t* source,
+                                            unsigned int width)
+  {
+    const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+      uint8_t* q = target + 3 * x;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(q), _mm_shuffle_epi8(v, m0));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(q + 16), _mm_shuffle_epi8(v, m1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(q + 32), _mm_shuffle_epi8(v, m2));
+    }
+
+    return x;
+  }
+
+
+  // Loading of 8 pixels as floating-point values
+  ORTHANC_AVX2_FUNCTION inline __m256 LoadFloatAvx2(const uint8_t* p)
+  {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+  }
+
+  ORTHANC_AVX2_FUNCTION inline __m256 LoadFloatAvx2(const uint16_t* p)
+  {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+  }
+
+  ORTHANC_AVX2_FUNCTION inline __m256 LoadFloatAvx2(const int16_t* p)
+  {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+  }
+
+  ORTHANC_AVX2_FUNCTION inline __m256 LoadFloatAvx2(const float* p)
+  {
+    return _mm256_loadu_ps(p);
+  }
+
+
+  // Storage of 8 integers that are known to be in the range of the target type
+  ORTHANC_AVX2_FUNCTION inline void StoreIntegersAvx2(uint8_t* p, __m256i v)
+  {
+    const __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(w, w));
+  }
+
+  ORTHANC_AVX2_FUNCTION inline void StoreIntegersAvx2(uint16_t* p, __m256i v)
+  {
+    const __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), w);
+  }
+
+  ORTHANC_AVX2_FUNCTION inline void StoreIntegersAvx2(int16_t* p, __m256i v)
+  {
+    const __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), w);
+  }
+
+
+  // Same as "RoundSse2()"
+  ORTHANC_AVX2_FUNCTION inline __m256i RoundAvx2(__m256 v)
+  {
+    const __m256i t = _mm256_cvttps_epi32(v);
+    const __m256 fraction = _mm256_sub_ps(v, _mm256_cvtepi32_ps(t));
+    const __m256 up = _mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ);
+    const __m256 down = _mm256_cmp_ps(fraction, _mm256_set1_ps(-0.5f), _CMP_LE_OQ);
+    return _mm256_add_epi32(_mm256_sub_epi32(t, _mm256_castps_si256(up)), _mm256_castps_si256(down));
+  }
+
+  template <typename TargetType,
+            typename SourceType,
+            bool UseRound,
+            bool Invert>
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ShiftScaleAvx2(TargetType* target,
+                              const SourceType* source,
+                              unsigned int width,
+                              float a,
+                              float b)
+  {
+    const __m256 va = _mm256_set1_ps(a);
+    const __m256 vb = _mm256_set1_ps(b);
+    const __m256 minValue = _mm256_set1_ps(static_cast<float>(std::numeric_limits<TargetType>::min()));
+    const __m256 maxValue = _mm256_set1_ps(static_cast<float>(std::numeric_limits<TargetType>::max()));
+    const __m256i maxInteger = _mm256_set1_epi32(std::numeric_limits<TargetType>::max());
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      // No fused multiply-add, to get the same rounding as the scalar code
+      __m256 v = _mm256_add_ps(_mm256_mul_ps(va, LoadFloatAvx2(source + x)), vb);
+      v = _mm256_min_ps(_mm256_max_ps(v, minValue), maxValue);
+
+      __m256i t = (UseRound ? RoundAvx2(v) : _mm256_cvttps_epi32(_mm256_floor_ps(v)));
+
+      if (Invert)
+      {
+        t = _mm256_sub_epi32(maxInteger, t);
+      }
+
+      StoreIntegersAvx2(target + x, t);
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int ShiftScaleFloatAvx2(float* target,
+                                   const float* source,
+                                   unsigned int width,
+                                   float a,
+                                   float b)
+  {
+    const __m256 va = _mm256_set1_ps(a);
+    const __m256 vb = _mm256_set1_ps(b);
+    const __m256 maxValue = _mm256_set1_ps(std::numeric_limits<float>::max());
+    const __m256 minValue = _mm256_set1_ps(-std::numeric_limits<float>::max());
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      const __m256 v = _mm256_add_ps(_mm256_mul_ps(va, _mm256_loadu_ps(source + x)), vb);
+
+      __m256 f = _mm256_floor_ps(v);
+      f = _mm256_blendv_ps(f, minValue, _mm256_cmp_ps(v, minValue, _CMP_LE_OQ));
+      f = _mm256_blendv_ps(f, maxValue, _mm256_cmp_ps(v, maxValue, _CMP_GE_OQ));
+
+      _mm256_storeu_ps(target + x, f);
+    }
+
+    return x;
+  }
+
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int GetMinMaxGrayscale8Avx2(uint8_t& minValue,
+                                       uint8_t& maxValue,
+                                       const uint8_t* row,
+                                       unsigned int width)
+  {
+    __m256i a = _mm256_set1_epi8(static_cast<char>(minValue));
+    __m256i b = _mm256_set1_epi8(static_cast<char>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+      const __m256i v = LoadAvx2(row + x);
+      a = _mm256_min_epu8(a, v);
+      b = _mm256_max_epu8(b, v);
+    }
+
+    uint8_t tmpMin[32], tmpMax[32];
+    StoreAvx2(tmpMin, a);
+    StoreAvx2(tmpMax, b);
+
+    for (unsigned int i = 0; i < 32; i++)
+    {
+      minValue = std::min(minValue, tmpMin[i]);
+      maxValue = std::max(maxValue, tmpMax[i]);
+    }
+
+    return x;
+  }
+
+  template <typename PixelType>
+  ORTHANC_AVX2_FUNCTION
+  unsigned int GetMinMaxGrayscale16Avx2(PixelType& minValue,
+                                        PixelType& maxValue,
+                                        const PixelType* row,
+                                        unsigned int width)
+  {
+    const bool isSigned = std::numeric_limits<PixelType>::is_signed;
+
+    __m256i a = _mm256_set1_epi16(static_cast<int16_t>(minValue));
+    __m256i b = _mm256_set1_epi16(static_cast<int16_t>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m256i v = LoadAvx2(row + x);
+      if (isSigned)
+      {
+        a = _mm256_min_epi16(a, v);
+        b = _mm256_max_epi16(b, v);
+      }
+      else
+      {
+        a = _mm256_min_epu16(a, v);
+        b = _mm256_max_epu16(b, v);
+      }
+    }
+
+    PixelType tmpMin[16], tmpMax[16];
+    StoreAvx2(tmpMin, a);
+    StoreAvx2(tmpMax, b);
+
+    for (unsigned int i = 0; i < 16; i++)
+    {
+      minValue = std::min(minValue, tmpMin[i]);
+      maxValue = std::max(maxValue, tmpMax[i]);
+    }
+
+    return x;
+  }
+
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int InvertGrayscale8Avx2(uint8_t* row,
+                                    unsigned int width,
+                                    uint8_t maxValue)
+  {
+    const __m256i m = _mm256_set1_epi8(static_cast<char>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+      StoreAvx2(row + x, _mm256_sub_epi8(m, LoadAvx2(row + x)));
+    }
+
+    return x;
+  }
+
+  ORTHANC_AVX2_FUNCTION
+  unsigned int InvertGrayscale16Avx2(uint16_t* row,
+                                     unsigned int width,
+                                     uint16_t maxValue)
+  {
+    const __m256i m = _mm256_set1_epi16(static_cast<int16_t>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      StoreAvx2(row + x, _mm256_sub_epi16(m, LoadAvx2(row + x)));
+    }
+
+    return x;
+  }
+}
+#endif
+
+
+namespace Orthanc
+{
+  namespace ImageProcessingSimd
+  {
+    template <typename TargetType,
+              typename SourceType,
+              bool UseRound,
+              bool Invert>
+    static unsigned int ShiftScaleDispatch(TargetType* target,
+                                           const SourceType* source,
+                                           unsigned int width,
+                                           float a,
+                                           float b)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ShiftScaleAvx2<TargetType, SourceType, UseRound, Invert>(target, source, width, a, b);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ShiftScaleSse2<TargetType, SourceType, UseRound, Invert>(target, source, width, a, b);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+    template <typename TargetType,
+              typename SourceType>
+    static unsigned int ShiftScaleDispatch(TargetType* target,
+                                           const SourceType* source,
+                                           unsigned int width,
+                                           float a,
+                                           float b,
+                                           bool useRound,
+                                           bool invert)
+    {
+      if (useRound)
+      {
+        if (invert)
+        {
+          return ShiftScaleDispatch<TargetType, SourceType, true, true>(target, source, width, a, b);
+        }
+        else
+        {
+          return ShiftScaleDispatch<TargetType, SourceType, true, false>(target, source, width, a, b);
+        }
+      }
+      else
+      {
+        if (invert)
+        {
+          return ShiftScaleDispatch<TargetType, SourceType, false, true>(target, source, width, a, b);
+        }
+        else
+        {
+          return ShiftScaleDispatch<TargetType, SourceType, false, false>(target, source, width, a, b);
+        }
+      }
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint8_t, uint16_t>(uint8_t* target,
+                                                        const uint16_t* source,
+                                                        unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ConvertGrayscale16ToGrayscale8Avx2(target, source, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ConvertGrayscale16ToGrayscale8Sse2(target, source, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint8_t, int16_t>(uint8_t* target,
+                                                       const int16_t* source,
+                                                       unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ConvertSignedGrayscale16ToGrayscale8Avx2(target, source, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ConvertSignedGrayscale16ToGrayscale8Sse2(target, source, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint16_t, uint8_t>(uint16_t* target,
+                                                        const uint8_t* source,
+                                                        unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ConvertGrayscale8ToGrayscale16Avx2(target, source, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ConvertGrayscale8ToGrayscale16Sse2(target, source, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleRow<int16_t, uint8_t>(int16_t* target,
+                                                       const uint8_t* source,
+                                                       unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ConvertGrayscale8ToGrayscale16Avx2(target, source, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ConvertGrayscale8ToGrayscale16Sse2(target, source, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint16_t, int16_t>(uint16_t* target,
+                                                        const int16_t* source,
+                                                        unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ConvertSignedGrayscale16ToGrayscale16Avx2(target, source, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ConvertSignedGrayscale16ToGrayscale16Sse2(target, source, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleRow<int16_t, uint16_t>(int16_t* target,
+                                                        const uint16_t* source,
+                                                        unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ConvertGrayscale16ToSignedGrayscale16Avx2(target, source, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ConvertGrayscale16ToSignedGrayscale16Sse2(target, source, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    // The byte shuffles are not available in SSE2, only AVX2 is implemented
+    template <>
+    unsigned int ConvertRGB24ToGrayscaleRow<uint8_t>(uint8_t* target,
+                                                     const uint8_t* source,
+                                                     unsigned int width)
+    {
+#if ORTHANC_SIMD_AVX2 == 1
+      if (instructionSet_ == InstructionSet_AVX2)
+      {
+        return ConvertRGB24ToGrayscale8Avx2(target, source, width);
+      }
+#endif
+
+      return 0;
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleToRGB24Row<uint8_t>(uint8_t* target,
+                                                     const uint8_t* source,
+                                                     unsigned int width)
+    {
+#if ORTHANC_SIMD_AVX2 == 1
+      if (instructionSet_ == InstructionSet_AVX2)
+      {
+        return ConvertGrayscale8ToRGB24Avx2(target, source, width);
+      }
+#endif
+
+      return 0;
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<uint8_t, uint8_t>(uint8_t* target,
+                                                 const uint8_t* source,
+                                                 unsigned int width,
+                                                 float a,
+                                                 float b,
+                                                 bool useRound,
+                                                 bool invert)
+    {
+      return ShiftScaleDispatch(target, source, width, a, b, useRound, invert);
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<uint16_t, uint8_t>(uint16_t* target,
+                                                  const uint8_t* source,
+                                                  unsigned int width,
+                                                  float a,
+                                                  float b,
+                                                  bool useRound,
+                                                  bool invert)
+    {
+      return ShiftScaleDispatch(target, source, width, a, b, useRound, invert);
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<uint8_t, uint16_t>(uint8_t* target,
+                                                  const uint16_t* source,
+                                                  unsigned int width,
+                                                  float a,
+                                                  float b,
+                                                  bool useRound,
+                                                  bool invert)
+    {
+      return ShiftScaleDispatch(target, source, width, a, b, useRound, invert);
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<uint16_t, uint16_t>(uint16_t* target,
+                                                   const uint16_t* source,
+                                                   unsigned int width,
+                                                   float a,
+                                                   float b,
+                                                   bool useRound,
+                                                   bool invert)
+    {
+      return ShiftScaleDispatch(target, source, width, a, b, useRound, invert);
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<int16_t, int16_t>(int16_t* target,
+                                                 const int16_t* source,
+                                                 unsigned int width,
+                                                 float a,
+                                                 float b,
+                                                 bool useRound,
+                                                 bool invert)
+    {
+      if (invert)
+      {
+        // The scalar code wraps around in this case, which is not implemented
+        return 0;
+      }
+      else
+      {
+        return ShiftScaleDispatch(target, source, width, a, b, useRound, false);
+      }
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<uint8_t, float>(uint8_t* target,
+                                               const float* source,
+                                               unsigned int width,
+                                               float a,
+                                               float b,
+                                               bool useRound,
+                                               bool invert)
+    {
+      return ShiftScaleDispatch(target, source, width, a, b, useRound, invert);
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<uint16_t, float>(uint16_t* target,
+                                                const float* source,
+                                                unsigned int width,
+                                                float a,
+                                                float b,
+                                                bool useRound,
+                                                bool invert)
+    {
+      return ShiftScaleDispatch(target, source, width, a, b, useRound, invert);
+    }
+
+
+    template <>
+    unsigned int ShiftScaleRow<float, float>(float* target,
+                                             const float* source,
+                                             unsigned int width,
+                                             float a,
+                                             float b,
+                                             bool useRound,
+                                             bool invert)
+    {
+      if (useRound ||
+          invert)
+      {
+        // Rounding to an integer is not implemented for floating-point images
+        return 0;
+      }
+
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return ShiftScaleFloatAvx2(target, source, width, a, b);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return ShiftScaleFloatSse2(target, source, width, a, b);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int GetMinMaxValueRow<uint8_t>(uint8_t& minValue,
+                                            uint8_t& maxValue,
+                                            const uint8_t* row,
+                                            unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return GetMinMaxGrayscale8Avx2(minValue, maxValue, row, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return GetMinMaxGrayscale8Sse2(minValue, maxValue, row, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int GetMinMaxValueRow<uint16_t>(uint16_t& minValue,
+                                             uint16_t& maxValue,
+                                             const uint16_t* row,
+                                             unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return GetMinMaxGrayscale16Avx2(minValue, maxValue, row, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return GetMinMaxGrayscale16Sse2(minValue, maxValue, row, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int GetMinMaxValueRow<int16_t>(int16_t& minValue,
+                                            int16_t& maxValue,
+                                            const int16_t* row,
+                                            unsigned int width)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return GetMinMaxGrayscale16Avx2(minValue, maxValue, row, width);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return GetMinMaxSignedGrayscale16Sse2(minValue, maxValue, row, width);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int InvertRow<uint8_t>(uint8_t* row,
+                                    unsigned int width,
+                                    uint8_t maxValue)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return InvertGrayscale8Avx2(row, width, maxValue);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return InvertGrayscale8Sse2(row, width, maxValue);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+
+
+    template <>
+    unsigned int InvertRow<uint16_t>(uint16_t* row,
+                                     unsigned int width,
+                                     uint16_t maxValue)
+    {
+      switch (instructionSet_)
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case InstructionSet_AVX2:
+          return InvertGrayscale16Avx2(row, width, maxValue);
+#endif
+
+#if ORTHANC_SIMD_SSE2 == 1
+        case InstructionSet_SSE2:
+          return InvertGrayscale16Sse2(row, width, maxValue);
+#endif
+
+        default:
+          return 0;
+      }
+    }
+  }
+}
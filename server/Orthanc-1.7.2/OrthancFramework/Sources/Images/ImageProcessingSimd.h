@@ -0,0 +1,267 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#include <stdint.h>
+
+
+/**
+ * Vectorized row kernels used by "ImageProcessing". Each kernel
+ * processes a prefix of the row, and returns the number of pixels it
+ * has processed: The caller must handle the remaining pixels with its
+ * scalar code. The kernels produce exactly the same output as the
+ * scalar code. The default implementations (i.e. the primary
+ * templates) process no pixel at all.
+ **/
+
+namespace Orthanc
+{
+  namespace ImageProcessingSimd
+  {
+    enum InstructionSet
+    {
+      InstructionSet_None,
+      InstructionSet_SSE2,
+      InstructionSet_AVX2
+    };
+
+    // Returns the instruction set that is currently used by the kernels
+    ORTHANC_PUBLIC InstructionSet GetInstructionSet();
+
+    // Returns the best instruction set that is supported by both the
+    // build and the CPU
+    ORTHANC_PUBLIC InstructionSet GetSupportedInstructionSet();
+
+    // Restrict the instruction set used by the kernels (values above
+    // the supported instruction set are lowered). This is not
+    // thread-safe, and is only intended for unit tests and benchmarks.
+    ORTHANC_PUBLIC void SetInstructionSet(InstructionSet instructionSet);
+
+    ORTHANC_PUBLIC const char* EnumerationToString(InstructionSet instructionSet);
+
+
+    // Conversion between grayscale formats, with saturation
+    template <typename TargetType, typename SourceType>
+    unsigned int ConvertGrayscaleRow(TargetType* /* target */,
+                                     const SourceType* /* source */,
+                                     unsigned int /* width */)
+    {
+      return 0;
+    }
+
+    // Luminance of RGB24 pixels, with the same coefficients as "ImageProcessing::Convert()"
+    template <typename TargetType>
+    unsigned int ConvertRGB24ToGrayscaleRow(TargetType* /* target */,
+                                            const uint8_t* /* source */,
+                                            unsigned int /* width */)
+    {
+      return 0;
+    }
+
+    template <typename SourceType>
+    unsigned int ConvertGrayscaleToRGB24Row(uint8_t* /* target */,
+                                            const SourceType* /* source */,
+                                            unsigned int /* width */)
+    {
+      return 0;
+    }
+
+    // Computes "a * x + b" at each pixel, with the same rounding and
+    // saturation rules as "ImageProcessing::ShiftScale2()". This
+    // function can be applied inplace (source == target).
+    template <typename TargetType, typename SourceType>
+    unsigned int ShiftScaleRow(TargetType* /* target */,
+                               const SourceType* /* source */,
+                               unsigned int /* width */,
+                               float /* a */,
+                               float /* b */,
+                               bool /* useRound */,
+                               bool /* invert */)
+    {
+      return 0;
+    }
+
+    // Updates "minValue" and "maxValue" with the processed pixels
+    template <typename PixelType>
+    unsigned int GetMinMaxValueRow(PixelType& /* minValue */,
+                                   PixelType& /* maxValue */,
+                                   const PixelType* /* row */,
+                                   unsigned int /* width */)
+    {
+      return 0;
+    }
+
+    // Computes "maxValue - x" at each pixel, modulo the range of PixelType
+    template <typename PixelType>
+    unsigned int InvertRow(PixelType* /* row */,
+                           unsigned int /* width */,
+                           PixelType /* maxValue */)
+    {
+      return 0;
+    }
+
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint8_t, uint16_t>(uint8_t* target,
+                                                        const uint16_t* source,
+                                                        unsigned int width);
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint8_t, int16_t>(uint8_t* target,
+                                                       const int16_t* source,
+                                                       unsigned int width);
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint16_t, uint8_t>(uint16_t* target,
+                                                        const uint8_t* source,
+                                                        unsigned int width);
+
+    template <>
+    unsigned int ConvertGrayscaleRow<int16_t, uint8_t>(int16_t* target,
+                                                       const uint8_t* source,
+                                                       unsigned int width);
+
+    template <>
+    unsigned int ConvertGrayscaleRow<uint16_t, int16_t>(uint16_t* target,
+                                                        const int16_t* source,
+                                                        unsigned int width);
+
+    template <>
+    unsigned int ConvertGrayscaleRow<int16_t, uint16_t>(int16_t* target,
+                                                        const uint16_t* source,
+                                                        unsigned int width);
+
+    template <>
+    unsigned int ConvertRGB24ToGrayscaleRow<uint8_t>(uint8_t* target,
+                                                     const uint8_t* source,
+                                                     unsigned int width);
+
+    template <>
+    unsigned int ConvertGrayscaleToRGB24Row<uint8_t>(uint8_t* target,
+                                                     const uint8_t* source,
+                                                     unsigned int width);
+
+    template <>
+    unsigned int ShiftScaleRow<uint8_t, uint8_t>(uint8_t* target,
+                                                 const uint8_t* source,
+                                                 unsigned int width,
+                                                 float a,
+                                                 float b,
+                                                 bool useRound,
+                                                 bool invert);
+
+    template <>
+    unsigned int ShiftScaleRow<uint16_t, uint8_t>(uint16_t* target,
+                                                  const uint8_t* source,
+                                                  unsigned int width,
+                                                  float a,
+                                                  float b,
+                                                  bool useRound,
+                                                  bool invert);
+
+    template <>
+    unsigned int ShiftScaleRow<uint8_t, uint16_t>(uint8_t* target,
+                                                  const uint16_t* source,
+                                                  unsigned int width,
+                                                  float a,
+                                                  float b,
+                                                  bool useRound,
+                                                  bool invert);
+
+    template <>
+    unsigned int ShiftScaleRow<uint16_t, uint16_t>(uint16_t* target,
+                                                   const uint16_t* source,
+                                                   unsigned int width,
+                                                   float a,
+                                                   float b,
+                                                   bool useRound,
+                                                   bool invert);
+
+    template <>
+    unsigned int ShiftScaleRow<int16_t, int16_t>(int16_t* target,
+                                                 const int16_t* source,
+                                                 unsigned int width,
+                                                 float a,
+                                                 float b,
+                                                 bool useRound,
+                                                 bool invert);
+
+    template <>
+    unsigned int ShiftScaleRow<uint8_t, float>(uint8_t* target,
+                                               const float* source,
+                                               unsigned int width,
+                                               float a,
+                                               float b,
+                                               bool useRound,
+                                               bool invert);
+
+    template <>
+    unsigned int ShiftScaleRow<uint16_t, float>(uint16_t* target,
+                                                const float* source,
+                                                unsigned int width,
+                                                float a,
+                                                float b,
+                                                bool useRound,
+                                                bool invert);
+
+    template <>
+    unsigned int ShiftScaleRow<float, float>(float* target,
+                                             const float* source,
+                                             unsigned int width,
+                                             float a,
+                                             float b,
+                                             bool useRound,
+                                             bool invert);
+
+    template <>
+    unsigned int GetMinMaxValueRow<uint8_t>(uint8_t& minValue,
+                                            uint8_t& maxValue,
+                                            const uint8_t* row,
+                                            unsigned int width);
+
+    template <>
+    unsigned int GetMinMaxValueRow<uint16_t>(uint16_t& minValue,
+                                             uint16_t& maxValue,
+                                             const uint16_t* row,
+                                             unsigned int width);
+
+    template <>
+    unsigned int GetMinMaxValueRow<int16_t>(int16_t& minValue,
+                                            int16_t& maxValue,
+                                            const int16_t* row,
+                                            unsigned int width);
+
+    template <>
+    unsigned int InvertRow<uint8_t>(uint8_t* row,
+                                    unsigned int width,
+                                    uint8_t maxValue);
+
+    template <>
+    unsigned int InvertRow<uint16_t>(uint16_t* row,
+                                     unsigned int width,
+                                     uint16_t maxValue);
+  }
+}
@@ -0,0 +1,157 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "InstancesLookAhead.h"
+
+#include <cassert>
+
+namespace Orthanc
+{
+  void InstancesLookAhead::SendTask::Execute()
+  {
+    try
+    {
+      success_ = Send(instance_);
+    }
+    catch (OrthancException& e)
+    {
+      error_.reset(new OrthancException(e));
+    }
+    catch (...)
+    {
+      error_.reset(new OrthancException(ErrorCode_InternalError));
+    }
+  }
+
+
+  bool InstancesLookAhead::SendTask::GetOutcome() const
+  {
+    if (error_.get() != NULL)
+    {
+      throw OrthancException(*error_);
+    }
+    else
+    {
+      return success_;
+    }
+  }
+
+
+  void InstancesLookAhead::SendBatch(ISendTaskFactory& factory,
+                                     const SetOfInstancesJob& job,
+                                     size_t position)
+  {
+    assert(threads_.get() != NULL);
+
+    Clear();
+
+    const size_t end = std::min(position + connectionsCount_, job.GetInstancesCount());
+
+    std::vector<ThreadPool::ITask*> tasks;
+    tasks.reserve(end - position);
+    tasks_.reserve(end - position);
+
+    for (size_t i = position; i < end; i++)
+    {
+      // One connection per instance of the batch
+      tasks_.push_back(factory.CreateSendTask(i - position, job.GetInstance(i)));
+      if (tasks_.back() == NULL)
+      {
+        tasks_.pop_back();
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      tasks.push_back(tasks_.back());
+    }
+
+    position_ = position;
+    threads_->Execute(tasks);
+  }
+
+
+  InstancesLookAhead::~InstancesLookAhead()
+  {
+    Clear();
+    Close();
+  }
+
+
+  void InstancesLookAhead::Clear()
+  {
+    for (size_t i = 0; i < tasks_.size(); i++)
+    {
+      assert(tasks_[i] != NULL);
+      delete tasks_[i];
+    }
+
+    tasks_.clear();
+    position_ = 0;
+  }
+
+
+  void InstancesLookAhead::Close()
+  {
+    threads_.reset(NULL);
+    connectionsCount_ = 0;
+  }
+
+
+  const InstancesLookAhead::SendTask& InstancesLookAhead::Lookup(ISendTaskFactory& factory,
+                                                                 const SetOfInstancesJob& job,
+                                                                 const std::string& instance,
+                                                                 size_t connectionsCount)
+  {
+    if (connectionsCount == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (threads_.get() == NULL ||
+        connectionsCount_ != connectionsCount)
+    {
+      // The thread running the job sends one of the instances by itself
+      threads_.reset(new ThreadPool(connectionsCount - 1));
+      connectionsCount_ = connectionsCount;
+    }
+
+    const size_t position = job.GetPosition();
+
+    if (position < position_ ||
+        position >= position_ + tasks_.size())
+    {
+      SendBatch(factory, job, position);
+    }
+
+    assert(position >= position_ &&
+           position < position_ + tasks_.size());
+
+    const SendTask& task = *tasks_[position - position_];
+    if (task.GetInstance() != instance)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    return task;
+  }
+}
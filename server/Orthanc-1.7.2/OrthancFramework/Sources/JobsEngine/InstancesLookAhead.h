@@ -0,0 +1,137 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class InstancesLookAhead cannot be used in sandboxed environments
+#endif
+
+#include "../Compatibility.h"
+#include "../MultiThreading/ThreadPool.h"
+#include "../OrthancException.h"
+#include "SetOfInstancesJob.h"
+
+namespace Orthanc
+{
+  /**
+   * Helper for the subclasses of "SetOfInstancesJob" that send their
+   * instances over several connections in parallel. When the job
+   * reaches an instance that was not sent in advance, this instance
+   * and the ones that follow it are sent as a batch, one instance per
+   * connection. The outcome of each instance is kept until the job
+   * reaches the corresponding step, so that the progress, the failed
+   * instances and the serialization of the job do not depend on the
+   * number of connections.
+   **/
+  class ORTHANC_PUBLIC InstancesLookAhead : public boost::noncopyable
+  {
+  public:
+    class ORTHANC_PUBLIC SendTask : public ThreadPool::ITask
+    {
+    private:
+      std::string                        instance_;
+      bool                               success_;
+      std::unique_ptr<OrthancException>  error_;
+
+    protected:
+      // Returns "false" if the instance could not be sent because it
+      // was removed after the job was issued
+      virtual bool Send(const std::string& instance) = 0;
+
+    public:
+      explicit SendTask(const std::string& instance) :
+        instance_(instance),
+        success_(false)
+      {
+      }
+
+      const std::string& GetInstance() const
+      {
+        return instance_;
+      }
+
+      virtual void Execute() ORTHANC_OVERRIDE;
+
+      // The errors are reported to the job only once it reaches the
+      // step of this instance, in order to honor "Permissive"
+      bool GetOutcome() const;
+    };
+
+    class ISendTaskFactory
+    {
+    public:
+      virtual ~ISendTaskFactory()
+      {
+      }
+
+      // Creates the task sending "instance" over the connection
+      // with the given index (between 0 and the connections count)
+      virtual SendTask* CreateSendTask(size_t connection,
+                                       const std::string& instance) = 0;
+    };
+
+  private:
+    std::unique_ptr<ThreadPool>  threads_;
+    size_t                       connectionsCount_;
+    std::vector<SendTask*>       tasks_;
+    size_t                       position_;
+
+    void SendBatch(ISendTaskFactory& factory,
+                   const SetOfInstancesJob& job,
+                   size_t position);
+
+  public:
+    InstancesLookAhead() :
+      connectionsCount_(0),
+      position_(0)
+    {
+    }
+
+    ~InstancesLookAhead();
+
+    // Forgets the outcomes of the instances sent in advance (e.g. if
+    // the job is reset)
+    void Clear();
+
+    // Stops the threads, but keeps the outcomes of the instances sent
+    // in advance, so that they are not sent twice if the job is
+    // resumed (e.g. if the job is paused)
+    void Close();
+
+    /**
+     * Returns the task that has sent "instance", which must be the
+     * instance at the current position of the job. If this instance
+     * was not sent in advance, the batch of the instances starting
+     * from the current position is sent first.
+     **/
+    const SendTask& Lookup(ISendTaskFactory& factory,
+                           const SetOfInstancesJob& job,
+                           const std::string& instance,
+                           size_t connectionsCount);
+  };
+}
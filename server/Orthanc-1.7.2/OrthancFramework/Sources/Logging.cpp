@@ -334,6 +334,7 @@ namespace
 #include "SystemToolbox.h"
 
 #include <fstream>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -511,6 +512,230 @@ namespace Orthanc
       prefix = (std::string(date) + path.filename().string() + ":" +
                 boost::lexical_cast<std::string>(line) + "] ");
     }
+
+
+    // "loggingStreamsMutex_" must be locked
+    static std::ostream* GetLevelStream(LogLevel level)
+    {
+      switch (level)
+      {
+        case LogLevel_ERROR:
+          return loggingStreamsContext_->error_;
+              
+        case LogLevel_WARNING:
+          return loggingStreamsContext_->warning_;
+              
+        case LogLevel_INFO:
+        case LogLevel_TRACE:
+          return loggingStreamsContext_->info_;
+              
+        default:
+          throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+
+
+    class AsynchronousWriter : public boost::noncopyable
+    {
+    private:
+      struct Message
+      {
+        LogLevel     level_;
+        std::string  line_;
+      };
+
+      // Bounded ring buffer of the messages that are waiting to be
+      // written by the background thread
+      boost::mutex               mutex_;
+      boost::condition_variable  notEmpty_;
+      boost::condition_variable  notFull_;
+      std::vector<Message>       queue_;
+      size_t                     head_;
+      size_t                     size_;
+      bool                       isWriting_;
+      bool                       done_;
+      LogOverflowPolicy          policy_;
+      uint64_t                   dropped_;
+      boost::thread              thread_;
+
+      static void WriteBatch(const std::vector<Message>& batch,
+                             uint64_t newlyDropped)
+      {
+        boost::mutex::scoped_lock lock(loggingStreamsMutex_);
+
+        if (loggingStreamsContext_.get() == NULL)
+        {
+          return;
+        }
+
+        try
+        {
+          if (newlyDropped > 0)
+          {
+            std::string prefix;
+            GetLinePrefix(prefix, LogLevel_WARNING, __FILE__, __LINE__);
+            *loggingStreamsContext_->warning_
+              << prefix << newlyDropped
+              << " log message(s) were dropped, as the logging queue was full\n";
+          }
+
+          for (size_t i = 0; i < batch.size(); i++)
+          {
+            *GetLevelStream(batch[i].level_) << batch[i].line_ << "\n";
+          }
+
+          // Flush once per batch, instead of once per line
+          loggingStreamsContext_->error_->flush();
+          loggingStreamsContext_->warning_->flush();
+          loggingStreamsContext_->info_->flush();
+        }
+        catch (...)
+        {
+          // Nothing can be reported if the logging itself fails
+        }
+      }
+
+      static void Worker(AsynchronousWriter* that)
+      {
+        std::vector<Message> batch;
+        uint64_t reported = 0;
+        
+        for (;;)
+        {
+          uint64_t dropped;
+
+          {
+            boost::mutex::scoped_lock lock(that->mutex_);
+
+            while (that->size_ == 0 &&
+                   !that->done_)
+            {
+              that->notEmpty_.wait(lock);
+            }
+
+            if (that->size_ == 0)
+            {
+              assert(that->done_);
+              return;
+            }
+
+            // Move the pending messages out of the queue, so that the
+            // producers are not blocked during the I/O
+            batch.resize(that->size_);
+            for (size_t i = 0; i < that->size_; i++)
+            {
+              Message& message = that->queue_[(that->head_ + i) % that->queue_.size()];
+              batch[i].level_ = message.level_;
+              batch[i].line_.swap(message.line_);
+            }
+
+            that->head_ = (that->head_ + that->size_) % that->queue_.size();
+            that->size_ = 0;
+            that->isWriting_ = true;
+            dropped = that->dropped_;
+          }
+
+          that->notFull_.notify_all();
+
+          WriteBatch(batch, dropped - reported);
+          reported = dropped;
+
+          {
+            boost::mutex::scoped_lock lock(that->mutex_);
+            that->isWriting_ = false;
+          }
+
+          that->notFull_.notify_all();  // Wakes up "WaitEmpty()"
+        }
+      }
+
+    public:
+      AsynchronousWriter(size_t queueSize,
+                         LogOverflowPolicy policy) :
+        queue_(queueSize),
+        head_(0),
+        size_(0),
+        isWriting_(false),
+        done_(false),
+        policy_(policy),
+        dropped_(0)
+      {
+        if (queueSize == 0)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        thread_ = boost::thread(Worker, this);
+      }
+
+      ~AsynchronousWriter()
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          done_ = true;
+        }
+
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+
+        if (thread_.joinable())
+        {
+          thread_.join();
+        }
+      }
+
+      // The content of "line" is moved into the queue
+      void Enqueue(LogLevel level,
+                   std::string& line)
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+
+          while (size_ == queue_.size())
+          {
+            if (policy_ == LogOverflowPolicy_Drop ||
+                done_)
+            {
+              dropped_++;
+              return;
+            }
+            else
+            {
+              notFull_.wait(lock);
+            }
+          }
+
+          Message& message = queue_[(head_ + size_) % queue_.size()];
+          message.level_ = level;
+          message.line_.swap(line);
+          size_++;
+        }
+
+        notEmpty_.notify_one();
+      }
+
+      void WaitEmpty()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        while (size_ != 0 ||
+               isWriting_)
+        {
+          notFull_.wait(lock);
+        }
+      }
+
+      uint64_t GetDroppedCount()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return dropped_;
+      }
+    };
+
+
+    // This pointer is only modified while no other thread is logging,
+    // which allows to read it without locking
+    static std::unique_ptr<AsynchronousWriter>  asynchronousWriter_;
     
 
     void InitializePluginContext(void* pluginContext)
@@ -535,6 +760,9 @@ namespace Orthanc
 
     void Finalize()
     {
+      // Write the pending messages, if any
+      asynchronousWriter_.reset(NULL);
+      
       boost::mutex::scoped_lock lock(loggingStreamsMutex_);
       loggingStreamsContext_.reset(NULL);
     }
@@ -680,6 +908,15 @@ namespace Orthanc
         std::string prefix;
         GetLinePrefix(prefix, level, file, line);
 
+        if (asynchronousWriter_.get() != NULL)
+        {
+          // The message is accumulated locally, and queued by the
+          // destructor: The global mutex is not locked
+          asynchronousStream_.reset(new std::stringstream);
+          stream_ = asynchronousStream_.get();
+          (*stream_) << prefix;
+        }
+        else
         {
           // We lock the global mutex. The mutex is locked until the
           // destructor is called: No change in the output can be done.
@@ -692,24 +929,7 @@ namespace Orthanc
             return;
           }
 
-          switch (level)
-          {
-            case LogLevel_ERROR:
-              stream_ = loggingStreamsContext_->error_;
-              break;
-              
-            case LogLevel_WARNING:
-              stream_ = loggingStreamsContext_->warning_;
-              break;
-              
-            case LogLevel_INFO:
-            case LogLevel_TRACE:
-              stream_ = loggingStreamsContext_->info_;
-              break;
-              
-            default:
-              throw OrthancException(ErrorCode_InternalError);
-          }
+          stream_ = GetLevelStream(level);
 
           if (stream_ == &nullStream_)
           {
@@ -765,6 +985,14 @@ namespace Orthanc
           }
         }
       }
+      else if (asynchronousStream_.get() != NULL)
+      {
+        if (asynchronousWriter_.get() != NULL)
+        {
+          std::string line = asynchronousStream_->str();
+          asynchronousWriter_->Enqueue(level_, line);
+        }
+      }
       else if (stream_ != &nullStream_)
       {
         *stream_ << "\n";
@@ -775,6 +1003,11 @@ namespace Orthanc
 
     void Flush()
     {
+      if (asynchronousWriter_.get() != NULL)
+      {
+        asynchronousWriter_->WaitEmpty();
+      }
+      
       if (pluginContext_ != NULL)
       {
         boost::mutex::scoped_lock lock(loggingStreamsMutex_);
@@ -799,6 +1032,39 @@ namespace Orthanc
       loggingStreamsContext_->warning_ = &warningStream;
       loggingStreamsContext_->info_ = &infoStream;
     }
+
+
+    void EnableAsynchronousMode(size_t queueSize,
+                                LogOverflowPolicy policy)
+    {
+      asynchronousWriter_.reset(NULL);
+      asynchronousWriter_.reset(new AsynchronousWriter(queueSize, policy));
+    }
+
+
+    void DisableAsynchronousMode()
+    {
+      asynchronousWriter_.reset(NULL);
+    }
+
+
+    bool IsAsynchronousMode()
+    {
+      return asynchronousWriter_.get() != NULL;
+    }
+
+
+    uint64_t GetDroppedMessagesCount()
+    {
+      if (asynchronousWriter_.get() == NULL)
+      {
+        return 0;
+      }
+      else
+      {
+        return asynchronousWriter_->GetDroppedCount();
+      }
+    }
   }
 }
 
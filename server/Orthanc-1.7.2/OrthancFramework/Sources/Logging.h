@@ -159,17 +159,25 @@ namespace Orthanc
 #include <boost/noncopyable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <sstream>
+#include <stdint.h>
 
 namespace Orthanc
 {
   namespace Logging
   {
+    enum LogOverflowPolicy
+    {
+      LogOverflowPolicy_Block,  // Wait for the queue to have room
+      LogOverflowPolicy_Drop    // Discard the message
+    };
+    
     class ORTHANC_PUBLIC InternalLogger : public boost::noncopyable
     {
     private:
       boost::mutex::scoped_lock           lock_;
       LogLevel                            level_;
       std::unique_ptr<std::stringstream>  pluginStream_;
+      std::unique_ptr<std::stringstream>  asynchronousStream_;
       std::ostream*                       stream_;
 
     public:
@@ -204,6 +212,30 @@ namespace Orthanc
     ORTHANC_PUBLIC void SetErrorWarnInfoLoggingStreams(std::ostream& errorStream,
                                                        std::ostream& warningStream, 
                                                        std::ostream& infoStream);
+
+
+    /**
+     * In the asynchronous mode, the log lines are formatted by the
+     * calling threads, and pushed into a bounded queue that is
+     * written to the logging streams by a background thread. This
+     * avoids holding the global logging mutex during the I/O. If the
+     * queue is full, "policy" tells whether the calling thread waits,
+     * or whether its message is discarded (the discarded messages are
+     * counted and reported in the log).
+     *
+     * These two functions must be called while no other thread is
+     * logging (i.e. at the startup and at the shutdown). The pending
+     * messages are written by DisableAsynchronousMode() and by
+     * Finalize().
+     **/
+    ORTHANC_PUBLIC void EnableAsynchronousMode(size_t queueSize,
+                                               LogOverflowPolicy policy);
+
+    ORTHANC_PUBLIC void DisableAsynchronousMode();
+
+    ORTHANC_PUBLIC bool IsAsynchronousMode();
+
+    ORTHANC_PUBLIC uint64_t GetDroppedMessagesCount();
   }
 }
 
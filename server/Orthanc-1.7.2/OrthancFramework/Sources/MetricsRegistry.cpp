@@ -27,6 +27,10 @@
 #include "Compatibility.h"
 #include "OrthancException.h"
 
+#include <boost/functional/hash.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
 namespace Orthanc
 {
   static const boost::posix_time::ptime GetNow()
@@ -165,6 +169,119 @@ namespace Orthanc
   };
 
 
+  // Upper bounds of the buckets of the histograms (typically in
+  // milliseconds), the last "+Inf" bucket being implicit
+  static const float HISTOGRAM_BOUNDS[] = {
+    1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000
+  };
+
+  static const size_t HISTOGRAM_BOUNDS_COUNT = sizeof(HISTOGRAM_BOUNDS) / sizeof(float);
+
+  static const size_t HISTOGRAM_SHARDS_COUNT = 16;
+
+
+  class MetricsRegistry::Histogram
+  {
+  private:
+    std::vector<uint64_t>  buckets_;  // Not cumulative, last one is "+Inf"
+    uint64_t               count_;
+    double                 sum_;
+
+  public:
+    Histogram() :
+      buckets_(HISTOGRAM_BOUNDS_COUNT + 1, 0),
+      count_(0),
+      sum_(0)
+    {
+    }
+
+    void Observe(float value)
+    {
+      size_t i = 0;
+      while (i < HISTOGRAM_BOUNDS_COUNT &&
+             value > HISTOGRAM_BOUNDS[i])
+      {
+        i++;
+      }
+
+      buckets_[i]++;
+      count_++;
+      sum_ += value;
+    }
+
+    void Merge(const Histogram& other)
+    {
+      assert(buckets_.size() == other.buckets_.size());
+      
+      for (size_t i = 0; i < buckets_.size(); i++)
+      {
+        buckets_[i] += other.buckets_[i];
+      }
+
+      count_ += other.count_;
+      sum_ += other.sum_;
+    }
+
+    uint64_t GetCount() const
+    {
+      return count_;
+    }
+
+    double GetSum() const
+    {
+      return sum_;
+    }
+
+    uint64_t GetBucket(size_t i) const
+    {
+      assert(i < buckets_.size());
+      return buckets_[i];
+    }
+  };
+
+
+  class MetricsRegistry::HistogramShard : public boost::noncopyable
+  {
+  public:
+    typedef std::map<std::string, Histogram>  Histograms;
+
+  private:
+    boost::mutex  mutex_;
+    Histograms    histograms_;
+
+  public:
+    void Observe(const std::string& name,
+                 float value)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      histograms_[name].Observe(value);
+    }
+
+    void MergeInto(Histograms& target)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      for (Histograms::const_iterator it = histograms_.begin();
+           it != histograms_.end(); ++it)
+      {
+        target[it->first].Merge(it->second);
+      }
+    }
+  };
+
+
+  MetricsRegistry::MetricsRegistry() :
+    enabled_(true)
+  {
+    histogramShards_.resize(HISTOGRAM_SHARDS_COUNT);
+    
+    for (size_t i = 0; i < histogramShards_.size(); i++)
+    {
+      histogramShards_[i] = new HistogramShard;
+    }
+  }
+
+
   MetricsRegistry::~MetricsRegistry()
   {
     for (Content::iterator it = content_.begin(); it != content_.end(); ++it)
@@ -172,6 +289,12 @@ namespace Orthanc
       assert(it->second != NULL);
       delete it->second;
     }
+
+    for (size_t i = 0; i < histogramShards_.size(); i++)
+    {
+      assert(histogramShards_[i] != NULL);
+      delete histogramShards_[i];
+    }
   }
 
 
@@ -230,6 +353,47 @@ namespace Orthanc
   }
 
 
+  void MetricsRegistry::ObserveInternal(const std::string& name,
+                                        float value)
+  {
+    // Spread the threads over the shards (Fibonacci hashing, as the
+    // low bits of the hash of a thread identifier are poorly mixed)
+    const size_t hash = boost::hash<boost::thread::id>()(boost::this_thread::get_id());
+    const size_t shard = static_cast<size_t>(
+      (static_cast<uint32_t>(hash) * 2654435761u) >> 16) % histogramShards_.size();
+
+    assert(histogramShards_[shard] != NULL);
+    histogramShards_[shard]->Observe(name, value);
+  }
+
+
+  bool MetricsRegistry::GetHistogramStatistics(uint64_t& count,
+                                               double& sum,
+                                               const std::string& name)
+  {
+    HistogramShard::Histograms merged;
+
+    for (size_t i = 0; i < histogramShards_.size(); i++)
+    {
+      assert(histogramShards_[i] != NULL);
+      histogramShards_[i]->MergeInto(merged);
+    }
+
+    HistogramShard::Histograms::const_iterator found = merged.find(name);
+
+    if (found == merged.end())
+    {
+      return false;
+    }
+    else
+    {
+      count = found->second.GetCount();
+      sum = found->second.GetSum();
+      return true;
+    }
+  }
+
+
   MetricsType MetricsRegistry::GetMetricsType(const std::string& name)
   {
     boost::mutex::scoped_lock lock(mutex_);
@@ -281,6 +445,87 @@ namespace Orthanc
       }
     }
 
+    HistogramShard::Histograms histograms;
+
+    for (size_t i = 0; i < histogramShards_.size(); i++)
+    {
+      assert(histogramShards_[i] != NULL);
+      histogramShards_[i]->MergeInto(histograms);
+    }
+
+    /**
+     * Group the histograms by the name of the metrics, without their
+     * labels. Prometheus expects a single "# TYPE" line per metrics,
+     * followed by all its samples, whereas the sorted map can
+     * interleave the names: "a" < "a_b" < "a{x}".
+     **/
+    typedef std::vector< std::pair<std::string, const Histogram*> >  Labeled;
+    typedef std::map<std::string, Labeled>  Families;
+
+    Families families;
+
+    for (HistogramShard::Histograms::const_iterator it = histograms.begin();
+         it != histograms.end(); ++it)
+    {
+      // Separate the name of the metrics from its labels, if any
+      std::string base, labels;
+
+      size_t pos = it->first.find('{');
+      if (pos == std::string::npos)
+      {
+        base = it->first;
+      }
+      else
+      {
+        base = it->first.substr(0, pos);
+
+        size_t end = it->first.rfind('}');
+        if (end != std::string::npos &&
+            end > pos + 1)
+        {
+          labels = it->first.substr(pos + 1, end - pos - 1) + ",";
+        }
+      }
+
+      families[base].push_back(std::make_pair(labels, &it->second));
+    }
+
+    for (Families::const_iterator family = families.begin();
+         family != families.end(); ++family)
+    {
+      const std::string& base = family->first;
+      buffer.AddChunk("# TYPE " + base + " histogram\n");
+
+      for (Labeled::const_iterator it = family->second.begin();
+           it != family->second.end(); ++it)
+      {
+        const std::string& labels = it->first;
+        const Histogram& histogram = *it->second;
+
+        uint64_t cumulative = 0;
+
+        for (size_t i = 0; i <= HISTOGRAM_BOUNDS_COUNT; i++)
+        {
+          cumulative += histogram.GetBucket(i);
+
+          const std::string bound = (i < HISTOGRAM_BOUNDS_COUNT ?
+                                     boost::lexical_cast<std::string>(HISTOGRAM_BOUNDS[i]) :
+                                     "+Inf");
+
+          buffer.AddChunk(base + "_bucket{" + labels + "le=\"" + bound + "\"} " +
+                          boost::lexical_cast<std::string>(cumulative) + "\n");
+        }
+
+        const std::string suffix = (labels.empty() ? "" :
+                                    "{" + labels.substr(0, labels.size() - 1) + "}");
+      
+        buffer.AddChunk(base + "_sum" + suffix + " " +
+                        boost::lexical_cast<std::string>(histogram.GetSum()) + "\n");
+        buffer.AddChunk(base + "_count" + suffix + " " +
+                        boost::lexical_cast<std::string>(histogram.GetCount()) + "\n");
+      }
+    }
+
     buffer.Flatten(s);
   }
 
@@ -316,4 +561,28 @@ namespace Orthanc
         name_, static_cast<float>(diff.total_milliseconds()), type_);
     }
   }
+
+
+  MetricsRegistry::HistogramTimer::HistogramTimer(MetricsRegistry& registry,
+                                                  const std::string& name) :
+    registry_(registry),
+    name_(name),
+    active_(registry.IsEnabled())
+  {
+    if (active_)
+    {
+      start_ = GetNow();
+    }
+  }
+
+
+  MetricsRegistry::HistogramTimer::~HistogramTimer()
+  {
+    if (active_)
+    {
+      boost::posix_time::time_duration diff = GetNow() - start_;
+      registry_.Observe(
+        name_, static_cast<float>(diff.total_microseconds()) / 1000.0f);
+    }
+  }
 }
@@ -34,6 +34,8 @@
 
 #include <boost/thread/mutex.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <stdint.h>
+#include <vector>
 
 namespace Orthanc
 {
@@ -50,6 +52,8 @@ namespace Orthanc
   {
   private:
     class Item;
+    class Histogram;
+    class HistogramShard;
 
     typedef std::map<std::string, Item*>   Content;
 
@@ -57,15 +61,20 @@ namespace Orthanc
     boost::mutex  mutex_;
     Content       content_;
 
+    // The histograms are sharded by thread, so that concurrent
+    // observations seldom contend on the same mutex. The shards are
+    // merged when the metrics are exported.
+    std::vector<HistogramShard*>  histogramShards_;
+
     void SetValueInternal(const std::string& name,
                           float value,
                           MetricsType type);
 
+    void ObserveInternal(const std::string& name,
+                         float value);
+
   public:
-    MetricsRegistry() :
-      enabled_(true)
-    {
-    }
+    MetricsRegistry();
 
     ~MetricsRegistry();
 
@@ -96,8 +105,29 @@ namespace Orthanc
       SetValue(name, value, MetricsType_Default);
     }
 
+    /**
+     * Adds one observation (typically a duration in milliseconds) to
+     * a histogram, which is exported as the "_bucket", "_sum" and
+     * "_count" Prometheus series. The name may contain labels, e.g.
+     * "orthanc_rest_api_route_duration_ms{method=\"GET\"}".
+     **/
+    void Observe(const std::string& name,
+                 float value)
+    {
+      // Inlining to avoid loosing time if metrics are disabled
+      if (enabled_)
+      {
+        ObserveInternal(name, value);
+      }
+    }
+
     MetricsType GetMetricsType(const std::string& name);
 
+    // Returns "false" if no value was observed for this histogram
+    bool GetHistogramStatistics(uint64_t& count,
+                                double& sum,
+                                const std::string& name);
+
     // https://prometheus.io/docs/instrumenting/exposition_formats/#text-based-format
     void ExportPrometheusText(std::string& s);
 
@@ -176,5 +206,22 @@ namespace Orthanc
 
       ~Timer();
     };
+
+
+    // Observes the lifetime of the object in a histogram
+    class ORTHANC_PUBLIC HistogramTimer : public boost::noncopyable
+    {
+    private:
+      MetricsRegistry&          registry_;
+      std::string               name_;
+      bool                      active_;
+      boost::posix_time::ptime  start_;
+
+    public:
+      HistogramTimer(MetricsRegistry& registry,
+                     const std::string& name);
+
+      ~HistogramTimer();
+    };
   };
 }
@@ -28,61 +28,118 @@
 #include "../OrthancException.h"
 #include "../Logging.h"
 
+#include <set>
+
+
 namespace Orthanc
 {
+  // A thread that has not received any runnable for 10 seconds
+  // (i.e. 100 times 100 milliseconds) is stopped
+  static const int32_t DEQUEUE_TIMEOUT = 100;
+  static const unsigned int MAX_IDLE_DEQUEUES = 100;
+
+
   struct RunnableWorkersPool::PImpl
   {
-    class Worker
+    class Worker : public boost::noncopyable
     {
     private:
-      const bool&           continue_;
-      SharedMessageQueue&   queue_;
-      boost::thread         thread_;
- 
+      PImpl&         pool_;
+      boost::thread  thread_;
+
       static void WorkerThread(Worker* that)
       {
-        while (that->continue_)
+        PImpl& pool = that->pool_;
+        unsigned int idle = 0;
+
+        for (;;)
         {
-          try
           {
-            std::unique_ptr<IDynamicObject>  obj(that->queue_.Dequeue(100));
-            if (obj.get() != NULL)
+            boost::mutex::scoped_lock lock(pool.mutex_);
+            if (!pool.continue_)
             {
-              IRunnableBySteps& runnable = *dynamic_cast<IRunnableBySteps*>(obj.get());
-              
-              bool wishToContinue = runnable.Step();
-              
-              if (wishToContinue)
-              {
-                // The runnable wishes to continue, reinsert it at the beginning of the queue
-                that->queue_.Enqueue(obj.release());
-              }
+              return;
             }
           }
-          catch (OrthancException& e)
-          {
-            LOG(ERROR) << "Exception while handling some runnable object: " << e.What();
-          }
-          catch (std::bad_alloc&)
-          {
-            LOG(ERROR) << "Not enough memory to handle some runnable object";
-          }
-          catch (std::exception& e)
+
+          std::unique_ptr<IDynamicObject>  obj(pool.queue_.Dequeue(DEQUEUE_TIMEOUT));
+          if (obj.get() == NULL)
           {
-            LOG(ERROR) << "std::exception while handling some runnable object: " << e.what();
+            idle++;
+
+            if (idle >= MAX_IDLE_DEQUEUES)
+            {
+              idle = 0;
+
+              boost::mutex::scoped_lock lock(pool.mutex_);
+              if (pool.continue_ &&
+                  pool.workers_.size() > pool.minWorkers_ &&
+                  pool.workers_.size() > pool.countRunnables_)
+              {
+                // Shrink the pool, the thread will be joined by "CollectFinished()"
+                pool.workers_.erase(that);
+                pool.finished_.push_back(that);
+                return;
+              }
+            }
           }
-          catch (...)
+          else
           {
-            LOG(ERROR) << "Native exception while handling some runnable object";
+            idle = 0;
+
+            {
+              boost::mutex::scoped_lock lock(pool.mutex_);
+              pool.countRunning_++;
+            }
+
+            bool wishToContinue = false;
+
+            try
+            {
+              IRunnableBySteps& runnable = *dynamic_cast<IRunnableBySteps*>(obj.get());
+              wishToContinue = runnable.Step();
+            }
+            catch (OrthancException& e)
+            {
+              LOG(ERROR) << "Exception while handling some runnable object: " << e.What();
+            }
+            catch (std::bad_alloc&)
+            {
+              LOG(ERROR) << "Not enough memory to handle some runnable object";
+            }
+            catch (std::exception& e)
+            {
+              LOG(ERROR) << "std::exception while handling some runnable object: " << e.what();
+            }
+            catch (...)
+            {
+              LOG(ERROR) << "Native exception while handling some runnable object";
+            }
+
+            if (wishToContinue)
+            {
+              // The runnable wishes to continue, reinsert it into the queue
+              pool.queue_.Enqueue(obj.release());
+            }
+            else
+            {
+              obj.reset(NULL);
+            }
+
+            boost::mutex::scoped_lock lock(pool.mutex_);
+            pool.countRunning_--;
+
+            if (!wishToContinue)
+            {
+              pool.countRunnables_--;
+            }
           }
         }
       }
 
     public:
-      Worker(const bool& globalContinue,
-             SharedMessageQueue& queue) : 
-        continue_(globalContinue),
-        queue_(queue)
+      explicit Worker(PImpl& pool) :
+        pool_(pool)
       {
         thread_ = boost::thread(WorkerThread, this);
       }
@@ -97,47 +154,99 @@ namespace Orthanc
     };
 
 
+    boost::mutex          mutex_;
     bool                  continue_;
-    std::vector<Worker*>  workers_;
+    size_t                minWorkers_;
+    size_t                maxWorkers_;
+    size_t                countRunnables_;
+    size_t                countRunning_;
+    std::set<Worker*>     workers_;
+    std::vector<Worker*>  finished_;
     SharedMessageQueue    queue_;
-  };
 
+    // The mutex must be locked
+    void AddWorker()
+    {
+      workers_.insert(new Worker(*this));
+    }
 
+    // The mutex must be locked
+    void CollectFinished()
+    {
+      for (size_t i = 0; i < finished_.size(); i++)
+      {
+        // This thread has left the loop, and will not lock the mutex anymore
+        finished_[i]->Join();
+        delete finished_[i];
+      }
 
-  RunnableWorkersPool::RunnableWorkersPool(size_t countWorkers) : pimpl_(new PImpl)
-  {
-    pimpl_->continue_ = true;
+      finished_.clear();
+    }
+  };
 
-    if (countWorkers == 0)
+
+  void RunnableWorkersPool::Setup(size_t minWorkers,
+                                  size_t maxWorkers)
+  {
+    if (minWorkers == 0 ||
+        minWorkers > maxWorkers)
     {
       throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    pimpl_->workers_.resize(countWorkers);
+    pimpl_->continue_ = true;
+    pimpl_->minWorkers_ = minWorkers;
+    pimpl_->maxWorkers_ = maxWorkers;
+    pimpl_->countRunnables_ = 0;
+    pimpl_->countRunning_ = 0;
 
-    for (size_t i = 0; i < countWorkers; i++)
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+    for (size_t i = 0; i < minWorkers; i++)
     {
-      pimpl_->workers_[i] = new PImpl::Worker(pimpl_->continue_, pimpl_->queue_);
+      pimpl_->AddWorker();
     }
   }
 
 
+  RunnableWorkersPool::RunnableWorkersPool(size_t countWorkers) :
+    pimpl_(new PImpl)
+  {
+    Setup(countWorkers, countWorkers);
+  }
+
+
+  RunnableWorkersPool::RunnableWorkersPool(size_t minWorkers,
+                                           size_t maxWorkers) :
+    pimpl_(new PImpl)
+  {
+    Setup(minWorkers, maxWorkers);
+  }
+
+
   void RunnableWorkersPool::Stop()
   {
-    if (pimpl_->continue_)
+    std::vector<PImpl::Worker*> workers;
+
     {
-      pimpl_->continue_ = false;
+      boost::mutex::scoped_lock lock(pimpl_->mutex_);
 
-      for (size_t i = 0; i < pimpl_->workers_.size(); i++)
+      if (!pimpl_->continue_)
       {
-        PImpl::Worker* worker = pimpl_->workers_[i];
-
-        if (worker != NULL)
-        {
-          worker->Join();
-          delete worker;
-        }
+        return;
       }
+
+      pimpl_->continue_ = false;
+      pimpl_->CollectFinished();
+
+      workers.assign(pimpl_->workers_.begin(), pimpl_->workers_.end());
+      pimpl_->workers_.clear();
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+      workers[i]->Join();
+      delete workers[i];
     }
   }
 
@@ -150,11 +259,40 @@ namespace Orthanc
 
   void RunnableWorkersPool::Add(IRunnableBySteps* runnable)
   {
+    std::unique_ptr<IRunnableBySteps> protection(runnable);
+
+    if (runnable == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
     if (!pimpl_->continue_)
     {
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
-    pimpl_->queue_.Enqueue(runnable);
+    pimpl_->CollectFinished();
+
+    pimpl_->queue_.Enqueue(protection.release());
+    pimpl_->countRunnables_++;
+
+    if (pimpl_->workers_.size() < pimpl_->countRunnables_ &&
+        pimpl_->workers_.size() < pimpl_->maxWorkers_)
+    {
+      pimpl_->AddWorker();
+    }
+  }
+
+
+  void RunnableWorkersPool::GetStatistics(size_t& countWorkers,
+                                          size_t& countRunnables,
+                                          size_t& countWaiting) const
+  {
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+    countWorkers = pimpl_->workers_.size();
+    countRunnables = pimpl_->countRunnables_;
+    countWaiting = pimpl_->countRunnables_ - pimpl_->countRunning_;
   }
 }
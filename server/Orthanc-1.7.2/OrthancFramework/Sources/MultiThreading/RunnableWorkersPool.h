@@ -28,19 +28,40 @@
 
 namespace Orthanc
 {
+  /**
+   * Pool of threads that execute runnables step by step, in a
+   * round-robin fashion. The number of threads grows with the number
+   * of pending runnables, up to "maxWorkers", and shrinks back to
+   * "minWorkers" once the threads become idle.
+   **/
   class RunnableWorkersPool : public boost::noncopyable
   {
   private:
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
 
+    void Setup(size_t minWorkers,
+               size_t maxWorkers);
+
     void Stop();
 
   public:
     explicit RunnableWorkersPool(size_t countWorkers);
 
+    RunnableWorkersPool(size_t minWorkers,
+                        size_t maxWorkers);
+
     ~RunnableWorkersPool();
 
     void Add(IRunnableBySteps* runnable);  // Takes the ownership
+
+    /**
+     * "countRunnables" is the number of runnables that are not
+     * finished yet, among which "countWaiting" are waiting for a
+     * thread to execute their next step.
+     **/
+    void GetStatistics(size_t& countWorkers,
+                       size_t& countRunnables,
+                       size_t& countWaiting) const;
   };
 }
@@ -0,0 +1,270 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ThreadPool.h"
+
+#include "../Compatibility.h"
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+#include <cassert>
+
+
+namespace Orthanc
+{
+  class ThreadPool::Batch : public boost::noncopyable
+  {
+  private:
+    const std::vector<ITask*>&         tasks_;
+    size_t                             next_;
+    size_t                             running_;
+    std::unique_ptr<OrthancException>  error_;
+
+  public:
+    explicit Batch(const std::vector<ITask*>& tasks) :
+      tasks_(tasks),
+      next_(0),
+      running_(0)
+    {
+    }
+
+    bool HasPendingTask() const
+    {
+      return next_ < tasks_.size();
+    }
+
+    bool IsFinished() const
+    {
+      return (!HasPendingTask() &&
+              running_ == 0);
+    }
+
+    ITask& StartTask()
+    {
+      assert(HasPendingTask());
+      running_++;
+      return *tasks_[next_++];
+    }
+
+    void FinishTask()
+    {
+      assert(running_ > 0);
+      running_--;
+    }
+
+    void SetError(const OrthancException& e)
+    {
+      if (error_.get() == NULL)
+      {
+        error_.reset(new OrthancException(e));
+      }
+    }
+
+    void CheckError() const
+    {
+      if (error_.get() != NULL)
+      {
+        throw OrthancException(*error_);
+      }
+    }
+  };
+
+
+  bool ThreadPool::ExecuteOneTask(boost::mutex::scoped_lock& lock,
+                                  Batch& batch)
+  {
+    // The mutex must be locked when entering and when leaving this method
+
+    if (!batch.HasPendingTask())
+    {
+      return false;
+    }
+
+    ITask& task = batch.StartTask();
+
+    if (!batch.HasPendingTask())
+    {
+      // This was the last task of the batch, no other thread can take part in it
+      queue_.remove(&batch);
+    }
+
+    lock.unlock();
+
+    std::unique_ptr<OrthancException> error;
+
+    try
+    {
+      task.Execute();
+    }
+    catch (OrthancException& e)
+    {
+      error.reset(new OrthancException(e));
+    }
+    catch (std::bad_alloc&)
+    {
+      error.reset(new OrthancException(ErrorCode_NotEnoughMemory));
+    }
+    catch (std::exception& e)
+    {
+      error.reset(new OrthancException(ErrorCode_InternalError, e.what()));
+    }
+    catch (...)
+    {
+      error.reset(new OrthancException(ErrorCode_InternalError, "Native exception in a task of a thread pool"));
+    }
+
+    lock.lock();
+
+    if (error.get() != NULL)
+    {
+      batch.SetError(*error);
+    }
+
+    batch.FinishTask();
+
+    if (batch.IsFinished())
+    {
+      taskFinished_.notify_all();
+    }
+
+    return true;
+  }
+
+
+  void ThreadPool::Worker(ThreadPool* that)
+  {
+    boost::mutex::scoped_lock lock(that->mutex_);
+
+    for (;;)
+    {
+      while (!that->done_ &&
+             that->queue_.empty())
+      {
+        that->batchAvailable_.wait(lock);
+      }
+
+      if (that->done_)
+      {
+        return;
+      }
+
+      that->ExecuteOneTask(lock, *that->queue_.front());
+    }
+  }
+
+
+  ThreadPool::ThreadPool(size_t countWorkers) :
+    done_(false)
+  {
+    workers_.reserve(countWorkers);
+
+    try
+    {
+      for (size_t i = 0; i < countWorkers; i++)
+      {
+        workers_.push_back(new boost::thread(Worker, this));
+      }
+    }
+    catch (...)
+    {
+      // Failure to create a thread: Stop the threads that were created
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        done_ = true;
+        batchAvailable_.notify_all();
+      }
+
+      for (size_t i = 0; i < workers_.size(); i++)
+      {
+        workers_[i]->join();
+        delete workers_[i];
+      }
+
+      throw;
+    }
+  }
+
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      done_ = true;
+      batchAvailable_.notify_all();
+    }
+
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+      workers_[i]->join();
+      delete workers_[i];
+    }
+  }
+
+
+  void ThreadPool::Execute(const std::vector<ITask*>& tasks)
+  {
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+      if (tasks[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+    }
+
+    if (tasks.empty())
+    {
+      return;
+    }
+
+    Batch batch(tasks);
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (done_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      if (!workers_.empty() &&
+          tasks.size() > 1)
+      {
+        queue_.push_back(&batch);
+        batchAvailable_.notify_all();
+      }
+
+      // The calling thread also takes part in the execution of its own batch
+      while (ExecuteOneTask(lock, batch))
+      {
+      }
+
+      while (!batch.IsFinished())
+      {
+        taskFinished_.wait(lock);
+      }
+    }
+
+    batch.CheckError();
+  }
+}
@@ -0,0 +1,95 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../OrthancFramework.h"
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+#  error The class ThreadPool cannot be used in sandboxed environments
+#endif
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <list>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Fixed set of threads that execute batches of independent tasks
+   * (fork-join). Several threads can submit batches concurrently. The
+   * thread that submits a batch also executes tasks from this batch,
+   * so that a pool with N workers runs N + 1 tasks in parallel.
+   **/
+  class ORTHANC_PUBLIC ThreadPool : public boost::noncopyable
+  {
+  public:
+    class ITask : public boost::noncopyable
+    {
+    public:
+      virtual ~ITask()
+      {
+      }
+
+      virtual void Execute() = 0;
+    };
+
+  private:
+    class Batch;
+
+    boost::mutex                mutex_;
+    boost::condition_variable   batchAvailable_;
+    boost::condition_variable   taskFinished_;
+    std::list<Batch*>           queue_;
+    bool                        done_;
+    std::vector<boost::thread*> workers_;
+
+    static void Worker(ThreadPool* that);
+
+    bool ExecuteOneTask(boost::mutex::scoped_lock& lock,
+                        Batch& batch);
+
+  public:
+    explicit ThreadPool(size_t countWorkers);
+
+    ~ThreadPool();
+
+    size_t GetWorkersCount() const
+    {
+      return workers_.size();
+    }
+
+    /**
+     * Executes all the tasks, and returns once all of them are
+     * finished. The tasks are not deleted. If some task throws an
+     * exception, the remaining tasks are still executed, then the
+     * first exception is rethrown as an OrthancException.
+     **/
+    void Execute(const std::vector<ITask*>& tasks);
+  };
+}
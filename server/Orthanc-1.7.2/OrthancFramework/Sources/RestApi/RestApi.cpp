@@ -25,6 +25,7 @@
 
 #include "../Logging.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <stdlib.h>   // To define "_exit()" under Windows
 #include <stdio.h>
 
@@ -76,48 +77,56 @@ namespace Orthanc
                          const IHttpHandler::Arguments& components,
                          const UriComponents& trailing)
       {
-        if (resource.HasHandler(method_))
+        if (!resource.HasHandler(method_))
         {
-          switch (method_)
+          return false;
+        }
+
+        const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        switch (method_)
+        {
+          case HttpMethod_Get:
+          {
+            RestApiGetCall call(output_, api_, origin_, remoteIp_, username_, 
+                                headers_, components, trailing, uri, getArguments_);
+            resource.Handle(call);
+            break;
+          }
+
+          case HttpMethod_Post:
           {
-            case HttpMethod_Get:
-            {
-              RestApiGetCall call(output_, api_, origin_, remoteIp_, username_, 
-                                  headers_, components, trailing, uri, getArguments_);
-              resource.Handle(call);
-              return true;
-            }
-
-            case HttpMethod_Post:
-            {
-              RestApiPostCall call(output_, api_, origin_, remoteIp_, username_, 
-                                   headers_, components, trailing, uri, bodyData_, bodySize_);
-              resource.Handle(call);
-              return true;
-            }
-
-            case HttpMethod_Delete:
-            {
-              RestApiDeleteCall call(output_, api_, origin_, remoteIp_, username_, 
-                                     headers_, components, trailing, uri);
-              resource.Handle(call);
-              return true;
-            }
-
-            case HttpMethod_Put:
-            {
-              RestApiPutCall call(output_, api_, origin_, remoteIp_, username_, 
-                                  headers_, components, trailing, uri, bodyData_, bodySize_);
-              resource.Handle(call);
-              return true;
-            }
-
-            default:
-              return false;
+            RestApiPostCall call(output_, api_, origin_, remoteIp_, username_, 
+                                 headers_, components, trailing, uri, bodyData_, bodySize_);
+            resource.Handle(call);
+            break;
           }
+
+          case HttpMethod_Delete:
+          {
+            RestApiDeleteCall call(output_, api_, origin_, remoteIp_, username_, 
+                                   headers_, components, trailing, uri);
+            resource.Handle(call);
+            break;
+          }
+
+          case HttpMethod_Put:
+          {
+            RestApiPutCall call(output_, api_, origin_, remoteIp_, username_, 
+                                headers_, components, trailing, uri, bodyData_, bodySize_);
+            resource.Handle(call);
+            break;
+          }
+
+          default:
+            return false;
         }
 
-        return false;
+        const boost::posix_time::time_duration duration =
+          boost::posix_time::microsec_clock::universal_time() - start;
+        api_.SignalHandledCall(method_, resource.GetPath(method_),
+                               static_cast<float>(duration.total_microseconds()) / 1000.0f);
+        return true;
       }
     };
   }
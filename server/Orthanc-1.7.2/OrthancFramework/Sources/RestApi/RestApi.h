@@ -48,6 +48,18 @@ namespace Orthanc
       return false;
     }
 
+    /**
+     * Invoked once a registered handler has served a call, with the
+     * path under which this handler was registered (for instance
+     * "/instances/{id}/file") and the duration of the call in
+     * milliseconds. This is notably used to collect metrics.
+     **/
+    virtual void SignalHandledCall(HttpMethod method,
+                                   const std::string& path,
+                                   float durationMs)
+    {
+    }
+
     virtual bool Handle(HttpOutput& output,
                         RequestOrigin origin,
                         const char* remoteIp,
@@ -61,6 +61,28 @@ namespace Orthanc
   }
 
 
+  const std::string& RestApiHierarchy::Resource::GetPath(HttpMethod method) const
+  {
+    switch (method)
+    {
+      case HttpMethod_Get:
+        return getPath_;
+
+      case HttpMethod_Post:
+        return postPath_;
+
+      case HttpMethod_Put:
+        return putPath_;
+
+      case HttpMethod_Delete:
+        return deletePath_;
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   bool RestApiHierarchy::Resource::IsEmpty() const
   {
     return (getHandler_ == NULL &&
@@ -158,7 +180,8 @@ namespace Orthanc
 
 
   template <typename Handler>
-  void RestApiHierarchy::RegisterInternal(const RestApiPath& path,
+  void RestApiHierarchy::RegisterInternal(const std::string& uri,
+                                          const RestApiPath& path,
                                           Handler handler,
                                           size_t level)
   {
@@ -166,11 +189,11 @@ namespace Orthanc
     {
       if (path.IsUniversalTrailing())
       {
-        universalHandlers_.Register(handler);
+        universalHandlers_.Register(uri, handler);
       }
       else
       {
-        handlers_.Register(handler);
+        handlers_.Register(uri, handler);
       }
     }
     else
@@ -185,7 +208,7 @@ namespace Orthanc
         child = &AddChild(children_, path.GetLevelName(level));
       }
 
-      child->RegisterInternal(path, handler, level + 1);
+      child->RegisterInternal(uri, path, handler, level + 1);
     }
   }
 
@@ -327,28 +350,28 @@ namespace Orthanc
                                   RestApiGetCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(uri, path, handler, 0);
   }
 
   void RestApiHierarchy::Register(const std::string& uri,
                                   RestApiPutCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(uri, path, handler, 0);
   }
 
   void RestApiHierarchy::Register(const std::string& uri,
                                   RestApiPostCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(uri, path, handler, 0);
   }
 
   void RestApiHierarchy::Register(const std::string& uri,
                                   RestApiDeleteCall::Handler handler)
   {
     RestApiPath path(uri);
-    RegisterInternal(path, handler, 0);
+    RegisterInternal(uri, path, handler, 0);
   }
 
   void RestApiHierarchy::CreateSiteMap(Json::Value& target) const
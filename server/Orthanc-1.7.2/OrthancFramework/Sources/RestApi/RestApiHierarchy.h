@@ -41,30 +41,47 @@ namespace Orthanc
       RestApiPostCall::Handler    postHandler_;
       RestApiPutCall::Handler     putHandler_;
       RestApiDeleteCall::Handler  deleteHandler_;
+      std::string                 getPath_;
+      std::string                 postPath_;
+      std::string                 putPath_;
+      std::string                 deletePath_;
 
     public:
       Resource();
 
       bool HasHandler(HttpMethod method) const;
 
-      void Register(RestApiGetCall::Handler handler)
+      // The path under which the handler of the given method was
+      // registered, such as "/instances/{id}/file", which is used to
+      // label the metrics
+      const std::string& GetPath(HttpMethod method) const;
+
+      void Register(const std::string& path,
+                    RestApiGetCall::Handler handler)
       {
         getHandler_ = handler;
+        getPath_ = path;
       }
 
-      void Register(RestApiPutCall::Handler handler)
+      void Register(const std::string& path,
+                    RestApiPutCall::Handler handler)
       {
         putHandler_ = handler;
+        putPath_ = path;
       }
 
-      void Register(RestApiPostCall::Handler handler)
+      void Register(const std::string& path,
+                    RestApiPostCall::Handler handler)
       {
         postHandler_ = handler;
+        postPath_ = path;
       }
 
-      void Register(RestApiDeleteCall::Handler handler)
+      void Register(const std::string& path,
+                    RestApiDeleteCall::Handler handler)
       {
         deleteHandler_ = handler;
+        deletePath_ = path;
       }
 
       bool IsEmpty() const;
@@ -107,7 +124,8 @@ namespace Orthanc
     static void DeleteChildren(Children& children);
 
     template <typename Handler>
-    void RegisterInternal(const RestApiPath& path,
+    void RegisterInternal(const std::string& uri,
+                          const RestApiPath& path,
                           Handler handler,
                           size_t level);
 
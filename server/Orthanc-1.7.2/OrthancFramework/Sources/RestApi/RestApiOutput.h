@@ -84,5 +84,18 @@ namespace Orthanc
     void ResetCookie(const std::string& name);
 
     void Finalize();
+
+    // Direct access to the HTTP output, e.g. to stream an answer
+    // whose size is unknown. "MarkLowLevelOutputDone()" must be
+    // invoked once the answer has been started this way.
+    HttpOutput& GetLowLevelOutput()
+    {
+      return output_;
+    }
+
+    void MarkLowLevelOutputDone()
+    {
+      alreadySent_ = true;
+    }
   };
 }
@@ -58,6 +58,12 @@ namespace Orthanc
                            const std::string& path,
                            size_t headerSize);
 
+    static void ReadFileRange(std::string& content,
+                              const std::string& path,
+                              uint64_t start,  // Inclusive
+                              uint64_t end,    // Exclusive
+                              bool throwIfOverflow);
+
     static void WriteFile(const void* content,
                           size_t size,
                           const std::string& path);
@@ -34,10 +34,13 @@
 #include "../Sources/Compatibility.h"
 #include "../Sources/OrthancException.h"
 #include "../Sources/DicomFormat/DicomMap.h"
+#include "../Sources/DicomFormat/DicomStreamReader.h"
 #include "../Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../Sources/DicomParsing/ToDcmtkBridge.h"
 #include "../Sources/DicomParsing/ParsedDicomFile.h"
 #include "../Sources/DicomParsing/DicomWebJsonVisitor.h"
+#include "../Sources/Images/Image.h"
+#include "../Sources/Images/ImageProcessing.h"
 
 
 using namespace Orthanc;
@@ -650,3 +653,218 @@ TEST(DicomMap, MainTagNames)
     }
   }
 }
+
+
+
+namespace
+{
+  class StreamVisitor : public DicomStreamReader::IVisitor
+  {
+  public:
+    DicomTransferSyntax  transferSyntax_;
+    std::string          patientId_;
+    unsigned int         countTags_;
+    bool                 hasPixelData_;
+    uint64_t             offset_;
+    uint32_t             length_;
+
+    StreamVisitor() :
+      transferSyntax_(DicomTransferSyntax_BigEndianExplicit),
+      countTags_(0),
+      hasPixelData_(false),
+      offset_(0),
+      length_(0)
+    {
+    }
+
+    virtual void VisitMetaHeaderTag(const DicomTag& tag,
+                                    ValueRepresentation vr,
+                                    const std::string& value) ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual void VisitTransferSyntax(DicomTransferSyntax transferSyntax) ORTHANC_OVERRIDE
+    {
+      transferSyntax_ = transferSyntax;
+    }
+
+    virtual bool VisitDatasetTag(const DicomTag& tag,
+                                 ValueRepresentation vr,
+                                 const std::string& value,
+                                 bool isLittleEndian) ORTHANC_OVERRIDE
+    {
+      if (tag == DICOM_TAG_PATIENT_ID)
+      {
+        patientId_ = value;
+      }
+
+      countTags_++;
+      return true;
+    }
+
+    virtual void VisitPixelData(uint64_t offset,
+                                uint32_t length) ORTHANC_OVERRIDE
+    {
+      hasPixelData_ = true;
+      offset_ = offset;
+      length_ = length;
+    }
+  };
+}
+
+
+TEST(DicomStreamReader, PixelData)
+{
+  Image image(PixelFormat_Grayscale8, 16, 8, false);
+  for (unsigned int y = 0; y < image.GetHeight(); y++)
+  {
+    uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
+    for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
+    {
+      *p = static_cast<uint8_t>(y * image.GetWidth() + x);
+    }
+  }
+
+  std::string dicom;
+
+  {
+    ParsedDicomFile f(true);
+    f.ReplacePlainString(DICOM_TAG_PATIENT_ID, "ORTHANC");
+    f.EmbedImage(image);
+    f.SaveToMemoryBuffer(dicom);
+  }
+
+  {
+    StreamVisitor visitor;
+    DicomStreamReader reader(dicom.c_str(), dicom.size());
+    ASSERT_TRUE(reader.Consume(visitor));
+    ASSERT_TRUE(visitor.hasPixelData_);
+    ASSERT_EQ(DicomTransferSyntax_LittleEndianExplicit, visitor.transferSyntax_);
+    ASSERT_EQ("ORTHANC ", visitor.patientId_);  // Padded to an even length
+    ASSERT_LT(0u, visitor.countTags_);
+    ASSERT_EQ(16u * 8u, visitor.length_);
+    ASSERT_EQ(dicom.size(), visitor.offset_ + visitor.length_);
+
+    for (unsigned int i = 0; i < visitor.length_; i++)
+    {
+      ASSERT_EQ(i, static_cast<uint8_t>(dicom[visitor.offset_ + i]));
+    }
+  }
+
+  {
+    uint64_t start, end;
+    DicomStreamReader reader(dicom.c_str(), dicom.size());
+    ASSERT_TRUE(reader.LookupPixelData(start, end));
+    ASSERT_EQ(dicom.size(), end);  // The pixel data is the last element
+    ASSERT_EQ(dicom.size() - 12u - 16u * 8u, start);  // Explicit VR "OW" header
+
+    DicomStreamReader reader2(dicom.c_str(), dicom.size() - 1);
+    ASSERT_FALSE(reader2.LookupPixelData(start, end));
+  }
+
+  {
+    // Truncated file: The pixel data cannot be reached
+    StreamVisitor visitor;
+    DicomStreamReader reader(dicom.c_str(), 200);
+    ASSERT_FALSE(reader.Consume(visitor));
+    ASSERT_FALSE(visitor.hasPixelData_);
+  }
+
+  {
+    std::string s = "Hello";
+    StreamVisitor visitor;
+    DicomStreamReader reader(s.c_str(), s.size());
+    ASSERT_FALSE(reader.Consume(visitor));
+
+    s.resize(200);
+    DicomStreamReader reader2(s.c_str(), s.size());
+    ASSERT_THROW(reader2.Consume(visitor), OrthancException);
+  }
+}
+
+
+static void AppendLittleEndian16(std::string& target,
+                                 uint16_t value)
+{
+  target.push_back(static_cast<char>(value & 0xff));
+  target.push_back(static_cast<char>(value >> 8));
+}
+
+
+static void AppendLittleEndian32(std::string& target,
+                                 uint32_t value)
+{
+  AppendLittleEndian16(target, static_cast<uint16_t>(value & 0xffff));
+  AppendLittleEndian16(target, static_cast<uint16_t>(value >> 16));
+}
+
+
+static void AppendImplicitHeader(std::string& target,
+                                 uint16_t group,
+                                 uint16_t element,
+                                 uint32_t length)
+{
+  AppendLittleEndian16(target, group);
+  AppendLittleEndian16(target, element);
+  AppendLittleEndian32(target, length);
+}
+
+
+TEST(DicomStreamReader, UndefinedLengthUnknown)
+{
+  // The content of an "UN" element with undefined length is encoded
+  // as implicit VR little endian, even in explicit VR files (PS3.5
+  // Section 6.2.2)
+  static const uint32_t UNDEFINED = 0xffffffffu;
+
+  std::string dicom(128, '\0');
+  dicom += "DICM";
+
+  const std::string transferSyntax("1.2.840.10008.1.2.1\0", 20);  // Explicit VR little endian
+
+  // (0002,0000) UL, then (0002,0010) UI
+  AppendLittleEndian16(dicom, 0x0002);
+  AppendLittleEndian16(dicom, 0x0000);
+  dicom += "UL";
+  AppendLittleEndian16(dicom, 4);
+  AppendLittleEndian32(dicom, static_cast<uint32_t>(8 + transferSyntax.size()));
+  AppendLittleEndian16(dicom, 0x0002);
+  AppendLittleEndian16(dicom, 0x0010);
+  dicom += "UI";
+  AppendLittleEndian16(dicom, static_cast<uint16_t>(transferSyntax.size()));
+  dicom += transferSyntax;
+
+  // (0009,1010) UN with undefined length
+  AppendLittleEndian16(dicom, 0x0009);
+  AppendLittleEndian16(dicom, 0x1010);
+  dicom += "UN";
+  AppendLittleEndian16(dicom, 0);
+  AppendLittleEndian32(dicom, UNDEFINED);
+
+  AppendImplicitHeader(dicom, 0xfffe, 0xe000, UNDEFINED);  // Item
+  AppendImplicitHeader(dicom, 0x0008, 0x1155, 4);          // Implicit VR element
+  dicom.append("1.2\0", 4);
+  AppendImplicitHeader(dicom, 0x0008, 0x1140, UNDEFINED);  // Nested sequence
+  AppendImplicitHeader(dicom, 0xfffe, 0xe000, 8);          // Item with defined length
+  AppendImplicitHeader(dicom, 0x0008, 0x0060, 0);
+  AppendImplicitHeader(dicom, 0xfffe, 0xe0dd, 0);          // Sequence delimitation
+  AppendImplicitHeader(dicom, 0xfffe, 0xe00d, 0);          // Item delimitation
+  AppendImplicitHeader(dicom, 0xfffe, 0xe0dd, 0);          // Sequence delimitation
+
+  // (0010,0020) LO, back to explicit VR
+  AppendLittleEndian16(dicom, 0x0010);
+  AppendLittleEndian16(dicom, 0x0020);
+  dicom += "LO";
+  AppendLittleEndian16(dicom, 8);
+  dicom += "ORTHANC ";
+
+  {
+    StreamVisitor visitor;
+    DicomStreamReader reader(dicom.c_str(), dicom.size());
+    ASSERT_FALSE(reader.Consume(visitor));  // No pixel data
+    ASSERT_EQ(DicomTransferSyntax_LittleEndianExplicit, visitor.transferSyntax_);
+    ASSERT_EQ(2u, visitor.countTags_);
+    ASSERT_EQ("ORTHANC ", visitor.patientId_);
+    ASSERT_FALSE(visitor.hasPixelData_);
+  }
+}
@@ -27,11 +27,15 @@
 
 #include <gtest/gtest.h>
 
+#include "../Sources/Cache/MemoryStringCache.h"
 #include "../Sources/FileStorage/FilesystemStorage.h"
+#include "../Sources/FileStorage/MemoryStorageArea.h"
 #include "../Sources/FileStorage/StorageAccessor.h"
 #include "../Sources/HttpServer/BufferHttpSender.h"
 #include "../Sources/HttpServer/FilesystemHttpSender.h"
+#include "../Sources/HttpServer/StringHttpOutput.h"
 #include "../Sources/Logging.h"
+#include "../Sources/MetricsRegistry.h"
 #include "../Sources/OrthancException.h"
 #include "../Sources/Toolbox.h"
 
@@ -115,6 +119,45 @@ TEST(FilesystemStorage, EndToEnd)
 }
 
 
+TEST(FilesystemStorage, ReadRange)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  ASSERT_TRUE(s.HasReadRange());
+
+  std::string data = "Hello world";
+  std::string uid = Toolbox::GenerateUuid();
+  s.Create(uid.c_str(), data.c_str(), data.size(), FileContentType_Unknown);
+
+  std::string d;
+  s.ReadRange(d, uid, FileContentType_Unknown, 0, 5);
+  ASSERT_EQ("Hello", d);
+  s.ReadRange(d, uid, FileContentType_Unknown, 6, 11);
+  ASSERT_EQ("world", d);
+  s.ReadRange(d, uid, FileContentType_Unknown, 4, 4);
+  ASSERT_TRUE(d.empty());
+  ASSERT_THROW(s.ReadRange(d, uid, FileContentType_Unknown, 6, 12), OrthancException);
+  ASSERT_THROW(s.ReadRange(d, uid, FileContentType_Unknown, 5, 4), OrthancException);
+
+  s.Remove(uid, FileContentType_Unknown);
+}
+
+
+TEST(MemoryStorageArea, ReadRange)
+{
+  MemoryStorageArea s;
+  ASSERT_TRUE(s.HasReadRange());
+
+  std::string data = "Hello world";
+  s.Create("a", data.c_str(), data.size(), FileContentType_Unknown);
+
+  std::string d;
+  s.ReadRange(d, "a", FileContentType_Unknown, 2, 8);
+  ASSERT_EQ("llo wo", d);
+  ASSERT_THROW(s.ReadRange(d, "a", FileContentType_Unknown, 0, 12), OrthancException);
+  ASSERT_THROW(s.ReadRange(d, "b", FileContentType_Unknown, 0, 1), OrthancException);
+}
+
+
 TEST(StorageAccessor, NoCompression)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -156,6 +199,102 @@ TEST(StorageAccessor, Compression)
 }
 
 
+TEST(StorageAccessor, AnswerFile)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+
+  std::string data(200000, 'a');  // Spans several chunks
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    data[i] = static_cast<char>(i % 251);
+  }
+
+  // The uncompressed attachment is streamed from the filesystem, the
+  // compressed attachment is transcoded in memory
+  FileInfo uncompressed = accessor.Write(data, FileContentType_Dicom, CompressionType_None, false);
+  FileInfo compressed = accessor.Write(data, FileContentType_Dicom, CompressionType_ZlibWithSize, false);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    StringHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      accessor.AnswerFile(output, (i == 0 ? uncompressed : compressed), MimeType_Dicom);
+    }
+
+    std::string r;
+    stream.GetOutput(r);
+    ASSERT_EQ(data.size(), r.size());
+    ASSERT_TRUE(data == r);
+  }
+
+  accessor.Remove(uncompressed);
+  accessor.Remove(compressed);
+}
+
+
+TEST(StorageAccessor, Cache)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  MemoryStringCache cache;
+  MetricsRegistry metrics;
+  StorageAccessor accessor(s, &cache, metrics);
+
+  std::string data = "HelloWorld";
+  FileInfo compressed = accessor.Write(data, FileContentType_Dicom, CompressionType_ZlibWithSize, false);
+  FileInfo uncompressed = accessor.Write(data, FileContentType_Dicom, CompressionType_None, false);
+
+  std::string r;
+  ASSERT_FALSE(cache.Fetch(r, compressed.GetUuid()));
+  ASSERT_FALSE(cache.Fetch(r, uncompressed.GetUuid()));
+
+  accessor.Read(r, compressed);
+  ASSERT_EQ(data, r);
+  accessor.Read(r, uncompressed);
+  ASSERT_EQ(data, r);
+
+  // The cache stores the uncompressed content
+  ASSERT_TRUE(cache.Fetch(r, compressed.GetUuid()));
+  ASSERT_EQ(data, r);
+  ASSERT_TRUE(cache.Fetch(r, uncompressed.GetUuid()));
+  ASSERT_EQ(data, r);
+
+  // Once cached, the content is not read again from the storage area
+  s.Remove(uncompressed.GetUuid(), uncompressed.GetContentType());
+  accessor.Read(r, uncompressed);
+  ASSERT_EQ(data, r);
+  accessor.ReadRange(r, uncompressed, 5, 10);
+  ASSERT_EQ("World", r);
+
+  {
+    StringHttpOutput stream;
+
+    {
+      HttpOutput output(stream, false);
+      accessor.AnswerFile(output, uncompressed, MimeType_Dicom);
+    }
+
+    stream.GetOutput(r);
+    ASSERT_EQ(data, r);
+  }
+
+  // Removing an attachment invalidates the cache
+  accessor.Remove(compressed);
+  ASSERT_FALSE(cache.Fetch(r, compressed.GetUuid()));
+  ASSERT_THROW(accessor.Read(r, compressed), OrthancException);
+
+  // No cache (as with "MaximumStorageCacheSize" set to zero)
+  StorageAccessor uncached(s, NULL, metrics);
+  FileInfo info = uncached.Write(data, FileContentType_Dicom, CompressionType_None, false);
+  uncached.Read(r, info);
+  ASSERT_EQ(data, r);
+  s.Remove(info.GetUuid(), info.GetContentType());
+  ASSERT_THROW(uncached.Read(r, info), OrthancException);
+}
+
+
 TEST(StorageAccessor, Mix)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -175,6 +314,15 @@ TEST(StorageAccessor, Mix)
   ASSERT_EQ(uncompressedData, r);
   ASSERT_NE(compressedData, r);
 
+  accessor.ReadRange(r, compressedInfo, 1, 4);
+  ASSERT_EQ("ell", r);
+
+  accessor.ReadRange(r, uncompressedInfo, 5, 10);
+  ASSERT_EQ("World", r);
+
+  ASSERT_THROW(accessor.ReadRange(r, compressedInfo, 0, 6), OrthancException);
+  ASSERT_THROW(accessor.ReadRange(r, uncompressedInfo, 0, 11), OrthancException);
+
   /*
   // This test is too slow on Windows
   accessor.SetCompressionForNextOperations(CompressionType_ZlibWithSize);
@@ -43,6 +43,7 @@
 #include "../Sources/TemporaryFile.h"
 #include "../Sources/Toolbox.h"
 
+#include <boost/thread.hpp>
 #include <ctype.h>
 
 
@@ -1333,3 +1334,135 @@ TEST(MetricsRegistry, Basic)
     ASSERT_EQ(MetricsType_MinOver10Seconds, m.GetMetricsType("b"));
   }
 }
+
+
+static void ObserveHistogramThread(MetricsRegistry* m)
+{
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    m->Observe("concurrent", 3);
+  }
+}
+
+
+TEST(MetricsRegistry, Histogram)
+{
+  {
+    MetricsRegistry m;
+    m.SetEnabled(false);
+    m.Observe("hello", 42);
+
+    uint64_t count;
+    double sum;
+    ASSERT_FALSE(m.GetHistogramStatistics(count, sum, "hello"));
+
+    std::string s;
+    m.ExportPrometheusText(s);
+    ASSERT_TRUE(s.empty());
+  }
+
+  {
+    MetricsRegistry m;
+    m.Observe("latency{route=\"/a\"}", 0.5f);
+    m.Observe("latency{route=\"/a\"}", 7);
+    m.Observe("latency{route=\"/a\"}", 100000);
+    m.Observe("plain", 3);
+
+    uint64_t count;
+    double sum;
+    ASSERT_TRUE(m.GetHistogramStatistics(count, sum, "latency{route=\"/a\"}"));
+    ASSERT_EQ(3u, count);
+    ASSERT_DOUBLE_EQ(100007.5, sum);
+    ASSERT_FALSE(m.GetHistogramStatistics(count, sum, "latency"));
+
+    std::string s;
+    m.ExportPrometheusText(s);
+
+    std::vector<std::string> t;
+    Toolbox::TokenizeString(t, s, '\n');
+
+    std::map<std::string, std::string> u;
+    for (size_t i = 0; i < t.size(); i++)
+    {
+      if (!t[i].empty() &&
+          t[i][0] != '#')
+      {
+        size_t pos = t[i].rfind(' ');
+        ASSERT_NE(std::string::npos, pos);
+        u[t[i].substr(0, pos)] = t[i].substr(pos + 1);
+      }
+    }
+
+    ASSERT_EQ("1", u["latency_bucket{route=\"/a\",le=\"1\"}"]);
+    ASSERT_EQ("1", u["latency_bucket{route=\"/a\",le=\"5\"}"]);
+    ASSERT_EQ("2", u["latency_bucket{route=\"/a\",le=\"10\"}"]);
+    ASSERT_EQ("2", u["latency_bucket{route=\"/a\",le=\"30000\"}"]);
+    ASSERT_EQ("3", u["latency_bucket{route=\"/a\",le=\"+Inf\"}"]);
+    ASSERT_EQ("3", u["latency_count{route=\"/a\"}"]);
+    ASSERT_EQ("100007.5", u["latency_sum{route=\"/a\"}"]);
+    ASSERT_EQ("0", u["plain_bucket{le=\"2\"}"]);
+    ASSERT_EQ("1", u["plain_bucket{le=\"5\"}"]);
+    ASSERT_EQ("1", u["plain_count"]);
+    ASSERT_EQ("3", u["plain_sum"]);
+
+    ASSERT_NE(std::string::npos, s.find("# TYPE latency histogram\n"));
+    ASSERT_NE(std::string::npos, s.find("# TYPE plain histogram\n"));
+  }
+
+  {
+    // "latency_other" is sorted between "latency" and "latency{...}"
+    MetricsRegistry m;
+    m.Observe("latency", 1);
+    m.Observe("latency_other", 1);
+    m.Observe("latency{route=\"/a\"}", 1);
+
+    std::string s;
+    m.ExportPrometheusText(s);
+
+    // A single "# TYPE" line per metrics, followed by all its samples
+    const size_t type = s.find("# TYPE latency histogram\n");
+    ASSERT_NE(std::string::npos, type);
+    ASSERT_EQ(std::string::npos, s.find("# TYPE latency histogram\n", type + 1));
+
+    const size_t other = s.find("# TYPE latency_other histogram\n");
+    ASSERT_NE(std::string::npos, other);
+    ASSERT_EQ(std::string::npos, s.find("# TYPE latency_other histogram\n", other + 1));
+
+    const size_t plain = s.find("latency_count 1\n");
+    const size_t labeled = s.find("latency_count{route=\"/a\"} 1\n");
+    ASSERT_NE(std::string::npos, plain);
+    ASSERT_NE(std::string::npos, labeled);
+    ASSERT_TRUE(other < type ||
+                (plain < other && labeled < other));
+    ASSERT_LT(type, plain);
+    ASSERT_LT(type, labeled);
+  }
+
+  {
+    MetricsRegistry m;
+
+    std::vector<boost::thread*> threads;
+    for (size_t i = 0; i < 8; i++)
+    {
+      threads.push_back(new boost::thread(ObserveHistogramThread, &m));
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+      threads[i]->join();
+      delete threads[i];
+    }
+
+    {
+      MetricsRegistry::HistogramTimer timer(m, "timer");
+    }
+
+    uint64_t count;
+    double sum;
+    ASSERT_TRUE(m.GetHistogramStatistics(count, sum, "concurrent"));
+    ASSERT_EQ(8000u, count);
+    ASSERT_DOUBLE_EQ(24000.0, sum);
+    ASSERT_TRUE(m.GetHistogramStatistics(count, sum, "timer"));
+    ASSERT_EQ(1u, count);
+  }
+}
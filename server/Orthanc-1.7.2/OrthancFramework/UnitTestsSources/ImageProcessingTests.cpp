@@ -31,10 +31,16 @@
 #include "../Sources/DicomFormat/DicomImageInformation.h"
 #include "../Sources/Images/Image.h"
 #include "../Sources/Images/ImageProcessing.h"
+#include "../Sources/Images/ImageProcessingSimd.h"
 #include "../Sources/Images/ImageTraits.h"
+#include "../Sources/Logging.h"
 #include "../Sources/OrthancException.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <limits>
 #include <memory>
+#include <string.h>
 
 using namespace Orthanc;
 
@@ -1044,3 +1050,585 @@ TEST(ImageProcessing, ShiftScale2)
     }
   }
 }
+
+
+namespace
+{
+  // Deterministic pseudo-random content, including the extreme values of the pixel format
+  void FillRandom(ImageAccessor& image,
+                  uint32_t seed)
+  {
+    const unsigned int bytesPerRow = image.GetBytesPerPixel() * image.GetWidth();
+
+    for (unsigned int y = 0; y < image.GetHeight(); y++)
+    {
+      uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
+      for (unsigned int x = 0; x < bytesPerRow; x++)
+      {
+        seed = seed * 1103515245u + 12345u;
+        p[x] = static_cast<uint8_t>(seed >> 16);
+      }
+    }
+
+    if (image.GetWidth() >= 2 &&
+        image.GetFormat() != PixelFormat_Float32)
+    {
+      uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(0));
+      memset(p, 0x00, image.GetBytesPerPixel());
+      memset(p + image.GetBytesPerPixel(), 0xff, image.GetBytesPerPixel());
+    }
+  }
+
+  // Float values in [low, high[, with a few values that are exactly halfway between integers
+  void FillRandomFloat(ImageAccessor& image,
+                       uint32_t seed,
+                       float low,
+                       float high)
+  {
+    for (unsigned int y = 0; y < image.GetHeight(); y++)
+    {
+      float* p = reinterpret_cast<float*>(image.GetRow(y));
+      for (unsigned int x = 0; x < image.GetWidth(); x++)
+      {
+        seed = seed * 1103515245u + 12345u;
+        const float v = low + (high - low) * static_cast<float>(seed >> 8) / 16777216.0f;
+        p[x] = ((seed & 7) == 0 ? std::floor(v) + 0.5f : v);
+      }
+    }
+  }
+
+  bool IsSameContent(const ImageAccessor& a,
+                     const ImageAccessor& b)
+  {
+    if (a.GetFormat() != b.GetFormat() ||
+        a.GetWidth() != b.GetWidth() ||
+        a.GetHeight() != b.GetHeight())
+    {
+      return false;
+    }
+
+    const size_t bytesPerRow = a.GetBytesPerPixel() * a.GetWidth();
+
+    for (unsigned int y = 0; y < a.GetHeight(); y++)
+    {
+      if (memcmp(a.GetConstRow(y), b.GetConstRow(y), bytesPerRow) != 0)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Checks that the vectorized kernels give exactly the same results as the scalar code
+  class SimdComparison : public boost::noncopyable
+  {
+  private:
+    ImageProcessingSimd::InstructionSet  previous_;
+
+  public:
+    SimdComparison() :
+      previous_(ImageProcessingSimd::GetInstructionSet())
+    {
+    }
+
+    ~SimdComparison()
+    {
+      ImageProcessingSimd::SetInstructionSet(previous_);
+    }
+
+    static unsigned int GetCount()
+    {
+      return static_cast<unsigned int>(ImageProcessingSimd::GetSupportedInstructionSet()) + 1;
+    }
+
+    static void Select(unsigned int index)
+    {
+      ImageProcessingSimd::SetInstructionSet(static_cast<ImageProcessingSimd::InstructionSet>(index));
+    }
+  };
+
+  const unsigned int SIMD_TEST_WIDTH = 67;   // Not a multiple of the vector sizes
+  const unsigned int SIMD_TEST_HEIGHT = 5;
+}
+
+
+TEST(ImageProcessingSimd, InstructionSet)
+{
+  SimdComparison comparison;
+
+  ImageProcessingSimd::SetInstructionSet(ImageProcessingSimd::InstructionSet_None);
+  ASSERT_EQ(ImageProcessingSimd::InstructionSet_None, ImageProcessingSimd::GetInstructionSet());
+
+  ImageProcessingSimd::SetInstructionSet(ImageProcessingSimd::InstructionSet_AVX2);
+  ASSERT_EQ(ImageProcessingSimd::GetSupportedInstructionSet(), ImageProcessingSimd::GetInstructionSet());
+
+  LOG(INFO) << "Supported SIMD instruction set: "
+            << ImageProcessingSimd::EnumerationToString(ImageProcessingSimd::GetSupportedInstructionSet());
+}
+
+
+TEST(ImageProcessingSimd, Convert)
+{
+  static const PixelFormat formats[][2] = {
+    // Source, target
+    { PixelFormat_Grayscale16, PixelFormat_Grayscale8 },
+    { PixelFormat_SignedGrayscale16, PixelFormat_Grayscale8 },
+    { PixelFormat_Grayscale8, PixelFormat_Grayscale16 },
+    { PixelFormat_Grayscale8, PixelFormat_SignedGrayscale16 },
+    { PixelFormat_SignedGrayscale16, PixelFormat_Grayscale16 },
+    { PixelFormat_Grayscale16, PixelFormat_SignedGrayscale16 },
+    { PixelFormat_RGB24, PixelFormat_Grayscale8 },
+    { PixelFormat_Grayscale8, PixelFormat_RGB24 }
+  };
+
+  SimdComparison comparison;
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+  {
+    Image source(formats[i][0], SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+    FillRandom(source, static_cast<uint32_t>(i));
+
+    Image reference(formats[i][1], SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+    SimdComparison::Select(0);
+    ImageProcessing::Convert(reference, source);
+
+    for (unsigned int j = 1; j < SimdComparison::GetCount(); j++)
+    {
+      Image target(formats[i][1], SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+      SimdComparison::Select(j);
+      ImageProcessing::Convert(target, source);
+      ASSERT_TRUE(IsSameContent(reference, target));
+    }
+  }
+
+  {
+    // Brightest RGB24 pixel
+    Image source(PixelFormat_RGB24, 32, 1, false);
+    ImageProcessing::Set(source, 255, 255, 255, 255);
+
+    Image target(PixelFormat_Grayscale8, 32, 1, false);
+    ImageProcessing::Convert(target, source);
+
+    for (unsigned int x = 0; x < 32; x++)
+    {
+      ASSERT_TRUE(TestGrayscale8Pixel(target, x, 0, 248));
+    }
+  }
+}
+
+
+TEST(ImageProcessingSimd, ShiftScale)
+{
+  static const PixelFormat formats[] = {
+    PixelFormat_Grayscale8,
+    PixelFormat_Grayscale16,
+    PixelFormat_SignedGrayscale16,
+    PixelFormat_Float32
+  };
+
+  // Pairs (offset, scaling), some of which produce halfway values
+  static const float parameters[][2] = {
+    { 0.0f, 1.0f },
+    { -1.1f, 1.5f },
+    { 0.5f, 0.5f },
+    { -17.1f, 11.5f },
+    { 100.0f, -0.25f },
+    { 0.25f, 3.0f }
+  };
+
+  SimdComparison comparison;
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+  {
+    Image source(formats[i], SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+
+    if (formats[i] == PixelFormat_Float32)
+    {
+      FillRandomFloat(source, static_cast<uint32_t>(i), -1000.0f, 1000.0f);
+
+      float* p = reinterpret_cast<float*>(source.GetRow(0));
+      p[0] = -0.0f;
+      p[1] = std::numeric_limits<float>::infinity();
+      p[2] = -std::numeric_limits<float>::infinity();
+      p[3] = std::numeric_limits<float>::max();
+      p[4] = 1.0e20f;
+      p[5] = -0.3f;
+    }
+    else
+    {
+      FillRandom(source, static_cast<uint32_t>(i));
+    }
+
+    for (size_t k = 0; k < sizeof(parameters) / sizeof(parameters[0]); k++)
+    {
+      for (unsigned int useRound = 0; useRound < 2; useRound++)
+      {
+        if (formats[i] == PixelFormat_Float32 &&
+            useRound)
+        {
+          continue;  // Rounding of floating-point images overflows on large values
+        }
+
+        std::unique_ptr<Image> reference(Image::Clone(source));
+        SimdComparison::Select(0);
+        ImageProcessing::ShiftScale2(*reference, parameters[k][0], parameters[k][1], useRound != 0);
+
+        for (unsigned int j = 1; j < SimdComparison::GetCount(); j++)
+        {
+          std::unique_ptr<Image> target(Image::Clone(source));
+          SimdComparison::Select(j);
+          ImageProcessing::ShiftScale2(*target, parameters[k][0], parameters[k][1], useRound != 0);
+          ASSERT_TRUE(IsSameContent(*reference, *target));
+        }
+      }
+    }
+  }
+}
+
+
+TEST(ImageProcessingSimd, FloatToGrayscale8)
+{
+  SimdComparison comparison;
+
+  Image source(PixelFormat_Float32, SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+  FillRandomFloat(source, 42, -100.0f, 400.0f);
+
+  for (unsigned int useRound = 0; useRound < 2; useRound++)
+  {
+    Image reference(PixelFormat_Grayscale8, SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+    SimdComparison::Select(0);
+    ImageProcessing::ShiftScale2(reference, source, 0.5f, 0.75f, useRound != 0);
+
+    for (unsigned int j = 1; j < SimdComparison::GetCount(); j++)
+    {
+      Image target(PixelFormat_Grayscale8, SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+      SimdComparison::Select(j);
+      ImageProcessing::ShiftScale2(target, source, 0.5f, 0.75f, useRound != 0);
+      ASSERT_TRUE(IsSameContent(reference, target));
+    }
+  }
+}
+
+
+TEST(ImageProcessingSimd, Windowing)
+{
+  static const PixelFormat sources[] = {
+    PixelFormat_Grayscale8,
+    PixelFormat_Grayscale16,
+    PixelFormat_Float32
+  };
+
+  static const PixelFormat targets[] = {
+    PixelFormat_Grayscale8,
+    PixelFormat_Grayscale16
+  };
+
+  SimdComparison comparison;
+
+  for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+  {
+    Image source(sources[i], SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+
+    if (sources[i] == PixelFormat_Float32)
+    {
+      FillRandomFloat(source, static_cast<uint32_t>(i), -2000.0f, 4000.0f);
+    }
+    else
+    {
+      FillRandom(source, static_cast<uint32_t>(i));
+    }
+
+    for (size_t k = 0; k < sizeof(targets) / sizeof(targets[0]); k++)
+    {
+      for (unsigned int invert = 0; invert < 2; invert++)
+      {
+        Image reference(targets[k], SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+        SimdComparison::Select(0);
+        ImageProcessing::ApplyWindowing_Deprecated(reference, source, 1000.0f, 1500.0f, 1.5f, -100.0f, invert != 0);
+
+        for (unsigned int j = 1; j < SimdComparison::GetCount(); j++)
+        {
+          Image target(targets[k], SIMD_TEST_WIDTH, SIMD_TEST_HEIGHT, false);
+          SimdComparison::Select(j);
+          ImageProcessing::ApplyWindowing_Deprecated(target, source, 1000.0f, 1500.0f, 1.5f, -100.0f, invert != 0);
+          ASSERT_TRUE(IsSameContent(reference, target));
+        }
+      }
+    }
+  }
+}
+
+
+TEST(ImageProcessingSimd, MinMaxAndInvert)
+{
+  static const PixelFormat formats[] = {
+    PixelFormat_Grayscale8,
+    PixelFormat_Grayscale16,
+    PixelFormat_SignedGrayscale16
+  };
+
+  SimdComparison comparison;
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+  {
+    for (unsigned int width = 1; width < 70; width += 23)
+    {
+      Image source(formats[i], width, SIMD_TEST_HEIGHT, false);
+      FillRandom(source, static_cast<uint32_t>(width));
+
+      int64_t referenceMin, referenceMax;
+      SimdComparison::Select(0);
+      ImageProcessing::GetMinMaxIntegerValue(referenceMin, referenceMax, source);
+
+      for (unsigned int j = 1; j < SimdComparison::GetCount(); j++)
+      {
+        int64_t minValue, maxValue;
+        SimdComparison::Select(j);
+        ImageProcessing::GetMinMaxIntegerValue(minValue, maxValue, source);
+        ASSERT_EQ(referenceMin, minValue);
+        ASSERT_EQ(referenceMax, maxValue);
+      }
+
+      if (formats[i] != PixelFormat_SignedGrayscale16)
+      {
+        std::unique_ptr<Image> reference(Image::Clone(source));
+        SimdComparison::Select(0);
+        ImageProcessing::Invert(*reference, 200);  // Wraps around for the values above 200
+
+        for (unsigned int j = 1; j < SimdComparison::GetCount(); j++)
+        {
+          std::unique_ptr<Image> target(Image::Clone(source));
+          SimdComparison::Select(j);
+          ImageProcessing::Invert(*target, 200);
+          ASSERT_TRUE(IsSameContent(*reference, *target));
+        }
+      }
+    }
+  }
+}
+
+
+TEST(ImageProcessingSimd, DISABLED_Benchmark)
+{
+  const unsigned int width = 2048;
+  const unsigned int height = 2048;
+  const unsigned int repetitions = 20;
+
+  Image grayscale16(PixelFormat_Grayscale16, width, height, false);
+  Image signedGrayscale16(PixelFormat_SignedGrayscale16, width, height, false);
+  Image rgb24(PixelFormat_RGB24, width, height, false);
+  Image float32(PixelFormat_Float32, width, height, false);
+  Image grayscale8(PixelFormat_Grayscale8, width, height, false);
+
+  FillRandom(grayscale16, 1);
+  FillRandom(signedGrayscale16, 2);
+  FillRandom(rgb24, 3);
+  FillRandomFloat(float32, 4, -1000.0f, 1000.0f);
+
+  SimdComparison comparison;
+
+  for (unsigned int j = 0; j < SimdComparison::GetCount(); j++)
+  {
+    SimdComparison::Select(j);
+
+    for (unsigned int operation = 0; operation < 6; operation++)
+    {
+      const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+      for (unsigned int k = 0; k < repetitions; k++)
+      {
+        int64_t a, b;
+
+        switch (operation)
+        {
+          case 0:
+            ImageProcessing::Convert(grayscale8, grayscale16);
+            break;
+
+          case 1:
+            ImageProcessing::Convert(grayscale8, signedGrayscale16);
+            break;
+
+          case 2:
+            ImageProcessing::Convert(grayscale8, rgb24);
+            break;
+
+          case 3:
+            ImageProcessing::ShiftScale2(grayscale8, float32, 10.0f, 0.1f, true);
+            break;
+
+          case 4:
+            ImageProcessing::ApplyWindowing_Deprecated(grayscale8, grayscale16, 2000.0f, 4000.0f, 1.0f, 0.0f, false);
+            break;
+
+          case 5:
+            ImageProcessing::GetMinMaxIntegerValue(a, b, grayscale16);
+            break;
+
+          default:
+            throw OrthancException(ErrorCode_InternalError);
+        }
+      }
+
+      static const char* const names[] = {
+        "Convert(Grayscale16 -> Grayscale8)",
+        "Convert(SignedGrayscale16 -> Grayscale8)",
+        "Convert(RGB24 -> Grayscale8)",
+        "ShiftScale2(Float32 -> Grayscale8)",
+        "ApplyWindowing(Grayscale16 -> Grayscale8)",
+        "GetMinMaxIntegerValue(Grayscale16)"
+      };
+
+      const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+      LOG(WARNING) << ImageProcessingSimd::EnumerationToString(ImageProcessingSimd::GetInstructionSet())
+                   << " - " << names[operation] << ": "
+                   << (static_cast<double>(elapsed.total_microseconds()) / 1000.0 / static_cast<double>(repetitions))
+                   << " ms per " << width << "x" << height << " image";
+    }
+  }
+}
+
+
+namespace
+{
+  class ThreadsCountRestorer : public boost::noncopyable
+  {
+  private:
+    unsigned int  previous_;
+
+  public:
+    ThreadsCountRestorer() :
+      previous_(ImageProcessing::GetThreadsCount())
+    {
+    }
+
+    ~ThreadsCountRestorer()
+    {
+      ImageProcessing::SetThreadsCount(previous_);
+    }
+  };
+
+
+  void ApplyParallelOperations(std::vector<ImageAccessor*>& target,
+                               const ImageAccessor& grayscale8,
+                               const ImageAccessor& rgb24,
+                               const ImageAccessor& float32)
+  {
+    for (size_t i = 0; i < target.size(); i++)
+    {
+      delete target[i];
+    }
+
+    target.clear();
+
+    // Enlarge and shrink, with widths that are not multiples of the number of bands
+    target.push_back(ImageProcessing::FitSize(grayscale8, 1031, 517));
+    target.push_back(ImageProcessing::FitSize(grayscale8, 171, 203));
+    target.push_back(ImageProcessing::FitSize(rgb24, 613, 1207));
+    target.push_back(ImageProcessing::FitSize(float32, 999, 333));
+
+    std::unique_ptr<ImageAccessor> image(Image::Clone(grayscale8));
+    ImageProcessing::SmoothGaussian5x5(*image, true);
+    target.push_back(image.release());
+
+    image.reset(Image::Clone(rgb24));
+    ImageProcessing::SmoothGaussian5x5(*image, false);
+    target.push_back(image.release());
+
+    std::vector<float> horizontal, vertical;
+    horizontal.push_back(1);
+    horizontal.push_back(3);
+    horizontal.push_back(-1);
+    vertical.push_back(2);
+    vertical.push_back(1);
+    vertical.push_back(1);
+    vertical.push_back(1);
+    vertical.push_back(2);
+
+    image.reset(Image::Clone(rgb24));
+    ImageProcessing::SeparableConvolution(*image, horizontal, 2, vertical, 1, true);
+    target.push_back(image.release());
+  }
+}
+
+
+TEST(ImageProcessing, ParallelProcessing)
+{
+  ASSERT_THROW(ImageProcessing::SetThreadsCount(0), OrthancException);
+
+  // Large enough for the multi-threaded code path to be used
+  Image grayscale8(PixelFormat_Grayscale8, 401, 257, false);
+  Image rgb24(PixelFormat_RGB24, 257, 401, false);
+  Image float32(PixelFormat_Float32, 300, 301, false);
+  FillRandom(grayscale8, 1);
+  FillRandom(rgb24, 2);
+  FillRandomFloat(float32, 3, -1000.0f, 1000.0f);
+
+  ThreadsCountRestorer restorer;
+
+  std::vector<ImageAccessor*> serial, parallel;
+
+  ImageProcessing::SetThreadsCount(1);
+  ASSERT_EQ(1u, ImageProcessing::GetThreadsCount());
+  ApplyParallelOperations(serial, grayscale8, rgb24, float32);
+
+  static const unsigned int threads[] = { 2, 3, 4, 7, 16 };
+
+  for (size_t i = 0; i < sizeof(threads) / sizeof(unsigned int); i++)
+  {
+    ImageProcessing::SetThreadsCount(threads[i]);
+    ASSERT_EQ(threads[i], ImageProcessing::GetThreadsCount());
+    ApplyParallelOperations(parallel, grayscale8, rgb24, float32);
+
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (size_t j = 0; j < serial.size(); j++)
+    {
+      ASSERT_TRUE(IsSameContent(*serial[j], *parallel[j]));
+    }
+  }
+
+  for (size_t i = 0; i < serial.size(); i++)
+  {
+    delete serial[i];
+    delete parallel[i];
+  }
+}
+
+
+TEST(ImageProcessing, DISABLED_BenchmarkParallel)
+{
+  const unsigned int width = 4096;
+  const unsigned int height = 4096;
+
+  Image source(PixelFormat_RGB24, width, height, false);
+  FillRandom(source, 1);
+
+  ThreadsCountRestorer restorer;
+
+  const unsigned int maxThreads = std::max(1u, boost::thread::hardware_concurrency());
+
+  for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    ImageProcessing::SetThreadsCount(threads);
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    {
+      std::unique_ptr<ImageAccessor> resized(ImageProcessing::FitSize(source, 1024, 1024));
+    }
+
+    boost::posix_time::ptime middle = boost::posix_time::microsec_clock::universal_time();
+
+    {
+      std::unique_ptr<ImageAccessor> smoothed(Image::Clone(source));
+      ImageProcessing::SmoothGaussian5x5(*smoothed, true);
+    }
+
+    boost::posix_time::ptime end = boost::posix_time::microsec_clock::universal_time();
+
+    LOG(WARNING) << threads << " thread(s) - FitSize(RGB24 " << width << "x" << height << " -> 1024x1024): "
+                 << (middle - start).total_milliseconds() << " ms, SmoothGaussian5x5(RGB24 "
+                 << width << "x" << height << "): " << (end - middle).total_milliseconds() << " ms";
+  }
+}
@@ -32,6 +32,7 @@
 #include "../../OrthancFramework/Sources/DicomParsing/DicomModification.h"
 #include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
 #include "../../OrthancFramework/Sources/JobsEngine/GenericJobUnserializer.h"
+#include "../../OrthancFramework/Sources/JobsEngine/InstancesLookAhead.h"
 #include "../../OrthancFramework/Sources/JobsEngine/JobsEngine.h"
 #include "../../OrthancFramework/Sources/JobsEngine/Operations/JobOperationValues.h"
 #include "../../OrthancFramework/Sources/JobsEngine/Operations/LogJobOperation.h"
@@ -40,7 +41,9 @@
 #include "../../OrthancFramework/Sources/JobsEngine/Operations/StringOperationValue.h"
 #include "../../OrthancFramework/Sources/JobsEngine/SetOfInstancesJob.h"
 #include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/Sources/MultiThreading/RunnableWorkersPool.h"
 #include "../../OrthancFramework/Sources/MultiThreading/SharedMessageQueue.h"
+#include "../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
 #include "../../OrthancFramework/Sources/OrthancException.h"
 #include "../../OrthancFramework/Sources/SerializationToolbox.h"
 
@@ -278,6 +281,333 @@ TEST(MultiThreading, SharedMessageQueueClean)
 }
 
 
+namespace
+{
+  class ThreadPoolTask : public ThreadPool::ITask
+  {
+  private:
+    boost::mutex&  mutex_;
+    std::set<int>& done_;
+    int            value_;
+
+  public:
+    ThreadPoolTask(boost::mutex& mutex,
+                   std::set<int>& done,
+                   int value) :
+      mutex_(mutex),
+      done_(done),
+      value_(value)
+    {
+    }
+
+    virtual void Execute() ORTHANC_OVERRIDE
+    {
+      if (value_ < 0)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      boost::mutex::scoped_lock lock(mutex_);
+      done_.insert(value_);
+    }
+  };
+}
+
+
+TEST(MultiThreading, ThreadPool)
+{
+  for (size_t workers = 0; workers < 4; workers++)
+  {
+    ThreadPool pool(workers);
+    ASSERT_EQ(workers, pool.GetWorkersCount());
+
+    boost::mutex mutex;
+    std::set<int> done;
+
+    std::vector<ThreadPool::ITask*> tasks;
+    pool.Execute(tasks);  // No task
+
+    for (int i = 0; i < 100; i++)
+    {
+      tasks.push_back(new ThreadPoolTask(mutex, done, i));
+    }
+
+    pool.Execute(tasks);
+    ASSERT_EQ(100u, done.size());
+    ASSERT_EQ(0, *done.begin());
+    ASSERT_EQ(99, *done.rbegin());
+
+    // The failure of one task does not prevent the other tasks from running
+    done.clear();
+    tasks.push_back(new ThreadPoolTask(mutex, done, -1));
+    ASSERT_THROW(pool.Execute(tasks), OrthancException);
+    ASSERT_EQ(100u, done.size());
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+      delete tasks[i];
+    }
+
+    tasks.clear();
+    tasks.push_back(NULL);
+    ASSERT_THROW(pool.Execute(tasks), OrthancException);
+  }
+}
+
+
+namespace
+{
+  class LookAheadJob :
+    public SetOfInstancesJob,
+    private InstancesLookAhead::ISendTaskFactory
+  {
+  private:
+    class SendTask : public InstancesLookAhead::SendTask
+    {
+    private:
+      LookAheadJob&  that_;
+      size_t         connection_;
+
+    protected:
+      virtual bool Send(const std::string& instance) ORTHANC_OVERRIDE
+      {
+        boost::mutex::scoped_lock lock(that_.mutex_);
+        that_.sent_.push_back(std::make_pair(instance, connection_));
+
+        if (instance == "error")
+        {
+          throw OrthancException(ErrorCode_NetworkProtocol);
+        }
+        else
+        {
+          return (instance != "removed");
+        }
+      }
+
+    public:
+      SendTask(LookAheadJob& that,
+               size_t connection,
+               const std::string& instance) :
+        InstancesLookAhead::SendTask(instance),
+        that_(that),
+        connection_(connection)
+      {
+      }
+    };
+
+    size_t              connections_;
+    InstancesLookAhead  lookAhead_;
+    boost::mutex        mutex_;
+    std::vector< std::pair<std::string, size_t> >  sent_;
+
+    virtual InstancesLookAhead::SendTask* CreateSendTask(size_t connection,
+                                                         const std::string& instance) ORTHANC_OVERRIDE
+    {
+      EXPECT_LT(connection, connections_);
+      return new SendTask(*this, connection, instance);
+    }
+
+  protected:
+    virtual bool HandleInstance(const std::string& instance) ORTHANC_OVERRIDE
+    {
+      return lookAhead_.Lookup(*this, *this, instance, connections_).GetOutcome();
+    }
+
+    virtual bool HandleTrailingStep() ORTHANC_OVERRIDE
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+  public:
+    explicit LookAheadJob(size_t connections) :
+      connections_(connections)
+    {
+    }
+
+    virtual ~LookAheadJob()
+    {
+      lookAhead_.Clear();
+    }
+
+    // Pairs (instance, index of the connection), in the order of the
+    // batches (the order is arbitrary within one batch)
+    const std::vector< std::pair<std::string, size_t> >& GetSent() const
+    {
+      return sent_;
+    }
+
+    virtual void Stop(JobStopReason reason) ORTHANC_OVERRIDE
+    {
+      lookAhead_.Close();
+    }
+
+    virtual void Reset() ORTHANC_OVERRIDE
+    {
+      SetOfInstancesJob::Reset();
+      lookAhead_.Clear();
+    }
+
+    virtual void GetJobType(std::string& s) ORTHANC_OVERRIDE
+    {
+      s = "LookAhead";
+    }
+  };
+}
+
+
+TEST(JobsEngine, InstancesLookAhead)
+{
+  for (size_t connections = 1; connections <= 4; connections++)
+  {
+    LookAheadJob job(connections);
+    job.SetPermissive(true);
+
+    for (size_t i = 0; i < 10; i++)
+    {
+      job.AddInstance(i == 5 ? "removed" :
+                      i == 7 ? "error" :
+                      "instance-" + boost::lexical_cast<std::string>(i));
+    }
+
+    job.Start();
+
+    for (size_t i = 0; i < 9; i++)
+    {
+      ASSERT_EQ(JobStepCode_Continue, job.Step("jobId").GetCode());
+
+      // The instances are sent by batches, starting at the current
+      // position of the job
+      ASSERT_EQ(std::min(static_cast<size_t>(10), (i / connections + 1) * connections),
+                job.GetSent().size());
+    }
+
+    ASSERT_EQ(JobStepCode_Success, job.Step("jobId").GetCode());
+
+    // Each instance is sent exactly once, in the order of the job, one
+    // instance per connection in each batch
+    const std::vector< std::pair<std::string, size_t> >& sent = job.GetSent();
+    ASSERT_EQ(10u, sent.size());
+
+    for (size_t i = 0; i < 10; i++)
+    {
+      bool found = false;
+      for (size_t j = (i / connections) * connections;
+           j < std::min(static_cast<size_t>(10), (i / connections + 1) * connections); j++)
+      {
+        if (sent[j].first == job.GetInstance(i))
+        {
+          ASSERT_FALSE(found);
+          ASSERT_EQ(i % connections, sent[j].second);
+          found = true;
+        }
+      }
+
+      ASSERT_TRUE(found);
+    }
+
+    // Only the removed instance is reported as failed, the error of a
+    // permissive job being ignored
+    ASSERT_EQ(1u, job.GetFailedInstances().size());
+    ASSERT_TRUE(job.IsFailedInstance("removed"));
+
+    // After a reset, the instances are sent again
+    job.Reset();
+    ASSERT_EQ(JobStepCode_Continue, job.Step("jobId").GetCode());
+    ASSERT_EQ(10u + connections, sent.size());
+
+    std::set<std::string> resent;
+    for (size_t i = 10; i < sent.size(); i++)
+    {
+      resent.insert(sent[i].first);
+    }
+
+    ASSERT_EQ(connections, resent.size());
+    ASSERT_TRUE(resent.find(job.GetInstance(0)) != resent.end());
+  }
+
+  {
+    // The errors are reported once the job reaches the step of the
+    // failing instance, even if it was sent in advance
+    LookAheadJob job(4);
+    job.AddInstance("instance-0");
+    job.AddInstance("instance-1");
+    job.AddInstance("error");
+    job.AddInstance("instance-3");
+    job.Start();
+
+    ASSERT_EQ(JobStepCode_Continue, job.Step("jobId").GetCode());
+    ASSERT_EQ(4u, job.GetSent().size());
+    ASSERT_EQ(JobStepCode_Continue, job.Step("jobId").GetCode());
+
+    JobStepResult result = job.Step("jobId");
+    ASSERT_EQ(JobStepCode_Failure, result.GetCode());
+    ASSERT_EQ(ErrorCode_NetworkProtocol, result.GetFailureCode());
+  }
+}
+
+
+namespace
+{
+  class CountingRunnable : public IRunnableBySteps
+  {
+  private:
+    unsigned int  steps_;
+
+  public:
+    explicit CountingRunnable(unsigned int steps) :
+      steps_(steps)
+    {
+    }
+
+    virtual bool Step() ORTHANC_OVERRIDE
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      steps_--;
+      return steps_ > 0;
+    }
+  };
+}
+
+
+TEST(MultiThreading, RunnableWorkersPool)
+{
+  ASSERT_THROW(RunnableWorkersPool(0), OrthancException);
+  ASSERT_THROW(RunnableWorkersPool(3, 2), OrthancException);
+
+  RunnableWorkersPool pool(1, 4);
+
+  size_t countWorkers, countRunnables, countWaiting;
+  pool.GetStatistics(countWorkers, countRunnables, countWaiting);
+  ASSERT_EQ(1u, countWorkers);
+  ASSERT_EQ(0u, countRunnables);
+  ASSERT_EQ(0u, countWaiting);
+
+  for (unsigned int i = 0; i < 10; i++)
+  {
+    pool.Add(new CountingRunnable(20));
+
+    pool.GetStatistics(countWorkers, countRunnables, countWaiting);
+    ASSERT_EQ(std::min(4u, i + 1), countWorkers);  // The pool grows up to its maximum size
+    ASSERT_GE(countRunnables, countWaiting);
+  }
+
+  for (unsigned int i = 0; i < 500; i++)
+  {
+    pool.GetStatistics(countWorkers, countRunnables, countWaiting);
+    if (countRunnables == 0)
+    {
+      break;
+    }
+
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+
+  ASSERT_EQ(4u, countWorkers);
+  ASSERT_EQ(0u, countRunnables);
+  ASSERT_EQ(0u, countWaiting);
+}
+
+
 
 
 static bool CheckState(JobsRegistry& registry,
@@ -1420,5 +1750,35 @@ TEST(JobsSerialization, RemoteModalityParameters)
     ASSERT_TRUE(modality.IsRequestAllowed(DicomRequestType_NAction));
     ASSERT_TRUE(modality.IsRequestAllowed(DicomRequestType_NEventReport));
     ASSERT_TRUE(modality.IsTranscodingAllowed());
+    ASSERT_EQ(1u, modality.GetStoreAssociationsCount());
+  }
+
+  {
+    Json::Value s;
+    s["AET"] = "AET";
+    s["Host"] = "host";
+    s["Port"] = "104";
+    s["StoreAssociationsCount"] = 4;
+    
+    RemoteModalityParameters modality(s);
+    ASSERT_TRUE(modality.IsAdvancedFormatNeeded());
+    ASSERT_EQ(4u, modality.GetStoreAssociationsCount());
+    ASSERT_THROW(modality.SetStoreAssociationsCount(0), OrthancException);
+    ASSERT_THROW(modality.SetStoreAssociationsCount(RemoteModalityParameters::MAX_STORE_ASSOCIATIONS + 1), OrthancException);
+    ASSERT_EQ(4u, modality.GetStoreAssociationsCount());
+    modality.SetStoreAssociationsCount(RemoteModalityParameters::MAX_STORE_ASSOCIATIONS);
+    ASSERT_EQ(16u, modality.GetStoreAssociationsCount());
+    modality.SetStoreAssociationsCount(4);
+
+    Json::Value t;
+    modality.Serialize(t, false);
+    ASSERT_EQ(Json::objectValue, t.type());
+    ASSERT_EQ(4u, RemoteModalityParameters(t).GetStoreAssociationsCount());
+
+    s["StoreAssociationsCount"] = 0;
+    ASSERT_THROW(RemoteModalityParameters m(s), OrthancException);
+
+    s["StoreAssociationsCount"] = 17;
+    ASSERT_THROW(RemoteModalityParameters m(s), OrthancException);
   }
 }
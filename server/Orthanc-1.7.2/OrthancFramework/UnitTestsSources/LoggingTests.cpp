@@ -28,8 +28,13 @@
 #include <gtest/gtest.h>
 
 #include "../Sources/Logging.h"
+#include "../Sources/OrthancException.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/regex.hpp>
+#include <boost/thread.hpp>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 
 using namespace Orthanc::Logging;
@@ -197,3 +202,147 @@ TEST(FuncStreamBuf, BasicTest)
     ASSERT_STREQ(payload.c_str(), text);
   }
 }
+
+
+TEST(FuncStreamBuf, Asynchronous)
+{
+  LoggingMementoScope loggingConfiguration;
+
+  typedef void(*LoggingFunctionFunc)(const char*);
+
+  FuncStreamBuf<LoggingFunctionFunc> errorStreamBuf(TestError);
+  std::ostream errorStream(&errorStreamBuf);
+
+  FuncStreamBuf<LoggingFunctionFunc> warningStreamBuf(TestWarning);
+  std::ostream warningStream(&warningStreamBuf);
+
+  FuncStreamBuf<LoggingFunctionFunc> infoStreamBuf(TestInfo);
+  std::ostream infoStream(&infoStreamBuf);
+
+  SetErrorWarnInfoLoggingStreams(errorStream, warningStream, infoStream);
+
+  ASSERT_THROW(EnableAsynchronousMode(0, LogOverflowPolicy_Block), Orthanc::OrthancException);
+  ASSERT_FALSE(IsAsynchronousMode());
+
+  EnableAsynchronousMode(16, LogOverflowPolicy_Block);
+  ASSERT_TRUE(IsAsynchronousMode());
+
+  {
+    const char* text = "Hello from the asynchronous logger";
+    LOG(WARNING) << text;
+    Flush();  // Waits for the background thread to write the message
+
+    std::string logLine = testWarningStream.str();
+    testWarningStream.str("");
+    testWarningStream.clear();
+    std::string payload;
+    ASSERT_TRUE(GetLogLinePayload(payload, logLine));
+    ASSERT_STREQ(payload.c_str(), text);
+  }
+
+  for (unsigned int i = 0; i < 100; i++)
+  {
+    LOG(ERROR) << "Message " << i;
+  }
+
+  // The pending messages are written before leaving the asynchronous mode
+  DisableAsynchronousMode();
+  ASSERT_FALSE(IsAsynchronousMode());
+
+  {
+    // The streams are flushed once per batch, so several lines can
+    // be received by a single call to "TestError()"
+    std::string s = testErrorStream.str();
+    testErrorStream.str("");
+    testErrorStream.clear();
+
+    size_t count = 0;
+    for (size_t pos = s.find('\n'); pos != std::string::npos; pos = s.find('\n', pos + 1))
+    {
+      count++;
+    }
+
+    ASSERT_EQ(100u, count);
+    ASSERT_NE(std::string::npos, s.find("] Message 0\n"));
+    ASSERT_NE(std::string::npos, s.find("] Message 99\n"));
+    ASSERT_LT(s.find("] Message 0\n"), s.find("] Message 99\n"));
+  }
+
+  ASSERT_EQ(0u, GetDroppedMessagesCount());
+}
+
+
+namespace
+{
+  void BenchmarkLoggingThread(unsigned int count)
+  {
+    for (unsigned int i = 0; i < count; i++)
+    {
+      LOG(WARNING) << "Benchmarking the logging engine: " << i;
+    }
+  }
+}
+
+
+TEST(FuncStreamBuf, DISABLED_BenchmarkAsynchronous)
+{
+  LoggingMementoScope loggingConfiguration;
+
+  // The synchronous mode flushes the file after each line
+  const char* path = "UnitTestsLogging.log";
+  std::ofstream file(path);
+  SetErrorWarnInfoLoggingStreams(file, file, file);
+
+  const unsigned int countThreads = 8;
+  const unsigned int countMessages = 100000;
+
+  for (unsigned int mode = 0; mode < 3; mode++)
+  {
+    switch (mode)
+    {
+      case 0:
+        DisableAsynchronousMode();
+        break;
+
+      case 1:
+        EnableAsynchronousMode(4096, LogOverflowPolicy_Block);
+        break;
+
+      case 2:
+        EnableAsynchronousMode(4096, LogOverflowPolicy_Drop);
+        break;
+
+      default:
+        throw std::runtime_error("Unknown mode");
+    }
+
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    std::vector<boost::thread*> threads;
+    for (unsigned int i = 0; i < countThreads; i++)
+    {
+      threads.push_back(new boost::thread(BenchmarkLoggingThread, countMessages));
+    }
+
+    for (unsigned int i = 0; i < countThreads; i++)
+    {
+      threads[i]->join();
+      delete threads[i];
+    }
+
+    Flush();
+    const uint64_t dropped = GetDroppedMessagesCount();
+    DisableAsynchronousMode();
+
+    const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+    std::cout << (mode == 0 ? "Synchronous" : (mode == 1 ? "Asynchronous (block)" : "Asynchronous (drop)"))
+              << " logging: " << (static_cast<double>(countThreads * countMessages) * 1000000.0 /
+                                  static_cast<double>(elapsed.total_microseconds()))
+              << " messages/second with " << countThreads << " threads ("
+              << dropped << " dropped)" << std::endl;
+  }
+
+  file.close();
+  std::remove(path);
+}
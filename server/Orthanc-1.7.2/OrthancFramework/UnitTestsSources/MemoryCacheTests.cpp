@@ -359,3 +359,18 @@ TEST(MemoryStringCache, Invalidate)
   ASSERT_FALSE(c.Fetch(v, "hello"));
   ASSERT_TRUE(c.Fetch(v, "hello2"));  ASSERT_EQ("b", v);
 }
+
+
+TEST(MemoryStringCache, FetchRange)
+{
+  Orthanc::MemoryStringCache c;
+  c.Add("hello", "HelloWorld");
+
+  std::string v;
+  ASSERT_FALSE(c.FetchRange(v, "nope", 0, 1));
+  ASSERT_TRUE(c.FetchRange(v, "hello", 5, 10));  ASSERT_EQ("World", v);
+  ASSERT_TRUE(c.FetchRange(v, "hello", 0, 5));   ASSERT_EQ("Hello", v);
+  ASSERT_TRUE(c.FetchRange(v, "hello", 4, 4));   ASSERT_TRUE(v.empty());
+  ASSERT_THROW(c.FetchRange(v, "hello", 0, 11), Orthanc::OrthancException);
+  ASSERT_THROW(c.FetchRange(v, "hello", 6, 5), Orthanc::OrthancException);
+}
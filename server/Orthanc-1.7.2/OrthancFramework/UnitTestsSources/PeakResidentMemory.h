@@ -0,0 +1,74 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include "../Sources/OrthancException.h"
+#include "../Sources/Toolbox.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+
+namespace Orthanc
+{
+  namespace PeakResidentMemory
+  {
+    /**
+     * Resets the peak resident set size ("VmHWM") of the process to
+     * its current resident set size, so that the peak measured
+     * afterwards only reflects the code under test, not whatever the
+     * previous tests have allocated. Returns "false" if the kernel
+     * does not allow this, in which case no measure can be done.
+     **/
+    static inline bool Reset()
+    {
+      std::ofstream f("/proc/self/clear_refs");
+      f << "5";
+      f.flush();
+      return f.good();
+    }
+
+    // Peak resident set size of the process, in KB (the files of
+    // "/proc" have no size, hence "SystemToolbox::ReadFile()" cannot be used)
+    static inline uint64_t Get()
+    {
+      std::ifstream f("/proc/self/status");
+
+      std::string line;
+      while (std::getline(f, line))
+      {
+        if (boost::starts_with(line, "VmHWM:"))
+        {
+          std::string value = Toolbox::StripSpaces(line.substr(6));
+          return boost::lexical_cast<uint64_t>(value.substr(0, value.find(' ')));
+        }
+      }
+
+      throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+}
+
+#endif
@@ -80,6 +80,73 @@ TEST(HttpClient, Basic)
 }
 
 
+TEST(HttpClient, IdleHandles)
+{
+  // Acquiring more handles than the pool can hold empties the pool
+  std::vector<HttpClient*> clients;
+  for (size_t i = 0; i < HttpClient::MAX_IDLE_HANDLES + 4; i++)
+  {
+    clients.push_back(new HttpClient);
+  }
+
+  ASSERT_EQ(0u, HttpClient::GetIdleHandlesCount());
+
+  // Destroying the clients gives their handles back to the pool, up
+  // to its maximum size
+  for (size_t i = 0; i < clients.size(); i++)
+  {
+    delete clients[i];
+  }
+
+  ASSERT_EQ(HttpClient::MAX_IDLE_HANDLES, HttpClient::GetIdleHandlesCount());
+
+  {
+    HttpClient c;
+    ASSERT_EQ(HttpClient::MAX_IDLE_HANDLES - 1, HttpClient::GetIdleHandlesCount());
+
+    // These options must not leak into the next client reusing the
+    // handle, as the handle is reset when it is given back
+    c.SetCredentials("username", "password");
+    c.SetProxy("127.0.0.1:1");
+    c.SetTimeout(1);
+    c.SetVerbose(true);
+
+#if UNIT_TESTS_WITH_HTTP_CONNEXIONS == 1
+    c.SetUrl("http://www.orthanc-server.com/downloads/third-party/Product.json");
+
+    std::string s;
+    ASSERT_THROW(c.Apply(s), OrthancException);   // The proxy is not reachable
+#endif
+  }
+
+  ASSERT_EQ(HttpClient::MAX_IDLE_HANDLES, HttpClient::GetIdleHandlesCount());
+
+#if UNIT_TESTS_WITH_HTTP_CONNEXIONS == 1
+  {
+    // Reuses the handle of the client above
+    HttpClient c;
+    c.SetUrl("http://www.orthanc-server.com/downloads/third-party/Product.json");
+
+    Json::Value v;
+    ASSERT_TRUE(c.Apply(v));
+    ASSERT_TRUE(v.isMember("Description"));
+  }
+#endif
+
+  {
+    // The handles authenticated by a client certificate are never
+    // shared with the other clients
+    SystemToolbox::WriteFile(std::string("nope"), "UnitTestsResults/client.crt");
+
+    HttpClient c;
+    c.SetClientCertificate("UnitTestsResults/client.crt", "", "");
+    ASSERT_EQ(HttpClient::MAX_IDLE_HANDLES - 1, HttpClient::GetIdleHandlesCount());
+  }
+
+  ASSERT_EQ(HttpClient::MAX_IDLE_HANDLES - 1, HttpClient::GetIdleHandlesCount());
+}
+
+
 #if UNIT_TESTS_WITH_HTTP_CONNEXIONS == 1 && ORTHANC_ENABLE_SSL == 1
 
 /**
@@ -269,6 +336,10 @@ static void SetValue(RestApiGetCall& get)
   testValue = value;
 }
 
+static void DeleteValue(RestApiDeleteCall& call)
+{
+}
+
 
 static bool GetDirectory(Json::Value& target,
                          RestApiHierarchy& hierarchy, 
@@ -297,6 +368,55 @@ namespace
 }
 
 
+namespace
+{
+  class PathVisitor : public RestApiHierarchy::IVisitor
+  {
+  private:
+    HttpMethod   method_;
+    std::string  path_;
+
+  public:
+    explicit PathVisitor(HttpMethod method) :
+      method_(method)
+    {
+    }
+
+    const std::string& GetPath() const
+    {
+      return path_;
+    }
+
+    virtual bool Visit(const RestApiHierarchy::Resource& resource,
+                       const UriComponents& uri,
+                       const IHttpHandler::Arguments& components,
+                       const UriComponents& trailing) ORTHANC_OVERRIDE
+    {
+      path_ = resource.GetPath(method_);
+      return true;
+    }
+  };
+}
+
+
+static std::string GetRegisteredPath(RestApiHierarchy& hierarchy, 
+                                     const std::string& uri,
+                                     HttpMethod method = HttpMethod_Get)
+{
+  UriComponents p;
+  Toolbox::SplitUriComponents(p, uri);
+  PathVisitor visitor(method);
+  if (hierarchy.LookupResource(p, visitor))
+  {
+    return visitor.GetPath();
+  }
+  else
+  {
+    return "";
+  }
+}
+
+
 static bool HandleGet(RestApiHierarchy& hierarchy, 
                       const std::string& uri)
 {
@@ -348,6 +468,17 @@ TEST(RestApi, RestApiHierarchy)
   ASSERT_EQ(testValue, 3);
   ASSERT_TRUE(HandleGet(root, "/hello2/a/b"));
   ASSERT_EQ(testValue, 4);
+
+  ASSERT_EQ("/hello/world/test", GetRegisteredPath(root, "/hello/world/test"));
+  ASSERT_EQ("/hello/{world}/test3/test4", GetRegisteredPath(root, "/hello/b/test3/test4"));
+  ASSERT_EQ("/hello2/*", GetRegisteredPath(root, "/hello2/a/b"));
+  ASSERT_EQ("", GetRegisteredPath(root, "/nope"));
+  ASSERT_EQ("", GetRegisteredPath(root, "/hello/world/test", HttpMethod_Delete));
+
+  // Each method of a node keeps the path it was registered with
+  root.Register("/hello/world/test/", DeleteValue);
+  ASSERT_EQ("/hello/world/test", GetRegisteredPath(root, "/hello/world/test"));
+  ASSERT_EQ("/hello/world/test/", GetRegisteredPath(root, "/hello/world/test", HttpMethod_Delete));
 }
 
 
@@ -28,9 +28,15 @@
 #include <gtest/gtest.h>
 
 #include "../Sources/OrthancException.h"
+#include "../Sources/Compression/ZipReader.h"
 #include "../Sources/Compression/ZipWriter.h"
 #include "../Sources/Compression/HierarchicalZipWriter.h"
+#include "../Sources/SystemToolbox.h"
+#include "../Sources/Logging.h"
 #include "../Sources/Toolbox.h"
+#include "PeakResidentMemory.h"
+
+#include <boost/lexical_cast.hpp>
 
 
 using namespace Orthanc;
@@ -88,7 +94,337 @@ TEST(ZipWriter, Append)
 }
 
 
+namespace
+{
+  class MemoryZipStream : public ZipWriter::IOutputStream
+  {
+  private:
+    std::string  content_;
+
+  public:
+    virtual void Write(const void* data,
+                       size_t size) ORTHANC_OVERRIDE
+    {
+      content_.append(reinterpret_cast<const char*>(data), size);
+    }
+
+    const std::string& GetContent() const
+    {
+      return content_;
+    }
+  };
+}
+
 
+static uint32_t ReadZipUInt32(const std::string& s,
+                              size_t pos)
+{
+  return (static_cast<uint32_t>(static_cast<uint8_t>(s[pos])) |
+          (static_cast<uint32_t>(static_cast<uint8_t>(s[pos + 1])) << 8) |
+          (static_cast<uint32_t>(static_cast<uint8_t>(s[pos + 2])) << 16) |
+          (static_cast<uint32_t>(static_cast<uint8_t>(s[pos + 3])) << 24));
+}
+
+
+TEST(ZipWriter, Stream)
+{
+  static const size_t END_OF_CENTRAL_DIRECTORY = 22 + 18;  // With the "Created by Orthanc" comment
+  
+  for (unsigned int zip64 = 0; zip64 < 2; zip64++)
+  {
+    MemoryZipStream stream;
+
+    {
+      HierarchicalZipWriter w(stream);
+      w.SetZip64(zip64 == 1);
+      w.OpenDirectory("world");
+      w.OpenFile("hello");
+      w.Write("Hello world");
+      w.CloseDirectory();
+      w.SetCompressionLevel(0);
+      w.OpenFile("hello");
+      w.Write(std::string(100000, 'a'));
+      ASSERT_THROW(w.SetZip64(zip64 == 0), OrthancException);
+      w.Close();
+    }
+
+    const std::string& s = stream.GetContent();
+    ASSERT_GT(s.size(), END_OF_CENTRAL_DIRECTORY);
+    ASSERT_EQ(0x04034b50u, ReadZipUInt32(s, 0));  // Local file header
+    ASSERT_EQ(0x0008u, ReadZipUInt32(s, 6) & 0xffffu);  // Data descriptor
+
+    const size_t end = s.size() - END_OF_CENTRAL_DIRECTORY;
+    ASSERT_EQ(0x06054b50u, ReadZipUInt32(s, end));
+
+    if (zip64)
+    {
+      ASSERT_EQ(0x07064b50u, ReadZipUInt32(s, end - 20));  // ZIP64 locator
+      ASSERT_EQ(0x06064b50u, ReadZipUInt32(s, end - 20 - 56));  // ZIP64 end of central directory
+      ASSERT_EQ(2u, ReadZipUInt32(s, end - 20 - 56 + 24));
+      SystemToolbox::WriteFile(s, "UnitTestsResults/stream64.zip");
+    }
+    else
+    {
+      ASSERT_EQ(2u, ReadZipUInt32(s, end + 8) & 0xffffu);  // Number of files
+      SystemToolbox::WriteFile(s, "UnitTestsResults/stream.zip");
+    }
+
+    // The stored file is not compressed
+    ASSERT_GT(s.size(), 100000u);
+  }
+
+  {
+    MemoryZipStream stream;
+
+    {
+      ZipWriter w;
+      w.SetOutputStream(stream);
+      w.SetAppendToExisting(true);
+      ASSERT_THROW(w.Open(), OrthancException);
+      w.SetAppendToExisting(false);
+      w.OpenFile("hello");
+      w.Write("Hello world");
+    }
+
+    // The central directory is not written without "Close()"
+    const std::string& s = stream.GetContent();
+    ASSERT_EQ(0x04034b50u, ReadZipUInt32(s, 0));
+    ASSERT_EQ(std::string::npos, s.find("Created by Orthanc"));
+  }
+}
+
+
+
+TEST(ZipWriter, CompressedFile)
+{
+  const std::string data(100000, 'a');
+
+  {
+    ZipWriter::CompressedFile stored(data, 0);
+    ASSERT_FALSE(stored.IsDeflated());
+    ASSERT_EQ(data, stored.GetContent());
+    ASSERT_EQ(100000u, stored.GetUncompressedSize());
+
+    ZipWriter::CompressedFile deflated(data, 9);
+    ASSERT_TRUE(deflated.IsDeflated());
+    ASSERT_LT(deflated.GetContent().size(), 1000u);
+    ASSERT_EQ(100000u, deflated.GetUncompressedSize());
+    ASSERT_EQ(stored.GetCrc32(), deflated.GetCrc32());
+
+    ZipWriter::CompressedFile empty(std::string(), 6);
+    ASSERT_EQ(0u, empty.GetUncompressedSize());
+    ASSERT_EQ(0u, empty.GetCrc32());
+
+    ASSERT_THROW(ZipWriter::CompressedFile(data, 10), OrthancException);
+  }
+
+  {
+    // Mixing files that are compressed on the fly, with files that
+    // are compressed ahead of time
+    HierarchicalZipWriter w("UnitTestsResults/compressed.zip");
+    w.SetZip64(true);
+    w.OpenFile("hello");
+    w.Write("Hello world");
+    w.WriteCompressedFile("deflated", ZipWriter::CompressedFile(data, 6));
+    ASSERT_THROW(w.Write("Nope"), OrthancException);
+    w.OpenDirectory("world");
+    w.WriteCompressedFile("stored", ZipWriter::CompressedFile(data, 0));
+    w.CloseDirectory();
+  }
+
+  {
+    MemoryZipStream stream;
+
+    {
+      HierarchicalZipWriter w(stream);
+      w.WriteCompressedFile("stored", ZipWriter::CompressedFile("Hello world", 0));
+      w.OpenFile("hello");
+      w.Write("Hello world");
+      w.Close();
+    }
+
+    const std::string& s = stream.GetContent();
+    ASSERT_EQ(0x04034b50u, ReadZipUInt32(s, 0));
+    ASSERT_EQ(0u, ReadZipUInt32(s, 6));  // No data descriptor, stored method
+    ASSERT_EQ(11u, ReadZipUInt32(s, 18));  // Compressed size
+    ASSERT_EQ(11u, ReadZipUInt32(s, 22));  // Uncompressed size
+    ASSERT_EQ("Hello world", s.substr(30 + 6, 11));
+    SystemToolbox::WriteFile(s, "UnitTestsResults/compressed-stream.zip");
+  }
+}
+
+
+
+TEST(ZipReader, Basic)
+{
+  ASSERT_FALSE(ZipReader::IsZipMemoryBuffer(std::string("PK")));
+  ASSERT_FALSE(ZipReader::IsZipMemoryBuffer(std::string("Hello world")));
+  ASSERT_THROW(ZipReader::CreateFromMemory(std::string("Hello world")), OrthancException);
+  ASSERT_THROW(ZipReader::CreateFromFile("UnitTestsResults/nope.zip"), OrthancException);
+
+  const std::string data(100000, 'a');
+
+  for (unsigned int zip64 = 0; zip64 < 2; zip64++)
+  {
+    MemoryZipStream stream;
+
+    {
+      HierarchicalZipWriter w(stream);
+      w.SetZip64(zip64 == 1);
+      w.OpenDirectory("world");
+      w.OpenFile("hello");
+      w.Write("Hello world");
+      w.CloseDirectory();
+      w.OpenFile("empty");
+      w.WriteCompressedFile("stored", ZipWriter::CompressedFile(data, 0));
+      w.WriteCompressedFile("deflated", ZipWriter::CompressedFile(data, 9));
+      w.Close();
+    }
+
+    const std::string& s = stream.GetContent();
+    ASSERT_TRUE(ZipReader::IsZipMemoryBuffer(s));
+
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(s));
+    ASSERT_EQ(4u, reader->GetEntriesCount());
+    ASSERT_EQ("world/hello", reader->GetEntryName(0));
+    ASSERT_EQ("empty", reader->GetEntryName(1));
+    ASSERT_EQ("stored", reader->GetEntryName(2));
+    ASSERT_EQ("deflated", reader->GetEntryName(3));
+    ASSERT_FALSE(reader->IsDirectory(0));
+    ASSERT_EQ(11u, reader->GetUncompressedSize(0));
+    ASSERT_EQ(0u, reader->GetUncompressedSize(1));
+    ASSERT_EQ(100000u, reader->GetUncompressedSize(3));
+    ASSERT_THROW(reader->GetEntryName(4), OrthancException);
+
+    std::string content;
+    reader->ReadEntry(content, 0);  ASSERT_EQ("Hello world", content);
+    reader->ReadEntry(content, 1);  ASSERT_TRUE(content.empty());
+    reader->ReadEntry(content, 2);  ASSERT_EQ(data, content);
+    reader->ReadEntry(content, 3);  ASSERT_EQ(data, content);
+
+    // Corrupt the stored entry, which must be detected by the CRC-32
+    std::string corrupted = s;
+    size_t pos = corrupted.find(data);
+    ASSERT_NE(std::string::npos, pos);
+    corrupted[pos + 50000] = 'b';
+
+    reader.reset(ZipReader::CreateFromMemory(corrupted));
+    reader->ReadEntry(content, 0);  ASSERT_EQ("Hello world", content);
+    ASSERT_THROW(reader->ReadEntry(content, 2), OrthancException);
+  }
+
+  {
+    // Archives that are written by minizip
+    HierarchicalZipWriter w("UnitTestsResults/reader.zip");
+    w.SetZip64(true);
+    w.OpenDirectory("world");
+    w.OpenFile("hello");
+    w.Write("Hello world");
+    w.CloseDirectory();
+    w.OpenFile("data");
+    w.Write(data);
+  }
+
+  {
+    ASSERT_TRUE(ZipReader::IsZipFile("UnitTestsResults/reader.zip"));
+
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromFile("UnitTestsResults/reader.zip"));
+    ASSERT_EQ(2u, reader->GetEntriesCount());
+    ASSERT_EQ("world/hello", reader->GetEntryName(0));
+    ASSERT_EQ("data", reader->GetEntryName(1));
+
+    std::string content;
+    reader->ReadEntry(content, 1);  ASSERT_EQ(data, content);
+    reader->ReadEntry(content, 0);  ASSERT_EQ("Hello world", content);
+  }
+}
+
+
+TEST(ZipReader, Bomb)
+{
+  const std::string data(100000, 'a');
+
+  MemoryZipStream stream;
+
+  {
+    HierarchicalZipWriter w(stream);
+    w.WriteCompressedFile("deflated", ZipWriter::CompressedFile(data, 9));
+    w.Close();
+  }
+
+  std::string s = stream.GetContent();
+
+  {
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(s));
+    std::string content;
+    reader->ReadEntry(content, 0);
+    ASSERT_EQ(data, content);
+  }
+
+  // Declare an uncompressed size of 2GB in the central directory,
+  // which is beyond the maximum compression ratio of deflate: The
+  // entry must be rejected before allocating memory
+  const size_t directory = s.find("PK\x01\x02");
+  ASSERT_NE(std::string::npos, directory);
+  s[directory + 24] = '\xff';
+  s[directory + 25] = '\xff';
+  s[directory + 26] = '\xff';
+  s[directory + 27] = '\x7f';
+
+  {
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromMemory(s));
+    ASSERT_EQ(0x7fffffffu, reader->GetUncompressedSize(0));
+
+    std::string content;
+    ASSERT_THROW(reader->ReadEntry(content, 0), OrthancException);
+    ASSERT_TRUE(content.empty());
+  }
+}
+
+
+#if defined(__linux__)
+TEST(ZipReader, BoundedMemory)
+{
+  static const size_t ENTRY_SIZE = 16 * 1024 * 1024;
+  static const size_t COUNT = 8;
+
+  {
+    HierarchicalZipWriter w("UnitTestsResults/large.zip");
+    w.SetZip64(true);
+
+    const std::string data(ENTRY_SIZE, '\0');
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      w.OpenFile(("entry-" + boost::lexical_cast<std::string>(i)).c_str());
+      w.Write(data);
+    }
+  }
+
+  if (!PeakResidentMemory::Reset())
+  {
+    LOG(WARNING) << "Cannot reset the peak resident memory, skipping test";
+    return;
+  }
+
+  const uint64_t before = PeakResidentMemory::Get();
+
+  {
+    // Only one entry is loaded in memory at any time
+    std::unique_ptr<ZipReader> reader(ZipReader::CreateFromFile("UnitTestsResults/large.zip"));
+    ASSERT_EQ(COUNT, reader->GetEntriesCount());
+
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      std::string content;
+      reader->ReadEntry(content, i);
+      ASSERT_EQ(ENTRY_SIZE, content.size());
+    }
+  }
+
+  const uint64_t after = PeakResidentMemory::Get();
+  ASSERT_LT(after - before, 3 * ENTRY_SIZE / 1024);
+}
+#endif
 
 
 namespace Orthanc
@@ -43,6 +43,7 @@
 #include "../../../OrthancFramework/Sources/OrthancException.h"
 #include "PluginsEnumerations.h"
 
+#include <algorithm>
 #include <cassert>
 
 namespace Orthanc
@@ -522,6 +523,43 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::GetInternalIdsAfter(std::list<int64_t>& target,
+                                                  ResourceType resourceType,
+                                                  int64_t since,
+                                                  size_t limit)
+  {
+    // The database SDK has no primitive for this operation, use a
+    // fallback implementation over "GetAllInternalIds()"
+    target.clear();
+
+    if (limit == 0)
+    {
+      return;
+    }
+
+    std::list<int64_t> tmp;
+    GetAllInternalIds(tmp, resourceType);
+
+    std::vector<int64_t> sorted;
+    sorted.reserve(tmp.size());
+
+    for (std::list<int64_t>::const_iterator it = tmp.begin(); it != tmp.end(); ++it)
+    {
+      if (*it > since)
+      {
+        sorted.push_back(*it);
+      }
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+
+    for (size_t i = 0; i < sorted.size() && i < limit; i++)
+    {
+      target.push_back(sorted[i]);
+    }
+  }
+
+
 
   void OrthancPluginDatabase::GetChanges(std::list<ServerIndexChange>& target /*out*/,
                                          bool& done /*out*/,
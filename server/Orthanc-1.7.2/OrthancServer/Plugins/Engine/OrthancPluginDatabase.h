@@ -178,6 +178,12 @@ namespace Orthanc
                                  size_t limit) 
       ORTHANC_OVERRIDE;
 
+    virtual void GetInternalIdsAfter(std::list<int64_t>& target,
+                                     ResourceType resourceType,
+                                     int64_t since,
+                                     size_t limit)
+      ORTHANC_OVERRIDE;
+
     virtual void GetChanges(std::list<ServerIndexChange>& target /*out*/,
                             bool& done /*out*/,
                             int64_t since,
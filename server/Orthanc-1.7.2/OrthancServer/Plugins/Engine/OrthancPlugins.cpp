@@ -227,6 +227,38 @@ namespace Orthanc
       }
 
 
+      virtual bool HasReadRange() const
+      {
+        // The plugin SDK has no primitive to read a part of a file
+        return false;
+      }
+
+
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start /* inclusive */,
+                             uint64_t end /* exclusive */)
+      {
+        if (start > end)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        std::string whole;
+        Read(whole, uuid, type);
+
+        if (end > whole.size())
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+        else
+        {
+          content.assign(whole, static_cast<size_t>(start), static_cast<size_t>(end - start));
+        }
+      }
+
+
       virtual void Remove(const std::string& uuid,
                           FileContentType type) 
       {
@@ -116,6 +116,15 @@ namespace Orthanc
                                  size_t since,
                                  size_t limit) = 0;
 
+    // New in Orthanc 1.7.3: At most "limit" resources of the given
+    // level whose internal ID is strictly greater than "since", by
+    // increasing internal ID. This allows to go through all the
+    // resources by batches, in a stable order.
+    virtual void GetInternalIdsAfter(std::list<int64_t>& target,
+                                     ResourceType resourceType,
+                                     int64_t since,
+                                     size_t limit) = 0;
+
     virtual void GetChanges(std::list<ServerIndexChange>& target /*out*/,
                             bool& done /*out*/,
                             int64_t since,
@@ -1069,6 +1069,32 @@ namespace Orthanc
   }
 
 
+  void SQLiteDatabaseWrapper::GetInternalIdsAfter(std::list<int64_t>& target,
+                                                  ResourceType resourceType,
+                                                  int64_t since,
+                                                  size_t limit)
+  {
+    target.clear();
+
+    if (limit == 0)
+    {
+      return;
+    }
+
+    SQLite::Statement s(db_, SQLITE_FROM_HERE,
+                        "SELECT internalId FROM Resources WHERE "
+                        "resourceType=? AND internalId>? ORDER BY internalId LIMIT ?");
+    s.BindInt(0, resourceType);
+    s.BindInt64(1, since);
+    s.BindInt64(2, limit);
+
+    while (s.Step())
+    {
+      target.push_back(s.ColumnInt64(0));
+    }
+  }
+
+
   bool SQLiteDatabaseWrapper::SelectPatientToRecycle(int64_t& internalId)
   {
     SQLite::Statement s(db_, SQLITE_FROM_HERE,
@@ -1177,6 +1203,12 @@ namespace Orthanc
       return "ESCAPE '\\'";
     }
 
+    virtual bool IsBinaryCollation()
+    {
+      // The values are compared with the default "BINARY" collation
+      return true;
+    }
+
     void Bind(SQLite::Statement& statement) const
     {
       size_t pos = 0;
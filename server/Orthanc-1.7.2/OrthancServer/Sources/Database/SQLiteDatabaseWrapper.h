@@ -303,6 +303,12 @@ namespace Orthanc
                                  size_t limit)
       ORTHANC_OVERRIDE;
 
+    virtual void GetInternalIdsAfter(std::list<int64_t>& target,
+                                     ResourceType resourceType,
+                                     int64_t since,
+                                     size_t limit)
+      ORTHANC_OVERRIDE;
+
     virtual bool SelectPatientToRecycle(int64_t& internalId)
       ORTHANC_OVERRIDE;
 
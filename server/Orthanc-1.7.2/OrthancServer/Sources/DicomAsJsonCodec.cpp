@@ -0,0 +1,775 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "DicomAsJsonCodec.h"
+
+#include "../../OrthancFramework/Sources/OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+#include <cassert>
+#include <map>
+#include <string.h>
+
+
+/**
+ * Layout of the binary format (all the integers are little-endian):
+ *
+ *   Header   = "\0DJB" + uint8 version
+ *   Dataset  = uint32 count + count * (uint32 tag + uint32 offset) + entries
+ *   Entry    = uint8 type + uint16 length + name
+ *              [+ uint16 length + private creator]
+ *              [+ uint32 length + value]                     (String, Binary)
+ *              [+ uint32 count + count * (uint32 size + Dataset)]  (Sequence)
+ *
+ * The index of a dataset is sorted by increasing tag, and the offsets
+ * are relative to the first byte following the index.
+ **/
+
+namespace Orthanc
+{
+  namespace DicomAsJsonCodec
+  {
+    static const char     MAGIC[] = { '\0', 'D', 'J', 'B' };
+    static const size_t   MAGIC_SIZE = sizeof(MAGIC);
+    static const size_t   HEADER_SIZE = MAGIC_SIZE + 1;
+    static const uint8_t  VERSION = 1;
+
+    static const uint8_t  FLAG_PRIVATE_CREATOR = 0x80;
+
+    enum EntryType
+    {
+      EntryType_Null = 0,
+      EntryType_String = 1,
+      EntryType_TooLong = 2,
+      EntryType_Binary = 3,
+      EntryType_Sequence = 4
+    };
+
+
+    static void WriteUInt8(std::string& target,
+                           uint8_t value)
+    {
+      target.push_back(static_cast<char>(value));
+    }
+
+
+    static void WriteUInt16(std::string& target,
+                            uint16_t value)
+    {
+      target.push_back(static_cast<char>(value & 0xff));
+      target.push_back(static_cast<char>((value >> 8) & 0xff));
+    }
+
+
+    static void WriteUInt32(std::string& target,
+                            uint32_t value)
+    {
+      target.push_back(static_cast<char>(value & 0xff));
+      target.push_back(static_cast<char>((value >> 8) & 0xff));
+      target.push_back(static_cast<char>((value >> 16) & 0xff));
+      target.push_back(static_cast<char>((value >> 24) & 0xff));
+    }
+
+
+    static void PatchUInt32(std::string& target,
+                            size_t position,
+                            uint32_t value)
+    {
+      assert(position + 4 <= target.size());
+      target[position] = static_cast<char>(value & 0xff);
+      target[position + 1] = static_cast<char>((value >> 8) & 0xff);
+      target[position + 2] = static_cast<char>((value >> 16) & 0xff);
+      target[position + 3] = static_cast<char>((value >> 24) & 0xff);
+    }
+
+
+    static bool WriteShortString(std::string& target,
+                                 const std::string& value)
+    {
+      if (value.size() > 0xffffu)
+      {
+        return false;
+      }
+      else
+      {
+        WriteUInt16(target, static_cast<uint16_t>(value.size()));
+        target.append(value);
+        return true;
+      }
+    }
+
+
+    static bool WriteLongString(std::string& target,
+                                const std::string& value)
+    {
+      if (static_cast<uint64_t>(value.size()) > 0xffffffffu)
+      {
+        return false;
+      }
+      else
+      {
+        WriteUInt32(target, static_cast<uint32_t>(value.size()));
+        target.append(value);
+        return true;
+      }
+    }
+
+
+    static bool EncodeDataset(std::string& target,
+                              const Json::Value& source);
+
+
+    static bool EncodeEntry(std::string& target,
+                            const Json::Value& source)
+    {
+      if (source.type() != Json::objectValue ||
+          !source.isMember("Name") ||
+          !source.isMember("Type") ||
+          !source.isMember("Value") ||
+          source["Name"].type() != Json::stringValue ||
+          source["Type"].type() != Json::stringValue)
+      {
+        return false;
+      }
+
+      // Make sure the conversion is lossless
+      const bool hasPrivateCreator = source.isMember("PrivateCreator");
+      if (source.size() != (hasPrivateCreator ? 4u : 3u) ||
+          (hasPrivateCreator &&
+           source["PrivateCreator"].type() != Json::stringValue))
+      {
+        return false;
+      }
+
+      const std::string type = source["Type"].asString();
+      const Json::Value& value = source["Value"];
+
+      EntryType entryType;
+      if (type == "Null" &&
+          value.type() == Json::nullValue)
+      {
+        entryType = EntryType_Null;
+      }
+      else if (type == "String" &&
+               value.type() == Json::stringValue)
+      {
+        entryType = EntryType_String;
+      }
+      else if (type == "TooLong" &&
+               value.type() == Json::nullValue)
+      {
+        entryType = EntryType_TooLong;
+      }
+      else if (type == "Binary" &&
+               value.type() == Json::stringValue)
+      {
+        entryType = EntryType_Binary;
+      }
+      else if (type == "Sequence" &&
+               value.type() == Json::arrayValue)
+      {
+        entryType = EntryType_Sequence;
+      }
+      else
+      {
+        return false;
+      }
+
+      WriteUInt8(target, static_cast<uint8_t>(entryType) |
+                 (hasPrivateCreator ? FLAG_PRIVATE_CREATOR : 0));
+
+      if (!WriteShortString(target, source["Name"].asString()) ||
+          (hasPrivateCreator &&
+           !WriteShortString(target, source["PrivateCreator"].asString())))
+      {
+        return false;
+      }
+
+      switch (entryType)
+      {
+        case EntryType_String:
+        case EntryType_Binary:
+          return WriteLongString(target, value.asString());
+
+        case EntryType_Sequence:
+        {
+          WriteUInt32(target, value.size());
+
+          for (Json::Value::ArrayIndex i = 0; i < value.size(); i++)
+          {
+            // Reserve room for the size of the item, that is only
+            // known once the item is encoded
+            const size_t position = target.size();
+            WriteUInt32(target, 0);
+
+            if (!EncodeDataset(target, value[i]))
+            {
+              return false;
+            }
+
+            const size_t size = target.size() - position - 4;
+            if (static_cast<uint64_t>(size) > 0xffffffffu)
+            {
+              return false;
+            }
+
+            PatchUInt32(target, position, static_cast<uint32_t>(size));
+          }
+
+          return true;
+        }
+
+        default:
+          return true;
+      }
+    }
+
+
+    static bool EncodeDataset(std::string& target,
+                              const Json::Value& source)
+    {
+      if (source.type() != Json::objectValue)
+      {
+        return false;
+      }
+
+      typedef std::map<uint32_t, const Json::Value*>  SortedEntries;
+
+      SortedEntries sorted;
+
+      Json::Value::Members members = source.getMemberNames();
+      for (size_t i = 0; i < members.size(); i++)
+      {
+        DicomTag tag(0, 0);
+        if (!DicomTag::ParseHexadecimal(tag, members[i].c_str()) ||
+            tag.Format() != members[i])
+        {
+          return false;
+        }
+
+        sorted[(static_cast<uint32_t>(tag.GetGroup()) << 16) |
+               static_cast<uint32_t>(tag.GetElement())] = &source[members[i]];
+      }
+
+      if (static_cast<uint64_t>(sorted.size()) > 0xffffffffu)
+      {
+        return false;
+      }
+
+      std::string entries;
+
+      WriteUInt32(target, static_cast<uint32_t>(sorted.size()));
+
+      for (SortedEntries::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+      {
+        if (static_cast<uint64_t>(entries.size()) > 0xffffffffu)
+        {
+          return false;
+        }
+
+        WriteUInt32(target, it->first);
+        WriteUInt32(target, static_cast<uint32_t>(entries.size()));
+
+        assert(it->second != NULL);
+        if (!EncodeEntry(entries, *it->second))
+        {
+          return false;
+        }
+      }
+
+      target.append(entries);
+      return true;
+    }
+
+
+    namespace
+    {
+      class BufferReader
+      {
+      private:
+        const uint8_t*  data_;
+        size_t          size_;
+        size_t          position_;
+
+        void CheckAvailable(size_t count) const
+        {
+          if (count > size_ - position_)
+          {
+            throw OrthancException(ErrorCode_CorruptedFile,
+                                   "Truncated binary DICOM-as-JSON attachment");
+          }
+        }
+
+      public:
+        BufferReader(const void* data,
+                     size_t size) :
+          data_(reinterpret_cast<const uint8_t*>(data)),
+          size_(size),
+          position_(0)
+        {
+        }
+
+        size_t GetPosition() const
+        {
+          return position_;
+        }
+
+        void SetPosition(size_t position)
+        {
+          if (position > size_)
+          {
+            throw OrthancException(ErrorCode_CorruptedFile);
+          }
+
+          position_ = position;
+        }
+
+        void Skip(size_t count)
+        {
+          CheckAvailable(count);
+          position_ += count;
+        }
+
+        uint8_t ReadUInt8()
+        {
+          CheckAvailable(1);
+          return data_[position_++];
+        }
+
+        uint16_t ReadUInt16()
+        {
+          CheckAvailable(2);
+          uint16_t value = (static_cast<uint16_t>(data_[position_]) |
+                            (static_cast<uint16_t>(data_[position_ + 1]) << 8));
+          position_ += 2;
+          return value;
+        }
+
+        uint32_t ReadUInt32()
+        {
+          CheckAvailable(4);
+          uint32_t value = (static_cast<uint32_t>(data_[position_]) |
+                            (static_cast<uint32_t>(data_[position_ + 1]) << 8) |
+                            (static_cast<uint32_t>(data_[position_ + 2]) << 16) |
+                            (static_cast<uint32_t>(data_[position_ + 3]) << 24));
+          position_ += 4;
+          return value;
+        }
+
+        void ReadString(std::string& target,
+                        size_t length)
+        {
+          CheckAvailable(length);
+          target.assign(reinterpret_cast<const char*>(data_) + position_, length);
+          position_ += length;
+        }
+
+        void SkipShortString()
+        {
+          Skip(ReadUInt16());
+        }
+
+        void ReadShortString(std::string& target)
+        {
+          ReadString(target, ReadUInt16());
+        }
+
+        void ReadLongString(std::string& target)
+        {
+          ReadString(target, ReadUInt32());
+        }
+
+        BufferReader GetRegion(size_t size)
+        {
+          CheckAvailable(size);
+          BufferReader region(data_ + position_, size);
+          position_ += size;
+          return region;
+        }
+      };
+
+
+      // Parses the index of a dataset, leaving the reader on the
+      // first byte of the entries
+      class DatasetIndex
+      {
+      private:
+        BufferReader&  reader_;
+        size_t         indexStart_;
+        size_t         entriesStart_;
+        uint32_t       count_;
+
+      public:
+        explicit DatasetIndex(BufferReader& reader) :
+          reader_(reader)
+        {
+          count_ = reader_.ReadUInt32();
+          indexStart_ = reader_.GetPosition();
+          reader_.Skip(8 * static_cast<size_t>(count_));
+          entriesStart_ = reader_.GetPosition();
+        }
+
+        uint32_t GetCount() const
+        {
+          return count_;
+        }
+
+        DicomTag GetTag(uint32_t i) const
+        {
+          BufferReader tmp(reader_);
+          tmp.SetPosition(indexStart_ + 8 * static_cast<size_t>(i));
+          uint32_t tag = tmp.ReadUInt32();
+          return DicomTag(static_cast<uint16_t>(tag >> 16), static_cast<uint16_t>(tag & 0xffff));
+        }
+
+        // Moves the reader to the beginning of the i-th entry
+        void SeekEntry(uint32_t i) const
+        {
+          BufferReader tmp(reader_);
+          tmp.SetPosition(indexStart_ + 8 * static_cast<size_t>(i) + 4);
+          reader_.SetPosition(entriesStart_ + tmp.ReadUInt32());
+        }
+
+        bool LookupTag(uint32_t& index,
+                       const DicomTag& tag) const
+        {
+          // Binary search, as the index is sorted by increasing tag
+          uint32_t low = 0;
+          uint32_t high = count_;
+
+          while (low < high)
+          {
+            uint32_t middle = low + (high - low) / 2;
+            DicomTag current = GetTag(middle);
+
+            if (current == tag)
+            {
+              index = middle;
+              return true;
+            }
+            else if (current < tag)
+            {
+              low = middle + 1;
+            }
+            else
+            {
+              high = middle;
+            }
+          }
+
+          return false;
+        }
+      };
+    }
+
+
+    static void CheckHeader(const std::string& buffer)
+    {
+      if (!IsBinary(buffer))
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      if (static_cast<uint8_t>(buffer[MAGIC_SIZE]) != VERSION)
+      {
+        throw OrthancException(ErrorCode_NotImplemented,
+                               "Unsupported version of the binary DICOM-as-JSON format: " +
+                               boost::lexical_cast<std::string>(static_cast<int>(static_cast<uint8_t>(buffer[MAGIC_SIZE]))));
+      }
+    }
+
+
+    // Reads the type of the entry, and skips its name and private creator
+    static EntryType ReadEntryHeader(BufferReader& reader)
+    {
+      uint8_t type = reader.ReadUInt8();
+      reader.SkipShortString();
+
+      if (type & FLAG_PRIVATE_CREATOR)
+      {
+        reader.SkipShortString();
+      }
+
+      switch (type & ~FLAG_PRIVATE_CREATOR)
+      {
+        case EntryType_Null:
+          return EntryType_Null;
+
+        case EntryType_String:
+          return EntryType_String;
+
+        case EntryType_TooLong:
+          return EntryType_TooLong;
+
+        case EntryType_Binary:
+          return EntryType_Binary;
+
+        case EntryType_Sequence:
+          return EntryType_Sequence;
+
+        default:
+          throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+
+    static void DecodeDataset(Json::Value& target,
+                              BufferReader& reader);
+
+
+    static void DecodeEntry(Json::Value& target,
+                            BufferReader& reader)
+    {
+      const uint8_t type = reader.ReadUInt8();
+
+      std::string s;
+      reader.ReadShortString(s);
+
+      target = Json::objectValue;
+      target["Name"] = s;
+
+      if (type & FLAG_PRIVATE_CREATOR)
+      {
+        reader.ReadShortString(s);
+        target["PrivateCreator"] = s;
+      }
+
+      switch (type & ~FLAG_PRIVATE_CREATOR)
+      {
+        case EntryType_Null:
+          target["Type"] = "Null";
+          target["Value"] = Json::nullValue;
+          break;
+
+        case EntryType_String:
+          reader.ReadLongString(s);
+          target["Type"] = "String";
+          target["Value"] = s;
+          break;
+
+        case EntryType_TooLong:
+          target["Type"] = "TooLong";
+          target["Value"] = Json::nullValue;
+          break;
+
+        case EntryType_Binary:
+          reader.ReadLongString(s);
+          target["Type"] = "Binary";
+          target["Value"] = s;
+          break;
+
+        case EntryType_Sequence:
+        {
+          target["Type"] = "Sequence";
+
+          Json::Value& items = target["Value"];
+          items = Json::arrayValue;
+
+          const uint32_t count = reader.ReadUInt32();
+          for (uint32_t i = 0; i < count; i++)
+          {
+            BufferReader item = reader.GetRegion(reader.ReadUInt32());
+            DecodeDataset(items.append(Json::objectValue), item);
+          }
+
+          break;
+        }
+
+        default:
+          throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+
+    static void DecodeDataset(Json::Value& target,
+                              BufferReader& reader)
+    {
+      target = Json::objectValue;
+
+      DatasetIndex index(reader);
+
+      for (uint32_t i = 0; i < index.GetCount(); i++)
+      {
+        index.SeekEntry(i);
+        DecodeEntry(target[index.GetTag(i).Format()], reader);
+      }
+    }
+
+
+    static void ParseJsonText(Json::Value& target,
+                              const std::string& buffer)
+    {
+      Json::Reader reader;
+      if (!reader.parse(buffer, target))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+
+    bool IsBinary(const std::string& buffer)
+    {
+      return (buffer.size() >= HEADER_SIZE &&
+              memcmp(buffer.c_str(), MAGIC, MAGIC_SIZE) == 0);
+    }
+
+
+    bool Encode(std::string& target,
+                const Json::Value& source)
+    {
+      target.assign(MAGIC, MAGIC_SIZE);
+      WriteUInt8(target, VERSION);
+
+      if (EncodeDataset(target, source))
+      {
+        return true;
+      }
+      else
+      {
+        target.clear();
+        return false;
+      }
+    }
+
+
+    void Decode(Json::Value& target,
+                const std::string& buffer)
+    {
+      if (IsBinary(buffer))
+      {
+        CheckHeader(buffer);
+
+        BufferReader reader(buffer.c_str() + HEADER_SIZE, buffer.size() - HEADER_SIZE);
+        DecodeDataset(target, reader);
+      }
+      else
+      {
+        // Legacy JSON text, as stored by Orthanc <= 1.7.2
+        ParseJsonText(target, buffer);
+      }
+    }
+
+
+    void ToJsonText(std::string& target,
+                    const std::string& buffer)
+    {
+      if (IsBinary(buffer))
+      {
+        Json::Value json;
+        Decode(json, buffer);
+        target = json.toStyledString();
+      }
+      else
+      {
+        target = buffer;
+      }
+    }
+
+
+    void ExtractDicomMap(DicomMap& target,
+                         const std::string& buffer)
+    {
+      if (IsBinary(buffer))
+      {
+        CheckHeader(buffer);
+
+        target.Clear();
+
+        BufferReader reader(buffer.c_str() + HEADER_SIZE, buffer.size() - HEADER_SIZE);
+        DatasetIndex index(reader);
+
+        for (uint32_t i = 0; i < index.GetCount(); i++)
+        {
+          index.SeekEntry(i);
+          if (ReadEntryHeader(reader) == EntryType_String)
+          {
+            std::string value;
+            reader.ReadLongString(value);
+            target.SetValue(index.GetTag(i), value, false /* not binary */);
+          }
+        }
+      }
+      else
+      {
+        Json::Value json;
+        ParseJsonText(json, buffer);
+        target.FromDicomAsJson(json);
+      }
+    }
+
+
+    void ExtractDicomMap(DicomMap& target,
+                         const std::string& buffer,
+                         const std::set<DicomTag>& tags)
+    {
+      if (IsBinary(buffer))
+      {
+        CheckHeader(buffer);
+
+        target.Clear();
+
+        BufferReader reader(buffer.c_str() + HEADER_SIZE, buffer.size() - HEADER_SIZE);
+        DatasetIndex index(reader);
+
+        for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+        {
+          uint32_t i;
+          if (index.LookupTag(i, *it))
+          {
+            index.SeekEntry(i);
+            if (ReadEntryHeader(reader) == EntryType_String)
+            {
+              std::string value;
+              reader.ReadLongString(value);
+              target.SetValue(*it, value, false /* not binary */);
+            }
+          }
+        }
+      }
+      else
+      {
+        DicomMap full;
+        ExtractDicomMap(full, buffer);
+
+        target.Clear();
+
+        for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+        {
+          target.CopyTagIfExists(full, *it);
+        }
+      }
+    }
+  }
+}
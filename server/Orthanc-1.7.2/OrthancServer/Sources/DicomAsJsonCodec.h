@@ -0,0 +1,78 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/DicomFormat/DicomMap.h"
+
+#include <json/json.h>
+#include <set>
+
+namespace Orthanc
+{
+  /**
+   * Compact binary serialization of the "DICOM-as-JSON" attachments
+   * (new in Orthanc 1.7.3). The top-level tags are sorted and indexed
+   * by offset, which allows to look for some tags or to extract the
+   * string values without deserializing the full dataset. Reading
+   * functions transparently accept the legacy JSON text format.
+   **/
+  namespace DicomAsJsonCodec
+  {
+    bool IsBinary(const std::string& buffer);
+
+    // Returns "false" if "source" does not follow the "DICOM-as-JSON"
+    // layout, in which case the caller must keep the JSON text format
+    bool Encode(std::string& target,
+                const Json::Value& source);
+
+    void Decode(Json::Value& target,
+                const std::string& buffer);
+
+    // Converts a binary buffer to the legacy JSON text (no-op if the
+    // buffer is already JSON)
+    void ToJsonText(std::string& target,
+                    const std::string& buffer);
+
+    // Same semantics as "DicomMap::FromDicomAsJson()"
+    void ExtractDicomMap(DicomMap& target,
+                         const std::string& buffer);
+
+    // Only extracts the given tags. In the binary format, each of
+    // them is looked up by a binary search in the index of the
+    // top-level dataset, without reading the other entries.
+    void ExtractDicomMap(DicomMap& target,
+                         const std::string& buffer,
+                         const std::set<DicomTag>& tags);
+  }
+}
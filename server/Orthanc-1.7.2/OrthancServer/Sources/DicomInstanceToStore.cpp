@@ -34,6 +34,7 @@
 #include "PrecompiledHeadersServer.h"
 #include "DicomInstanceToStore.h"
 
+#include "../../OrthancFramework/Sources/DicomFormat/DicomStreamReader.h"
 #include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
 #include "../../OrthancFramework/Sources/Logging.h"
@@ -41,6 +42,7 @@
 
 #include <dcmtk/dcmdata/dcfilefo.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcpixel.h>
 
 
 namespace Orthanc
@@ -169,6 +171,66 @@ namespace Orthanc
   private:
     std::unique_ptr<DicomInstanceHasher>  hasher_;
 
+    void GetRawBuffer(const void*& data,
+                      size_t& size) const
+    {
+      if (ownBuffer_.get() != NULL)
+      {
+        data = (ownBuffer_->empty() ? NULL : ownBuffer_->c_str());
+        size = ownBuffer_->size();
+      }
+      else
+      {
+        data = bufferData_;
+        size = bufferSize_;
+      }
+    }
+
+    /**
+     * Parses the DICOM file up to its pixel data, which is replaced
+     * by an empty element. This gives the same summary and JSON as
+     * the full parsing (the pixel data is a "Null" value in both of
+     * them), while avoiding to copy the pixel data into DCMTK, which
+     * is costly for large multiframe instances. Returns NULL if the
+     * pixel data is not the last element of the dataset, as the
+     * subsequent elements would be lost.
+     **/
+    ParsedDicomFile* ParseDicomHeader() const
+    {
+      const void* data = NULL;
+      size_t size = 0;
+      GetRawBuffer(data, size);
+
+      uint64_t pixelDataStart, pixelDataEnd;
+
+      try
+      {
+        DicomStreamReader reader(data, size);
+        if (!reader.LookupPixelData(pixelDataStart, pixelDataEnd) ||
+            pixelDataEnd != static_cast<uint64_t>(size))
+        {
+          return NULL;
+        }
+      }
+      catch (OrthancException&)
+      {
+        // Let DCMTK deal with the unusual files (e.g. deflated transfer syntax)
+        return NULL;
+      }
+
+      std::unique_ptr<ParsedDicomFile> header(
+        new ParsedDicomFile(data, static_cast<size_t>(pixelDataStart)));
+
+      std::unique_ptr<DcmPixelData> pixelData(new DcmPixelData(DCM_PixelData));
+      if (!header->GetDcmtkObject().getDataset()->insert(pixelData.get()).good())
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      pixelData.release();
+      return header.release();
+    }
+
     void ParseDicomFile()
     {
       if (!parsed_.HasContent())
@@ -235,18 +297,32 @@ namespace Orthanc
 
       // At this point, we know that the DICOM file is available as a
       // memory buffer, but that its summary or its JSON version is
-      // missing
+      // missing. The full DICOM file is only parsed if it is not
+      // available yet, and if parsing its header is not sufficient:
+      // The full parsing is postponed until it is actually needed
+      // (transcoding, Lua scripts, plugins...).
 
-      ParseDicomFile();
-      assert(parsed_.HasContent());
+      std::unique_ptr<ParsedDicomFile> header;
+
+      if (!parsed_.HasContent())
+      {
+        header.reset(ParseDicomHeader());
+
+        if (header.get() == NULL)
+        {
+          ParseDicomFile();
+          assert(parsed_.HasContent());
+        }
+      }
+
+      DcmDataset& dataset = *(header.get() != NULL ? *header : parsed_.GetContent()).GetDcmtkObject().getDataset();
 
       // At this point, we have parsed the DICOM file
     
       if (!summary_.HasContent())
       {
         summary_.Allocate();
-        FromDcmtkBridge::ExtractDicomSummary(summary_.GetContent(), 
-                                             *parsed_.GetContent().GetDcmtkObject().getDataset());
+        FromDcmtkBridge::ExtractDicomSummary(summary_.GetContent(), dataset);
       }
     
       if (!json_.HasContent())
@@ -254,9 +330,7 @@ namespace Orthanc
         json_.Allocate();
 
         std::set<DicomTag> ignoreTagLength;
-        FromDcmtkBridge::ExtractDicomAsJson(json_.GetContent(), 
-                                            *parsed_.GetContent().GetDcmtkObject().getDataset(),
-                                            ignoreTagLength);
+        FromDcmtkBridge::ExtractDicomAsJson(json_.GetContent(), dataset, ignoreTagLength);
       }
     }
 
@@ -381,8 +455,31 @@ namespace Orthanc
     }
 
 
+    bool HasPixelData()
+    {
+      if (parsed_.HasContent())
+      {
+        return parsed_.GetConstContent().HasTag(DICOM_TAG_PIXEL_DATA);
+      }
+      else
+      {
+        // Avoid parsing the full DICOM file if only its header was
+        // parsed: The summary contains all the top-level elements,
+        // including the pixel data
+        return GetSummary().HasTag(DICOM_TAG_PIXEL_DATA);
+      }
+    }
+
+
     ParsedDicomFile& GetParsedDicomFile()
     {
+      if (hasBuffer_)
+      {
+        // Parse the full DICOM file first, so that it is reused by
+        // "ComputeMissingInformation()" instead of parsing its header
+        ParseDicomFile();
+      }
+
       ComputeMissingInformation();
       ParseDicomFile();
       
@@ -498,7 +595,7 @@ namespace Orthanc
 
   bool DicomInstanceToStore::HasPixelData() const
   {
-    return const_cast<PImpl&>(*pimpl_).GetParsedDicomFile().HasTag(DICOM_TAG_PIXEL_DATA);
+    return const_cast<PImpl&>(*pimpl_).HasPixelData();
   }
 
   ParsedDicomFile& DicomInstanceToStore::GetParsedDicomFile() const
@@ -110,13 +110,7 @@ namespace Orthanc
 
     virtual void Apply(LuaScripting& that)
     {
-      LuaScripting::Lock lock(that);
-
-      if (lock.GetLua().IsExistingFunction(command_.c_str()))
-      {
-        LuaFunctionCall call(lock.GetLua(), command_.c_str());
-        call.Execute();
-      }
+      that.ExecuteSynchronously(command_);
     }
   };
 
@@ -897,12 +891,75 @@ namespace Orthanc
   }
 
 
+  bool LuaScripting::FilterIncomingHttpRequest(HttpMethod method,
+                                               const char* uri,
+                                               const char* ip,
+                                               const char* username,
+                                               const std::map<std::string, std::string>& httpHeaders)
+  {
+    static const char* NAME = "IncomingHttpRequestFilter";
+
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    if (lua_.IsExistingFunction(NAME))
+    {
+      LuaFunctionCall call(lua_, NAME);
+
+      switch (method)
+      {
+        case HttpMethod_Get:
+          call.PushString("GET");
+          break;
+
+        case HttpMethod_Put:
+          call.PushString("PUT");
+          break;
+
+        case HttpMethod_Post:
+          call.PushString("POST");
+          break;
+
+        case HttpMethod_Delete:
+          call.PushString("DELETE");
+          break;
+
+        default:
+          return true;
+      }
+
+      call.PushString(uri);
+      call.PushString(ip);
+      call.PushString(username);
+      call.PushStringMap(httpHeaders);
+
+      if (!call.ExecutePredicate())
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
   void LuaScripting::Execute(const std::string& command)
   {
     pendingEvents_.Enqueue(new ExecuteEvent(command));
   }
 
 
+  void LuaScripting::ExecuteSynchronously(const std::string& command)
+  {
+    LuaScripting::Lock lock(*this);
+
+    if (lock.GetLua().IsExistingFunction(command.c_str()))
+    {
+      LuaFunctionCall call(lock.GetLua(), command.c_str());
+      call.Execute();
+    }
+  }
+
+
   void LuaScripting::LoadGlobalConfiguration()
   {
     OrthancConfiguration::ReaderLock configLock;
@@ -129,8 +129,18 @@ namespace Orthanc
     bool FilterIncomingInstance(const DicomInstanceToStore& instance,
                                 const Json::Value& simplifiedTags);
 
+    bool FilterIncomingHttpRequest(HttpMethod method,
+                                   const char* uri,
+                                   const char* ip,
+                                   const char* username,
+                                   const std::map<std::string, std::string>& httpHeaders);
+
     void Execute(const std::string& command);
 
+    // Same as "Execute()", but in the calling thread, for the
+    // interpreters that have no event thread
+    void ExecuteSynchronously(const std::string& command);
+
     void SignalJobSubmitted(const std::string& jobId);
 
     void SignalJobSuccess(const std::string& jobId);
@@ -43,6 +43,7 @@
 #include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../OrthancFramework/Sources/FileStorage/FilesystemStorage.h"
 #include "../../OrthancFramework/Sources/HttpClient.h"
+#include "../../OrthancFramework/Sources/Images/ImageProcessing.h"
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/OrthancException.h"
 
@@ -51,6 +52,7 @@
 
 #include <OrthancServerResources.h>
 
+#include <boost/thread.hpp>
 #include <dcmtk/dcmnet/dul.h>   // For dcmDisableGethostbyaddr()
 
 
@@ -268,6 +270,18 @@ namespace Orthanc
     LoadCustomDictionary(lock.GetJson());
 
     lock.GetConfiguration().RegisterFont(ServerResources::FONT_UBUNTU_MONO_BOLD_16);
+
+    {
+      // "0" means as many threads as CPU cores
+      unsigned int threads = lock.GetConfiguration().GetUnsignedIntegerParameter("ImageProcessingThreadsCount", 0);
+      if (threads == 0)
+      {
+        threads = std::max(1u, boost::thread::hardware_concurrency());
+      }
+
+      LOG(INFO) << "Number of threads for image processing: " << threads;
+      ImageProcessing::SetThreadsCount(threads);
+    }
   }
 
 
@@ -275,6 +289,10 @@ namespace Orthanc
   void OrthancFinalize()
   {
     OrthancConfiguration::WriterLock lock;
+
+    // Stop the threads of the image processing
+    ImageProcessing::SetThreadsCount(1);
+
     Orthanc::FinalizeFramework();
   }
 
@@ -343,6 +361,27 @@ namespace Orthanc
         }
       }
 
+      virtual bool HasReadRange() const
+      {
+        return storage_.HasReadRange();
+      }
+
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start /* inclusive */,
+                             uint64_t end /* exclusive */)
+      {
+        if (type != FileContentType_Dicom)
+        {
+          storage_.ReadRange(content, uuid, type, start, end);
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_UnknownResource);
+        }
+      }
+
       virtual void Remove(const std::string& uuid,
                           FileContentType type) 
       {
@@ -35,12 +35,18 @@
 #include "OrthancRestApi.h"
 
 #include "../../../OrthancFramework/Sources/Compression/GzipCompressor.h"
+#include "../../../OrthancFramework/Sources/Compression/ZipReader.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
 #include "../../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
+#include "../../../OrthancFramework/Sources/TemporaryFile.h"
+#include "../OrthancConfiguration.h"
 #include "../ServerContext.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
 
 namespace Orthanc
 {
@@ -61,18 +67,26 @@ namespace Orthanc
   }
 
 
-  void OrthancRestApi::AnswerStoredInstance(RestApiPostCall& call,
-                                            DicomInstanceToStore& instance,
-                                            StoreStatus status,
-                                            const std::string& instanceId) const
+  static void SetupStoredInstanceAnswer(Json::Value& result,
+                                        DicomInstanceToStore& instance,
+                                        StoreStatus status,
+                                        const std::string& instanceId)
   {
-    Json::Value result;
     SetupResourceAnswer(result, instanceId, ResourceType_Instance, status);
 
     result["ParentPatient"] = instance.GetHasher().HashPatient();
     result["ParentStudy"] = instance.GetHasher().HashStudy();
     result["ParentSeries"] = instance.GetHasher().HashSeries();
+  }
+
 
+  void OrthancRestApi::AnswerStoredInstance(RestApiPostCall& call,
+                                            DicomInstanceToStore& instance,
+                                            StoreStatus status,
+                                            const std::string& instanceId) const
+  {
+    Json::Value result;
+    SetupStoredInstanceAnswer(result, instance, status, instanceId);
     call.GetOutput().AnswerJson(result);
   }
 
@@ -109,6 +123,125 @@ namespace Orthanc
 
   // Upload of DICOM files through HTTP ---------------------------------------
 
+  namespace
+  {
+    // Uncompresses and stores one entry of an uploaded ZIP archive
+    class StoreZipEntryTask : public ThreadPool::ITask
+    {
+    private:
+      ServerContext&              context_;
+      const ZipReader&            reader_;
+      size_t                      index_;
+      const DicomInstanceOrigin&  origin_;
+      Json::Value                 answer_;
+
+    public:
+      StoreZipEntryTask(ServerContext& context,
+                        const ZipReader& reader,
+                        size_t index,
+                        const DicomInstanceOrigin& origin) :
+        context_(context),
+        reader_(reader),
+        index_(index),
+        origin_(origin)
+      {
+      }
+
+      virtual void Execute() ORTHANC_OVERRIDE
+      {
+        try
+        {
+          // The uncompressed entry is released as soon as it is
+          // stored, so that only the entries being stored by the
+          // workers are in memory at any time
+          std::string dicom;
+          reader_.ReadEntry(dicom, index_);
+
+          DicomInstanceToStore toStore;
+          toStore.SetOrigin(origin_);
+          toStore.SetBuffer(dicom.c_str(), dicom.size());
+
+          std::string publicId;
+          StoreStatus status = context_.Store(publicId, toStore, StoreInstanceMode_Default);
+          SetupStoredInstanceAnswer(answer_, toStore, status, publicId);
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot store the file \"" << reader_.GetEntryName(index_)
+                     << "\" of an uploaded ZIP archive: " << e.What();
+
+          answer_ = Json::objectValue;
+          answer_["Status"] = EnumerationToString(StoreStatus_Failure);
+          answer_["Details"] = e.What();
+        }
+        catch (std::bad_alloc&)
+        {
+          LOG(ERROR) << "Not enough memory to store the file \"" << reader_.GetEntryName(index_)
+                     << "\" of an uploaded ZIP archive";
+
+          answer_ = Json::objectValue;
+          answer_["Status"] = EnumerationToString(StoreStatus_Failure);
+          answer_["Details"] = EnumerationToString(ErrorCode_NotEnoughMemory);
+        }
+
+        answer_["Filename"] = reader_.GetEntryName(index_);
+      }
+
+      const Json::Value& GetAnswer() const
+      {
+        return answer_;
+      }
+    };
+  }
+
+
+  static void StoreZipArchive(Json::Value& answer,
+                              ServerContext& context,
+                              const ZipReader& reader,
+                              const DicomInstanceOrigin& origin)
+  {
+    // The entries are uncompressed and stored in parallel by the
+    // threads of "ZipUploadThreadsCount". The answer lists the
+    // entries in the order of the archive.
+    std::vector<StoreZipEntryTask*> entries;
+    entries.reserve(reader.GetEntriesCount());
+
+    try
+    {
+      for (size_t i = 0; i < reader.GetEntriesCount(); i++)
+      {
+        if (!reader.IsDirectory(i))
+        {
+          entries.push_back(new StoreZipEntryTask(context, reader, i, origin));
+        }
+      }
+
+      std::vector<ThreadPool::ITask*> tasks(entries.begin(), entries.end());
+      context.GetZipUploadThreads().Execute(tasks);
+
+      answer = Json::arrayValue;
+      for (size_t i = 0; i < entries.size(); i++)
+      {
+        answer.append(entries[i]->GetAnswer());
+      }
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < entries.size(); i++)
+      {
+        delete entries[i];
+      }
+
+      throw;
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+      delete entries[i];
+    }
+  }
+
+
   static void UploadDicomFile(RestApiPostCall& call)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
@@ -136,6 +269,32 @@ namespace Orthanc
     }
     else
     {
+      if (ZipReader::IsZipMemoryBuffer(call.GetBodyData(), call.GetBodySize()))
+      {
+        std::unique_ptr<ZipReader> reader;
+
+        try
+        {
+          reader.reset(ZipReader::CreateFromMemory(call.GetBodyData(), call.GetBodySize()));
+        }
+        catch (OrthancException&)
+        {
+          // Not a ZIP archive, despite its signature: Try and parse
+          // the body as a DICOM file
+        }
+
+        if (reader.get() != NULL)
+        {
+          LOG(INFO) << "The uploaded file is a ZIP archive with "
+                    << reader->GetEntriesCount() << " entries";
+
+          Json::Value answer;
+          StoreZipArchive(answer, context, *reader, DicomInstanceOrigin::FromRest(call));
+          call.GetOutput().AnswerJson(answer);
+          return;
+        }
+      }
+
       toStore.SetBuffer(call.GetBodyData(), call.GetBodySize());
     }    
 
@@ -146,6 +305,189 @@ namespace Orthanc
   }
 
 
+  /**
+   * Reader for the body of "POST /instances". ZIP archives are
+   * spooled to a temporary file as the body is received, then
+   * processed entry by entry, so that they are never fully loaded in
+   * memory. The other bodies (DICOM files, possibly gzip-compressed)
+   * are accumulated in a single buffer, and forwarded to the
+   * "UploadDicomFile()" handler. Spooling these bodies to disk would
+   * not lower the memory peak, as "DicomInstanceToStore" and DCMTK
+   * need the whole DICOM file in memory anyway: The memory used by a
+   * single DICOM upload is thus proportional to the size of the file.
+   **/
+  class OrthancRestApi::InstancesUploadReader : public IHttpHandler::IChunkedRequestReader
+  {
+  private:
+    OrthancRestApi&                  api_;
+    RequestOrigin                    origin_;
+    std::string                      remoteIp_;
+    std::string                      username_;
+    UriComponents                    uri_;
+    Arguments                        headers_;
+    bool                             isGzip_;
+    uint64_t                         contentLength_;
+    bool                             isModeKnown_;
+    std::string                      buffer_;
+    std::unique_ptr<TemporaryFile>   zip_;
+    boost::filesystem::ofstream      zipStream_;
+
+    void StartZipSpooling()
+    {
+      {
+        OrthancConfiguration::ReaderLock lock;
+        zip_.reset(lock.GetConfiguration().CreateTemporaryFile());
+      }
+
+      zipStream_.open(zip_->GetPath(), std::ofstream::out | std::ofstream::binary);
+      if (!zipStream_.good())
+      {
+        throw OrthancException(ErrorCode_CannotWriteFile);
+      }
+
+      WriteToZip(buffer_.c_str(), buffer_.size());
+
+      std::string empty;
+      buffer_.swap(empty);
+    }
+
+    void WriteToZip(const void* data,
+                    size_t size)
+    {
+      if (size > 0)
+      {
+        zipStream_.write(reinterpret_cast<const char*>(data), size);
+        if (!zipStream_.good())
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+      }
+    }
+
+    void AnswerZip(HttpOutput& output,
+                   const ZipReader& reader)
+    {
+      MetricsRegistry::Timer timer(api_.context_.GetMetricsRegistry(), "orthanc_rest_api_duration_ms");
+      MetricsRegistry::ActiveCounter counter(api_.activeRequests_);
+
+      const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+      LOG(INFO) << "Receiving a ZIP archive with " << reader.GetEntriesCount()
+                << " entries through HTTP";
+
+      Json::Value answer;
+      StoreZipArchive(answer, api_.context_, reader,
+                      DicomInstanceOrigin::FromHttp(remoteIp_.c_str(), username_.c_str()));
+
+      RestApiOutput restOutput(output, HttpMethod_Post);
+      restOutput.AnswerJson(answer);
+
+      const boost::posix_time::time_duration duration =
+        boost::posix_time::microsec_clock::universal_time() - start;
+      api_.SignalHandledCall(HttpMethod_Post, "/instances",
+                             static_cast<float>(duration.total_microseconds()) / 1000.0f);
+    }
+
+  public:
+    InstancesUploadReader(OrthancRestApi& api,
+                          RequestOrigin origin,
+                          const char* remoteIp,
+                          const char* username,
+                          const UriComponents& uri,
+                          const Arguments& headers) :
+      api_(api),
+      origin_(origin),
+      remoteIp_(remoteIp),
+      username_(username),
+      uri_(uri),
+      headers_(headers),
+      isGzip_(false),
+      contentLength_(0),
+      isModeKnown_(false)
+    {
+      Arguments::const_iterator found = headers.find("content-encoding");
+      isGzip_ = (found != headers.end() &&
+                 boost::iequals(found->second, "gzip"));
+
+      found = headers.find("content-length");
+      if (found != headers.end())
+      {
+        try
+        {
+          contentLength_ = boost::lexical_cast<uint64_t>(found->second);
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+        }
+      }
+    }
+
+    virtual void AddBodyChunk(const void* data,
+                              size_t size) ORTHANC_OVERRIDE
+    {
+      if (zip_.get() != NULL)
+      {
+        WriteToZip(data, size);
+        return;
+      }
+
+      buffer_.append(reinterpret_cast<const char*>(data), size);
+
+      if (!isModeKnown_ &&
+          buffer_.size() >= 4)
+      {
+        // The first bytes of the body are sufficient to decide
+        // whether it is a ZIP archive
+        isModeKnown_ = true;
+
+        if (!isGzip_ &&
+            ZipReader::IsZipMemoryBuffer(buffer_))
+        {
+          StartZipSpooling();
+        }
+        else if (contentLength_ > buffer_.size() &&
+                 contentLength_ <= static_cast<uint64_t>(buffer_.max_size()))
+        {
+          buffer_.reserve(static_cast<size_t>(contentLength_));
+        }
+      }
+    }
+
+    virtual void Execute(HttpOutput& output) ORTHANC_OVERRIDE
+    {
+      if (zip_.get() != NULL)
+      {
+        zipStream_.close();
+
+        std::unique_ptr<ZipReader> reader;
+
+        try
+        {
+          reader.reset(ZipReader::CreateFromFile(zip_->GetPath()));
+        }
+        catch (OrthancException&)
+        {
+          // Not a ZIP archive, despite its signature: Try and parse
+          // the body as a DICOM file
+          zip_->Read(buffer_);
+        }
+
+        if (reader.get() != NULL)
+        {
+          AnswerZip(output, *reader);
+          return;
+        }
+      }
+
+      if (!api_.Handle(output, origin_, remoteIp_.c_str(), username_.c_str(), HttpMethod_Post,
+                       uri_, headers_, GetArguments(), buffer_.empty() ? NULL : buffer_.c_str(), buffer_.size()))
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
+      }
+    }
+  };
+
+
 
   // Registration of the various REST handlers --------------------------------
 
@@ -175,6 +517,28 @@ namespace Orthanc
   }
 
 
+  bool OrthancRestApi::CreateChunkedRequestReader(std::unique_ptr<IChunkedRequestReader>& target,
+                                                  RequestOrigin origin,
+                                                  const char* remoteIp,
+                                                  const char* username,
+                                                  HttpMethod method,
+                                                  const UriComponents& uri,
+                                                  const Arguments& headers)
+  {
+    if (method == HttpMethod_Post &&
+        uri.size() == 1 &&
+        uri[0] == "instances")
+    {
+      target.reset(new InstancesUploadReader(*this, origin, remoteIp, username, uri, headers));
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
   bool OrthancRestApi::Handle(HttpOutput& output,
                               RequestOrigin origin,
                               const char* remoteIp,
@@ -194,6 +558,21 @@ namespace Orthanc
   }
 
 
+  void OrthancRestApi::SignalHandledCall(HttpMethod method,
+                                         const std::string& path,
+                                         float durationMs)
+  {
+    MetricsRegistry& registry = context_.GetMetricsRegistry();
+
+    if (registry.IsEnabled())
+    {
+      registry.Observe("orthanc_rest_api_route_duration_ms{method=\"" +
+                       std::string(EnumerationToString(method)) +
+                       "\",route=\"" + path + "\"}", durationMs);
+    }
+  }
+
+
   ServerContext& OrthancRestApi::GetContext(RestApiCall& call)
   {
     return GetApi(call).context_;
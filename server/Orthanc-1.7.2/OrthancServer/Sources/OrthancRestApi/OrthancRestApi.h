@@ -53,6 +53,8 @@ namespace Orthanc
     typedef std::set<std::string> SetOfStrings;
 
   private:
+    class InstancesUploadReader;
+
     ServerContext&                  context_;
     bool                            leaveBarrier_;
     bool                            resetRequestReceived_;
@@ -77,6 +79,14 @@ namespace Orthanc
   public:
     OrthancRestApi(ServerContext& context);
 
+    virtual bool CreateChunkedRequestReader(std::unique_ptr<IChunkedRequestReader>& target,
+                                            RequestOrigin origin,
+                                            const char* remoteIp,
+                                            const char* username,
+                                            HttpMethod method,
+                                            const UriComponents& uri,
+                                            const Arguments& headers) ORTHANC_OVERRIDE;
+
     virtual bool Handle(HttpOutput& output,
                         RequestOrigin origin,
                         const char* remoteIp,
@@ -88,6 +98,10 @@ namespace Orthanc
                         const void* bodyData,
                         size_t bodySize) ORTHANC_OVERRIDE;
 
+    virtual void SignalHandledCall(HttpMethod method,
+                                   const std::string& path,
+                                   float durationMs) ORTHANC_OVERRIDE;
+
     const bool& LeaveBarrierFlag() const
     {
       return leaveBarrier_;
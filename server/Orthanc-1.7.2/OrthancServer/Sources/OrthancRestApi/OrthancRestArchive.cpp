@@ -35,18 +35,259 @@
 #include "OrthancRestApi.h"
 
 #include "../../../OrthancFramework/Sources/HttpServer/FilesystemHttpSender.h"
+#include "../../../OrthancFramework/Sources/Logging.h"
 #include "../../../OrthancFramework/Sources/OrthancException.h"
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../OrthancConfiguration.h"
 #include "../ServerContext.h"
 #include "../ServerJobs/ArchiveJob.h"
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+
 
 namespace Orthanc
 {
   static const char* const KEY_RESOURCES = "Resources";
   static const char* const KEY_EXTENDED = "Extended";
   static const char* const KEY_TRANSCODE = "Transcode";
+
+
+  namespace
+  {
+    /**
+     * Bounded queue of chunks between the job that writes the ZIP
+     * archive, and the HTTP thread that sends it to the client. The
+     * job never blocks on the network: Once the queue is full, the
+     * job is put in the "Retry" state until the HTTP thread has
+     * caught up (cf. "ArchiveJob::IStreamTarget").
+     **/
+    class SynchronousZipStream : public ArchiveJob::IStreamTarget
+    {
+    private:
+      static const size_t CHUNK_SIZE = 1024 * 1024;
+      static const size_t MAX_QUEUED_CHUNKS = 4;
+
+      boost::mutex               mutex_;
+      boost::condition_variable  chunkAvailable_;
+      std::list<std::string>     queue_;
+      std::string                buffer_;
+
+    public:
+      SynchronousZipStream()
+      {
+        buffer_.reserve(CHUNK_SIZE);
+      }
+
+      virtual void Write(const void* data,
+                         size_t size) ORTHANC_OVERRIDE
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        buffer_.append(reinterpret_cast<const char*>(data), size);
+
+        if (buffer_.size() >= CHUNK_SIZE)
+        {
+          queue_.push_back(std::string());
+          queue_.back().swap(buffer_);
+          buffer_.reserve(CHUNK_SIZE);
+          chunkAvailable_.notify_one();
+        }
+      }
+
+      virtual bool IsFull() ORTHANC_OVERRIDE
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        return queue_.size() >= MAX_QUEUED_CHUNKS;
+      }
+
+      // Only to be called once the job has completed
+      void FlushBuffer()
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (!buffer_.empty())
+        {
+          queue_.push_back(std::string());
+          queue_.back().swap(buffer_);
+        }
+      }
+
+      bool Dequeue(std::string& chunk,
+                   unsigned int timeout)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (queue_.empty())
+        {
+          chunkAvailable_.timed_wait(lock, boost::posix_time::milliseconds(timeout));
+        }
+
+        if (queue_.empty())
+        {
+          return false;
+        }
+        else
+        {
+          chunk.swap(queue_.front());
+          queue_.pop_front();
+          return true;
+        }
+      }
+    };
+
+
+    /**
+     * Forwards the chunks of the ZIP archive to the HTTP client. The
+     * HTTP header is only sent with the first chunk, so that errors
+     * occurring at the beginning of the job are still reported
+     * through the HTTP status.
+     **/
+    class ZipStreamSender : public boost::noncopyable
+    {
+    private:
+      RestApiOutput&  output_;
+      std::string     filename_;
+      bool            isStarted_;
+
+      void Start()
+      {
+        if (!isStarted_)
+        {
+          HttpOutput& http = output_.GetLowLevelOutput();
+          http.SetContentFilename(filename_.c_str());
+          http.StartStream(EnumerationToString(MimeType_Zip));
+          output_.MarkLowLevelOutputDone();
+          isStarted_ = true;
+        }
+      }
+
+    public:
+      ZipStreamSender(RestApiOutput& output,
+                      const std::string& filename) :
+        output_(output),
+        filename_(filename),
+        isStarted_(false)
+      {
+      }
+
+      bool IsStarted() const
+      {
+        return isStarted_;
+      }
+
+      void Send(const std::string& chunk)
+      {
+        Start();
+
+        if (!chunk.empty())
+        {
+          output_.GetLowLevelOutput().SendStreamItem(chunk.c_str(), chunk.size());
+        }
+      }
+
+      void Close()
+      {
+        Start();
+        output_.GetLowLevelOutput().CloseStream();
+      }
+    };
+  }
+
+
+  static void ThrowJobFailure(JobsRegistry& registry,
+                              const std::string& jobId)
+  {
+    JobInfo info;
+    if (registry.GetJobInfo(info, jobId))
+    {
+      const JobStatus& status = info.GetStatus();
+
+      if (status.GetDetails().empty())
+      {
+        throw OrthancException(status.GetErrorCode());
+      }
+      else
+      {
+        throw OrthancException(status.GetErrorCode(), status.GetDetails());
+      }
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+
+
+  static void StreamSynchronousArchive(RestApiOutput& output,
+                                       JobsRegistry& registry,
+                                       const std::string& jobId,
+                                       SynchronousZipStream& stream,
+                                       const std::string& filename)
+  {
+    static const unsigned int TIMEOUT = 100;  // In milliseconds
+
+    ZipStreamSender sender(output, filename);
+
+    try
+    {
+      for (;;)
+      {
+        std::string chunk;
+
+        if (stream.Dequeue(chunk, TIMEOUT))
+        {
+          sender.Send(chunk);
+          continue;
+        }
+
+        JobState state;
+        if (!registry.GetState(state, jobId))
+        {
+          throw OrthancException(ErrorCode_InexistentItem,
+                                 "Cannot retrieve the status of the job, "
+                                 "make sure that \"JobsHistorySize\" is not 0");
+        }
+        else if (state == JobState_Failure)
+        {
+          ThrowJobFailure(registry, jobId);
+        }
+        else if (state == JobState_Success)
+        {
+          // The job has written the full archive, send the last chunks
+          stream.FlushBuffer();
+
+          while (stream.Dequeue(chunk, 0))
+          {
+            sender.Send(chunk);
+          }
+
+          sender.Close();
+          return;
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      // Either the job has failed, or the client has disconnected:
+      // Cancel the job if it is still running (no effect otherwise)
+      registry.Cancel(jobId);
+
+      if (sender.IsStarted())
+      {
+        // The HTTP header is already sent, so the error cannot be
+        // reported to the client, that will notice the truncated
+        // chunked transfer as the connection gets closed
+        LOG(ERROR) << "Error while streaming a ZIP archive: " << e.What();
+      }
+      else
+      {
+        throw;
+      }
+    }
+  }
+
   
   static void AddResourcesOfInterestFromArray(ArchiveJob& job,
                                               const Json::Value& resources)
@@ -164,7 +405,39 @@ namespace Orthanc
 
     job->SetDescription("REST API");
 
-    if (synchronous)
+    bool streaming;
+    unsigned int loaderThreads;
+
+    {
+      OrthancConfiguration::ReaderLock lock;
+      streaming = lock.GetConfiguration().GetBooleanParameter("SynchronousZipStream", true);
+      loaderThreads = lock.GetConfiguration().GetUnsignedIntegerParameter("ZipLoaderThreads", 0);
+    }
+
+    job->SetLoaderThreads(loaderThreads);
+    job->SetCompressionLevel(context.GetZipCompressionLevel());  // Validated at startup
+
+    if (synchronous &&
+        streaming)
+    {
+      boost::shared_ptr<SynchronousZipStream> stream(new SynchronousZipStream);
+
+      {
+        boost::shared_ptr<ArchiveJob::IStreamTarget> target(stream);
+        job->SetSynchronousTarget(target);
+      }
+
+      // The HTTP thread drains the stream while the job is running in
+      // the jobs engine, so that a slow client never keeps a worker
+      // of the jobs engine busy
+      JobsRegistry& registry = context.GetJobsEngine().GetRegistry();
+
+      std::string jobId;
+      registry.Submit(jobId, job.release(), priority);
+
+      StreamSynchronousArchive(output, registry, jobId, *stream, filename);
+    }
+    else if (synchronous)
     {
       boost::shared_ptr<TemporaryFile> tmp;
 
@@ -70,6 +70,9 @@ namespace Orthanc
 
   static void GetChanges(RestApiGetCall& call)
   {
+    // Upper bound on the duration of long polling, in seconds
+    static const unsigned int MAX_WAIT = 60;
+
     ServerContext& context = OrthancRestApi::GetContext(call);
 
     //std::string filter = GetArgument(getArguments, "filter", "");
@@ -78,6 +81,17 @@ namespace Orthanc
     bool last;
     GetSinceAndLimit(since, limit, last, call);
 
+    unsigned int wait;
+
+    try
+    {
+      wait = std::min(MAX_WAIT, boost::lexical_cast<unsigned int>(call.GetArgument("wait", "0")));
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      wait = 0;
+    }
+
     Json::Value result;
     if (last)
     {
@@ -85,7 +99,32 @@ namespace Orthanc
     }
     else
     {
-      context.GetIndex().GetChanges(result, since, limit);
+      // Long polling: If no change is available after "since", wait
+      // for at most "wait" seconds until new changes are logged
+      const boost::posix_time::ptime deadline =
+        boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(wait);
+
+      for (;;)
+      {
+        const uint64_t count = context.GetChangesCount();
+
+        context.GetIndex().GetChanges(result, since, limit);
+
+        if (wait == 0 ||
+            result["Changes"].size() > 0)
+        {
+          break;
+        }
+
+        const boost::posix_time::time_duration remaining =
+          deadline - boost::posix_time::microsec_clock::universal_time();
+
+        if (remaining.is_negative() ||
+            !context.WaitForChanges(count, static_cast<unsigned int>(remaining.total_milliseconds())))
+        {
+          break;
+        }
+      }
     }
 
     call.GetOutput().AnswerJson(result);
@@ -1143,6 +1143,13 @@ namespace Orthanc
     {
       job->SetTranscode(SerializationToolbox::ReadString(request, TRANSCODE));
     }
+
+    static const char* CONCURRENCY = "Concurrency";
+    if (request.type() == Json::objectValue &&
+        request.isMember(CONCURRENCY))
+    {
+      job->SetConcurrency(SerializationToolbox::ReadUnsignedInteger(request, CONCURRENCY));
+    }
     
     {
       OrthancConfiguration::ReaderLock lock;
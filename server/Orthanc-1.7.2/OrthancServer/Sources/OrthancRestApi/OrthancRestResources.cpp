@@ -996,6 +996,13 @@ namespace Orthanc
     std::string raw;
     MimeType mime;
 
+    if (OrthancRestApi::GetContext(call).ReadRawFrameFromStorage(raw, publicId, frame))
+    {
+      // Uncompressed transfer syntax: The frame was directly read
+      // from the storage area, without parsing the full DICOM file
+      mime = MimeType_Binary;
+    }
+    else
     {
       ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), publicId);
       locker.GetDicom().GetRawFrame(raw, mime, frame);
@@ -1264,6 +1271,14 @@ namespace Orthanc
   }
 
 
+  /**
+   * The size and MD5 routes below report the information that is
+   * stored in the index, which describes the file in the storage
+   * area. Since Orthanc 1.7.3, the "dicom-as-json" attachment may be
+   * stored in a binary format that is converted to JSON text by
+   * "GetAttachmentData()": The reported values then do not
+   * correspond to the body of ".../dicom-as-json/data".
+   **/
   static void GetAttachmentSize(RestApiGetCall& call)
   {
     FileInfo info;
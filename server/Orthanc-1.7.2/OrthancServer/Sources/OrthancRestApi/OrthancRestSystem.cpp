@@ -441,6 +441,9 @@ namespace Orthanc
     unsigned int jobsPending, jobsRunning, jobsSuccess, jobsFailed;
     context.GetJobsEngine().GetRegistry().GetStatistics(jobsPending, jobsRunning, jobsSuccess, jobsFailed);
 
+    uint64_t dicomCacheHits, dicomCacheMisses, dicomCacheEvictions;
+    context.GetDicomCache().GetStatistics(dicomCacheHits, dicomCacheMisses, dicomCacheEvictions);
+
     MetricsRegistry& registry = context.GetMetricsRegistry();
     registry.SetValue("orthanc_disk_size_mb", static_cast<float>(diskSize) / MEGA_BYTES);
     registry.SetValue("orthanc_uncompressed_size_mb", static_cast<float>(diskSize) / MEGA_BYTES);
@@ -453,6 +456,9 @@ namespace Orthanc
     registry.SetValue("orthanc_jobs_completed", jobsSuccess + jobsFailed);
     registry.SetValue("orthanc_jobs_success", jobsSuccess);
     registry.SetValue("orthanc_jobs_failed", jobsFailed);
+    registry.SetValue("orthanc_dicom_cache_hits", static_cast<float>(dicomCacheHits));
+    registry.SetValue("orthanc_dicom_cache_misses", static_cast<float>(dicomCacheMisses));
+    registry.SetValue("orthanc_dicom_cache_evictions", static_cast<float>(dicomCacheEvictions));
     
     std::string s;
     registry.ExportPrometheusText(s);
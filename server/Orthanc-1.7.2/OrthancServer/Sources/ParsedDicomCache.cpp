@@ -0,0 +1,308 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "ParsedDicomCache.h"
+
+#include "../../OrthancFramework/Sources/OrthancException.h"
+
+#include <boost/functional/hash.hpp>
+
+
+namespace Orthanc
+{
+  class ParsedDicomCache::Item : public ICacheable
+  {
+  private:
+    ParsedDicomCache&                 cache_;
+    boost::mutex                      mutex_;
+    std::unique_ptr<ParsedDicomFile>  dicom_;
+    size_t                            fileSize_;
+    bool                              signalEviction_;
+
+  public:
+    Item(ParsedDicomCache& cache,
+         ParsedDicomFile* dicom,  // Takes ownership
+         size_t fileSize) :
+      cache_(cache),
+      dicom_(dicom),
+      fileSize_(fileSize),
+      signalEviction_(false)
+    {
+      if (dicom == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+    }
+
+    virtual ~Item()
+    {
+      if (signalEviction_)
+      {
+        cache_.SignalEviction();
+      }
+    }
+
+    virtual size_t GetMemoryUsage() const ORTHANC_OVERRIDE
+    {
+      return fileSize_;
+    }
+
+    boost::mutex& GetMutex()
+    {
+      return mutex_;
+    }
+
+    ParsedDicomFile& GetDicom() const
+    {
+      assert(dicom_.get() != NULL);
+      return *dicom_;
+    }
+
+    size_t GetFileSize() const
+    {
+      return fileSize_;
+    }
+
+    // Only the items that are removed by the LRU recycling policy
+    // are counted as evictions
+    void SetSignalEviction(bool signal)
+    {
+      signalEviction_ = signal;
+    }
+  };
+
+
+  MemoryObjectCache& ParsedDicomCache::GetShard(const std::string& instancePublicId)
+  {
+    assert(!shards_.empty());
+
+    boost::hash<std::string> hasher;
+    size_t index = hasher(instancePublicId) % shards_.size();
+
+    assert(shards_[index] != NULL);
+    return *shards_[index];
+  }
+
+
+  void ParsedDicomCache::SignalEviction()
+  {
+    boost::mutex::scoped_lock lock(statisticsMutex_);
+    countEvictions_++;
+  }
+
+
+  ParsedDicomCache::ParsedDicomCache(size_t maxSize,
+                                     unsigned int countShards) :
+    countHits_(0),
+    countMisses_(0),
+    countEvictions_(0),
+    maxSize_(0)
+  {
+    if (countShards == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    shards_.resize(countShards);
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i] = new MemoryObjectCache;
+    }
+
+    SetMaximumSize(maxSize);
+  }
+
+
+  ParsedDicomCache::~ParsedDicomCache()
+  {
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      assert(shards_[i] != NULL);
+      delete shards_[i];
+    }
+  }
+
+
+  size_t ParsedDicomCache::GetMaximumSize()
+  {
+    boost::mutex::scoped_lock lock(statisticsMutex_);
+    return maxSize_;
+  }
+
+
+  void ParsedDicomCache::SetMaximumSize(size_t maxSize)
+  {
+    // Each shard gets an equal part of the memory budget
+    size_t shardSize = maxSize / shards_.size();
+    if (shardSize == 0)
+    {
+      shardSize = 1;
+    }
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      shards_[i]->SetMaximumSize(shardSize);
+    }
+
+    boost::mutex::scoped_lock lock(statisticsMutex_);
+    maxSize_ = maxSize;
+  }
+
+
+  bool ParsedDicomCache::IsCacheable(size_t fileSize)
+  {
+    return fileSize <= GetMaximumSize() / shards_.size();
+  }
+
+
+  void ParsedDicomCache::Acquire(const std::string& instancePublicId,
+                                 ParsedDicomFile* dicom,
+                                 size_t fileSize)
+  {
+    std::unique_ptr<Item> item(new Item(*this, dicom, fileSize));
+
+    if (!IsCacheable(fileSize))
+    {
+      return;  // Too large, discard the item
+    }
+
+    MemoryObjectCache& shard = GetShard(instancePublicId);
+
+    // The item is not stored if another thread has already cached
+    // the same instance: In such a case, "item" is deleted by
+    // "MemoryObjectCache::Acquire()" and must not be accessed anymore
+    const ICacheable* stored = item.get();
+    shard.Acquire(instancePublicId, item.release());
+
+    MemoryObjectCache::Accessor accessor(shard, instancePublicId, true /* unique */);
+    if (accessor.IsValid() &&
+        &accessor.GetValue() == stored)
+    {
+      dynamic_cast<Item&>(accessor.GetValue()).SetSignalEviction(true);
+    }
+  }
+
+
+  void ParsedDicomCache::Invalidate(const std::string& instancePublicId)
+  {
+    MemoryObjectCache& shard = GetShard(instancePublicId);
+
+    {
+      MemoryObjectCache::Accessor accessor(shard, instancePublicId, true /* unique */);
+      if (accessor.IsValid())
+      {
+        dynamic_cast<Item&>(accessor.GetValue()).SetSignalEviction(false);
+      }
+    }
+
+    shard.Invalidate(instancePublicId);
+  }
+
+
+  void ParsedDicomCache::GetStatistics(uint64_t& countHits,
+                                       uint64_t& countMisses,
+                                       uint64_t& countEvictions)
+  {
+    boost::mutex::scoped_lock lock(statisticsMutex_);
+    countHits = countHits_;
+    countMisses = countMisses_;
+    countEvictions = countEvictions_;
+  }
+
+
+  ParsedDicomCache::Accessor::Accessor(ParsedDicomCache& cache,
+                                       const std::string& instancePublicId,
+                                       bool updateStatistics) :
+    item_(NULL)
+  {
+    // The shard is only locked in shared mode, which prevents the
+    // item from being recycled while it is in use
+    accessor_.reset(new MemoryObjectCache::Accessor(cache.GetShard(instancePublicId),
+                                                    instancePublicId, false /* shared */));
+
+    if (accessor_->IsValid())
+    {
+      item_ = &dynamic_cast<Item&>(accessor_->GetValue());
+
+      // "ParsedDicomFile" is not thread-safe: Lock the item itself
+      itemLock_ = boost::mutex::scoped_lock(item_->GetMutex());
+    }
+    else
+    {
+      accessor_.reset(NULL);
+    }
+
+    if (updateStatistics)
+    {
+      boost::mutex::scoped_lock lock(cache.statisticsMutex_);
+      if (item_ == NULL)
+      {
+        cache.countMisses_++;
+      }
+      else
+      {
+        cache.countHits_++;
+      }
+    }
+  }
+
+
+  ParsedDicomFile& ParsedDicomCache::Accessor::GetDicom() const
+  {
+    if (IsValid())
+    {
+      return item_->GetDicom();
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+
+
+  size_t ParsedDicomCache::Accessor::GetFileSize() const
+  {
+    if (IsValid())
+    {
+      return item_->GetFileSize();
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+  }
+}
@@ -0,0 +1,119 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2020 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#pragma once
+
+#include "../../OrthancFramework/Sources/Cache/MemoryObjectCache.h"
+#include "../../OrthancFramework/Sources/Compatibility.h"
+#include "../../OrthancFramework/Sources/DicomParsing/ParsedDicomFile.h"
+
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Cache of parsed DICOM instances, whose memory usage is bounded by
+   * the total size of the cached DICOM files. The cache is split into
+   * shards that are indexed by the hash of the instance identifier:
+   * Accessing an instance only locks its shard in shared mode, and
+   * the cached instance itself in exclusive mode. This allows
+   * independent instances to be accessed concurrently. Each shard
+   * follows a LRU recycling policy.
+   **/
+  class ParsedDicomCache : public boost::noncopyable
+  {
+  private:
+    class Item;
+
+    boost::mutex                       statisticsMutex_;
+    uint64_t                           countHits_;
+    uint64_t                           countMisses_;
+    uint64_t                           countEvictions_;
+    size_t                             maxSize_;
+    std::vector<MemoryObjectCache*>    shards_;
+
+    MemoryObjectCache& GetShard(const std::string& instancePublicId);
+
+    void SignalEviction();
+
+  public:
+    ParsedDicomCache(size_t maxSize,
+                     unsigned int countShards);
+
+    ~ParsedDicomCache();
+
+    size_t GetMaximumSize();
+
+    void SetMaximumSize(size_t maxSize);
+
+    // Returns "false" if the DICOM file is too large to be cached
+    bool IsCacheable(size_t fileSize);
+
+    // Takes the ownership of "dicom", that is discarded if too large
+    void Acquire(const std::string& instancePublicId,
+                 ParsedDicomFile* dicom,
+                 size_t fileSize);
+
+    void Invalidate(const std::string& instancePublicId);
+
+    void GetStatistics(uint64_t& countHits,
+                       uint64_t& countMisses,
+                       uint64_t& countEvictions);
+
+    class Accessor : public boost::noncopyable
+    {
+    private:
+      std::unique_ptr<MemoryObjectCache::Accessor>  accessor_;
+      boost::mutex::scoped_lock                     itemLock_;
+      Item*                                         item_;
+
+    public:
+      Accessor(ParsedDicomCache& cache,
+               const std::string& instancePublicId,
+               bool updateStatistics);
+
+      bool IsValid() const
+      {
+        return item_ != NULL;
+      }
+
+      ParsedDicomFile& GetDicom() const;
+
+      size_t GetFileSize() const;
+    };
+  };
+}
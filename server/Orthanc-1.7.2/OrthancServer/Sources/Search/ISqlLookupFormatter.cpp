@@ -73,6 +73,69 @@ namespace Orthanc
   }      
   
 
+  static bool GetPrefixUpperBound(std::string& target,
+                                  const std::string& prefix)
+  {
+    // Exclusive upper bound of the strings starting with "prefix", in
+    // byte order. There is no such bound if the prefix only contains
+    // 0xff bytes.
+    target = prefix;
+
+    while (!target.empty() &&
+           static_cast<uint8_t>(target[target.size() - 1]) == 0xff)
+    {
+      target.resize(target.size() - 1);
+    }
+
+    if (target.empty())
+    {
+      return false;
+    }
+    else
+    {
+      target[target.size() - 1] = static_cast<char>(static_cast<uint8_t>(target[target.size() - 1]) + 1);
+      return true;
+    }
+  }
+
+
+  static std::string FormatLikePattern(const std::string& value)
+  {
+    std::string escaped;
+    escaped.reserve(value.size());
+
+    for (size_t i = 0; i < value.size(); i++)
+    {
+      if (value[i] == '*')
+      {
+        escaped += "%";
+      }
+      else if (value[i] == '?')
+      {
+        escaped += "_";
+      }
+      else if (value[i] == '%')
+      {
+        escaped += "\\%";
+      }
+      else if (value[i] == '_')
+      {
+        escaped += "\\_";
+      }
+      else if (value[i] == '\\')
+      {
+        escaped += "\\\\";
+      }
+      else
+      {
+        escaped += value[i];
+      }               
+    }
+
+    return escaped;
+  }
+
+
   static bool FormatComparison(std::string& target,
                                ISqlLookupFormatter& formatter,
                                const DatabaseConstraint& constraint,
@@ -166,40 +229,50 @@ namespace Orthanc
             return false;
           }
         }
-        else
+        else if (constraint.IsCaseSensitive() &&
+                 formatter.IsBinaryCollation() &&
+                 !value.empty() &&
+                 value[0] != '*' &&
+                 value[0] != '?')
         {
-          std::string escaped;
-          escaped.reserve(value.size());
+          // The pattern starts with a literal prefix: Restrict the
+          // candidates to the range of values starting with this
+          // prefix, which can be resolved using the index
+          const size_t wildcard = value.find_first_of("*?");
 
-          for (size_t i = 0; i < value.size(); i++)
+          if (wildcard == std::string::npos)
           {
-            if (value[i] == '*')
-            {
-              escaped += "%";
-            }
-            else if (value[i] == '?')
-            {
-              escaped += "_";
-            }
-            else if (value[i] == '%')
-            {
-              escaped += "\\%";
-            }
-            else if (value[i] == '_')
+            // No wildcard character at all
+            comparison = tag + ".value = " + formatter.GenerateParameter(value);
+          }
+          else
+          {
+            const std::string prefix = value.substr(0, wildcard);
+            
+            comparison = tag + ".value >= " + formatter.GenerateParameter(prefix);
+
+            std::string upper;
+            if (GetPrefixUpperBound(upper, prefix))
             {
-              escaped += "\\_";
+              comparison += " AND " + tag + ".value < " + formatter.GenerateParameter(upper);
             }
-            else if (value[i] == '\\')
+
+            if (wildcard + 1 != value.size() ||
+                value[wildcard] != '*')
             {
-              escaped += "\\\\";
+              // The pattern is not of the form "prefix*": The
+              // candidates in the range must be filtered
+              comparison += (" AND " + tag + ".value LIKE " +
+                             formatter.GenerateParameter(FormatLikePattern(value)) + " " +
+                             formatter.FormatWildcardEscape());
             }
-            else
-            {
-              escaped += value[i];
-            }               
-          }
 
-          std::string parameter = formatter.GenerateParameter(escaped);
+            comparison = "(" + comparison + ")";
+          }
+        }
+        else
+        {
+          std::string parameter = formatter.GenerateParameter(FormatLikePattern(value));
 
           if (constraint.IsCaseSensitive())
           {
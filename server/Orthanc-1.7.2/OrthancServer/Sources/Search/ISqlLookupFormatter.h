@@ -60,6 +60,20 @@ namespace Orthanc
 
     virtual std::string FormatWildcardEscape() = 0;
 
+    /**
+     * Whether the comparison operators on the "value" columns follow
+     * the byte order of the strings (binary collation). If this is
+     * the case, the case-sensitive wildcard constraints that start
+     * with a literal prefix are turned into range predicates that can
+     * use the index on the values, the "LIKE" operator being only
+     * used to filter the remaining candidates. This is disabled by
+     * default, as this is not true for most locale-aware collations.
+     **/
+    virtual bool IsBinaryCollation()
+    {
+      return false;
+    }
+
     static void Apply(std::string& sql,
                       ISqlLookupFormatter& formatter,
                       const std::vector<DatabaseConstraint>& lookup,
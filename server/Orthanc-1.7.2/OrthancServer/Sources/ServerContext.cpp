@@ -36,6 +36,8 @@
 
 #include "../../OrthancFramework/Sources/DicomParsing/Internals/DicomImageDecoder.h"
 #include "../../OrthancFramework/Sources/Cache/SharedArchive.h"
+#include "../../OrthancFramework/Sources/DicomFormat/DicomImageInformation.h"
+#include "../../OrthancFramework/Sources/DicomFormat/DicomStreamReader.h"
 #include "../../OrthancFramework/Sources/DicomParsing/DcmtkTranscoder.h"
 #include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../OrthancFramework/Sources/FileStorage/StorageAccessor.h"
@@ -44,8 +46,11 @@
 #include "../../OrthancFramework/Sources/JobsEngine/SetOfInstancesJob.h"
 #include "../../OrthancFramework/Sources/Logging.h"
 #include "../../OrthancFramework/Sources/MetricsRegistry.h"
+#include "../../OrthancFramework/Sources/MultiThreading/Semaphore.h"
+#include "../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
 #include "../Plugins/Engine/OrthancPlugins.h"
 
+#include "DicomAsJsonCodec.h"
 #include "OrthancConfiguration.h"
 #include "OrthancRestApi/OrthancRestApi.h"
 #include "Search/DatabaseLookup.h"
@@ -57,9 +62,7 @@
 
 
 
-#define ENABLE_DICOM_CACHE  1
-
-static const size_t DICOM_CACHE_SIZE = 2;
+static const unsigned int DICOM_CACHE_SHARDS = 16;
 
 /**
  * IMPORTANT: We make the assumption that the same instance of
@@ -72,6 +75,111 @@ static const size_t DICOM_CACHE_SIZE = 2;
 
 namespace Orthanc
 {
+  namespace
+  {
+    void SerializeDicomAsJsonInternal(std::string& target,
+                                      const Json::Value& source,
+                                      bool binary)
+    {
+      // Fallback to the JSON text if the summary has an unexpected layout
+      if (!binary ||
+          !DicomAsJsonCodec::Encode(target, source))
+      {
+        target = source.toStyledString();
+      }
+    }
+
+
+    // Compresses and writes one attachment of an incoming instance
+    class WriteAttachmentTask : public ThreadPool::ITask
+    {
+    private:
+      StorageAccessor     accessor_;
+      const void*         data_;
+      size_t              size_;
+      const Json::Value*  json_;   // If not NULL, serialized by the task
+      bool                binaryJson_;
+      FileContentType     type_;
+      CompressionType     compression_;
+      bool                storeMD5_;
+      bool                isWritten_;
+      FileInfo            info_;
+
+    public:
+      WriteAttachmentTask(IStorageArea& area,
+                          MemoryStringCache* cache,
+                          MetricsRegistry& metrics,
+                          const void* data,
+                          size_t size,
+                          FileContentType type,
+                          CompressionType compression,
+                          bool storeMD5) :
+        accessor_(area, cache, metrics),
+        data_(data),
+        size_(size),
+        json_(NULL),
+        binaryJson_(false),
+        type_(type),
+        compression_(compression),
+        storeMD5_(storeMD5),
+        isWritten_(false)
+      {
+      }
+
+      WriteAttachmentTask(IStorageArea& area,
+                          MemoryStringCache* cache,
+                          MetricsRegistry& metrics,
+                          const Json::Value& json,
+                          bool binaryJson,
+                          FileContentType type,
+                          CompressionType compression,
+                          bool storeMD5) :
+        accessor_(area, cache, metrics),
+        data_(NULL),
+        size_(0),
+        json_(&json),
+        binaryJson_(binaryJson),
+        type_(type),
+        compression_(compression),
+        storeMD5_(storeMD5),
+        isWritten_(false)
+      {
+      }
+
+      virtual void Execute() ORTHANC_OVERRIDE
+      {
+        if (json_ != NULL)
+        {
+          std::string s;
+          SerializeDicomAsJsonInternal(s, *json_, binaryJson_);
+          info_ = accessor_.Write(s, type_, compression_, storeMD5_);
+        }
+        else
+        {
+          info_ = accessor_.Write(data_, size_, type_, compression_, storeMD5_);
+        }
+
+        isWritten_ = true;
+      }
+
+      const FileInfo& GetInfo() const
+      {
+        assert(isWritten_);
+        return info_;
+      }
+
+      void RemoveIfWritten()
+      {
+        if (isWritten_)
+        {
+          accessor_.Remove(info_);
+          isWritten_ = false;
+        }
+      }
+    };
+  }
+
+
   void ServerContext::ChangeThread(ServerContext* that,
                                    unsigned int sleepDelay)
   {
@@ -242,6 +350,18 @@ namespace Orthanc
   }
 
 
+  static void DeleteLuaInterpreters(std::vector<LuaScripting*>& interpreters)
+  {
+    for (size_t i = 0; i < interpreters.size(); i++)
+    {
+      assert(interpreters[i] != NULL);
+      delete interpreters[i];
+    }
+
+    interpreters.clear();
+  }
+
+
   ServerContext::ServerContext(IDatabaseWrapper& database,
                                IStorageArea& area,
                                bool unitTesting,
@@ -250,10 +370,9 @@ namespace Orthanc
     area_(area),
     compressionEnabled_(false),
     storeMD5_(true),
-    provider_(*this),
-    dicomCache_(provider_, DICOM_CACHE_SIZE),
+    dicomCache_(128 * 1024 * 1024 /* 128MB, overwritten by the configuration */, DICOM_CACHE_SHARDS),
+    binaryDicomAsJson_(true),
     mainLua_(*this),
-    filterLua_(*this),
     luaListener_(*this),
     jobsEngine_(maxCompletedJobs),
 #if ORTHANC_ENABLE_PLUGINS == 1
@@ -262,6 +381,8 @@ namespace Orthanc
     done_(false),
     haveJobsChanged_(false),
     isJobsEngineUnserialized_(false),
+    changesCount_(0),
+    isChangesWaitAborted_(false),
     metricsRegistry_(new MetricsRegistry),
     isHttpServerSecure_(true),
     isExecuteLuaEnabled_(false),
@@ -272,6 +393,7 @@ namespace Orthanc
     try
     {
       unsigned int lossyQuality;
+      unsigned int luaFilters;
 
       {
         OrthancConfiguration::ReaderLock lock;
@@ -284,6 +406,32 @@ namespace Orthanc
         jobsEngine_.SetWorkersCount(lock.GetConfiguration().GetUnsignedIntegerParameter("ConcurrentJobs", 2));
         saveJobs_ = lock.GetConfiguration().GetBooleanParameter("SaveJobs", true);
         metricsRegistry_->SetEnabled(lock.GetConfiguration().GetBooleanParameter("MetricsEnabled", true));
+        dicomCache_.SetMaximumSize(static_cast<size_t>(
+          lock.GetConfiguration().GetUnsignedIntegerParameter("DicomCacheSize", 128)) * 1024 * 1024);
+
+        unsigned int storageCacheSize = lock.GetConfiguration().GetUnsignedIntegerParameter("MaximumStorageCacheSize", 128);
+        if (storageCacheSize != 0)
+        {
+          storageCache_.reset(new MemoryStringCache);
+          storageCache_->SetMaximumSize(static_cast<size_t>(storageCacheSize) * 1024 * 1024);
+        }
+
+        ingestThreads_.reset(new ThreadPool(lock.GetConfiguration().GetUnsignedIntegerParameter("IngestThreadsCount", 4)));
+
+        SetMaximumConcurrentIngests(lock.GetConfiguration().GetUnsignedIntegerParameter("MaximumConcurrentIngests", 16));
+
+        binaryDicomAsJson_ = lock.GetConfiguration().GetBooleanParameter("BinaryDicomAsJson", false);
+        findThreads_.reset(new ThreadPool(lock.GetConfiguration().GetUnsignedIntegerParameter("FindThreadsCount", 4)));
+        zipUploadThreads_.reset(new ThreadPool(lock.GetConfiguration().GetUnsignedIntegerParameter("ZipUploadThreadsCount", 4)));
+
+        unsigned int zipCompressionLevel = lock.GetConfiguration().GetUnsignedIntegerParameter("ZipCompressionLevel", 6);
+        if (zipCompressionLevel >= 10)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange,
+                                 "The configuration option \"ZipCompressionLevel\" must be between 0 and 9");
+        }
+
+        zipCompressionLevel_ = static_cast<uint8_t>(zipCompressionLevel);
 
         // New configuration options in Orthanc 1.5.1
         findStorageAccessMode_ = StringToFindStorageAccessMode(lock.GetConfiguration().GetStringParameter("StorageAccessOnFind", "Always"));
@@ -298,6 +446,12 @@ namespace Orthanc
         builtinDecoderTranscoderOrder_ = StringToBuiltinDecoderTranscoderOrder(lock.GetConfiguration().GetStringParameter("BuiltinDecoderTranscoderOrder", "After"));
         lossyQuality = lock.GetConfiguration().GetUnsignedIntegerParameter("DicomLossyTranscodingQuality", 90);
 
+        luaFilters = lock.GetConfiguration().GetUnsignedIntegerParameter("LuaFilterInterpretersCount", 1);
+        if (luaFilters == 0)
+        {
+          luaFilters = std::max(1u, boost::thread::hardware_concurrency());
+        }
+
         std::string s;
         if (lock.GetConfiguration().LookupStringParameter(s, "IngestTranscoding"))
         {
@@ -322,6 +476,17 @@ namespace Orthanc
 
       jobsEngine_.SetThreadSleep(unitTesting ? 20 : 200);
 
+      // The Lua interpreters read the configuration by themselves
+      LOG(INFO) << "Initializing " << luaFilters << " Lua interpreter(s) for the filters";
+      filterLua_.reserve(luaFilters);
+
+      for (unsigned int i = 0; i < luaFilters; i++)
+      {
+        filterLua_.push_back(new LuaScripting(*this));
+      }
+
+      availableFilterLua_ = filterLua_;
+
       listeners_.push_back(ServerListener(luaListener_, "Lua"));
       changeThread_ = boost::thread(ChangeThread, this, (unitTesting ? 20 : 100));
     
@@ -330,6 +495,7 @@ namespace Orthanc
     catch (OrthancException&)
     {
       Stop();
+      DeleteLuaInterpreters(filterLua_);
       throw;
     }
   }
@@ -343,6 +509,76 @@ namespace Orthanc
       LOG(ERROR) << "INTERNAL ERROR: ServerContext::Stop() should be invoked manually to avoid mess in the destruction order!";
       Stop();
     }
+
+    DeleteLuaInterpreters(filterLua_);
+  }
+
+
+  ServerContext::LuaFilterLock::LuaFilterLock(ServerContext& that) :
+    that_(that)
+  {
+    boost::mutex::scoped_lock lock(that_.filterLuaMutex_);
+
+    FilterLuaOwners::iterator owner = that_.filterLuaOwners_.find(boost::this_thread::get_id());
+    if (owner != that_.filterLuaOwners_.end())
+    {
+      // Re-entrant call from a filter: Reuse the interpreter that is
+      // already borrowed by this thread
+      lua_ = owner->second.first;
+      owner->second.second++;
+    }
+    else
+    {
+      // Wait for one of the interpreters of the pool to be available
+      while (that_.availableFilterLua_.empty())
+      {
+        that_.filterLuaAvailable_.wait(lock);
+      }
+
+      lua_ = that_.availableFilterLua_.back();
+      that_.availableFilterLua_.pop_back();
+
+      that_.filterLuaOwners_[boost::this_thread::get_id()] = std::make_pair(lua_, 1u);
+    }
+
+    assert(lua_ != NULL);
+  }
+
+
+  ServerContext::LuaFilterLock::~LuaFilterLock()
+  {
+    {
+      boost::mutex::scoped_lock lock(that_.filterLuaMutex_);
+
+      FilterLuaOwners::iterator owner = that_.filterLuaOwners_.find(boost::this_thread::get_id());
+      assert(owner != that_.filterLuaOwners_.end() &&
+             owner->second.first == lua_ &&
+             owner->second.second > 0);
+
+      owner->second.second--;
+      if (owner->second.second > 0)
+      {
+        return;  // Nested lock, the interpreter is still in use by this thread
+      }
+
+      that_.filterLuaOwners_.erase(owner);
+      that_.availableFilterLua_.push_back(lua_);
+    }
+
+    that_.filterLuaAvailable_.notify_one();
+  }
+
+
+  void ServerContext::ExecuteLuaFilterCallback(const std::string& command)
+  {
+    if (IsLuaFilterPoolEnabled())
+    {
+      for (size_t i = 0; i < filterLua_.size(); i++)
+      {
+        assert(filterLua_[i] != NULL);
+        filterLua_[i]->ExecuteSynchronously(command);
+      }
+    }
   }
 
 
@@ -357,6 +593,9 @@ namespace Orthanc
 
       done_ = true;
 
+      // Release the clients that are still long polling "/changes"
+      AbortWaitForChanges();
+
       if (changeThread_.joinable())
       {
         changeThread_.join();
@@ -393,10 +632,35 @@ namespace Orthanc
   }
 
 
+  void ServerContext::SetFindThreadsCount(unsigned int count)
+  {
+    findThreads_.reset(new ThreadPool(count));
+  }
+
+
+  void ServerContext::SetZipUploadThreadsCount(unsigned int count)
+  {
+    zipUploadThreads_.reset(new ThreadPool(count));
+  }
+
+
+  void ServerContext::SetMaximumConcurrentIngests(unsigned int count)
+  {
+    if (count == 0)
+    {
+      ingestSemaphore_.reset(NULL);
+    }
+    else
+    {
+      ingestSemaphore_.reset(new Semaphore(count));
+    }
+  }
+
+
   void ServerContext::RemoveFile(const std::string& fileUuid,
                                  FileContentType type)
   {
-    StorageAccessor accessor(area_, GetMetricsRegistry());
+    StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
     accessor.Remove(fileUuid, type);
   }
 
@@ -427,12 +691,25 @@ namespace Orthanc
     try
     {
       MetricsRegistry::Timer timer(GetMetricsRegistry(), "orthanc_store_dicom_duration_ms");
-      StorageAccessor accessor(area_, GetMetricsRegistry());
+      MetricsRegistry::HistogramTimer histogram(GetMetricsRegistry(), "orthanc_store_latency_ms{step=\"total\"}");
+      StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
 
-      resultPublicId = dicom.GetHasher().HashInstance();
+      // Backpressure on the C-STORE SCP and on the REST API: Bound the
+      // number of instances that are simultaneously ingested
+      std::unique_ptr<Semaphore::Locker> ingestLocker;
+      if (ingestSemaphore_.get() != NULL)
+      {
+        MetricsRegistry::Timer queueTimer(GetMetricsRegistry(), "orthanc_store_queue_duration_ms");
+        ingestLocker.reset(new Semaphore::Locker(*ingestSemaphore_));
+      }
 
       Json::Value simplifiedTags;
-      Toolbox::SimplifyDicomAsJson(simplifiedTags, dicom.GetJson(), DicomToJsonFormat_Human);
+
+      {
+        MetricsRegistry::Timer parseTimer(GetMetricsRegistry(), "orthanc_store_parse_duration_ms");
+        resultPublicId = dicom.GetHasher().HashInstance();
+        Toolbox::SimplifyDicomAsJson(simplifiedTags, dicom.GetJson(), DicomToJsonFormat_Human);
+      }
 
       // Test if the instance must be filtered out
       bool accepted = true;
@@ -469,17 +746,45 @@ namespace Orthanc
       {
         // Remove the file from the DicomCache (useful if
         // "OverwriteInstances" is set to "true")
-        boost::mutex::scoped_lock lock(dicomCacheMutex_);
         dicomCache_.Invalidate(resultPublicId);
       }
 
       // TODO Should we use "gzip" instead?
       CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
 
-      FileInfo dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
-                                          FileContentType_Dicom, compression, storeMD5_);
-      FileInfo jsonInfo = accessor.Write(dicom.GetJson().toStyledString(), 
-                                         FileContentType_DicomAsJson, compression, storeMD5_);
+      FileInfo dicomInfo, jsonInfo;
+
+      {
+        // The compression and the writing of the DICOM file and of
+        // its JSON summary run concurrently
+        MetricsRegistry::Timer writeTimer(GetMetricsRegistry(), "orthanc_store_write_duration_ms");
+        MetricsRegistry::HistogramTimer writeHistogram(GetMetricsRegistry(), "orthanc_store_latency_ms{step=\"write\"}");
+
+        WriteAttachmentTask dicomTask(area_, storageCache_.get(), GetMetricsRegistry(),
+                                      dicom.GetBufferData(), dicom.GetBufferSize(),
+                                      FileContentType_Dicom, compression, storeMD5_);
+        WriteAttachmentTask jsonTask(area_, storageCache_.get(), GetMetricsRegistry(), dicom.GetJson(),
+                                     binaryDicomAsJson_, FileContentType_DicomAsJson, compression, storeMD5_);
+
+        std::vector<ThreadPool::ITask*> tasks;
+        tasks.push_back(&dicomTask);
+        tasks.push_back(&jsonTask);
+
+        try
+        {
+          ingestThreads_->Execute(tasks);
+        }
+        catch (OrthancException&)
+        {
+          // Don't leave orphan files in the storage area
+          dicomTask.RemoveIfWritten();
+          jsonTask.RemoveIfWritten();
+          throw;
+        }
+
+        dicomInfo = dicomTask.GetInfo();
+        jsonInfo = jsonTask.GetInfo();
+      }
 
       ServerIndex::Attachments attachments;
       attachments.push_back(dicomInfo);
@@ -487,8 +792,13 @@ namespace Orthanc
 
       typedef std::map<MetadataType, std::string>  InstanceMetadata;
       InstanceMetadata  instanceMetadata;
-      StoreStatus status = index_.Store(
-        instanceMetadata, dicom, attachments, overwrite);
+      StoreStatus status;
+
+      {
+        MetricsRegistry::Timer indexTimer(GetMetricsRegistry(), "orthanc_store_index_duration_ms");
+        MetricsRegistry::HistogramTimer indexHistogram(GetMetricsRegistry(), "orthanc_store_latency_ms{step=\"index\"}");
+        status = index_.Store(instanceMetadata, dicom, attachments, overwrite);
+      }
 
       // Only keep the metadata for the "instance" level
       dicom.GetMetadata().clear();
@@ -525,6 +835,11 @@ namespace Orthanc
           break;
       }
 
+      // The listeners might themselves store new instances (e.g. a
+      // plugin that modifies the incoming instances): Release the slot
+      // before calling them, so as to avoid a deadlock
+      ingestLocker.reset(NULL);
+
       if (status == StoreStatus_Success ||
           status == StoreStatus_AlreadyStored)
       {
@@ -570,11 +885,14 @@ namespace Orthanc
     }
     else
     {
-      // Automated transcoding of incoming DICOM files
+      // Automated transcoding of incoming DICOM files. The transfer
+      // syntax is read from the meta header, which avoids parsing the
+      // full DICOM file if no transcoding is needed.
 
+      std::string sourceUid;
       DicomTransferSyntax sourceSyntax;
-      if (!FromDcmtkBridge::LookupOrthancTransferSyntax(
-            sourceSyntax, dicom.GetParsedDicomFile().GetDcmtkObject()) ||
+      if (!dicom.LookupTransferSyntax(sourceUid) ||
+          !LookupTransferSyntax(sourceSyntax, sourceUid) ||
           sourceSyntax == ingestTransferSyntax_)
       {
         // No transcoding
@@ -622,8 +940,21 @@ namespace Orthanc
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    StorageAccessor accessor(area_, GetMetricsRegistry());
-    accessor.AnswerFile(output, attachment, GetFileContentMime(content));
+    StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
+
+    if (content == FileContentType_DicomAsJson)
+    {
+      // Always answer the JSON text, even if the attachment is stored
+      // using the binary format (new in Orthanc 1.7.3)
+      std::string buffer, json;
+      accessor.Read(buffer, attachment);
+      DicomAsJsonCodec::ToJsonText(json, buffer);
+      output.AnswerBuffer(json, MimeType_Json);
+    }
+    else
+    {
+      accessor.AnswerFile(output, attachment, GetFileContentMime(content));
+    }
   }
 
 
@@ -650,7 +981,7 @@ namespace Orthanc
 
     std::string content;
 
-    StorageAccessor accessor(area_, GetMetricsRegistry());
+    StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
     accessor.Read(content, attachment);
 
     FileInfo modified = accessor.Write(content.empty() ? NULL : content.c_str(),
@@ -696,7 +1027,7 @@ namespace Orthanc
       Json::Value summary;
       parsed.DatasetToJson(summary);
 
-      result = summary.toStyledString();
+      SerializeDicomAsJson(result, summary);
 
       if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson,
                          result.c_str(), result.size()))
@@ -708,13 +1039,22 @@ namespace Orthanc
   }
 
 
+  void ServerContext::SerializeDicomAsJson(std::string& target,
+                                           const Json::Value& source) const
+  {
+    SerializeDicomAsJsonInternal(target, source, binaryDicomAsJson_);
+  }
+
+
   void ServerContext::ReadDicomAsJson(std::string& result,
                                       const std::string& instancePublicId,
                                       const std::set<DicomTag>& ignoreTagLength)
   {
     if (ignoreTagLength.empty())
     {
-      ReadDicomAsJsonInternal(result, instancePublicId);
+      std::string tmp;
+      ReadDicomAsJsonInternal(tmp, instancePublicId);
+      DicomAsJsonCodec::ToJsonText(result, tmp);
     }
     else
     {
@@ -733,12 +1073,7 @@ namespace Orthanc
     {
       std::string tmp;
       ReadDicomAsJsonInternal(tmp, instancePublicId);
-
-      Json::Reader reader;
-      if (!reader.parse(tmp, result))
-      {
-        throw OrthancException(ErrorCode_CorruptedFile);
-      }
+      DicomAsJsonCodec::Decode(result, tmp);
     }
     else
     {
@@ -776,7 +1111,7 @@ namespace Orthanc
     {
       // Do not uncompress the content of the storage area, return the
       // raw data
-      StorageAccessor accessor(area_, GetMetricsRegistry());
+      StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
       accessor.ReadRaw(result, attachment);
     }
   }
@@ -786,31 +1121,293 @@ namespace Orthanc
                                      const FileInfo& attachment)
   {
     // This will decompress the attachment
-    StorageAccessor accessor(area_, GetMetricsRegistry());
+    StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
     accessor.Read(result, attachment);
   }
 
 
-  IDynamicObject* ServerContext::DicomCacheProvider::Provide(const std::string& instancePublicId)
+  namespace
   {
-    std::string content;
-    context_.ReadDicom(content, instancePublicId);
-    return new ParsedDicomFile(content);
+    class RawFrameVisitor : public DicomStreamReader::IVisitor
+    {
+    private:
+      DicomTransferSyntax  transferSyntax_;
+      DicomMap             tags_;
+      bool                 isPsmctRle1_;
+      bool                 hasPixelData_;
+      uint64_t             pixelDataOffset_;
+      uint32_t             pixelDataLength_;
+
+      static bool IsUnsignedShort(const DicomTag& tag)
+      {
+        return (tag == DICOM_TAG_ROWS ||
+                tag == DICOM_TAG_COLUMNS ||
+                tag == DICOM_TAG_BITS_ALLOCATED ||
+                tag == DICOM_TAG_BITS_STORED ||
+                tag == DICOM_TAG_HIGH_BIT ||
+                tag == DICOM_TAG_PIXEL_REPRESENTATION ||
+                tag == DICOM_TAG_SAMPLES_PER_PIXEL ||
+                tag == DICOM_TAG_PLANAR_CONFIGURATION);
+      }
+
+      static void StripPadding(std::string& value)
+      {
+        while (!value.empty() &&
+               (value[value.size() - 1] == '\0' ||
+                value[value.size() - 1] == ' '))
+        {
+          value.resize(value.size() - 1);
+        }
+      }
+
+    public:
+      RawFrameVisitor() :
+        transferSyntax_(DicomTransferSyntax_LittleEndianImplicit),
+        isPsmctRle1_(false),
+        hasPixelData_(false),
+        pixelDataOffset_(0),
+        pixelDataLength_(0)
+      {
+      }
+
+      virtual void VisitMetaHeaderTag(const DicomTag& tag,
+                                      ValueRepresentation vr,
+                                      const std::string& value) ORTHANC_OVERRIDE
+      {
+      }
+
+      virtual void VisitTransferSyntax(DicomTransferSyntax transferSyntax) ORTHANC_OVERRIDE
+      {
+        transferSyntax_ = transferSyntax;
+      }
+
+      virtual bool VisitDatasetTag(const DicomTag& tag,
+                                   ValueRepresentation vr,
+                                   const std::string& value,
+                                   bool isLittleEndian) ORTHANC_OVERRIDE
+      {
+        if (IsUnsignedShort(tag))
+        {
+          if (value.size() != 2 ||
+              !isLittleEndian)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          const uint8_t* p = reinterpret_cast<const uint8_t*>(value.c_str());
+          uint16_t v = static_cast<uint16_t>(p[0]) | (static_cast<uint16_t>(p[1]) << 8);
+          tags_.SetValue(tag, boost::lexical_cast<std::string>(v), false);
+        }
+        else if (tag == DICOM_TAG_NUMBER_OF_FRAMES ||
+                 tag == DICOM_TAG_PHOTOMETRIC_INTERPRETATION)
+        {
+          std::string s = value;
+          StripPadding(s);
+          tags_.SetValue(tag, s, false);
+        }
+        else if (tag == DicomTag(0x07a1, 0x1011))  // Compression type of PMSCT_RLE1 images
+        {
+          std::string s = value;
+          StripPadding(s);
+          if (s == "PMSCT_RLE1")
+          {
+            isPsmctRle1_ = true;
+          }
+        }
+
+        return true;
+      }
+
+      virtual void VisitPixelData(uint64_t offset,
+                                  uint32_t length) ORTHANC_OVERRIDE
+      {
+        hasPixelData_ = true;
+        pixelDataOffset_ = offset;
+        pixelDataLength_ = length;
+      }
+
+      bool IsEligible() const
+      {
+        // Only the uncompressed, little endian transfer syntaxes
+        // store the frames as is (on a little endian host)
+        return (hasPixelData_ &&
+                !isPsmctRle1_ &&
+                pixelDataLength_ != 0xffffffffu &&
+                (transferSyntax_ == DicomTransferSyntax_LittleEndianImplicit ||
+                 transferSyntax_ == DicomTransferSyntax_LittleEndianExplicit));
+      }
+
+      const DicomMap& GetTags() const
+      {
+        return tags_;
+      }
+
+      uint64_t GetPixelDataOffset() const
+      {
+        return pixelDataOffset_;
+      }
+
+      uint32_t GetPixelDataLength() const
+      {
+        return pixelDataLength_;
+      }
+    };
+  }
+
+
+  bool ServerContext::ReadRawFrameFromStorage(std::string& frame,
+                                              const std::string& instancePublicId,
+                                              unsigned int frameIndex)
+  {
+    static const uint64_t INITIAL_HEADER_SIZE = 64 * 1024;
+
+    if (Toolbox::DetectEndianness() != Endianness_Little ||
+        !area_.HasReadRange())
+    {
+      return false;
+    }
+
+    FileInfo attachment;
+    if (!index_.LookupAttachment(attachment, instancePublicId, FileContentType_Dicom) ||
+        attachment.GetCompressionType() != CompressionType_None)
+    {
+      return false;
+    }
+
+    StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
+    const uint64_t fileSize = attachment.GetUncompressedSize();
+
+    std::unique_ptr<RawFrameVisitor> visitor;
+
+    try
+    {
+      // Read larger and larger prefixes of the file, until the
+      // beginning of the pixel data is reached
+      uint64_t headerSize = std::min(INITIAL_HEADER_SIZE, fileSize);
+
+      for (;;)
+      {
+        std::string header;
+        accessor.ReadRange(header, attachment, 0, headerSize);
+
+        visitor.reset(new RawFrameVisitor);
+
+        DicomStreamReader reader(header.empty() ? NULL : header.c_str(), header.size());
+        if (reader.Consume(*visitor))
+        {
+          break;
+        }
+        else if (headerSize == fileSize)
+        {
+          return false;  // No pixel data in this instance
+        }
+        else
+        {
+          headerSize = std::min(2 * headerSize, fileSize);
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      LOG(INFO) << "Cannot locate the pixel data without parsing the DICOM file: " << e.What();
+      return false;
+    }
+
+    if (!visitor->IsEligible())
+    {
+      return false;
+    }
+
+    unsigned int countFrames = 1;
+    uint64_t frameSize;
+
+    try
+    {
+      const DicomValue* value = visitor->GetTags().TestAndGetValue(DICOM_TAG_NUMBER_OF_FRAMES);
+      if (value != NULL &&
+          !value->IsNull())
+      {
+        countFrames = boost::lexical_cast<unsigned int>(value->GetContent());
+      }
+
+      frameSize = DicomImageInformation(visitor->GetTags()).GetFrameSize();
+    }
+    catch (OrthancException&)
+    {
+      return false;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;
+    }
+
+    if (countFrames == 0 ||
+        frameSize == 0 ||
+        static_cast<uint64_t>(visitor->GetPixelDataLength()) < frameSize * countFrames ||
+        visitor->GetPixelDataOffset() + visitor->GetPixelDataLength() > fileSize)
+    {
+      return false;  // Let the full parser deal with this unusual image
+    }
+
+    if (frameIndex >= countFrames)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const uint64_t start = visitor->GetPixelDataOffset() + frameIndex * frameSize;
+    accessor.ReadRange(frame, attachment, start, start + frameSize);
+
+    return true;
   }
 
 
   ServerContext::DicomCacheLocker::DicomCacheLocker(ServerContext& that,
-                                                    const std::string& instancePublicId) : 
-    that_(that),
-    lock_(that_.dicomCacheMutex_)
+                                                    const std::string& instancePublicId) :
+    dicom_(NULL)
   {
-#if ENABLE_DICOM_CACHE == 0
-    static std::unique_ptr<IDynamicObject> p;
-    p.reset(that_.provider_.Provide(instancePublicId));
-    dicom_ = dynamic_cast<ParsedDicomFile*>(p.get());
-#else
-    dicom_ = &dynamic_cast<ParsedDicomFile&>(that_.dicomCache_.Access(instancePublicId));
-#endif
+    accessor_.reset(new ParsedDicomCache::Accessor(that.dicomCache_, instancePublicId, true));
+
+    if (accessor_->IsValid())
+    {
+      dicom_ = &accessor_->GetDicom();
+      return;
+    }
+
+    accessor_.reset(NULL);
+
+    // Cache miss: The DICOM file is read and parsed without holding
+    // any lock on the cache, so that other instances can be accessed
+    // in the meantime
+    std::string content;
+    that.ReadDicom(content, instancePublicId);
+
+    std::unique_ptr<ParsedDicomFile> dicom(new ParsedDicomFile(content));
+
+    if (that.dicomCache_.IsCacheable(content.size()))
+    {
+      that.dicomCache_.Acquire(instancePublicId, dicom.release(), content.size());
+      accessor_.reset(new ParsedDicomCache::Accessor(that.dicomCache_, instancePublicId, false));
+    }
+
+    if (accessor_.get() != NULL &&
+        accessor_->IsValid())
+    {
+      dicom_ = &accessor_->GetDicom();
+    }
+    else
+    {
+      // The file is too large to be cached, or it was recycled by
+      // a concurrent thread right after being cached
+      accessor_.reset(NULL);
+
+      if (dicom.get() == NULL)
+      {
+        dicom.reset(new ParsedDicomFile(content));
+      }
+
+      largeDicom_.reset(dicom.release());
+      dicom_ = largeDicom_.get();
+    }
   }
 
 
@@ -836,7 +1433,7 @@ namespace Orthanc
     // TODO Should we use "gzip" instead?
     CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
 
-    StorageAccessor accessor(area_, GetMetricsRegistry());
+    StorageAccessor accessor(area_, storageCache_.get(), GetMetricsRegistry());
     FileInfo attachment = accessor.Write(data, size, attachmentType, compression, storeMD5_);
 
     StoreStatus status = index_.AddAttachment(attachment, resourceId);
@@ -859,7 +1456,6 @@ namespace Orthanc
     if (expectedType == ResourceType_Instance)
     {
       // remove the file from the DicomCache
-      boost::mutex::scoped_lock lock(dicomCacheMutex_);
       dicomCache_.Invalidate(uuid);
     }
 
@@ -870,6 +1466,46 @@ namespace Orthanc
   void ServerContext::SignalChange(const ServerIndexChange& change)
   {
     pendingChanges_.Enqueue(change.Clone());
+
+    boost::mutex::scoped_lock lock(changesMutex_);
+    changesCount_++;
+    changesCondition_.notify_all();
+  }
+
+
+  uint64_t ServerContext::GetChangesCount()
+  {
+    boost::mutex::scoped_lock lock(changesMutex_);
+    return changesCount_;
+  }
+
+
+  bool ServerContext::WaitForChanges(uint64_t count,
+                                     unsigned int timeout)
+  {
+    const boost::system_time deadline =
+      boost::get_system_time() + boost::posix_time::milliseconds(timeout);
+
+    boost::mutex::scoped_lock lock(changesMutex_);
+
+    while (changesCount_ == count &&
+           !isChangesWaitAborted_)
+    {
+      if (!changesCondition_.timed_wait(lock, deadline))
+      {
+        return (changesCount_ != count);
+      }
+    }
+
+    return (changesCount_ != count);
+  }
+
+
+  void ServerContext::AbortWaitForChanges()
+  {
+    boost::mutex::scoped_lock lock(changesMutex_);
+    isChangesWaitAborted_ = true;
+    changesCondition_.notify_all();
   }
 
 
@@ -936,81 +1572,53 @@ namespace Orthanc
   }
 
 
-  void ServerContext::Apply(ILookupVisitor& visitor,
-                            const DatabaseLookup& lookup,
-                            ResourceType queryLevel,
-                            size_t since,
-                            size_t limit)
+  class ServerContext::LookupCandidate : public ThreadPool::ITask
   {
-    unsigned int databaseLimit = (queryLevel == ResourceType_Instance ?
-                                  limitFindInstances_ : limitFindResults_);
-      
-    std::vector<std::string> resources, instances;
-
-    {
-      const size_t lookupLimit = (databaseLimit == 0 ? 0 : databaseLimit + 1);      
-      GetIndex().ApplyLookupResources(resources, &instances, lookup, queryLevel, lookupLimit);
-    }
-
-    bool complete = (databaseLimit == 0 ||
-                     resources.size() <= databaseLimit);
-
-    LOG(INFO) << "Number of candidate resources after fast DB filtering on main DICOM tags: " << resources.size();
-
-    /**
-     * "resources" contains the Orthanc ID of the resource at level
-     * "queryLevel", "instances" contains one the Orthanc ID of one
-     * sample instance from this resource.
-     **/
-    assert(resources.size() == instances.size());
-
-    size_t countResults = 0;
-    size_t skipped = 0;
-
-    const bool isDicomAsJsonNeeded = visitor.IsDicomAsJsonNeeded();
-    
-    for (size_t i = 0; i < instances.size(); i++)
+  private:
+    ServerContext&                context_;
+    const std::string&            instanceId_;
+    ResourceType                  queryLevel_;
+    bool                          isDatabaseOnly_;
+    const std::set<DicomTag>&     extractedTags_;      // Only in Case (2)
+    bool                          hasTags_;
+    bool                          isRemoved_;
+    DicomMap                      tags_;
+    std::string                   dicomAsJsonBuffer_;  // Only in Case (2)
+    std::unique_ptr<Json::Value>  dicomAsJson_;
+
+    void LoadTags()
     {
-      // Optimization in Orthanc 1.5.1 - Don't read the full JSON from
-      // the disk if only "main DICOM tags" are to be returned
-
-      std::unique_ptr<Json::Value> dicomAsJson;
-
-      bool hasOnlyMainDicomTags;
-      DicomMap dicom;
-      
-      if (findStorageAccessMode_ == FindStorageAccessMode_DatabaseOnly ||
-          findStorageAccessMode_ == FindStorageAccessMode_DiskOnAnswer ||
-          lookup.HasOnlyMainDicomTags())
+      if (isDatabaseOnly_)
       {
         // Case (1): The main DICOM tags, as stored in the database,
         // are sufficient to look for match
 
         DicomMap tmp;
-        if (!GetIndex().GetAllMainDicomTags(tmp, instances[i]))
+        if (!context_.GetIndex().GetAllMainDicomTags(tmp, instanceId_))
         {
           // The instance has been removed during the execution of the
           // lookup, ignore it
-          continue;
+          isRemoved_ = true;
+          return;
         }
 
 #if 1
         // New in Orthanc 1.6.0: Only keep the main DICOM tags at the
         // level of interest for the query
-        switch (queryLevel)
+        switch (queryLevel_)
         {
           // WARNING: Don't reorder cases below, and don't add "break"
           case ResourceType_Instance:
-            dicom.MergeMainDicomTags(tmp, ResourceType_Instance);
+            tags_.MergeMainDicomTags(tmp, ResourceType_Instance);
 
           case ResourceType_Series:
-            dicom.MergeMainDicomTags(tmp, ResourceType_Series);
+            tags_.MergeMainDicomTags(tmp, ResourceType_Series);
 
           case ResourceType_Study:
-            dicom.MergeMainDicomTags(tmp, ResourceType_Study);
+            tags_.MergeMainDicomTags(tmp, ResourceType_Study);
             
           case ResourceType_Patient:
-            dicom.MergeMainDicomTags(tmp, ResourceType_Patient);
+            tags_.MergeMainDicomTags(tmp, ResourceType_Patient);
             break;
 
           default:
@@ -1020,69 +1628,237 @@ namespace Orthanc
         // Special case of the "Modality" at the study level, in order
         // to deal with C-FIND on "ModalitiesInStudy" (0008,0061).
         // Check out integration test "test_rest_modalities_in_study".
-        if (queryLevel == ResourceType_Study)
+        if (queryLevel_ == ResourceType_Study)
         {
-          dicom.CopyTagIfExists(tmp, DICOM_TAG_MODALITY);
+          tags_.CopyTagIfExists(tmp, DICOM_TAG_MODALITY);
         }
 #else
-        dicom.Assign(tmp);  // This emulates Orthanc <= 1.5.8
+        tags_.Assign(tmp);  // This emulates Orthanc <= 1.5.8
 #endif
-        
-        hasOnlyMainDicomTags = true;
       }
       else
       {
         // Case (2): Need to read the "DICOM-as-JSON" attachment from
-        // the storage area
-        dicomAsJson.reset(new Json::Value);
-        ReadDicomAsJson(*dicomAsJson, instances[i]);
+        // the storage area. New in Orthanc 1.7.3: Only the tags that
+        // are needed for the matching and the answers are looked up
+        // in the attachment, which is only fully decoded if the
+        // instance is part of the answers.
+        context_.ReadDicomAsJsonInternal(dicomAsJsonBuffer_, instanceId_);
+        DicomAsJsonCodec::ExtractDicomMap(tags_, dicomAsJsonBuffer_, extractedTags_);
+      }
+    }
+
+    void LoadDicomAsJson()
+    {
+      dicomAsJson_.reset(new Json::Value);
+
+      if (isDatabaseOnly_)
+      {
+        context_.ReadDicomAsJson(*dicomAsJson_, instanceId_);
+      }
+      else
+      {
+        DicomAsJsonCodec::Decode(*dicomAsJson_, dicomAsJsonBuffer_);
+      }
+    }
 
-        dicom.FromDicomAsJson(*dicomAsJson);
+  public:
+    LookupCandidate(ServerContext& context,
+                    const std::string& instanceId,
+                    ResourceType queryLevel,
+                    bool isDatabaseOnly,
+                    const std::set<DicomTag>& extractedTags) :
+      context_(context),
+      instanceId_(instanceId),
+      queryLevel_(queryLevel),
+      isDatabaseOnly_(isDatabaseOnly),
+      extractedTags_(extractedTags),
+      hasTags_(false),
+      isRemoved_(false)
+    {
+    }
 
-        // This map contains the entire JSON, i.e. more than the main DICOM tags
-        hasOnlyMainDicomTags = false;   
+    // The first execution loads the tags that are used to look for
+    // match, the second one loads the "DICOM-as-JSON" summary
+    virtual void Execute() ORTHANC_OVERRIDE
+    {
+      if (hasTags_)
+      {
+        LoadDicomAsJson();
+      }
+      else
+      {
+        LoadTags();
+        hasTags_ = true;
       }
+    }
+
+    bool IsRemoved() const
+    {
+      return isRemoved_;
+    }
+
+    const DicomMap& GetTags() const
+    {
+      return tags_;
+    }
+
+    // Can be NULL
+    const Json::Value* GetDicomAsJson() const
+    {
+      return dicomAsJson_.get();
+    }
+  };
+
+
+  void ServerContext::Apply(ILookupVisitor& visitor,
+                            const DatabaseLookup& lookup,
+                            ResourceType queryLevel,
+                            size_t since,
+                            size_t limit)
+  {
+    unsigned int databaseLimit = (queryLevel == ResourceType_Instance ?
+                                  limitFindInstances_ : limitFindResults_);
       
-      if (lookup.IsMatch(dicom))
+    std::vector<std::string> resources, instances;
+
+    {
+      const size_t lookupLimit = (databaseLimit == 0 ? 0 : databaseLimit + 1);      
+      GetIndex().ApplyLookupResources(resources, &instances, lookup, queryLevel, lookupLimit);
+    }
+
+    bool complete = (databaseLimit == 0 ||
+                     resources.size() <= databaseLimit);
+
+    LOG(INFO) << "Number of candidate resources after fast DB filtering on main DICOM tags: " << resources.size();
+
+    /**
+     * "resources" contains the Orthanc ID of the resource at level
+     * "queryLevel", "instances" contains one the Orthanc ID of one
+     * sample instance from this resource.
+     **/
+    assert(resources.size() == instances.size());
+
+    size_t countResults = 0;
+    size_t skipped = 0;
+
+    const bool isDicomAsJsonNeeded = visitor.IsDicomAsJsonNeeded();
+
+    // Optimization in Orthanc 1.5.1 - Don't read the full JSON from
+    // the disk if only "main DICOM tags" are to be returned
+    const bool isDatabaseOnly = (findStorageAccessMode_ == FindStorageAccessMode_DatabaseOnly ||
+                                 findStorageAccessMode_ == FindStorageAccessMode_DiskOnAnswer ||
+                                 lookup.HasOnlyMainDicomTags());
+
+    const bool isDicomAsJsonLoadedOnAnswer = (isDicomAsJsonNeeded &&
+                                              (!isDatabaseOnly ||
+                                               findStorageAccessMode_ == FindStorageAccessMode_DiskOnLookupAndAnswer ||
+                                               findStorageAccessMode_ == FindStorageAccessMode_DiskOnAnswer));
+
+    // In Case (2), the tags to be read from the "DICOM-as-JSON"
+    // attachments: Those of the constraints, and the main DICOM tags
+    // that are given to the visitor
+    std::set<DicomTag> extractedTags;
+    if (!isDatabaseOnly)
+    {
+      DicomMap::GetMainDicomTags(extractedTags);
+
+      for (size_t i = 0; i < lookup.GetConstraintsCount(); i++)
       {
-        if (skipped < since)
-        {
-          skipped++;
-        }
-        else if (limit != 0 &&
-                 countResults >= limit)
-        {
-          // Too many results, don't mark as complete
-          complete = false;
-          break;
-        }
-        else
+        extractedTags.insert(lookup.GetConstraint(i).GetTag());
+      }
+    }
+
+    /**
+     * New in Orthanc 1.7.3: The candidates are processed by batches,
+     * whose tags are loaded in parallel by "findThreads_". The
+     * matching and the calls to the visitor are sequential, in the
+     * order of the candidates. The size of the batches bounds the
+     * number of useless reads once "limit" is reached.
+     **/
+    const size_t batchSize = 4 * (findThreads_->GetWorkersCount() + 1);
+
+    bool stop = false;
+
+    for (size_t batchStart = 0; batchStart < instances.size() && !stop; batchStart += batchSize)
+    {
+      const size_t batchEnd = std::min(batchStart + batchSize, instances.size());
+
+      std::vector< boost::shared_ptr<LookupCandidate> > candidates;
+      candidates.reserve(batchEnd - batchStart);
+
+      std::vector<ThreadPool::ITask*> tasks;
+      tasks.reserve(batchEnd - batchStart);
+
+      for (size_t i = batchStart; i < batchEnd; i++)
+      {
+        candidates.push_back(boost::shared_ptr<LookupCandidate>(
+                               new LookupCandidate(*this, instances[i], queryLevel, isDatabaseOnly, extractedTags)));
+        tasks.push_back(candidates.back().get());
+      }
+
+      findThreads_->Execute(tasks);
+
+      // Indices of the candidates that are part of the answers
+      std::vector<size_t> answers;
+      answers.reserve(candidates.size());
+      
+      for (size_t i = 0; i < candidates.size(); i++)
+      {
+        if (!candidates[i]->IsRemoved() &&
+            lookup.IsMatch(candidates[i]->GetTags()))
         {
-          if ((findStorageAccessMode_ == FindStorageAccessMode_DiskOnLookupAndAnswer ||
-               findStorageAccessMode_ == FindStorageAccessMode_DiskOnAnswer) &&
-              dicomAsJson.get() == NULL &&
-              isDicomAsJsonNeeded)
+          if (skipped < since)
           {
-            dicomAsJson.reset(new Json::Value);
-            ReadDicomAsJson(*dicomAsJson, instances[i]);
+            skipped++;
           }
-
-          if (hasOnlyMainDicomTags)
+          else if (limit != 0 &&
+                   countResults >= limit)
           {
-            // This is Case (1): The variable "dicom" only contains the main DICOM tags
-            visitor.Visit(resources[i], instances[i], dicom, dicomAsJson.get());
+            // Too many results, don't mark as complete
+            complete = false;
+            stop = true;
+            break;
           }
           else
           {
-            // Remove the non-main DICOM tags from "dicom" if Case (2)
-            // was used, for consistency with Case (1)
-
-            DicomMap mainDicomTags;
-            mainDicomTags.ExtractMainDicomTags(dicom);
-            visitor.Visit(resources[i], instances[i], mainDicomTags, dicomAsJson.get());            
+            answers.push_back(i);
+            countResults ++;
           }
-            
-          countResults ++;
+        }
+      }
+
+      if (isDicomAsJsonLoadedOnAnswer)
+      {
+        // The second execution of the candidates loads the
+        // "DICOM-as-JSON" summary of the answers
+        tasks.clear();
+        for (size_t i = 0; i < answers.size(); i++)
+        {
+          tasks.push_back(candidates[answers[i]].get());
+        }
+
+        findThreads_->Execute(tasks);
+      }
+
+      for (size_t i = 0; i < answers.size(); i++)
+      {
+        const size_t index = batchStart + answers[i];
+        const LookupCandidate& candidate = *candidates[answers[i]];
+
+        if (isDatabaseOnly)
+        {
+          // This is Case (1): The tags only contain the main DICOM tags
+          visitor.Visit(resources[index], instances[index], candidate.GetTags(), candidate.GetDicomAsJson());
+        }
+        else
+        {
+          // Remove the non-main DICOM tags if Case (2) was used, for
+          // consistency with Case (1)
+
+          DicomMap mainDicomTags;
+          mainDicomTags.ExtractMainDicomTags(candidate.GetTags());
+          visitor.Visit(resources[index], instances[index], mainDicomTags, candidate.GetDicomAsJson());
         }
       }
     }
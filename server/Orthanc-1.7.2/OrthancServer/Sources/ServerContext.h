@@ -36,10 +36,11 @@
 #include "IServerListener.h"
 #include "LuaScripting.h"
 #include "OrthancHttpHandler.h"
+#include "ParsedDicomCache.h"
 #include "ServerIndex.h"
 #include "ServerJobs/IStorageCommitmentFactory.h"
 
-#include "../../OrthancFramework/Sources/Cache/MemoryCache.h"
+#include "../../OrthancFramework/Sources/Cache/MemoryStringCache.h"
 #include "../../OrthancFramework/Sources/DicomParsing/IDicomTranscoder.h"
 
 
@@ -52,10 +53,12 @@ namespace Orthanc
   class OrthancPlugins;
   class ParsedDicomFile;
   class RestApiOutput;
+  class Semaphore;
   class SetOfInstancesJob;
   class SharedArchive;
   class SharedMessageQueue;
   class StorageCommitmentReports;
+  class ThreadPool;
   
   
   /**
@@ -114,23 +117,11 @@ namespace Orthanc
       virtual bool FilterIncomingInstance(const DicomInstanceToStore& instance,
                                           const Json::Value& simplified)
       {
-        return context_.filterLua_.FilterIncomingInstance(instance, simplified);
+        LuaFilterLock lock(context_);
+        return lock.GetLuaScripting().FilterIncomingInstance(instance, simplified);
       }
     };
     
-    class DicomCacheProvider : public Deprecated::ICachePageProvider  // TODO
-    {
-    private:
-      ServerContext& context_;
-
-    public:
-      DicomCacheProvider(ServerContext& context) : context_(context)
-      {
-      }
-      
-      virtual IDynamicObject* Provide(const std::string& id);
-    };
-
     class ServerListener
     {
     private:
@@ -165,6 +156,9 @@ namespace Orthanc
     static void SaveJobsThread(ServerContext* that,
                                unsigned int sleepDelay);
 
+    // Candidate resource of a lookup, whose tags are loaded by "findThreads_"
+    class LookupCandidate;
+
     void ReadDicomAsJsonInternal(std::string& result,
                                  const std::string& instancePublicId);
 
@@ -182,13 +176,38 @@ namespace Orthanc
     bool compressionEnabled_;
     bool storeMD5_;
     
-    DicomCacheProvider provider_;
-    boost::mutex dicomCacheMutex_;
-    Deprecated::MemoryCache dicomCache_;  // TODO
+    ParsedDicomCache dicomCache_;
+
+    // Cache of the uncompressed content of the attachments, indexed
+    // by their UUID (NULL if disabled)
+    std::unique_ptr<MemoryStringCache> storageCache_;
+
+    // Threads that compress and write the attachments of the incoming
+    // instances, and bound on the number of instances that are
+    // simultaneously ingested (NULL if no bound)
+    std::unique_ptr<ThreadPool>  ingestThreads_;
+    std::unique_ptr<Semaphore>   ingestSemaphore_;
+
+    // Whether the "DICOM-as-JSON" attachments are written using the
+    // compact binary format of "DicomAsJsonCodec"
+    bool binaryDicomAsJson_;
 
     LuaScripting mainLua_;
-    LuaScripting filterLua_;
     LuaServerListener  luaListener_;
+
+    // Interpreter of the pool that is borrowed by each thread, with
+    // the number of nested "LuaFilterLock" objects in this thread
+    typedef std::map<boost::thread::id, std::pair<LuaScripting*, unsigned int> >  FilterLuaOwners;
+
+    // Pool of Lua interpreters that are loaded with the same scripts
+    // as "mainLua_", and that evaluate the filters of the incoming
+    // instances and HTTP requests concurrently
+    std::vector<LuaScripting*>  filterLua_;
+    std::vector<LuaScripting*>  availableFilterLua_;
+    boost::mutex                filterLuaMutex_;
+    FilterLuaOwners             filterLuaOwners_;
+    boost::condition_variable   filterLuaAvailable_;
+
     std::unique_ptr<SharedArchive>  mediaArchive_;
     
     // The "JobsEngine" must be *after* "LuaScripting", as
@@ -209,6 +228,12 @@ namespace Orthanc
     bool haveJobsChanged_;
     bool isJobsEngineUnserialized_;
     SharedMessageQueue  pendingChanges_;
+
+    // Wakes up the clients that are waiting for changes (long polling)
+    boost::mutex               changesMutex_;
+    boost::condition_variable  changesCondition_;
+    uint64_t                   changesCount_;
+    bool                       isChangesWaitAborted_;
     boost::thread  changeThread_;
     boost::thread  saveJobsThread_;
         
@@ -220,6 +245,18 @@ namespace Orthanc
     unsigned int limitFindInstances_;
     unsigned int limitFindResults_;
 
+    // Threads that load the tags of the candidate resources of the
+    // lookups (C-FIND and "/tools/find") - New in Orthanc 1.7.3
+    std::unique_ptr<ThreadPool>  findThreads_;
+
+    // Threads that store the entries of the ZIP archives uploaded
+    // through the REST API - New in Orthanc 1.7.3
+    std::unique_ptr<ThreadPool>  zipUploadThreads_;
+
+    // Compression level (between 0 and 9) of the ZIP archives that
+    // are created through the REST API - New in Orthanc 1.7.3
+    uint8_t  zipCompressionLevel_;
+
     std::unique_ptr<MetricsRegistry>  metricsRegistry_;
     bool isHttpServerSecure_;
     bool isExecuteLuaEnabled_;
@@ -238,12 +275,39 @@ namespace Orthanc
                                       StoreInstanceMode mode);
 
   public:
+    /**
+     * Borrows one interpreter of the pool of the filters. A filter
+     * can re-enter Orthanc (e.g. "RestApiPost('/instances', ...)"
+     * inside "ReceivedInstanceFilter()"): A nested lock in the same
+     * thread gets back the interpreter that is already borrowed by
+     * this thread, instead of waiting for the pool (which would
+     * deadlock if the pool only contains one interpreter). This is
+     * the same re-entrant behavior as the recursive mutex of
+     * "LuaScripting".
+     **/
+    class LuaFilterLock : public boost::noncopyable
+    {
+    private:
+      ServerContext&  that_;
+      LuaScripting*   lua_;
+
+    public:
+      explicit LuaFilterLock(ServerContext& that);
+
+      ~LuaFilterLock();
+
+      LuaScripting& GetLuaScripting()
+      {
+        return *lua_;
+      }
+    };
+
     class DicomCacheLocker : public boost::noncopyable
     {
     private:
-      ServerContext& that_;
-      ParsedDicomFile *dicom_;
-      boost::mutex::scoped_lock lock_;
+      std::unique_ptr<ParsedDicomCache::Accessor>  accessor_;
+      std::unique_ptr<ParsedDicomFile>             largeDicom_;  // Too large to be cached
+      ParsedDicomFile                             *dicom_;
 
     public:
       DicomCacheLocker(ServerContext& that,
@@ -279,6 +343,26 @@ namespace Orthanc
       return compressionEnabled_;
     }
 
+    // Not thread-safe, must be called before the first lookup
+    void SetFindThreadsCount(unsigned int count);
+
+    ThreadPool& GetZipUploadThreads()
+    {
+      return *zipUploadThreads_;
+    }
+
+    // Not thread-safe, must be called before the first upload
+    void SetZipUploadThreadsCount(unsigned int count);
+
+    uint8_t GetZipCompressionLevel() const
+    {
+      return zipCompressionLevel_;
+    }
+
+    // Not thread-safe, must be called before the first store (zero
+    // means no bound)
+    void SetMaximumConcurrentIngests(unsigned int count);
+
     void RemoveFile(const std::string& fileUuid,
                     FileContentType type);
 
@@ -299,6 +383,10 @@ namespace Orthanc
                                      FileContentType attachmentType,
                                      CompressionType compression);
 
+    // Serializes a "DICOM-as-JSON" summary to be stored as an attachment
+    void SerializeDicomAsJson(std::string& target,
+                              const Json::Value& source) const;
+
     void ReadDicomAsJson(std::string& result,
                          const std::string& instancePublicId,
                          const std::set<DicomTag>& ignoreTagLength);
@@ -327,7 +415,6 @@ namespace Orthanc
       ReadAttachment(dicom, instancePublicId, FileContentType_Dicom, true);
     }
     
-    // TODO CACHING MECHANISM AT THIS POINT
     void ReadAttachment(std::string& result,
                         const std::string& instancePublicId,
                         FileContentType content,
@@ -336,6 +423,14 @@ namespace Orthanc
     void ReadAttachment(std::string& result,
                         const FileInfo& attachment);
 
+    // Fast path to extract one frame of an uncompressed image, by
+    // only reading the DICOM header and the frame from the storage
+    // area. Returns "false" if the instance is not eligible (in which
+    // case, the full DICOM file must be parsed).
+    bool ReadRawFrameFromStorage(std::string& frame,
+                                 const std::string& instancePublicId,
+                                 unsigned int frameIndex);
+
     void SetStoreMD5ForAttachments(bool storeMD5);
 
     bool IsStoreMD5ForAttachments() const
@@ -354,6 +449,21 @@ namespace Orthanc
 
     void SignalChange(const ServerIndexChange& change);
 
+    // Number of changes that have been signaled since the startup. To
+    // be given to "WaitForChanges()" *before* reading the changes
+    // from the index, in order to avoid missing a change.
+    uint64_t GetChangesCount();
+
+    // Waits for at most "timeout" milliseconds until some change is
+    // signaled after "GetChangesCount()" has returned "count".
+    // Returns "false" in the case of a timeout.
+    bool WaitForChanges(uint64_t count,
+                        unsigned int timeout);
+
+    // Wakes up all the waiting threads, and disables further waits
+    // (invoked when Orthanc is stopping)
+    void AbortWaitForChanges();
+
     SharedArchive& GetQueryRetrieveArchive()
     {
       return *queryRetrieveArchive_;
@@ -374,6 +484,23 @@ namespace Orthanc
       return mainLua_;
     }
 
+    size_t GetLuaFilterInterpretersCount() const
+    {
+      return filterLua_.size();
+    }
+
+    // If "false", the interpreters behave as in Orthanc <= 1.7.2: The
+    // HTTP filter is evaluated by the main interpreter, and
+    // "ReceivedInstanceFilter()" by one separate interpreter
+    bool IsLuaFilterPoolEnabled() const
+    {
+      return filterLua_.size() > 1;
+    }
+
+    // Executes a callback such as "Initialize()" or "Finalize()" in
+    // each interpreter of the pool, if the pool is enabled
+    void ExecuteLuaFilterCallback(const std::string& command);
+
     OrthancHttpHandler& GetHttpHandler()
     {
       return httpHandler_;
@@ -415,6 +542,11 @@ namespace Orthanc
 
     void SignalUpdatedPeers();
 
+    ParsedDicomCache& GetDicomCache()
+    {
+      return dicomCache_;
+    }
+
     MetricsRegistry& GetMetricsRegistry()
     {
       return *metricsRegistry_;
@@ -287,6 +287,112 @@ namespace Orthanc
   };
 
 
+  class ServerIndex::StoreRequest : public boost::noncopyable
+  {
+  private:
+    struct UnstableResource
+    {
+      int64_t       id_;
+      ResourceType  type_;
+      std::string   publicId_;
+    };
+
+    std::map<MetadataType, std::string>&  instanceMetadata_;
+    DicomInstanceToStore&                 instance_;
+    const Attachments&                    attachments_;
+    bool                                  overwrite_;
+    bool                                  done_;
+    StoreStatus                           status_;
+
+    // Parent resources that are only marked as unstable once the
+    // transaction is committed, as the transaction of a group of
+    // instances can be rolled back
+    std::vector<UnstableResource>         unstableResources_;
+
+  public:
+    StoreRequest(std::map<MetadataType, std::string>& instanceMetadata,
+                 DicomInstanceToStore& instance,
+                 const Attachments& attachments,
+                 bool overwrite) :
+      instanceMetadata_(instanceMetadata),
+      instance_(instance),
+      attachments_(attachments),
+      overwrite_(overwrite),
+      done_(false),
+      status_(StoreStatus_Failure)
+    {
+    }
+
+    std::map<MetadataType, std::string>& GetInstanceMetadata() const
+    {
+      return instanceMetadata_;
+    }
+
+    DicomInstanceToStore& GetInstance() const
+    {
+      return instance_;
+    }
+
+    const Attachments& GetAttachments() const
+    {
+      return attachments_;
+    }
+
+    bool IsOverwrite() const
+    {
+      return overwrite_;
+    }
+
+    bool IsDone() const
+    {
+      return done_;
+    }
+
+    void SetDone()
+    {
+      done_ = true;
+    }
+
+    StoreStatus GetStatus() const
+    {
+      return status_;
+    }
+
+    void SetStatus(StoreStatus status)
+    {
+      status_ = status;
+    }
+
+    void AddUnstableResource(int64_t id,
+                             ResourceType type,
+                             const std::string& publicId)
+    {
+      UnstableResource resource;
+      resource.id_ = id;
+      resource.type_ = type;
+      resource.publicId_ = publicId;
+      unstableResources_.push_back(resource);
+    }
+
+    void ClearUnstableResources()
+    {
+      unstableResources_.clear();
+    }
+
+    // To be called once the transaction is committed
+    void CommitUnstableResources(ServerIndex& index)
+    {
+      for (size_t i = 0; i < unstableResources_.size(); i++)
+      {
+        index.MarkAsUnstable(unstableResources_[i].id_, unstableResources_[i].type_,
+                             unstableResources_[i].publicId_);
+      }
+
+      unstableResources_.clear();
+    }
+  };
+
+
   class ServerIndex::UnstableResourcePayload
   {
   private:
@@ -435,7 +541,7 @@ namespace Orthanc
                                    const std::string& uuid,
                                    ResourceType expectedType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
 
     Transaction t(*this);
 
@@ -478,7 +584,7 @@ namespace Orthanc
 
     try
     {
-      boost::mutex::scoped_lock lock(that->mutex_);
+      WriterLock lock(that->mutex_);
       std::string sleepString;
 
       if (that->db_.LookupGlobalProperty(sleepString, GlobalProperty_FlushSleep) &&
@@ -506,7 +612,7 @@ namespace Orthanc
 
       Logging::Flush();
 
-      boost::mutex::scoped_lock lock(that->mutex_);
+      WriterLock lock(that->mutex_);
 
       try
       {
@@ -674,11 +780,16 @@ namespace Orthanc
     db_(db),
     maximumStorageSize_(0),
     maximumPatients_(0),
-    mainDicomTagsRegistry_(new MainDicomTagsRegistry)
+    mainDicomTagsRegistry_(new MainDicomTagsRegistry),
+    hasStoreLeader_(false),
+    groupCommitSize_(1),
+    groupCommitDelay_(0)
   {
     listener_.reset(new Listener(context));
     db_.SetListener(*listener_);
 
+    UpgradePersonNameIdentifiers();
+
     // Initial recycling if the parameters have changed since the last
     // execution of Orthanc
     StandaloneRecycling();
@@ -749,12 +860,17 @@ namespace Orthanc
   }
 
   
-  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
-                                 DicomInstanceToStore& instanceToStore,
-                                 const Attachments& attachments,
-                                 bool overwrite)
+  StoreStatus ServerIndex::StoreInternal(uint64_t& instanceSize,
+                                         StoreRequest& request)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    // WARNING: "mutex_" must be exclusively locked, and a transaction
+    // must be active. Throws an exception in the case of an error.
+
+    std::map<MetadataType, std::string>& instanceMetadata = request.GetInstanceMetadata();
+    DicomInstanceToStore& instanceToStore = request.GetInstance();
+    const Attachments& attachments = request.GetAttachments();
+
+    instanceSize = 0;
 
     const DicomMap& dicomSummary = instanceToStore.GetSummary();
     const ServerIndex::MetadataMap& metadata = instanceToStore.GetMetadata();
@@ -770,10 +886,7 @@ namespace Orthanc
     const std::string hashSeries = instanceToStore.GetHasher().HashSeries();
     const std::string hashInstance = instanceToStore.GetHasher().HashInstance();
 
-    try
     {
-      Transaction t(*this);
-
       IDatabaseWrapper::CreateInstanceResult status;
       int64_t instanceId;
 
@@ -783,7 +896,7 @@ namespace Orthanc
       {
         // The instance already exists
         
-        if (overwrite)
+        if (request.IsOverwrite())
         {
           // Overwrite the old instance
           LOG(INFO) << "Overwriting instance: " << hashInstance;
@@ -832,7 +945,6 @@ namespace Orthanc
       
       
       // Ensure there is enough room in the storage for the new instance
-      uint64_t instanceSize = 0;
       for (Attachments::const_iterator it = attachments.begin();
            it != attachments.end(); ++it)
       {
@@ -998,21 +1110,234 @@ namespace Orthanc
       }
       
 
-      // Mark the parent resources of this instance as unstable
-      MarkAsUnstable(status.seriesId_, ResourceType_Series, hashSeries);
-      MarkAsUnstable(status.studyId_, ResourceType_Study, hashStudy);
-      MarkAsUnstable(status.patientId_, ResourceType_Patient, hashPatient);
+      // Mark the parent resources of this instance as unstable (the
+      // changes are logged within the transaction)
+      LogChange(status.seriesId_, ChangeType_NewChildInstance, ResourceType_Series, hashSeries);
+      LogChange(status.studyId_, ChangeType_NewChildInstance, ResourceType_Study, hashStudy);
+      LogChange(status.patientId_, ChangeType_NewChildInstance, ResourceType_Patient, hashPatient);
 
-      t.Commit(instanceSize);
+      request.AddUnstableResource(status.seriesId_, ResourceType_Series, hashSeries);
+      request.AddUnstableResource(status.studyId_, ResourceType_Study, hashStudy);
+      request.AddUnstableResource(status.patientId_, ResourceType_Patient, hashPatient);
 
       return StoreStatus_Success;
     }
-    catch (OrthancException& e)
+  }
+
+
+  void ServerIndex::StoreBatch(const std::vector<StoreRequest*>& batch)
+  {
+    // WARNING: "mutex_" must be exclusively locked. This method never
+    // throws, the outcome is stored in each request.
+
+    if (batch.size() > 1)
     {
-      LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+      try
+      {
+        Transaction t(*this);
+
+        uint64_t totalSize = 0;
+        std::vector<StoreStatus> statuses(batch.size());
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+          uint64_t instanceSize;
+          statuses[i] = StoreInternal(instanceSize, *batch[i]);
+          totalSize += instanceSize;
+        }
+
+        t.Commit(totalSize);
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+          batch[i]->SetStatus(statuses[i]);
+          batch[i]->CommitUnstableResources(*this);
+        }
+
+        return;
+      }
+      catch (OrthancException& e)
+      {
+        LOG(INFO) << "Cannot store a group of " << batch.size() << " instances in a single "
+                  << "transaction, storing them one by one: " << e.What();
+      }
+      catch (std::exception& e)
+      {
+        LOG(INFO) << "Cannot store a group of " << batch.size() << " instances in a single "
+                  << "transaction, storing them one by one: " << e.what();
+      }
+      catch (...)
+      {
+        LOG(INFO) << "Cannot store a group of " << batch.size() << " instances in a single "
+                  << "transaction, storing them one by one";
+      }
+
+      // The transaction was rolled back: Forget about the parent
+      // resources of the instances that were stored in this group
+      for (size_t i = 0; i < batch.size(); i++)
+      {
+        batch[i]->ClearUnstableResources();
+      }
+    }
+
+    // Either a single instance, or the transaction for the whole
+    // group has been rolled back: One transaction per instance, so
+    // that an error only impacts the faulty instance
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      batch[i]->SetStatus(StoreStatus_Failure);
+
+      try
+      {
+        Transaction t(*this);
+
+        uint64_t instanceSize;
+        StoreStatus status = StoreInternal(instanceSize, *batch[i]);
+        t.Commit(instanceSize);
+
+        batch[i]->SetStatus(status);
+        batch[i]->CommitUnstableResources(*this);
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+      }
+      catch (std::exception& e)
+      {
+        LOG(ERROR) << "EXCEPTION [" << e.what() << "]";
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Native exception while storing an instance";
+      }
+
+      batch[i]->ClearUnstableResources();
+    }
+  }
+
+
+  void ServerIndex::SetGroupCommit(unsigned int maxInstances,
+                                   unsigned int delay)
+  {
+    if (maxInstances == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(storeMutex_);
+    groupCommitSize_ = maxInstances;
+    groupCommitDelay_ = delay;
+
+    if (maxInstances == 1)
+    {
+      LOG(INFO) << "Each instance is stored in the database within its own transaction";
+    }
+    else
+    {
+      LOG(INFO) << "Up to " << maxInstances << " instances are stored in the database within "
+                << "the same transaction (group commit, delay: " << delay << "ms)";
+    }
+  }
+
+
+  void ServerIndex::ReleaseStoreLeadership(const std::vector<StoreRequest*>& batch)
+  {
+    // WARNING: "storeMutex_" must be locked
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      batch[i]->SetDone();
+    }
+
+    hasStoreLeader_ = false;
+    storeCondition_.notify_all();
+  }
+
+
+  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
+                                 DicomInstanceToStore& instanceToStore,
+                                 const Attachments& attachments,
+                                 bool overwrite)
+  {
+    StoreRequest request(instanceMetadata, instanceToStore, attachments, overwrite);
+
+    {
+      boost::mutex::scoped_lock lock(storeMutex_);
+      pendingStores_.push_back(&request);
+      storeCondition_.notify_all();
     }
 
-    return StoreStatus_Failure;
+    for (;;)
+    {
+      {
+        boost::mutex::scoped_lock lock(storeMutex_);
+
+        while (!request.IsDone() &&
+               hasStoreLeader_)
+        {
+          storeCondition_.wait(lock);
+        }
+
+        if (request.IsDone())
+        {
+          // Another thread has stored this instance on our behalf
+          return request.GetStatus();
+        }
+
+        // This thread becomes the leader that stores the next batch
+        hasStoreLeader_ = true;
+
+        if (groupCommitDelay_ != 0)
+        {
+          const boost::system_time timeout =
+            boost::get_system_time() + boost::posix_time::milliseconds(groupCommitDelay_);
+
+          while (pendingStores_.size() < groupCommitSize_ &&
+                 storeCondition_.timed_wait(lock, timeout))
+          {
+          }
+        }
+      }
+
+      std::vector<StoreRequest*> batch;
+
+      try
+      {
+        // While waiting for the lock on the database, other instances
+        // might join the queue, which enlarges the batch
+        WriterLock lock(mutex_);
+
+        {
+          boost::mutex::scoped_lock storeLock(storeMutex_);
+
+          // FIFO order, to preserve the order of the changes
+          while (!pendingStores_.empty() &&
+                 batch.size() < groupCommitSize_)
+          {
+            batch.push_back(pendingStores_.front());
+            pendingStores_.pop_front();
+          }
+        }
+
+        StoreBatch(batch);
+      }
+      catch (...)
+      {
+        // Never leave the other threads waiting for a leader. The
+        // requests of the batch keep their "failure" status, and the
+        // request of this thread must not be processed once this
+        // method has returned, as it lives on the stack.
+        boost::mutex::scoped_lock lock(storeMutex_);
+        pendingStores_.remove(&request);
+        ReleaseStoreLeadership(batch);
+        throw;
+      }
+
+      {
+        boost::mutex::scoped_lock lock(storeMutex_);
+        ReleaseStoreLeadership(batch);
+      }
+    }
   }
 
 
@@ -1023,7 +1348,8 @@ namespace Orthanc
                                         /* out */ uint64_t& countSeries, 
                                         /* out */ uint64_t& countInstances)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
     diskSize = db_.GetTotalCompressedSize();
     uncompressedSize = db_.GetTotalUncompressedSize();
     countPatients = db_.GetResourceCount(ResourceType_Patient);
@@ -1082,12 +1408,9 @@ namespace Orthanc
 
 
   void ServerIndex::MainDicomTagsToJson(Json::Value& target,
-                                        int64_t resourceId,
+                                        const DicomMap& tags,
                                         ResourceType resourceType)
   {
-    DicomMap tags;
-    db_.GetMainDicomTags(tags, resourceId);
-
     if (resourceType == ResourceType_Study)
     {
       DicomMap t1, t2;
@@ -1114,16 +1437,60 @@ namespace Orthanc
   {
     result = Json::objectValue;
 
-    boost::mutex::scoped_lock lock(mutex_);
-
-    // Lookup for the requested resource
     int64_t id;
     ResourceType type;
     std::string parent;
-    if (!db_.LookupResourceAndParent(id, type, parent, publicId) ||
-        type != expectedType)
+    std::list<std::string> children;
+    std::map<MetadataType, std::string> metadata;
+    DicomMap tags;
+    FileInfo attachment;
+    SeriesStatus seriesStatus = SeriesStatus_Unknown;
+    int64_t expectedNumberOfInstances = 0;
+    bool hasExpectedNumberOfInstances = false;
+    bool isStable = false;
+
     {
-      return false;
+      ReaderLock lock(mutex_);
+
+      {
+        // Only the accesses to the database are serialized, the
+        // formatting of the JSON answer is done concurrently
+        boost::mutex::scoped_lock databaseLock(databaseMutex_);
+
+        // Lookup for the requested resource
+        if (!db_.LookupResourceAndParent(id, type, parent, publicId) ||
+            type != expectedType)
+        {
+          return false;
+        }
+
+        // List the children resources
+        db_.GetChildrenPublicId(children, id);
+
+        // Extract the metadata
+        db_.GetAllMetadata(metadata, id);
+
+        if (type == ResourceType_Series)
+        {
+          hasExpectedNumberOfInstances = LookupIntegerMetadata(
+            expectedNumberOfInstances, metadata, MetadataType_Series_ExpectedNumberOfInstances);
+
+          if (hasExpectedNumberOfInstances)
+          {
+            seriesStatus = GetSeriesStatus(id, expectedNumberOfInstances);
+          }
+        }
+        else if (type == ResourceType_Instance &&
+                 !db_.LookupAttachment(attachment, id, FileContentType_Dicom))
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        db_.GetMainDicomTags(tags, id);
+      }
+
+      // "unstableResources_" is only modified by writers
+      isStable = !unstableResources_.Contains(id);
     }
 
     // Set information about the parent resource (if it exists)
@@ -1160,10 +1527,6 @@ namespace Orthanc
       }
     }
 
-    // List the children resources
-    std::list<std::string> children;
-    db_.GetChildrenPublicId(children, id);
-
     if (type != ResourceType_Instance)
     {
       Json::Value c = Json::arrayValue;
@@ -1193,10 +1556,6 @@ namespace Orthanc
       }
     }
 
-    // Extract the metadata
-    std::map<MetadataType, std::string> metadata;
-    db_.GetAllMetadata(metadata, id);
-
     // Set the resource type
     switch (type)
     {
@@ -1212,11 +1571,10 @@ namespace Orthanc
       {
         result["Type"] = "Series";
 
-        int64_t i;
-        if (LookupIntegerMetadata(i, metadata, MetadataType_Series_ExpectedNumberOfInstances))
+        if (hasExpectedNumberOfInstances)
         {
-          result["ExpectedNumberOfInstances"] = static_cast<int>(i);
-          result["Status"] = EnumerationToString(GetSeriesStatus(id, i));
+          result["ExpectedNumberOfInstances"] = static_cast<int>(expectedNumberOfInstances);
+          result["Status"] = EnumerationToString(seriesStatus);
         }
         else
         {
@@ -1231,12 +1589,6 @@ namespace Orthanc
       {
         result["Type"] = "Instance";
 
-        FileInfo attachment;
-        if (!db_.LookupAttachment(attachment, id, FileContentType_Dicom))
-        {
-          throw OrthancException(ErrorCode_InternalError);
-        }
-
         result["FileSize"] = static_cast<unsigned int>(attachment.GetUncompressedSize());
         result["FileUuid"] = attachment.GetUuid();
 
@@ -1259,7 +1611,7 @@ namespace Orthanc
 
     // Record the remaining information
     result["ID"] = publicId;
-    MainDicomTagsToJson(result, id, type);
+    MainDicomTagsToJson(result, tags, type);
 
     std::string tmp;
 
@@ -1277,7 +1629,7 @@ namespace Orthanc
         type == ResourceType_Study ||
         type == ResourceType_Series)
     {
-      result["IsStable"] = !unstableResources_.Contains(id);
+      result["IsStable"] = isStable;
 
       if (LookupStringMetadata(tmp, metadata, MetadataType_LastUpdate))
       {
@@ -1293,7 +1645,8 @@ namespace Orthanc
                                      const std::string& instanceUuid,
                                      FileContentType contentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     int64_t id;
     ResourceType type;
@@ -1318,7 +1671,8 @@ namespace Orthanc
   void ServerIndex::GetAllUuids(std::list<std::string>& target,
                                 ResourceType resourceType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
     db_.GetAllPublicIds(target, resourceType);
   }
 
@@ -1334,7 +1688,8 @@ namespace Orthanc
       return;
     }
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
     db_.GetAllPublicIds(target, resourceType, since, limit);
   }
 
@@ -1388,7 +1743,7 @@ namespace Orthanc
     int64_t last = 0;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      WriterLock lock(mutex_);
 
       // Fix wrt. Orthanc <= 1.3.2: A transaction was missing, as
       // "GetLastChange()" involves calls to "GetPublicId()"
@@ -1415,7 +1770,7 @@ namespace Orthanc
     int64_t last = 0;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      WriterLock lock(mutex_);
 
       // Fix wrt. Orthanc <= 1.3.2: A transaction was missing, as
       // "GetLastChange()" involves calls to "GetPublicId()"
@@ -1438,7 +1793,7 @@ namespace Orthanc
   void ServerIndex::LogExportedResource(const std::string& publicId,
                                         const std::string& remoteModality)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     Transaction transaction(*this);
 
     int64_t id;
@@ -1534,7 +1889,8 @@ namespace Orthanc
     bool done;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      ReaderLock lock(mutex_);
+      boost::mutex::scoped_lock databaseLock(databaseMutex_);
       db_.GetExportedResources(exported, done, since, maxResults);
     }
 
@@ -1547,7 +1903,8 @@ namespace Orthanc
     std::list<ExportedResource> exported;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      ReaderLock lock(mutex_);
+      boost::mutex::scoped_lock databaseLock(databaseMutex_);
       db_.GetLastExportedResource(exported);
     }
 
@@ -1628,7 +1985,7 @@ namespace Orthanc
 
   void ServerIndex::SetMaximumPatientCount(unsigned int count) 
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     maximumPatients_ = count;
 
     if (count == 0)
@@ -1645,7 +2002,7 @@ namespace Orthanc
 
   void ServerIndex::SetMaximumStorageSize(uint64_t size) 
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     maximumStorageSize_ = size;
 
     if (size == 0)
@@ -1670,9 +2027,107 @@ namespace Orthanc
   }
 
 
+  void ServerIndex::UpgradePersonNameIdentifiers()
+  {
+    // WARNING: No mutex here, do not include this as a public method
+
+    /**
+     * The global property is "1" once the person names are indexed.
+     * During the upgrade, it contains the last processed internal ID
+     * at the current level (e.g. "Study:2000"), that is committed
+     * together with each batch of resources, which allows to resume
+     * an interrupted upgrade. The resources are paged by increasing
+     * internal ID, which is stable and doesn't rescan the previous
+     * batches.
+     **/
+    static const size_t BATCH_SIZE = 1000;
+
+    std::string value;
+    if (db_.LookupGlobalProperty(value, GlobalProperty_PersonNameIdentifiers) &&
+        value == "1")
+    {
+      return;
+    }
+
+    ResourceType level = ResourceType_Study;
+    int64_t since = -1;
+
+    if (value.empty())
+    {
+      if (db_.GetResourceCount(ResourceType_Study) == 0 &&
+          db_.GetResourceCount(ResourceType_Series) == 0)
+      {
+        // New database, or nothing to be indexed
+        Transaction t(*this);
+        db_.SetGlobalProperty(GlobalProperty_PersonNameIdentifiers, "1");
+        t.Commit(0);
+        return;
+      }
+    }
+    else
+    {
+      std::vector<std::string> tokens;
+      Toolbox::TokenizeString(tokens, value, ':');
+
+      try
+      {
+        if (tokens.size() != 2)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        level = StringToResourceType(tokens[0].c_str());
+        since = boost::lexical_cast<int64_t>(tokens[1]);
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+
+    LOG(WARNING) << "The database was created by a version of Orthanc below 1.7.3, "
+                 << "indexing the person names for case-insensitive lookups";
+
+    uint64_t processed = 0;
+
+    for (;;)
+    {
+      Transaction t(*this);
+
+      size_t count = ServerToolbox::ReconstructPersonNameIdentifiers(db_, level, since, BATCH_SIZE);
+      processed += count;
+
+      if (count < BATCH_SIZE)
+      {
+        if (level == ResourceType_Study)
+        {
+          level = ResourceType_Series;
+          since = -1;
+        }
+        else
+        {
+          db_.SetGlobalProperty(GlobalProperty_PersonNameIdentifiers, "1");
+          t.Commit(0);
+          break;
+        }
+      }
+
+      db_.SetGlobalProperty(GlobalProperty_PersonNameIdentifiers,
+                            std::string(EnumerationToString(level)) + ":" +
+                            boost::lexical_cast<std::string>(since));
+      t.Commit(0);
+
+      LOG(INFO) << "Indexed the person names of " << processed << " study/series resources";
+    }
+
+    LOG(WARNING) << "The person names are now indexed";
+  }
+
+
   bool ServerIndex::IsProtectedPatient(const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     // Lookup for the requested resource
     int64_t id;
@@ -1690,7 +2145,7 @@ namespace Orthanc
   void ServerIndex::SetProtectedPatient(const std::string& publicId,
                                         bool isProtected)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     Transaction transaction(*this);
 
     // Lookup for the requested resource
@@ -1717,7 +2172,8 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     ResourceType type;
     int64_t resource;
@@ -1748,7 +2204,8 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     ResourceType type;
     int64_t top;
@@ -1797,7 +2254,7 @@ namespace Orthanc
                                 MetadataType type,
                                 const std::string& value)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     Transaction t(*this);
 
     ResourceType rtype;
@@ -1821,7 +2278,7 @@ namespace Orthanc
   void ServerIndex::DeleteMetadata(const std::string& publicId,
                                    MetadataType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     Transaction t(*this);
 
     ResourceType rtype;
@@ -1846,7 +2303,8 @@ namespace Orthanc
                                    const std::string& publicId,
                                    MetadataType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     ResourceType rtype;
     int64_t id;
@@ -1862,7 +2320,8 @@ namespace Orthanc
   void ServerIndex::GetAllMetadata(std::map<MetadataType, std::string>& target,
                                    const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     ResourceType type;
     int64_t id;
@@ -1879,7 +2338,8 @@ namespace Orthanc
                                              const std::string& publicId,
                                              ResourceType expectedType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     ResourceType type;
     int64_t id;
@@ -1896,7 +2356,8 @@ namespace Orthanc
   bool ServerIndex::LookupParent(std::string& target,
                                  const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     ResourceType type;
     int64_t id;
@@ -1920,7 +2381,8 @@ namespace Orthanc
 
   uint64_t ServerIndex::IncrementGlobalSequence(GlobalProperty sequence)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
     Transaction transaction(*this);
 
     uint64_t seq = IncrementGlobalSequenceInternal(sequence);
@@ -1934,7 +2396,7 @@ namespace Orthanc
   void ServerIndex::LogChange(ChangeType changeType,
                               const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     Transaction transaction(*this);
 
     int64_t id;
@@ -1951,7 +2413,7 @@ namespace Orthanc
 
   void ServerIndex::DeleteChanges()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
 
     Transaction transaction(*this);
     db_.ClearChanges();
@@ -1960,7 +2422,7 @@ namespace Orthanc
 
   void ServerIndex::DeleteExportedResources()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
 
     Transaction transaction(*this);
     db_.ClearExportedResources();
@@ -1978,7 +2440,8 @@ namespace Orthanc
                                           /* out */ uint64_t& dicomUncompressedSize, 
                                           const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     int64_t top;
     if (!db_.LookupResource(top, type, publicId))
@@ -2090,7 +2553,7 @@ namespace Orthanc
       // Check for stable resources each few seconds
       boost::this_thread::sleep(boost::posix_time::milliseconds(threadSleep));
 
-      boost::mutex::scoped_lock lock(that->mutex_);
+      WriterLock lock(that->mutex_);
 
       while (!that->unstableResources_.IsEmpty() &&
              that->unstableResources_.GetOldestPayload().GetAge() > static_cast<unsigned int>(stableAge))
@@ -2135,7 +2598,7 @@ namespace Orthanc
                                    Orthanc::ResourceType type,
                                    const std::string& publicId)
   {
-    // WARNING: Before calling this method, "mutex_" must be locked.
+    // WARNING: Before calling this method, "mutex_" must be exclusively locked.
 
     assert(type == Orthanc::ResourceType_Patient ||
            type == Orthanc::ResourceType_Study ||
@@ -2144,8 +2607,6 @@ namespace Orthanc
     UnstableResourcePayload payload(type, publicId);
     unstableResources_.AddOrMakeMostRecent(id, payload);
     //LOG(INFO) << "Unstable resource: " << EnumerationToString(type) << " " << id;
-
-    LogChange(id, ChangeType_NewChildInstance, type, publicId);
   }
 
 
@@ -2171,7 +2632,8 @@ namespace Orthanc
     std::list<std::string> tmp;
     
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      ReaderLock lock(mutex_);
+      boost::mutex::scoped_lock databaseLock(databaseMutex_);
       db_.ApplyLookupResources(tmp, NULL, query, level, 0);
     }
 
@@ -2182,7 +2644,7 @@ namespace Orthanc
   StoreStatus ServerIndex::AddAttachment(const FileInfo& attachment,
                                          const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
 
     Transaction t(*this);
 
@@ -2233,7 +2695,7 @@ namespace Orthanc
   void ServerIndex::DeleteAttachment(const std::string& publicId,
                                      FileContentType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
     Transaction t(*this);
 
     ResourceType rtype;
@@ -2257,7 +2719,7 @@ namespace Orthanc
   void ServerIndex::SetGlobalProperty(GlobalProperty property,
                                       const std::string& value)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
 
     Transaction transaction(*this);
     db_.SetGlobalProperty(property, value);
@@ -2268,7 +2730,8 @@ namespace Orthanc
   bool ServerIndex::LookupGlobalProperty(std::string& value,
                                          GlobalProperty property)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
     return db_.LookupGlobalProperty(value, property);
   }
   
@@ -2306,7 +2769,8 @@ namespace Orthanc
 
     result.Clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     // Lookup for the requested resource
     int64_t id;
@@ -2349,7 +2813,8 @@ namespace Orthanc
   {
     result.Clear();
     
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     // Lookup for the requested resource
     int64_t instance;
@@ -2419,7 +2884,8 @@ namespace Orthanc
   bool ServerIndex::LookupResourceType(ResourceType& type,
                                        const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     int64_t id;
     return db_.LookupResource(id, type, publicId);
@@ -2428,7 +2894,8 @@ namespace Orthanc
 
   unsigned int ServerIndex::GetDatabaseVersion()
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
     return db_.GetDatabaseVersion();
   }
 
@@ -2437,7 +2904,8 @@ namespace Orthanc
                                  const std::string& publicId,
                                  ResourceType parentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReaderLock lock(mutex_);
+    boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
     ResourceType type;
     int64_t id;
@@ -2472,7 +2940,7 @@ namespace Orthanc
 
     DicomInstanceHasher hasher(summary);
 
-    boost::mutex::scoped_lock lock(mutex_);
+    WriterLock lock(mutex_);
 
     try
     {
@@ -2576,7 +3044,8 @@ namespace Orthanc
     std::list<std::string> resourcesList, instancesList;
     
     {
-      boost::mutex::scoped_lock lock(mutex_);
+      ReaderLock lock(mutex_);
+      boost::mutex::scoped_lock databaseLock(databaseMutex_);
 
       if (instancesId == NULL)
       {
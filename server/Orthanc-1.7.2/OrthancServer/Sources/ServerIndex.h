@@ -39,6 +39,7 @@
 #include "Database/IDatabaseWrapper.h"
 
 #include <boost/thread.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/noncopyable.hpp>
 
 namespace Orthanc
@@ -57,11 +58,29 @@ namespace Orthanc
   private:
     class Listener;
     class Transaction;
+    class StoreRequest;
     class UnstableResourcePayload;
     class MainDicomTagsRegistry;
 
+    typedef boost::unique_lock<boost::shared_mutex>  WriterLock;
+    typedef boost::shared_lock<boost::shared_mutex>  ReaderLock;
+
     bool done_;
-    boost::mutex mutex_;
+
+    // Read-only operations share this mutex, whereas the operations
+    // that modify the index (hence that start a transaction) lock it
+    // exclusively
+    boost::shared_mutex mutex_;
+
+    // The database backends are not thread-safe: This mutex
+    // serializes the calls to "db_" that are issued by concurrent
+    // readers. It is never needed while "mutex_" is exclusively held.
+    // SQLite shares its cached statements between the callers, and
+    // "OrthancPluginDatabase" collects the answers of the plugin into
+    // its own members, so readers cannot skip this mutex: Only the
+    // work done outside of "db_" (e.g. JSON formatting) runs in parallel.
+    boost::mutex databaseMutex_;
+
     boost::thread flushThread_;
     boost::thread unstableResourcesMonitorThread_;
 
@@ -73,15 +92,25 @@ namespace Orthanc
     unsigned int maximumPatients_;
     std::unique_ptr<MainDicomTagsRegistry>  mainDicomTagsRegistry_;
 
+    // Group commit: The concurrent calls to "Store()" are queued, and
+    // one of the calling threads (the "leader") stores a batch of
+    // queued instances within a single database transaction
+    boost::mutex                storeMutex_;
+    boost::condition_variable   storeCondition_;
+    std::list<StoreRequest*>    pendingStores_;
+    bool                        hasStoreLeader_;
+    unsigned int                groupCommitSize_;
+    unsigned int                groupCommitDelay_;
+
     static void FlushThread(ServerIndex* that,
                             unsigned int threadSleep);
 
     static void UnstableResourcesMonitorThread(ServerIndex* that,
                                                unsigned int threadSleep);
 
-    void MainDicomTagsToJson(Json::Value& result,
-                             int64_t resourceId,
-                             ResourceType resourceType);
+    static void MainDicomTagsToJson(Json::Value& result,
+                                    const DicomMap& tags,
+                                    ResourceType resourceType);
 
     bool IsRecyclingNeeded(uint64_t instanceSize);
 
@@ -90,6 +119,8 @@ namespace Orthanc
 
     void StandaloneRecycling();
 
+    void UpgradePersonNameIdentifiers();
+
     void MarkAsUnstable(int64_t id,
                         Orthanc::ResourceType type,
                         const std::string& publicId);
@@ -113,6 +144,13 @@ namespace Orthanc
     SeriesStatus GetSeriesStatus(int64_t id,
                                  int64_t expectedNumberOfInstances);
 
+    StoreStatus StoreInternal(uint64_t& instanceSize,
+                              StoreRequest& request);
+
+    void StoreBatch(const std::vector<StoreRequest*>& batch);
+
+    void ReleaseStoreLeadership(const std::vector<StoreRequest*>& batch);
+
   public:
     ServerIndex(ServerContext& context,
                 IDatabaseWrapper& database,
@@ -138,6 +176,14 @@ namespace Orthanc
     // "count == 0" means no limit on the number of patients
     void SetMaximumPatientCount(unsigned int count);
 
+    // At most "maxInstances" concurrent calls to "Store()" are
+    // committed within the same database transaction ("1" means one
+    // transaction per instance). If "delay" is not zero, the
+    // transaction waits for at most "delay" milliseconds for other
+    // instances to arrive, before being committed.
+    void SetGroupCommit(unsigned int maxInstances,
+                        unsigned int delay);
+
     StoreStatus Store(std::map<MetadataType, std::string>& instanceMetadata,
                       DicomInstanceToStore& instance,
                       const Attachments& attachments,
@@ -39,6 +39,7 @@
 #include "../../../OrthancFramework/Sources/DicomParsing/DicomDirWriter.h"
 #include "../../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../../OrthancFramework/Sources/Logging.h"
+#include "../../../OrthancFramework/Sources/MultiThreading/ThreadPool.h"
 #include "../../../OrthancFramework/Sources/OrthancException.h"
 #include "../OrthancConfiguration.h"
 #include "../ServerContext.h"
@@ -58,6 +59,10 @@ static const char* const KEY_INSTANCES_COUNT = "InstancesCount";
 static const char* const KEY_UNCOMPRESSED_SIZE_MB = "UncompressedSizeMB";
 static const char* const KEY_TRANSCODE = "Transcode";
 
+// Delay (in milliseconds) before checking again whether the HTTP
+// client has drained the stream of a synchronous archive
+static const unsigned int STREAM_RETRY_TIMEOUT = 100;
+
 
 namespace Orthanc
 {
@@ -355,6 +360,57 @@ namespace Orthanc
 
   class ArchiveJob::ZipCommands : public boost::noncopyable
   {
+  public:
+    // Content of one instance, once read from the storage area and
+    // compressed, ready to be appended to the archive
+    class LoadedInstance : public boost::noncopyable
+    {
+    private:
+      std::unique_ptr<ZipWriter::CompressedFile>  file_;
+      std::unique_ptr<ParsedDicomFile>            parsed_;  // Only for DICOMDIR
+
+    public:
+      // The instance was removed after the job was issued
+      bool IsRemoved() const
+      {
+        return file_.get() == NULL;
+      }
+
+      void SetFile(ZipWriter::CompressedFile* file)
+      {
+        file_.reset(file);
+      }
+
+      const ZipWriter::CompressedFile& GetFile() const
+      {
+        if (file_.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+        else
+        {
+          return *file_;
+        }
+      }
+
+      void SetParsed(ParsedDicomFile* parsed)
+      {
+        parsed_.reset(parsed);
+      }
+
+      ParsedDicomFile& GetParsed() const
+      {
+        if (parsed_.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+        else
+        {
+          return *parsed_;
+        }
+      }
+    };
+
   private:
     enum Type
     {
@@ -398,12 +454,89 @@ namespace Orthanc
         assert(type_ == Type_WriteInstance);
       }
         
+      bool IsWriteInstance() const
+      {
+        return type_ == Type_WriteInstance;
+      }
+
+      // This method can be invoked concurrently by the loader threads
+      LoadedInstance* Load(ServerContext& context,
+                           bool isMedia,
+                           bool transcode,
+                           DicomTransferSyntax transferSyntax,
+                           uint8_t compressionLevel) const
+      {
+        if (type_ != Type_WriteInstance)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        std::unique_ptr<LoadedInstance> loaded(new LoadedInstance);
+
+        std::string content;
+
+        try
+        {
+          context.ReadAttachment(content, info_);
+        }
+        catch (OrthancException& e)
+        {
+          ResourceType type;
+          if (context.GetIndex().LookupResourceType(type, instanceId_))
+          {
+            // The instance still exists, this is an error of the
+            // storage area that must make the job fail
+            throw;
+          }
+
+          LOG(WARNING) << "An instance was removed after the job was issued: " << instanceId_;
+          return loaded.release();
+        }
+
+        //boost::this_thread::sleep(boost::posix_time::milliseconds(300));
+
+        if (transcode)
+        {
+          // New in Orthanc 1.7.0
+          std::set<DicomTransferSyntax> syntaxes;
+          syntaxes.insert(transferSyntax);
+
+          IDicomTranscoder::DicomImage source, transcoded;
+          source.SetExternalBuffer(content);
+
+          if (context.Transcode(transcoded, source, syntaxes, true /* allow new SOP instance UID */))
+          {
+            loaded->SetFile(new ZipWriter::CompressedFile(
+                              transcoded.GetBufferData(), transcoded.GetBufferSize(), compressionLevel));
+
+            if (isMedia)
+            {
+              loaded->SetParsed(transcoded.ReleaseAsParsedDicomFile());
+            }
+
+            return loaded.release();
+          }
+          else
+          {
+            LOG(INFO) << "Cannot transcode instance " << instanceId_
+                      << " to transfer syntax: " << GetTransferSyntaxUid(transferSyntax);
+          }
+        }
+
+        loaded->SetFile(new ZipWriter::CompressedFile(content, compressionLevel));
+
+        if (isMedia)
+        {
+          loaded->SetParsed(new ParsedDicomFile(content));
+        }
+
+        return loaded.release();
+      }
+
       void Apply(HierarchicalZipWriter& writer,
-                 ServerContext& context,
                  DicomDirWriter* dicomDir,
                  const std::string& dicomDirFolder,
-                 bool transcode,
-                 DicomTransferSyntax transferSyntax) const
+                 const LoadedInstance* instance) const
       {
         switch (type_)
         {
@@ -417,66 +550,18 @@ namespace Orthanc
 
           case Type_WriteInstance:
           {
-            std::string content;
-
-            try
-            {
-              context.ReadAttachment(content, info_);
-            }
-            catch (OrthancException& e)
-            {
-              LOG(WARNING) << "An instance was removed after the job was issued: " << instanceId_;
-              return;
-            }
-
-            //boost::this_thread::sleep(boost::posix_time::milliseconds(300));
-
-            writer.OpenFile(filename_.c_str());
-
-            bool transcodeSuccess = false;
-
-            std::unique_ptr<ParsedDicomFile> parsed;
-            
-            if (transcode)
+            if (instance == NULL)
             {
-              // New in Orthanc 1.7.0
-              std::set<DicomTransferSyntax> syntaxes;
-              syntaxes.insert(transferSyntax);
-
-              IDicomTranscoder::DicomImage source, transcoded;
-              source.SetExternalBuffer(content);
-
-              if (context.Transcode(transcoded, source, syntaxes, true /* allow new SOP instance UID */))
-              {
-                writer.Write(transcoded.GetBufferData(), transcoded.GetBufferSize());
-
-                if (dicomDir != NULL)
-                {
-                  std::unique_ptr<ParsedDicomFile> tmp(transcoded.ReleaseAsParsedDicomFile());
-                  dicomDir->Add(dicomDirFolder, filename_, *tmp);
-                }
-                
-                transcodeSuccess = true;
-              }
-              else
-              {
-                LOG(INFO) << "Cannot transcode instance " << instanceId_
-                          << " to transfer syntax: " << GetTransferSyntaxUid(transferSyntax);
-              }
+              throw OrthancException(ErrorCode_InternalError);
             }
 
-            if (!transcodeSuccess)
+            if (!instance->IsRemoved())
             {
-              writer.Write(content);
+              writer.WriteCompressedFile(filename_.c_str(), instance->GetFile());
 
               if (dicomDir != NULL)
               {
-                if (parsed.get() == NULL)
-                {
-                  parsed.reset(new ParsedDicomFile(content));
-                }
-
-                dicomDir->Add(dicomDirFolder, filename_, *parsed);
+                dicomDir->Add(dicomDirFolder, filename_, instance->GetParsed());
               }
             }
               
@@ -493,21 +578,17 @@ namespace Orthanc
     uint64_t              uncompressedSize_;
     unsigned int          instancesCount_;
 
-      
-    void ApplyInternal(HierarchicalZipWriter& writer,
-                       ServerContext& context,
-                       size_t index,
-                       DicomDirWriter* dicomDir,
-                       const std::string& dicomDirFolder,
-                       bool transcode,
-                       DicomTransferSyntax transferSyntax) const
+    const Command& GetCommand(size_t index) const
     {
       if (index >= commands_.size())
       {
         throw OrthancException(ErrorCode_ParameterOutOfRange);
       }
-
-      commands_[index]->Apply(writer, context, dicomDir, dicomDirFolder, transcode, transferSyntax);
+      else
+      {
+        assert(commands_[index] != NULL);
+        return *commands_[index];
+      }
     }
       
   public:
@@ -542,26 +623,37 @@ namespace Orthanc
       return uncompressedSize_;
     }
 
+    bool IsWriteInstance(size_t index) const
+    {
+      return GetCommand(index).IsWriteInstance();
+    }
+
+    LoadedInstance* Load(ServerContext& context,
+                         size_t index,
+                         bool isMedia,
+                         bool transcode,
+                         DicomTransferSyntax transferSyntax,
+                         uint8_t compressionLevel) const
+    {
+      return GetCommand(index).Load(context, isMedia, transcode, transferSyntax, compressionLevel);
+    }
+
     // "media" flavor (with DICOMDIR)
     void Apply(HierarchicalZipWriter& writer,
-               ServerContext& context,
                size_t index,
                DicomDirWriter& dicomDir,
                const std::string& dicomDirFolder,
-               bool transcode,
-               DicomTransferSyntax transferSyntax) const
+               const LoadedInstance* instance) const
     {
-      ApplyInternal(writer, context, index, &dicomDir, dicomDirFolder, transcode, transferSyntax);
+      GetCommand(index).Apply(writer, &dicomDir, dicomDirFolder, instance);
     }
 
     // "archive" flavor (without DICOMDIR)
     void Apply(HierarchicalZipWriter& writer,
-               ServerContext& context,
                size_t index,
-               bool transcode,
-               DicomTransferSyntax transferSyntax) const
+               const LoadedInstance* instance) const
     {
-      ApplyInternal(writer, context, index, NULL, "", transcode, transferSyntax);
+      GetCommand(index).Apply(writer, NULL, "", instance);
     }
       
     void AddOpenDirectory(const std::string& filename)
@@ -747,23 +839,154 @@ namespace Orthanc
   class ArchiveJob::ZipWriterIterator : public boost::noncopyable
   {
   private:
-    TemporaryFile&                          target_;
+    typedef ZipCommands::LoadedInstance  LoadedInstance;
+    typedef std::map<size_t, LoadedInstance*>  LoadedInstances;
+
+    class LoadTask : public ThreadPool::ITask
+    {
+    private:
+      const ZipCommands&               commands_;
+      ServerContext&                   context_;
+      size_t                           index_;
+      bool                             isMedia_;
+      bool                             transcode_;
+      DicomTransferSyntax              transferSyntax_;
+      uint8_t                          compressionLevel_;
+      std::unique_ptr<LoadedInstance>  result_;
+
+    public:
+      LoadTask(const ZipCommands& commands,
+               ServerContext& context,
+               size_t index,
+               bool isMedia,
+               bool transcode,
+               DicomTransferSyntax transferSyntax,
+               uint8_t compressionLevel) :
+        commands_(commands),
+        context_(context),
+        index_(index),
+        isMedia_(isMedia),
+        transcode_(transcode),
+        transferSyntax_(transferSyntax),
+        compressionLevel_(compressionLevel)
+      {
+      }
+
+      virtual void Execute() ORTHANC_OVERRIDE
+      {
+        result_.reset(commands_.Load(context_, index_, isMedia_, transcode_,
+                                     transferSyntax_, compressionLevel_));
+      }
+
+      size_t GetIndex() const
+      {
+        return index_;
+      }
+
+      LoadedInstance* ReleaseResult()
+      {
+        if (result_.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+        else
+        {
+          return result_.release();
+        }
+      }
+    };
+
     ServerContext&                          context_;
     ZipCommands                             commands_;
     std::unique_ptr<HierarchicalZipWriter>  zip_;
     std::unique_ptr<DicomDirWriter>         dicomDir_;
     bool                                    isMedia_;
+    uint8_t                                 compressionLevel_;
+    std::unique_ptr<ThreadPool>             loaders_;
+    size_t                                  readAhead_;
+    LoadedInstances                         loaded_;
+
+    /**
+     * Reads and compresses the next instances in parallel. The
+     * results are appended to the archive by the next steps, in the
+     * order of the commands, which bounds the memory to "readAhead_"
+     * instances.
+     **/
+    void ReadAhead(size_t index,
+                   bool transcode,
+                   DicomTransferSyntax transferSyntax)
+    {
+      assert(loaders_.get() != NULL);
+
+      std::vector<LoadTask*> tasks;
+      tasks.reserve(readAhead_);
+
+      try
+      {
+        for (size_t i = index; i < commands_.GetSize() && tasks.size() < readAhead_; i++)
+        {
+          if (commands_.IsWriteInstance(i) &&
+              loaded_.find(i) == loaded_.end())
+          {
+            tasks.push_back(new LoadTask(commands_, context_, i, isMedia_, transcode,
+                                         transferSyntax, compressionLevel_));
+          }
+        }
+
+        std::vector<ThreadPool::ITask*> tmp(tasks.begin(), tasks.end());
+        loaders_->Execute(tmp);
+
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+          std::unique_ptr<LoadedInstance> result(tasks[i]->ReleaseResult());
+          loaded_[tasks[i]->GetIndex()] = result.get();
+          result.release();
+        }
+      }
+      catch (...)
+      {
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+          delete tasks[i];
+        }
+
+        throw;
+      }
+
+      for (size_t i = 0; i < tasks.size(); i++)
+      {
+        delete tasks[i];
+      }
+    }
 
   public:
-    ZipWriterIterator(TemporaryFile& target,
+    ZipWriterIterator(HierarchicalZipWriter* zip,  // Takes ownership
                       ServerContext& context,
                       ArchiveIndex& archive,
                       bool isMedia,
-                      bool enableExtendedSopClass) :
-      target_(target),
+                      bool enableExtendedSopClass,
+                      unsigned int loaderThreads,
+                      uint8_t compressionLevel) :
       context_(context),
-      isMedia_(isMedia)
+      zip_(zip),
+      isMedia_(isMedia),
+      compressionLevel_(compressionLevel),
+      readAhead_(0)
     {
+      if (zip == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+
+      zip_->SetCompressionLevel(compressionLevel);
+
+      if (loaderThreads > 1)
+      {
+        // The thread of the job is also one of the loaders
+        loaders_.reset(new ThreadPool(loaderThreads - 1));
+        readAhead_ = 2 * loaderThreads;
+      }
+
       if (isMedia)
       {
         MediaIndexVisitor visitor(commands_, context);
@@ -783,9 +1006,17 @@ namespace Orthanc
         archive.Apply(visitor);
       }
 
-      zip_.reset(new HierarchicalZipWriter(target.GetPath().c_str()));
       zip_->SetZip64(commands_.IsZip64());
     }
+
+    ~ZipWriterIterator()
+    {
+      for (LoadedInstances::iterator it = loaded_.begin(); it != loaded_.end(); ++it)
+      {
+        assert(it->second != NULL);
+        delete it->second;
+      }
+    }
       
     size_t GetStepsCount() const
     {
@@ -815,16 +1046,40 @@ namespace Orthanc
       }
       else
       {
+        std::unique_ptr<LoadedInstance> instance;
+
+        if (commands_.IsWriteInstance(index))
+        {
+          LoadedInstances::iterator found = loaded_.find(index);
+
+          if (found == loaded_.end() &&
+              loaders_.get() != NULL)
+          {
+            ReadAhead(index, transcode, transferSyntax);
+            found = loaded_.find(index);
+          }
+
+          if (found == loaded_.end())
+          {
+            instance.reset(commands_.Load(context_, index, isMedia_, transcode,
+                                          transferSyntax, compressionLevel_));
+          }
+          else
+          {
+            instance.reset(found->second);
+            loaded_.erase(found);
+          }
+        }
+
         if (isMedia_)
         {
           assert(dicomDir_.get() != NULL);
-          commands_.Apply(*zip_, context_, index, *dicomDir_,
-                          MEDIA_IMAGES_FOLDER, transcode, transferSyntax);
+          commands_.Apply(*zip_, index, *dicomDir_, MEDIA_IMAGES_FOLDER, instance.get());
         }
         else
         {
           assert(dicomDir_.get() == NULL);
-          commands_.Apply(*zip_, context_, index, transcode, transferSyntax);
+          commands_.Apply(*zip_, index, instance.get());
         }
       }
     }
@@ -838,6 +1093,11 @@ namespace Orthanc
     {
       return commands_.GetUncompressedSize();
     }
+
+    void Close()
+    {
+      zip_->Close();
+    }
   };
 
 
@@ -852,7 +1112,9 @@ namespace Orthanc
     instancesCount_(0),
     uncompressedSize_(0),
     transcode_(false),
-    transferSyntax_(DicomTransferSyntax_LittleEndianImplicit)
+    transferSyntax_(DicomTransferSyntax_LittleEndianImplicit),
+    loaderThreads_(0),
+    compressionLevel_(6)
   {
   }
 
@@ -874,6 +1136,7 @@ namespace Orthanc
     }
     else if (writer_.get() != NULL ||  // Already started
              synchronousTarget_.get() != NULL ||
+             synchronousStream_.get() != NULL ||
              asynchronousTarget_.get() != NULL)
     {
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
@@ -885,6 +1148,26 @@ namespace Orthanc
   }
 
 
+  void ArchiveJob::SetSynchronousTarget(boost::shared_ptr<IStreamTarget>& target)
+  {
+    if (target.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NullPointer);
+    }
+    else if (writer_.get() != NULL ||  // Already started
+             synchronousTarget_.get() != NULL ||
+             synchronousStream_.get() != NULL ||
+             asynchronousTarget_.get() != NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      synchronousStream_ = target;
+    }
+  }
+
+
   void ArchiveJob::SetDescription(const std::string& description)
   {
     if (writer_.get() != NULL)   // Already started
@@ -926,6 +1209,38 @@ namespace Orthanc
   }
 
   
+  void ArchiveJob::SetLoaderThreads(unsigned int count)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      loaderThreads_ = count;
+    }
+  }
+
+
+  void ArchiveJob::SetCompressionLevel(uint8_t level)
+  {
+    if (writer_.get() != NULL)   // Already started
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (level >= 10)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "ZIP compression level must be between 0 (no compression) "
+                             "and 9 (highest compression)");
+    }
+    else
+    {
+      compressionLevel_ = level;
+    }
+  }
+
+  
   void ArchiveJob::Reset()
   {
     throw OrthancException(ErrorCode_BadSequenceOfCalls,
@@ -935,32 +1250,44 @@ namespace Orthanc
   
   void ArchiveJob::Start()
   {
-    TemporaryFile* target = NULL;
-    
-    if (synchronousTarget_.get() == NULL)
+    if (writer_.get() != NULL)
     {
-      {
-        OrthancConfiguration::ReaderLock lock;
-        asynchronousTarget_.reset(lock.GetConfiguration().CreateTemporaryFile());
-      }
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    std::unique_ptr<HierarchicalZipWriter> zip;
 
-      target = asynchronousTarget_.get();
+    if (synchronousStream_.get() != NULL)
+    {
+      zip.reset(new HierarchicalZipWriter(*synchronousStream_));
     }
     else
     {
-      target = synchronousTarget_.get();
-    }
-
-    assert(target != NULL);
-    target->Touch();  // Make sure we can write to the temporary file
+      TemporaryFile* target = NULL;
     
-    if (writer_.get() != NULL)
-    {
-      throw OrthancException(ErrorCode_BadSequenceOfCalls);
-    }
+      if (synchronousTarget_.get() == NULL)
+      {
+        {
+          OrthancConfiguration::ReaderLock lock;
+          asynchronousTarget_.reset(lock.GetConfiguration().CreateTemporaryFile());
+        }
 
-    writer_.reset(new ZipWriterIterator(*target, context_, *archive_,
-                                        isMedia_, enableExtendedSopClass_));
+        target = asynchronousTarget_.get();
+      }
+      else
+      {
+        target = synchronousTarget_.get();
+      }
+
+      assert(target != NULL);
+      target->Touch();  // Make sure we can write to the temporary file
+
+      zip.reset(new HierarchicalZipWriter(target->GetPath().c_str()));
+    }
+    
+    writer_.reset(new ZipWriterIterator(zip.release(), context_, *archive_,
+                                        isMedia_, enableExtendedSopClass_,
+                                        loaderThreads_, compressionLevel_));
 
     instancesCount_ = writer_->GetInstancesCount();
     uncompressedSize_ = writer_->GetUncompressedSize();
@@ -995,7 +1322,8 @@ namespace Orthanc
 
   void ArchiveJob::FinalizeTarget()
   {
-    writer_.reset();  // Flush all the results
+    writer_->Close();  // Flush all the results, and write the central directory
+    writer_.reset();
 
     if (asynchronousTarget_.get() != NULL)
     {
@@ -1010,13 +1338,23 @@ namespace Orthanc
   {
     assert(writer_.get() != NULL);
 
-    if (synchronousTarget_.get() != NULL &&
-        synchronousTarget_.unique())
+    if ((synchronousTarget_.get() != NULL &&
+         synchronousTarget_.unique()) ||
+        (synchronousStream_.get() != NULL &&
+         synchronousStream_.unique()))
     {
       LOG(WARNING) << "A client has disconnected while creating an archive";
       return JobStepResult::Failure(ErrorCode_NetworkProtocol,
                                     "A client has disconnected while creating an archive");
     }
+
+    if (synchronousStream_.get() != NULL &&
+        synchronousStream_->IsFull())
+    {
+      // The HTTP client is slower than the job: Wait for the stream
+      // to be drained, without keeping the worker thread busy
+      return JobStepResult::Retry(STREAM_RETRY_TIMEOUT);
+    }
         
     if (writer_->GetStepsCount() == 0)
     {
@@ -34,6 +34,7 @@
 #pragma once
 
 #include "../../../OrthancFramework/Sources/Compatibility.h"
+#include "../../../OrthancFramework/Sources/Compression/ZipWriter.h"
 #include "../../../OrthancFramework/Sources/JobsEngine/IJob.h"
 #include "../../../OrthancFramework/Sources/TemporaryFile.h"
 
@@ -46,6 +47,21 @@ namespace Orthanc
   
   class ArchiveJob : public IJob
   {
+  public:
+    /**
+     * Stream that receives the ZIP archive while it is written by the
+     * job, and that is drained by another thread (typically the HTTP
+     * thread). New in Orthanc 1.7.3.
+     **/
+    class IStreamTarget : public ZipWriter::IOutputStream
+    {
+    public:
+      // Whether the consumer has not caught up with the job yet: The
+      // job is then put in the "Retry" state, which releases its
+      // worker thread for the other jobs
+      virtual bool IsFull() = 0;
+    };
+
   private:
     class ArchiveIndex;
     class ArchiveIndexVisitor;
@@ -56,6 +72,7 @@ namespace Orthanc
     class ZipWriterIterator;
     
     boost::shared_ptr<TemporaryFile>      synchronousTarget_;
+    boost::shared_ptr<IStreamTarget>      synchronousStream_;  // New in Orthanc 1.7.3
     std::unique_ptr<TemporaryFile>        asynchronousTarget_;
     ServerContext&                        context_;
     boost::shared_ptr<ArchiveIndex>       archive_;
@@ -72,6 +89,10 @@ namespace Orthanc
     // New in Orthanc 1.7.0
     bool                 transcode_;
     DicomTransferSyntax  transferSyntax_;
+
+    // New in Orthanc 1.7.3
+    unsigned int         loaderThreads_;
+    uint8_t              compressionLevel_;
     
     void FinalizeTarget();
     
@@ -84,6 +105,10 @@ namespace Orthanc
     
     void SetSynchronousTarget(boost::shared_ptr<TemporaryFile>& synchronousTarget);
 
+    // The archive is directly written to the stream, without any
+    // temporary file. New in Orthanc 1.7.3.
+    void SetSynchronousTarget(boost::shared_ptr<IStreamTarget>& synchronousTarget);
+
     void SetDescription(const std::string& description);
 
     const std::string& GetDescription() const
@@ -95,6 +120,13 @@ namespace Orthanc
 
     void SetTranscode(DicomTransferSyntax transferSyntax);
 
+    // Number of threads that read and compress the instances ahead
+    // of their insertion in the archive (0 or 1 means no read-ahead)
+    void SetLoaderThreads(unsigned int count);
+
+    // 0 means that the instances are stored without compression
+    void SetCompressionLevel(uint8_t level);
+
     virtual void Reset() ORTHANC_OVERRIDE;
 
     virtual void Start() ORTHANC_OVERRIDE;
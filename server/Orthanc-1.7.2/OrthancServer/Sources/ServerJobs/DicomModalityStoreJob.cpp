@@ -44,20 +44,79 @@
 
 namespace Orthanc
 {
-  void DicomModalityStoreJob::OpenConnection()
+  class DicomModalityStoreJob::SendTask : public InstancesLookAhead::SendTask
   {
-    if (connection_.get() == NULL)
+  private:
+    DicomModalityStoreJob&     that_;
+    DicomStoreUserConnection&  connection_;
+    std::string                sopClassUid_;
+    std::string                sopInstanceUid_;
+
+  protected:
+    virtual bool Send(const std::string& instance) ORTHANC_OVERRIDE
     {
-      connection_.reset(new DicomStoreUserConnection(parameters_));
+      return that_.SendInstance(sopClassUid_, sopInstanceUid_, connection_, instance);
+    }
+
+  public:
+    SendTask(DicomModalityStoreJob& that,
+             DicomStoreUserConnection& connection,
+             const std::string& instance) :
+      InstancesLookAhead::SendTask(instance),
+      that_(that),
+      connection_(connection)
+    {
+    }
+
+    const std::string& GetSopClassUid() const
+    {
+      return sopClassUid_;
+    }
+
+    const std::string& GetSopInstanceUid() const
+    {
+      return sopInstanceUid_;
+    }
+  };
+
+  
+  void DicomModalityStoreJob::OpenConnections()
+  {
+    const unsigned int count = parameters_.GetRemoteModality().GetStoreAssociationsCount();
+    assert(count >= 1);
+    
+    if (connections_.size() != count)
+    {
+      CloseConnections();
+
+      connections_.reserve(count);
+      for (unsigned int i = 0; i < count; i++)
+      {
+        connections_.push_back(new DicomStoreUserConnection(parameters_));
+      }
     }
   }
 
 
-  bool DicomModalityStoreJob::HandleInstance(const std::string& instance)
+  void DicomModalityStoreJob::CloseConnections()
   {
-    assert(IsStarted());
-    OpenConnection();
+    lookAhead_.Close();
+
+    for (size_t i = 0; i < connections_.size(); i++)
+    {
+      assert(connections_[i] != NULL);
+      delete connections_[i];
+    }
+
+    connections_.clear();
+  }
+
 
+  bool DicomModalityStoreJob::SendInstance(std::string& sopClassUid,
+                                           std::string& sopInstanceUid,
+                                           DicomStoreUserConnection& connection,
+                                           const std::string& instance)
+  {
     LOG(INFO) << "Sending instance " << instance << " to modality \"" 
               << parameters_.GetRemoteModality().GetApplicationEntityTitle() << "\"";
 
@@ -73,9 +132,46 @@ namespace Orthanc
       return false;
     }
     
-    std::string sopClassUid, sopInstanceUid;
-    context_.StoreWithTranscoding(sopClassUid, sopInstanceUid, *connection_, dicom,
+    context_.StoreWithTranscoding(sopClassUid, sopInstanceUid, connection, dicom,
                                   HasMoveOriginator(), moveOriginatorAet_, moveOriginatorId_);
+    return true;
+  }
+
+
+  InstancesLookAhead::SendTask* DicomModalityStoreJob::CreateSendTask(size_t connection,
+                                                                       const std::string& instance)
+  {
+    assert(connection < connections_.size());
+    return new SendTask(*this, *connections_[connection], instance);
+  }
+
+
+  bool DicomModalityStoreJob::HandleInstance(const std::string& instance)
+  {
+    assert(IsStarted());
+    OpenConnections();
+
+    bool success;
+    std::string sopClassUid, sopInstanceUid;
+
+    if (connections_.size() == 1)
+    {
+      success = SendInstance(sopClassUid, sopInstanceUid, *connections_[0], instance);
+    }
+    else
+    {
+      const SendTask& task = dynamic_cast<const SendTask&>(
+        lookAhead_.Lookup(*this, *this, instance, connections_.size()));
+
+      success = task.GetOutcome();
+      sopClassUid = task.GetSopClassUid();
+      sopInstanceUid = task.GetSopInstanceUid();
+    }
+
+    if (!success)
+    {
+      return false;
+    }
 
     if (storageCommitment_)
     {
@@ -91,7 +187,7 @@ namespace Orthanc
       if (sopClassUids_.size() == GetInstancesCount())
       {
         assert(IsStarted());
-        connection_.reset(NULL);
+        CloseConnections();
         
         const std::string& remoteAet = parameters_.GetRemoteModality().GetApplicationEntityTitle();
         
@@ -123,13 +219,20 @@ namespace Orthanc
 
   DicomModalityStoreJob::DicomModalityStoreJob(ServerContext& context) :
     context_(context),
-    moveOriginatorId_(0),      // By default, not a C-MOVE
-    storageCommitment_(false)  // By default, no storage commitment
+    moveOriginatorId_(0),       // By default, not a C-MOVE
+    storageCommitment_(false)   // By default, no storage commitment
   {
     ResetStorageCommitment();
   }
 
 
+  DicomModalityStoreJob::~DicomModalityStoreJob()
+  {
+    lookAhead_.Clear();
+    CloseConnections();
+  }
+
+
   void DicomModalityStoreJob::SetLocalAet(const std::string& aet)
   {
     if (IsStarted())
@@ -216,7 +319,11 @@ namespace Orthanc
 
   void DicomModalityStoreJob::Stop(JobStopReason reason)   // For pausing jobs
   {
-    connection_.reset(NULL);
+    /**
+     * The outcomes of the instances that were sent in advance are
+     * kept, so that they are not sent twice if the job is resumed.
+     **/
+    CloseConnections();
   }
 
 
@@ -234,6 +341,7 @@ namespace Orthanc
   void DicomModalityStoreJob::Reset()
   {
     SetOfInstancesJob::Reset();
+    lookAhead_.Clear();
 
     /**
      * "After the N-EVENT-REPORT has been sent, the Transaction UID is
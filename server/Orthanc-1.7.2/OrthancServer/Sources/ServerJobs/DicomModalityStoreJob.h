@@ -36,6 +36,7 @@
 #include "../../../OrthancFramework/Sources/Compatibility.h"
 #include "../../../OrthancFramework/Sources/JobsEngine/SetOfInstancesJob.h"
 #include "../../../OrthancFramework/Sources/DicomNetworking/DicomStoreUserConnection.h"
+#include "../../../OrthancFramework/Sources/JobsEngine/InstancesLookAhead.h"
 
 #include <list>
 
@@ -43,22 +44,40 @@ namespace Orthanc
 {
   class ServerContext;
   
-  class DicomModalityStoreJob : public SetOfInstancesJob
+  class DicomModalityStoreJob :
+    public SetOfInstancesJob,
+    private InstancesLookAhead::ISendTaskFactory
   {
   private:
+    class SendTask;
+    
     ServerContext&                             context_;
     DicomAssociationParameters                 parameters_;
     std::string                                moveOriginatorAet_;
     uint16_t                                   moveOriginatorId_;
-    std::unique_ptr<DicomStoreUserConnection>  connection_;
+    std::vector<DicomStoreUserConnection*>     connections_;
     bool                                       storageCommitment_;
 
+    // For parallel associations (one association per instance of
+    // the batches)
+    InstancesLookAhead                         lookAhead_;
+
     // For storage commitment
     std::string             transactionUid_;
     std::list<std::string>  sopInstanceUids_;
     std::list<std::string>  sopClassUids_;
 
-    void OpenConnection();
+    void OpenConnections();
+
+    void CloseConnections();
+
+    bool SendInstance(std::string& sopClassUid,
+                      std::string& sopInstanceUid,
+                      DicomStoreUserConnection& connection,
+                      const std::string& instance);
+
+    virtual InstancesLookAhead::SendTask* CreateSendTask(size_t connection,
+                                                         const std::string& instance) ORTHANC_OVERRIDE;
 
     void ResetStorageCommitment();
 
@@ -73,6 +92,8 @@ namespace Orthanc
     DicomModalityStoreJob(ServerContext& context,
                           const Json::Value& serialized);
 
+    virtual ~DicomModalityStoreJob();
+
     const DicomAssociationParameters& GetParameters() const
     {
       return parameters_;
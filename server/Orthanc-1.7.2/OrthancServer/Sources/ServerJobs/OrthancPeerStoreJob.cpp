@@ -38,21 +38,95 @@
 #include "../../../OrthancFramework/Sources/SerializationToolbox.h"
 #include "../ServerContext.h"
 
+#include <boost/lexical_cast.hpp>
 #include <dcmtk/dcmdata/dcfilefo.h>
 
 
 namespace Orthanc
 {
+  class OrthancPeerStoreJob::SendTask : public InstancesLookAhead::SendTask
+  {
+  private:
+    OrthancPeerStoreJob&  that_;
+    HttpClient&           client_;
+
+  protected:
+    virtual bool Send(const std::string& instance) ORTHANC_OVERRIDE
+    {
+      return that_.SendInstance(client_, instance);
+    }
+
+  public:
+    SendTask(OrthancPeerStoreJob& that,
+             HttpClient& client,
+             const std::string& instance) :
+      InstancesLookAhead::SendTask(instance),
+      that_(that),
+      client_(client)
+    {
+    }
+  };
+
+
+  void OrthancPeerStoreJob::OpenClients()
+  {
+    if (clients_.size() != concurrency_)
+    {
+      CloseClients();
+
+      // The HTTP connections are kept alive between the instances
+      clients_.reserve(concurrency_);
+      for (unsigned int i = 0; i < concurrency_; i++)
+      {
+        clients_.push_back(new HttpClient(peer_, "instances"));
+        clients_.back()->SetMethod(HttpMethod_Post);
+      }
+    }
+  }
+
+
+  void OrthancPeerStoreJob::CloseClients()
+  {
+    lookAhead_.Close();
+
+    for (size_t i = 0; i < clients_.size(); i++)
+    {
+      assert(clients_[i] != NULL);
+      delete clients_[i];
+    }
+
+    clients_.clear();
+  }
+
+
+  InstancesLookAhead::SendTask* OrthancPeerStoreJob::CreateSendTask(size_t connection,
+                                                                     const std::string& instance)
+  {
+    assert(connection < clients_.size());
+    return new SendTask(*this, *clients_[connection], instance);
+  }
+
+
   bool OrthancPeerStoreJob::HandleInstance(const std::string& instance)
   {
     //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
 
-    if (client_.get() == NULL)
+    OpenClients();
+
+    if (clients_.size() == 1)
     {
-      client_.reset(new HttpClient(peer_, "instances"));
-      client_->SetMethod(HttpMethod_Post);
+      return SendInstance(*clients_[0], instance);
     }
-      
+    else
+    {
+      return lookAhead_.Lookup(*this, *this, instance, clients_.size()).GetOutcome();
+    }
+  }
+
+
+  bool OrthancPeerStoreJob::SendInstance(HttpClient& client,
+                                         const std::string& instance)
+  {
     LOG(INFO) << "Sending instance " << instance << " to peer \"" 
               << peer_.GetUrl() << "\"";
 
@@ -71,17 +145,17 @@ namespace Orthanc
 
         if (context_.Transcode(transcoded, source, syntaxes, true))
         {
-          client_->GetBody().assign(reinterpret_cast<const char*>(transcoded.GetBufferData()),
+          client.GetBody().assign(reinterpret_cast<const char*>(transcoded.GetBufferData()),
                                     transcoded.GetBufferSize());
         }
         else
         {
-          client_->GetBody().swap(dicom);
+          client.GetBody().swap(dicom);
         }
       }
       else
       {
-        context_.ReadDicom(client_->GetBody(), instance);
+        context_.ReadDicom(client.GetBody(), instance);
       }
     }
     catch (OrthancException& e)
@@ -91,7 +165,7 @@ namespace Orthanc
     }
 
     std::string answer;
-    if (client_->Apply(answer))
+    if (client.Apply(answer))
     {
       return true;
     }
@@ -176,9 +250,46 @@ namespace Orthanc
   }
 
 
+  const unsigned int OrthancPeerStoreJob::MAX_CONCURRENCY;
+
+
+  void OrthancPeerStoreJob::SetConcurrency(unsigned int concurrency)
+  {
+    if (IsStarted())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else if (concurrency == 0 ||
+             concurrency > MAX_CONCURRENCY)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The concurrency of the transfers to an Orthanc peer must be between 1 and " +
+                             boost::lexical_cast<std::string>(MAX_CONCURRENCY));
+    }
+    else
+    {
+      concurrency_ = concurrency;
+    }
+  }
+
+
+  OrthancPeerStoreJob::~OrthancPeerStoreJob()
+  {
+    lookAhead_.Clear();
+    CloseClients();
+  }
+
+
   void OrthancPeerStoreJob::Stop(JobStopReason reason)   // For pausing jobs
   {
-    client_.reset(NULL);
+    CloseClients();
+  }
+
+
+  void OrthancPeerStoreJob::Reset()
+  {
+    SetOfInstancesJob::Reset();
+    lookAhead_.Clear();
   }
 
 
@@ -196,16 +307,20 @@ namespace Orthanc
     {
       value["Transcode"] = GetTransferSyntaxUid(transferSyntax_);
     }
+
+    value["Concurrency"] = concurrency_;
   }
 
 
   static const char* PEER = "Peer";
   static const char* TRANSCODE = "Transcode";
+  static const char* CONCURRENCY = "Concurrency";
 
   OrthancPeerStoreJob::OrthancPeerStoreJob(ServerContext& context,
                                            const Json::Value& serialized) :
     SetOfInstancesJob(serialized),
-    context_(context)
+    context_(context),
+    concurrency_(1)
   {
     assert(serialized.type() == Json::objectValue);
     peer_ = WebServiceParameters(serialized[PEER]);
@@ -218,6 +333,11 @@ namespace Orthanc
     {
       transcode_ = false;
     }
+
+    if (serialized.isMember(CONCURRENCY))
+    {
+      SetConcurrency(SerializationToolbox::ReadUnsignedInteger(serialized, CONCURRENCY));
+    }
   }
 
 
@@ -238,6 +358,8 @@ namespace Orthanc
       {
         target[TRANSCODE] = GetTransferSyntaxUid(transferSyntax_);
       }
+
+      target[CONCURRENCY] = concurrency_;
       
       return true;
     }
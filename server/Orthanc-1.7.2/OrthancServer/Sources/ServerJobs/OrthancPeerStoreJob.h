@@ -36,20 +36,40 @@
 #include "../../../OrthancFramework/Sources/Compatibility.h"
 #include "../../../OrthancFramework/Sources/JobsEngine/SetOfInstancesJob.h"
 #include "../../../OrthancFramework/Sources/HttpClient.h"
+#include "../../../OrthancFramework/Sources/JobsEngine/InstancesLookAhead.h"
 
 
 namespace Orthanc
 {
   class ServerContext;
   
-  class OrthancPeerStoreJob : public SetOfInstancesJob
+  class OrthancPeerStoreJob :
+    public SetOfInstancesJob,
+    private InstancesLookAhead::ISendTaskFactory
   {
   private:
+    class SendTask;
+    
     ServerContext&               context_;
     WebServiceParameters         peer_;
-    std::unique_ptr<HttpClient>  client_;
+    std::vector<HttpClient*>     clients_;
     bool                         transcode_;
     DicomTransferSyntax          transferSyntax_;
+    unsigned int                 concurrency_;
+
+    // For concurrent transfers (one HTTP client per instance of the
+    // batches)
+    InstancesLookAhead           lookAhead_;
+
+    void OpenClients();
+
+    void CloseClients();
+
+    bool SendInstance(HttpClient& client,
+                      const std::string& instance);
+
+    virtual InstancesLookAhead::SendTask* CreateSendTask(size_t connection,
+                                                         const std::string& instance) ORTHANC_OVERRIDE;
 
   protected:
     virtual bool HandleInstance(const std::string& instance);
@@ -57,15 +77,21 @@ namespace Orthanc
     virtual bool HandleTrailingStep();
 
   public:
+    // Each HTTP connection comes with a thread and a cURL handle
+    static const unsigned int MAX_CONCURRENCY = 32;
+
     OrthancPeerStoreJob(ServerContext& context) :
       context_(context),
-      transcode_(false)
+      transcode_(false),
+      concurrency_(1)
     {
     }
 
     OrthancPeerStoreJob(ServerContext& context,
                         const Json::Value& serialize);
 
+    virtual ~OrthancPeerStoreJob();
+
     void SetPeer(const WebServiceParameters& peer);
 
     const WebServiceParameters& GetPeer() const
@@ -86,8 +112,19 @@ namespace Orthanc
 
     void ClearTranscode();
 
+    // Number of instances that are sent simultaneously to the peer,
+    // each over its own HTTP connection
+    unsigned int GetConcurrency() const
+    {
+      return concurrency_;
+    }
+
+    void SetConcurrency(unsigned int concurrency);
+
     virtual void Stop(JobStopReason reason);   // For pausing jobs
 
+    virtual void Reset();
+
     virtual void GetJobType(std::string& target)
     {
       target = "OrthancPeerStore";
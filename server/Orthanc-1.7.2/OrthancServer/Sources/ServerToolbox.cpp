@@ -62,12 +62,34 @@ namespace Orthanc
     DICOM_TAG_STUDY_INSTANCE_UID,
     DICOM_TAG_ACCESSION_NUMBER,
     DICOM_TAG_STUDY_DESCRIPTION,
-    DICOM_TAG_STUDY_DATE
+    DICOM_TAG_STUDY_DATE,
+    DICOM_TAG_REFERRING_PHYSICIAN_NAME,  // New in Orthanc 1.7.3
+    DICOM_TAG_REQUESTING_PHYSICIAN       // New in Orthanc 1.7.3
   };
 
   static const DicomTag SERIES_IDENTIFIERS[] = 
   {
-    DICOM_TAG_SERIES_INSTANCE_UID
+    DICOM_TAG_SERIES_INSTANCE_UID,
+    DICOM_TAG_OPERATOR_NAME              // New in Orthanc 1.7.3
+  };
+
+  /**
+   * The person names (PN value representation) among the main DICOM
+   * tags are matched case-insensitively by default. Storing them as
+   * normalized identifiers makes such lookups use the index on the
+   * "DicomIdentifiers" table, instead of comparing "lower(value)" on
+   * each row of "MainDicomTags". The databases created before Orthanc
+   * 1.7.3 are upgraded by "ReconstructPersonNameIdentifiers()".
+   **/
+  static const DicomTag STUDY_PERSON_NAME_IDENTIFIERS[] = 
+  {
+    DICOM_TAG_REFERRING_PHYSICIAN_NAME,
+    DICOM_TAG_REQUESTING_PHYSICIAN
+  };
+
+  static const DicomTag SERIES_PERSON_NAME_IDENTIFIERS[] = 
+  {
+    DICOM_TAG_OPERATOR_NAME
   };
 
   static const DicomTag INSTANCE_IDENTIFIERS[] = 
@@ -345,6 +367,86 @@ namespace Orthanc
     }
 
 
+    size_t ReconstructPersonNameIdentifiers(IDatabaseWrapper& database,
+                                            ResourceType level,
+                                            int64_t& since,
+                                            size_t limit)
+    {
+      const DicomTag* personNames = NULL;
+      size_t size = 0;
+
+      switch (level)
+      {
+        case ResourceType_Study:
+          personNames = STUDY_PERSON_NAME_IDENTIFIERS;
+          size = sizeof(STUDY_PERSON_NAME_IDENTIFIERS) / sizeof(DicomTag);
+          break;
+
+        case ResourceType_Series:
+          personNames = SERIES_PERSON_NAME_IDENTIFIERS;
+          size = sizeof(SERIES_PERSON_NAME_IDENTIFIERS) / sizeof(DicomTag);
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      std::list<int64_t> resources;
+      database.GetInternalIdsAfter(resources, level, since, limit);
+
+      ResourcesContent content;
+      
+      for (std::list<int64_t>::const_iterator
+             it = resources.begin(); it != resources.end(); ++it)
+      {
+        const int64_t id = *it;
+
+        DicomMap tags;
+        database.GetMainDicomTags(tags, id);
+
+        for (size_t i = 0; i < size; i++)
+        {
+          const DicomValue* value = tags.TestAndGetValue(personNames[i]);
+          if (value != NULL &&
+              !value->IsNull() &&
+              !value->IsBinary())
+          {
+            content.AddIdentifierTag(id, personNames[i], NormalizeIdentifier(value->GetContent()));
+          }
+        }
+      }
+
+      database.SetResourcesContent(content);
+
+      if (!resources.empty())
+      {
+        since = resources.back();
+      }
+
+      return resources.size();
+    }
+
+
+    void ReconstructPersonNameIdentifiers(IDatabaseWrapper& database)
+    {
+      static const size_t BATCH_SIZE = 1000;
+
+      static const ResourceType LEVELS[] = { ResourceType_Study, ResourceType_Series };
+
+      for (size_t i = 0; i < sizeof(LEVELS) / sizeof(ResourceType); i++)
+      {
+        int64_t since = -1;
+        size_t count;
+
+        do
+        {
+          count = ReconstructPersonNameIdentifiers(database, LEVELS[i], since, BATCH_SIZE);
+        }
+        while (count == BATCH_SIZE);
+      }
+    }
+
+
     bool IsIdentifier(const DicomTag& tag,
                       ResourceType level)
     {
@@ -381,7 +483,8 @@ namespace Orthanc
         Json::Value dicomAsJson;
         locker.GetDicom().DatasetToJson(dicomAsJson);
 
-        std::string s = dicomAsJson.toStyledString();
+        std::string s;
+        context.SerializeDicomAsJson(s, dicomAsJson);
         context.AddAttachment(*it, FileContentType_DicomAsJson, s.c_str(), s.size());
 
         context.GetIndex().ReconstructInstance(locker.GetDicom());
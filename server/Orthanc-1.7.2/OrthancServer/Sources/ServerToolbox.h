@@ -65,6 +65,17 @@ namespace Orthanc
 
     std::string NormalizeIdentifier(const std::string& value);
 
+    // Indexes the person names of at most "limit" study or series
+    // resources whose internal ID is greater than "since", which is
+    // updated to the last processed internal ID. Returns the number
+    // of processed resources (smaller than "limit" at the end).
+    size_t ReconstructPersonNameIdentifiers(IDatabaseWrapper& database,
+                                            ResourceType level,
+                                            int64_t& since,
+                                            size_t limit);
+
+    void ReconstructPersonNameIdentifiers(IDatabaseWrapper& database);
+
     void ReconstructResource(ServerContext& context,
                              const std::string& resource);
   }
@@ -460,47 +460,23 @@ public:
     }
 #endif
 
-    static const char* HTTP_FILTER = "IncomingHttpRequestFilter";
-
-    LuaScripting::Lock lock(context_.GetLuaScripting());
-
-    // Test if the instance must be filtered out
-    if (lock.GetLua().IsExistingFunction(HTTP_FILTER))
+    // If a pool of interpreters is configured, the filter is
+    // evaluated by one of them, so that the HTTP requests are not
+    // serialized. Otherwise, the main interpreter is used.
+    std::unique_ptr<ServerContext::LuaFilterLock> filter;
+    if (context_.IsLuaFilterPoolEnabled())
     {
-      LuaFunctionCall call(lock.GetLua(), HTTP_FILTER);
-
-      switch (method)
-      {
-        case HttpMethod_Get:
-          call.PushString("GET");
-          break;
-
-        case HttpMethod_Put:
-          call.PushString("PUT");
-          break;
-
-        case HttpMethod_Post:
-          call.PushString("POST");
-          break;
-
-        case HttpMethod_Delete:
-          call.PushString("DELETE");
-          break;
-
-        default:
-          return true;
-      }
+      filter.reset(new ServerContext::LuaFilterLock(context_));
+    }
 
-      call.PushString(uri);
-      call.PushString(ip);
-      call.PushString(username);
-      call.PushStringMap(httpHeaders);
+    LuaScripting& lua = (filter.get() == NULL ?
+                         context_.GetLuaScripting() : filter->GetLuaScripting());
 
-      if (!call.ExecutePredicate())
-      {
-        LOG(INFO) << "An incoming HTTP request has been discarded by the filter";
-        return false;
-      }
+    // Test if the request must be filtered out
+    if (!lua.FilterIncomingHttpRequest(method, uri, ip, username, httpHeaders))
+    {
+      LOG(INFO) << "An incoming HTTP request has been discarded by the filter";
+      return false;
     }
 
     return true;
@@ -611,6 +587,11 @@ static void PrintHelp(const char* path)
     << "\t\t\t(by default, the log is dumped to stderr)" << std::endl
     << "  --logfile=[file]\tfile where to store the log of Orthanc" << std::endl
     << "\t\t\t(by default, the log is dumped to stderr)" << std::endl
+    << "  --logasync=[size]\twrite the log from a background thread, through" << std::endl
+    << "\t\t\ta queue of \"size\" messages (the threads that log" << std::endl
+    << "\t\t\twait if the queue is full)" << std::endl
+    << "  --logasync-drop=[size]\tsame as --logasync, but the messages are" << std::endl
+    << "\t\t\tdiscarded if the queue is full" << std::endl
     << "  --config=[file]\tcreate a sample configuration file and exit" << std::endl
     << "\t\t\t(if file is \"-\", dumps to stdout)" << std::endl
     << "  --errors\t\tprint the supported error codes and exit" << std::endl
@@ -822,6 +803,7 @@ static bool WaitForExit(ServerContext& context,
 
   context.GetLuaScripting().Start();
   context.GetLuaScripting().Execute("Initialize");
+  context.ExecuteLuaFilterCallback("Initialize");
 
   bool restart;
 
@@ -857,8 +839,13 @@ static bool WaitForExit(ServerContext& context,
     }
   }
 
+  // Wake up the HTTP clients that are long polling "/changes", so
+  // that they do not delay the shutdown of the HTTP server
+  context.AbortWaitForChanges();
+
   context.GetLuaScripting().Execute("Finalize");
   context.GetLuaScripting().Stop();
+  context.ExecuteLuaFilterCallback("Finalize");
 
 #if ORTHANC_ENABLE_PLUGINS == 1
   if (context.HasPlugins())
@@ -1074,8 +1061,16 @@ static bool StartDicomServer(ServerContext& context,
       dicomServer.SetAssociationTimeout(lock.GetConfiguration().GetUnsignedIntegerParameter("DicomScpTimeout", 30));
       dicomServer.SetPortNumber(lock.GetConfiguration().GetUnsignedIntegerParameter("DicomPort", 4242));
       dicomServer.SetApplicationEntityTitle(lock.GetConfiguration().GetStringParameter("DicomAet", "ORTHANC"));
+
+      unsigned int minThreads = lock.GetConfiguration().GetUnsignedIntegerParameter("DicomThreadsCount", 4);
+      unsigned int maxThreads = lock.GetConfiguration().GetUnsignedIntegerParameter("DicomMaximumThreadsCount", 32);
+      dicomServer.SetThreadsCount(minThreads, std::max(minThreads, maxThreads));
+      dicomServer.SetMaximumAssociationsPerAETitle(
+        lock.GetConfiguration().GetUnsignedIntegerParameter("DicomMaximumAssociationsPerAet", 0));
     }
 
+    dicomServer.SetMetricsRegistry(context.GetMetricsRegistry());
+
 #if ORTHANC_ENABLE_PLUGINS == 1
     if (plugins != NULL)
     {
@@ -1338,6 +1333,10 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
     {
       context.GetIndex().SetMaximumStorageSize(0);
     }
+
+    context.GetIndex().SetGroupCommit(
+      std::max(1u, lock.GetConfiguration().GetUnsignedIntegerParameter("GroupCommitSize", 16)),
+      lock.GetConfiguration().GetUnsignedIntegerParameter("GroupCommitDelay", 0));
   }
 
   {
@@ -1469,6 +1468,8 @@ int main(int argc, char* argv[])
   bool upgradeDatabase = false;
   bool loadJobsFromDatabase = true;
   const char* configurationFile = NULL;
+  size_t asynchronousLogQueue = 0;  // Synchronous logging by default
+  Logging::LogOverflowPolicy asynchronousLogPolicy = Logging::LogOverflowPolicy_Block;
 
 
   /**
@@ -1554,6 +1555,30 @@ int main(int argc, char* argv[])
         return -1;
       }
     }
+    else if (boost::starts_with(argument, "--logasync=") ||
+             boost::starts_with(argument, "--logasync-drop="))
+    {
+      const size_t separator = argument.find('=');
+
+      try
+      {
+        int size = boost::lexical_cast<int>(argument.substr(separator + 1));
+        if (size <= 0)
+        {
+          throw boost::bad_lexical_cast();
+        }
+
+        asynchronousLogQueue = static_cast<size_t>(size);
+        asynchronousLogPolicy = (boost::starts_with(argument, "--logasync-drop=") ?
+                                 Logging::LogOverflowPolicy_Drop :
+                                 Logging::LogOverflowPolicy_Block);
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        LOG(ERROR) << "Bad size for the queue of the asynchronous logging: " << argument;
+        return -1;
+      }
+    }
     else if (argument == "--upgrade")
     {
       upgradeDatabase = true;
@@ -1664,6 +1689,13 @@ int main(int argc, char* argv[])
     {
       OrthancInitialize(configurationFile);
 
+      if (asynchronousLogQueue != 0)
+      {
+        // No other thread is logging at this point. The pending
+        // messages are written by "OrthancFinalize()".
+        Logging::EnableAsynchronousMode(asynchronousLogQueue, asynchronousLogPolicy);
+      }
+
       bool restart = StartOrthanc(argc, argv, upgradeDatabase, loadJobsFromDatabase);
       if (restart)
       {
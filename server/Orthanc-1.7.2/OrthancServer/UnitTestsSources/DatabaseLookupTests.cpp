@@ -37,6 +37,7 @@
 #include "../../OrthancFramework/Sources/OrthancException.h"
 
 #include "../Sources/Search/DatabaseLookup.h"
+#include "../Sources/Search/ISqlLookupFormatter.h"
 
 using namespace Orthanc;
 
@@ -278,3 +279,114 @@ TEST(DatabaseLookup, FromDicom)
     ASSERT_FALSE(lookup.GetConstraint(1).IsMandatory());
   }
 }
+
+
+namespace
+{
+  class TestLookupFormatter : public ISqlLookupFormatter
+  {
+  private:
+    bool                      binaryCollation_;
+    std::vector<std::string>  parameters_;
+
+  public:
+    explicit TestLookupFormatter(bool binaryCollation) :
+      binaryCollation_(binaryCollation)
+    {
+    }
+
+    const std::vector<std::string>& GetParameters() const
+    {
+      return parameters_;
+    }
+
+    virtual std::string GenerateParameter(const std::string& value) ORTHANC_OVERRIDE
+    {
+      parameters_.push_back(value);
+      return "$" + boost::lexical_cast<std::string>(parameters_.size());
+    }
+    
+    virtual std::string FormatResourceType(ResourceType level) ORTHANC_OVERRIDE
+    {
+      return boost::lexical_cast<std::string>(level);
+    }
+
+    virtual std::string FormatWildcardEscape() ORTHANC_OVERRIDE
+    {
+      return "ESCAPE '\\'";
+    }
+
+    virtual bool IsBinaryCollation() ORTHANC_OVERRIDE
+    {
+      return binaryCollation_;
+    }
+  };
+
+
+  std::string FormatWildcard(std::vector<std::string>& parameters,
+                             const std::string& value,
+                             bool caseSensitive,
+                             bool binaryCollation)
+  {
+    std::vector<std::string> values;
+    values.push_back(value);
+
+    std::vector<DatabaseConstraint> lookup;
+    lookup.push_back(DatabaseConstraint(ResourceType_Patient, DICOM_TAG_PATIENT_NAME, true,
+                                        ConstraintType_Wildcard, values, caseSensitive, true));
+
+    TestLookupFormatter formatter(binaryCollation);
+    
+    std::string sql;
+    ISqlLookupFormatter::Apply(sql, formatter, lookup, ResourceType_Patient, 0);
+    parameters = formatter.GetParameters();
+
+    // Only keep the comparison on the value
+    const std::string prefix = ("WHERE patients.resourceType = " +
+                                formatter.FormatResourceType(ResourceType_Patient) + " AND ");
+    size_t pos = sql.find(prefix);
+    if (pos == std::string::npos)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    return sql.substr(pos + prefix.size());
+  }
+}
+
+
+TEST(DatabaseLookup, WildcardPrefix)
+{
+  std::vector<std::string> p;
+
+  ASSERT_EQ("(t0.value >= $1 AND t0.value < $2)", FormatWildcard(p, "SMITH*", true, true));
+  ASSERT_EQ(2u, p.size());
+  ASSERT_EQ("SMITH", p[0]);
+  ASSERT_EQ("SMITI", p[1]);
+
+  ASSERT_EQ("(t0.value >= $1 AND t0.value < $2 AND t0.value LIKE $3 ESCAPE '\\')",
+            FormatWildcard(p, "SM_TH?J*", true, true));
+  ASSERT_EQ(3u, p.size());
+  ASSERT_EQ("SM_TH", p[0]);
+  ASSERT_EQ("SM_TI", p[1]);
+  ASSERT_EQ("SM\\_TH_J%", p[2]);
+
+  ASSERT_EQ("(t0.value >= $1 AND t0.value LIKE $2 ESCAPE '\\')",
+            FormatWildcard(p, "\xff\xff*A", true, true));
+  ASSERT_EQ(2u, p.size());
+  ASSERT_EQ("\xff\xff", p[0]);
+  ASSERT_EQ("\xff\xff%A", p[1]);
+
+  ASSERT_EQ("(t0.value >= $1 AND t0.value < $2)", FormatWildcard(p, "A\xff*", true, true));
+  ASSERT_EQ("A\xff", p[0]);
+  ASSERT_EQ("B", p[1]);
+
+  // No literal prefix, case-insensitive constraint, or no binary collation
+  ASSERT_EQ("t0.value LIKE $1 ESCAPE '\\'", FormatWildcard(p, "*SMITH", true, true));
+  ASSERT_EQ("%SMITH", p[0]);
+  ASSERT_EQ("t0.value LIKE $1 ESCAPE '\\'", FormatWildcard(p, "?MITH", true, true));
+  ASSERT_EQ("t0.value LIKE $1 ESCAPE '\\'", FormatWildcard(p, "SMITH*", true, false));
+  ASSERT_EQ("lower(t0.value) LIKE lower($1) ESCAPE '\\'", FormatWildcard(p, "SMITH*", false, true));
+  ASSERT_EQ(1u, p.size());
+  ASSERT_EQ("SMITH%", p[0]);
+}
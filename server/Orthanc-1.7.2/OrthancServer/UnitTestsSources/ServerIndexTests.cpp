@@ -35,17 +35,29 @@
 #include <gtest/gtest.h>
 
 #include "../../OrthancFramework/Sources/Compatibility.h"
+#include "../../OrthancFramework/Sources/Compression/ZipWriter.h"
+#include "../../OrthancFramework/Sources/DicomParsing/FromDcmtkBridge.h"
 #include "../../OrthancFramework/Sources/FileStorage/FilesystemStorage.h"
 #include "../../OrthancFramework/Sources/FileStorage/MemoryStorageArea.h"
+#include "../../OrthancFramework/Sources/HttpServer/StringHttpOutput.h"
+#include "../../OrthancFramework/Sources/Images/Image.h"
+#include "../../OrthancFramework/Sources/Images/ImageProcessing.h"
 #include "../../OrthancFramework/Sources/Logging.h"
+#include "../../OrthancFramework/UnitTestsSources/PeakResidentMemory.h"
 
 #include "../Sources/Database/SQLiteDatabaseWrapper.h"
+#include "../Sources/DicomAsJsonCodec.h"
+#include "../Sources/OrthancRestApi/OrthancRestApi.h"
 #include "../Sources/Search/DatabaseLookup.h"
 #include "../Sources/ServerContext.h"
 #include "../Sources/ServerToolbox.h"
 
 #include <ctype.h>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <boost/thread/barrier.hpp>
 
 using namespace Orthanc;
 
@@ -690,6 +702,146 @@ TEST_F(DatabaseWrapperTest, LookupIdentifier)
 }
 
 
+TEST_F(DatabaseWrapperTest, ReconstructPersonNameIdentifiers)
+{
+  int64_t a[] = {
+    index_->CreateResource("a", ResourceType_Study),   // 0
+    index_->CreateResource("b", ResourceType_Study),   // 1
+    index_->CreateResource("c", ResourceType_Series)   // 2
+  };
+
+  // Main DICOM tags of a database created before Orthanc 1.7.3
+  index_->SetMainDicomTag(a[0], DICOM_TAG_REFERRING_PHYSICIAN_NAME, "Doe^John");
+  index_->SetMainDicomTag(a[1], DICOM_TAG_REFERRING_PHYSICIAN_NAME, "Smith^Jane");
+  index_->SetMainDicomTag(a[1], DICOM_TAG_REQUESTING_PHYSICIAN, "doe^john");
+  index_->SetMainDicomTag(a[2], DICOM_TAG_OPERATOR_NAME, "Doe^Jack");
+
+  ASSERT_TRUE(ServerToolbox::IsIdentifier(DICOM_TAG_REFERRING_PHYSICIAN_NAME, ResourceType_Study));
+  ASSERT_TRUE(ServerToolbox::IsIdentifier(DICOM_TAG_REQUESTING_PHYSICIAN, ResourceType_Study));
+  ASSERT_TRUE(ServerToolbox::IsIdentifier(DICOM_TAG_OPERATOR_NAME, ResourceType_Series));
+  ASSERT_FALSE(ServerToolbox::IsIdentifier(DICOM_TAG_OPERATOR_NAME, ResourceType_Study));
+
+  std::list<std::string> s;
+  DoLookupIdentifier(s, ResourceType_Study, DICOM_TAG_REFERRING_PHYSICIAN_NAME, ConstraintType_Equal, "doe^john");
+  ASSERT_EQ(0u, s.size());
+
+  // Paging by internal ID, as used by the upgrade
+  std::list<int64_t> ids;
+  index_->GetInternalIdsAfter(ids, ResourceType_Study, -1, 10);
+  ASSERT_EQ(2u, ids.size());
+  ASSERT_EQ(a[0], ids.front());
+  ASSERT_EQ(a[1], ids.back());
+  index_->GetInternalIdsAfter(ids, ResourceType_Study, -1, 1);
+  ASSERT_EQ(1u, ids.size());
+  ASSERT_EQ(a[0], ids.front());
+  index_->GetInternalIdsAfter(ids, ResourceType_Study, a[0], 10);
+  ASSERT_EQ(1u, ids.size());
+  ASSERT_EQ(a[1], ids.front());
+  index_->GetInternalIdsAfter(ids, ResourceType_Study, a[1], 10);
+  ASSERT_TRUE(ids.empty());
+  index_->GetInternalIdsAfter(ids, ResourceType_Series, -1, 0);
+  ASSERT_TRUE(ids.empty());
+
+  ServerToolbox::ReconstructPersonNameIdentifiers(*index_);
+
+  DoLookupIdentifier(s, ResourceType_Study, DICOM_TAG_REFERRING_PHYSICIAN_NAME, ConstraintType_Equal, "doe^john");
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ("a", s.front());
+
+  DoLookupIdentifier(s, ResourceType_Study, DICOM_TAG_REFERRING_PHYSICIAN_NAME, ConstraintType_Equal, "DOE^JOHN");
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ("a", s.front());
+
+  DoLookupIdentifier(s, ResourceType_Study, DICOM_TAG_REQUESTING_PHYSICIAN, ConstraintType_Equal, "Doe^John");
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ("b", s.front());
+
+  DoLookupIdentifier(s, ResourceType_Series, DICOM_TAG_OPERATOR_NAME, ConstraintType_Wildcard, "doe*");
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ("c", s.front());
+
+  // The original values of the main DICOM tags are left untouched
+  DicomMap m;
+  index_->GetMainDicomTags(m, a[0]);
+  ASSERT_EQ("Doe^John", m.GetValue(DICOM_TAG_REFERRING_PHYSICIAN_NAME).GetContent());
+}
+
+
+static void LookupPersonName(std::list<std::string>& result,
+                             IDatabaseWrapper& db,
+                             ResourceType level,
+                             const DicomTag& tag,
+                             const std::string& value)
+{
+  DicomTagConstraint c(tag, ConstraintType_Equal, value, true, true);
+
+  std::vector<DatabaseConstraint> lookup;
+  lookup.push_back(c.ConvertToDatabaseConstraint(level, DicomTagType_Identifier));
+
+  db.ApplyLookupResources(result, NULL, lookup, level, 0 /* no limit */);
+}
+
+
+TEST(ServerIndex, UpgradePersonNameIdentifiers)
+{
+  MemoryStorageArea storage;
+
+  {
+    // New database: No upgrade is needed
+    SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+    db.Open();
+
+    ServerContext context(db, storage, true /* running unit tests */, 10);
+    context.SetupJobsEngine(true, false);
+
+    std::string s;
+    ASSERT_TRUE(db.LookupGlobalProperty(s, GlobalProperty_PersonNameIdentifiers));
+    ASSERT_EQ("1", s);
+
+    context.Stop();
+    db.Close();
+  }
+
+  {
+    // Database created before Orthanc 1.7.3, whose upgrade was
+    // interrupted after the batch containing the first study
+    SQLiteDatabaseWrapper db;
+    db.Open();
+
+    int64_t a = db.CreateResource("a", ResourceType_Study);
+    int64_t b = db.CreateResource("b", ResourceType_Study);
+    int64_t c = db.CreateResource("c", ResourceType_Series);
+    db.SetMainDicomTag(a, DICOM_TAG_REFERRING_PHYSICIAN_NAME, "Doe^John");
+    db.SetIdentifierTag(a, DICOM_TAG_REFERRING_PHYSICIAN_NAME, "DOE^JOHN");
+    db.SetMainDicomTag(b, DICOM_TAG_REFERRING_PHYSICIAN_NAME, "Doe^John");
+    db.SetMainDicomTag(c, DICOM_TAG_OPERATOR_NAME, "Doe^Jack");
+    db.SetGlobalProperty(GlobalProperty_PersonNameIdentifiers,
+                         "Study:" + boost::lexical_cast<std::string>(a));
+
+    ServerContext context(db, storage, true /* running unit tests */, 10);
+    context.SetupJobsEngine(true, false);
+
+    std::string s;
+    ASSERT_TRUE(db.LookupGlobalProperty(s, GlobalProperty_PersonNameIdentifiers));
+    ASSERT_EQ("1", s);
+
+    // The first study must not have been indexed twice
+    std::list<std::string> r;
+    LookupPersonName(r, db, ResourceType_Study, DICOM_TAG_REFERRING_PHYSICIAN_NAME, "doe^john");
+    ASSERT_EQ(2u, r.size());
+    ASSERT_TRUE(std::find(r.begin(), r.end(), "a") != r.end());
+    ASSERT_TRUE(std::find(r.begin(), r.end(), "b") != r.end());
+
+    LookupPersonName(r, db, ResourceType_Series, DICOM_TAG_OPERATOR_NAME, "DOE^JACK");
+    ASSERT_EQ(1u, r.size());
+    ASSERT_EQ("c", r.front());
+
+    context.Stop();
+    db.Close();
+  }
+}
+
+
 TEST(ServerIndex, AttachmentRecycling)
 {
   const std::string path = "UnitTestsStorage";
@@ -914,3 +1066,1851 @@ TEST(ServerIndex, Overwrite)
 }
 
 
+namespace
+{
+  // Server context over an in-memory SQLite database, whose storage
+  // area is in memory unless another one is provided
+  class TestServerContext : public boost::noncopyable
+  {
+  private:
+    MemoryStorageArea                memoryStorage_;
+    SQLiteDatabaseWrapper            db_;   // The SQLite DB is in memory
+    std::unique_ptr<ServerContext>   context_;
+
+    void Setup(IStorageArea& storage)
+    {
+      db_.Open();
+      context_.reset(new ServerContext(db_, storage, true /* running unit tests */, 10));
+      context_->SetupJobsEngine(true, false);
+    }
+
+  public:
+    TestServerContext()
+    {
+      Setup(memoryStorage_);
+    }
+
+    explicit TestServerContext(IStorageArea& storage)
+    {
+      Setup(storage);
+    }
+
+    ~TestServerContext()
+    {
+      context_->Stop();
+      context_.reset(NULL);
+      db_.Close();
+    }
+
+    ServerContext& GetContext()
+    {
+      return *context_;
+    }
+  };
+
+
+  // Main DICOM tags of a test instance, whose patient, study and
+  // series are specific to this instance
+  void CreateTestInstance(DicomMap& instance,
+                          const std::string& id)
+  {
+    instance.Clear();
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient-" + id, false);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study-" + id, false);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + id, false);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + id, false);
+    instance.SetValue(DICOM_TAG_SOP_CLASS_UID, "1.2.840.10008.5.1.4.1.1.1", false);  // CR image
+  }
+
+
+  // Stores a test instance directly in the index, with a fake DICOM
+  // attachment that is not written to the storage area
+  StoreStatus StoreTestInstance(std::map<MetadataType, std::string>& instanceMetadata,
+                                ServerIndex& index,
+                                const DicomMap& instance)
+  {
+    ServerIndex::Attachments attachments;
+    attachments.push_back(FileInfo(Toolbox::GenerateUuid(), FileContentType_Dicom, 1, "md5"));
+
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+
+    return index.Store(instanceMetadata, toStore, attachments, false);
+  }
+
+
+  // Stores a test instance through the server context (this writes
+  // its attachments to the storage area)
+  StoreStatus StoreTestInstance(ServerContext& context,
+                                const DicomMap& instance)
+  {
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+    toStore.SetOrigin(DicomInstanceOrigin::FromPlugins());
+
+    std::string s;
+    return context.Store(s, toStore, StoreInstanceMode_Default);
+  }
+
+
+  // Storage area that can make the writing of one type of
+  // attachment fail, or block the writers until they are released
+  class InstrumentedStorageArea : public IStorageArea
+  {
+  private:
+    MemoryStorageArea          storage_;
+    boost::mutex               mutex_;
+    boost::condition_variable  released_;
+    std::set<std::string>      files_;
+    bool                       hasFailure_;
+    FileContentType            failure_;
+    bool                       blocking_;
+    unsigned int               countWriters_;
+
+  public:
+    InstrumentedStorageArea() :
+      hasFailure_(false),
+      failure_(FileContentType_Unknown),
+      blocking_(false),
+      countWriters_(0)
+    {
+    }
+
+    void SetFailure(FileContentType type)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      hasFailure_ = true;
+      failure_ = type;
+    }
+
+    void SetBlocking(bool blocking)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      blocking_ = blocking;
+      released_.notify_all();
+    }
+
+    // Number of calls to "Create()" so far, including the blocked ones
+    unsigned int GetCountWriters()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return countWriters_;
+    }
+
+    size_t GetFilesCount()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return files_.size();
+    }
+
+    virtual void Create(const std::string& uuid,
+                        const void* content,
+                        size_t size,
+                        FileContentType type) ORTHANC_OVERRIDE
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        countWriters_++;
+
+        while (blocking_)
+        {
+          released_.wait(lock);
+        }
+
+        if (hasFailure_ &&
+            failure_ == type)
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+      }
+
+      storage_.Create(uuid, content, size, type);
+
+      boost::mutex::scoped_lock lock(mutex_);
+      files_.insert(uuid);
+    }
+
+    virtual void Read(std::string& content,
+                      const std::string& uuid,
+                      FileContentType type) ORTHANC_OVERRIDE
+    {
+      storage_.Read(content, uuid, type);
+    }
+
+    virtual bool HasReadRange() const ORTHANC_OVERRIDE
+    {
+      return storage_.HasReadRange();
+    }
+
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start /* inclusive */,
+                           uint64_t end /* exclusive */) ORTHANC_OVERRIDE
+    {
+      storage_.ReadRange(content, uuid, type, start, end);
+    }
+
+    virtual void Remove(const std::string& uuid,
+                        FileContentType type) ORTHANC_OVERRIDE
+    {
+      storage_.Remove(uuid, type);
+
+      boost::mutex::scoped_lock lock(mutex_);
+      files_.erase(uuid);
+    }
+  };
+
+
+  void StoreTestInstance(ServerContext& context,
+                         const std::string& id)
+  {
+    DicomMap instance;
+    CreateTestInstance(instance, id);
+
+    if (StoreTestInstance(context, instance) != StoreStatus_Success)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+
+
+  void StoreTestInstanceThread(ServerContext* context,
+                               std::string id,
+                               bool* success)
+  {
+    try
+    {
+      StoreTestInstance(*context, id);
+      *success = true;
+    }
+    catch (OrthancException&)
+    {
+      *success = false;
+    }
+  }
+}
+
+
+TEST(ServerContext, IngestWriteFailure)
+{
+  // If one of the two attachments of an instance cannot be written,
+  // the other one must not be left as an orphan in the storage area
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    const FileContentType failure = (i == 0 ? FileContentType_Dicom : FileContentType_DicomAsJson);
+
+    InstrumentedStorageArea storage;
+    TestServerContext test(storage);
+    ServerContext& context = test.GetContext();
+
+    StoreTestInstance(context, "ok");
+    ASSERT_EQ(2u, storage.GetFilesCount());
+
+    storage.SetFailure(failure);
+    ASSERT_THROW(StoreTestInstance(context, "failure"), OrthancException);
+    ASSERT_EQ(4u, storage.GetCountWriters());  // Both attachments were written
+    ASSERT_EQ(2u, storage.GetFilesCount());    // Only the files of the first instance
+
+    std::list<std::string> instances;
+    context.GetIndex().GetAllUuids(instances, ResourceType_Instance);
+    ASSERT_EQ(1u, instances.size());
+  }
+}
+
+
+TEST(ServerContext, MaximumConcurrentIngests)
+{
+  for (unsigned int maximum = 0; maximum <= 1; maximum++)
+  {
+    InstrumentedStorageArea storage;
+    TestServerContext test(storage);
+    ServerContext& context = test.GetContext();
+    context.SetMaximumConcurrentIngests(maximum);
+
+    storage.SetBlocking(true);
+
+    bool success1 = false;
+    bool success2 = false;
+    boost::thread thread1(StoreTestInstanceThread, &context, std::string("1"), &success1);
+
+    while (storage.GetCountWriters() == 0)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+
+    // The first instance is blocked while writing its attachments,
+    // hence while holding the single ingest slot
+    boost::thread thread2(StoreTestInstanceThread, &context, std::string("2"), &success2);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+
+    if (maximum == 1)
+    {
+      // The second instance waits for the slot before being written
+      ASSERT_GE(2u, storage.GetCountWriters());
+    }
+    else
+    {
+      // No bound on the ingests: Both instances are being written
+      ASSERT_LT(2u, storage.GetCountWriters());
+    }
+
+    storage.SetBlocking(false);
+    thread1.join();
+    thread2.join();
+
+    ASSERT_TRUE(success1);
+    ASSERT_TRUE(success2);
+    ASSERT_EQ(4u, storage.GetCountWriters());
+    ASSERT_EQ(4u, storage.GetFilesCount());
+  }
+}
+
+
+TEST(ServerContext, IngestMetrics)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+  context.GetMetricsRegistry().SetEnabled(true);
+
+  static const unsigned int COUNT = 5;
+
+  for (unsigned int i = 0; i < COUNT; i++)
+  {
+    StoreTestInstance(context, boost::lexical_cast<std::string>(i));
+  }
+
+  // One observation per instance and per stage of the ingest
+  const char* const STAGES[] = { "total", "write", "index" };
+
+  for (size_t i = 0; i < sizeof(STAGES) / sizeof(STAGES[0]); i++)
+  {
+    uint64_t count;
+    double sum;
+    ASSERT_TRUE(context.GetMetricsRegistry().GetHistogramStatistics(
+                  count, sum, "orthanc_store_latency_ms{step=\"" + std::string(STAGES[i]) + "\"}"));
+    ASSERT_EQ(COUNT, count);
+    ASSERT_LE(0.0, sum);
+  }
+
+  const char* const TIMERS[] = {
+    "orthanc_store_dicom_duration_ms",
+    "orthanc_store_queue_duration_ms",
+    "orthanc_store_parse_duration_ms",
+    "orthanc_store_write_duration_ms",
+    "orthanc_store_index_duration_ms"
+  };
+
+  std::string text;
+  context.GetMetricsRegistry().ExportPrometheusText(text);
+
+  for (size_t i = 0; i < sizeof(TIMERS) / sizeof(TIMERS[0]); i++)
+  {
+    ASSERT_NE(std::string::npos, text.find(std::string(TIMERS[i]) + " ")) << TIMERS[i];
+  }
+}
+
+namespace
+{
+  // Borrows one interpreter of the pool of the filters, loads the
+  // HTTP filter into it, and keeps it until all the threads have
+  // borrowed their own interpreter
+  void LoadLuaFilterThread(ServerContext* context,
+                           boost::barrier* barrier,
+                           boost::mutex* mutex,
+                           std::set<LuaScripting*>* interpreters)
+  {
+    ServerContext::LuaFilterLock filter(*context);
+
+    {
+      LuaScripting::Lock lock(filter.GetLuaScripting());
+      lock.GetLua().Execute("function IncomingHttpRequestFilter(method, uri, ip, username, headers)\n"
+                            "  return uri ~= '/forbidden'\n"
+                            "end\n");
+    }
+
+    {
+      boost::mutex::scoped_lock lock(*mutex);
+      interpreters->insert(&filter.GetLuaScripting());
+    }
+
+    barrier->wait();  // All the interpreters of the pool are borrowed
+    barrier->wait();  // The main thread has tested the nested lock
+  }
+
+
+  void HttpFilterThread(ServerContext* context,
+                        boost::mutex* mutex,
+                        std::set<LuaScripting*>* busy,
+                        unsigned int* errors)
+  {
+    const std::map<std::string, std::string> headers;
+
+    for (unsigned int i = 0; i < 100; i++)
+    {
+      ServerContext::LuaFilterLock filter(*context);
+      LuaScripting* lua = &filter.GetLuaScripting();
+
+      {
+        boost::mutex::scoped_lock lock(*mutex);
+        if (!busy->insert(lua).second)
+        {
+          (*errors)++;  // The interpreter is shared by two threads
+        }
+      }
+
+      try
+      {
+        if (!lua->FilterIncomingHttpRequest(HttpMethod_Get, "/instances", "127.0.0.1", "alice", headers) ||
+            lua->FilterIncomingHttpRequest(HttpMethod_Post, "/forbidden", "127.0.0.1", "alice", headers))
+        {
+          (*errors)++;
+        }
+      }
+      catch (OrthancException&)
+      {
+        (*errors)++;
+      }
+
+      {
+        boost::mutex::scoped_lock lock(*mutex);
+        busy->erase(lua);
+      }
+    }
+  }
+}
+
+
+TEST(ServerContext, LuaFilterPool)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  const size_t count = context.GetLuaFilterInterpretersCount();
+  ASSERT_LE(1u, count);
+
+  boost::mutex mutex;
+  std::set<LuaScripting*> interpreters;
+
+  {
+    // Exhaust the pool, then check that a re-entrant filter in the
+    // same thread (such as "RestApiPost()" inside
+    // "ReceivedInstanceFilter()") does not wait for the pool
+    boost::barrier barrier(count);
+
+    std::vector<boost::thread*> threads;
+    for (size_t i = 1; i < count; i++)
+    {
+      threads.push_back(new boost::thread(LoadLuaFilterThread, &context, &barrier, &mutex, &interpreters));
+    }
+
+    {
+      ServerContext::LuaFilterLock outer(context);
+
+      {
+        LuaScripting::Lock lock(outer.GetLuaScripting());
+        lock.GetLua().Execute("function IncomingHttpRequestFilter(method, uri, ip, username, headers)\n"
+                              "  return uri ~= '/forbidden'\n"
+                              "end\n");
+      }
+
+      barrier.wait();
+
+      {
+        ServerContext::LuaFilterLock nested(context);
+        EXPECT_EQ(&outer.GetLuaScripting(), &nested.GetLuaScripting());
+        EXPECT_FALSE(nested.GetLuaScripting().FilterIncomingHttpRequest(
+                       HttpMethod_Get, "/forbidden", "127.0.0.1", "alice", std::map<std::string, std::string>()));
+      }
+
+      // The outer lock still owns the interpreter
+      EXPECT_TRUE(outer.GetLuaScripting().FilterIncomingHttpRequest(
+                    HttpMethod_Get, "/instances", "127.0.0.1", "alice", std::map<std::string, std::string>()));
+
+      interpreters.insert(&outer.GetLuaScripting());
+
+      barrier.wait();
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+      threads[i]->join();
+      delete threads[i];
+    }
+  }
+
+  // Each thread had its own interpreter
+  ASSERT_EQ(count, interpreters.size());
+
+  {
+    // More threads than interpreters evaluate the HTTP filter
+    // concurrently, never sharing an interpreter
+    std::set<LuaScripting*> busy;
+    std::vector<unsigned int> errors(4 * count, 0);
+
+    std::vector<boost::thread*> threads;
+    for (size_t i = 0; i < errors.size(); i++)
+    {
+      threads.push_back(new boost::thread(HttpFilterThread, &context, &mutex, &busy, &errors[i]));
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+      threads[i]->join();
+      delete threads[i];
+      ASSERT_EQ(0u, errors[i]);
+    }
+
+    ASSERT_TRUE(busy.empty());
+  }
+
+  {
+    // All the interpreters are back in the pool
+    boost::barrier barrier(count + 1);
+    std::set<LuaScripting*> again;
+
+    std::vector<boost::thread*> threads;
+    for (size_t i = 0; i < count; i++)
+    {
+      threads.push_back(new boost::thread(LoadLuaFilterThread, &context, &barrier, &mutex, &again));
+    }
+
+    barrier.wait();
+    barrier.wait();
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+      threads[i]->join();
+      delete threads[i];
+    }
+
+    ASSERT_EQ(interpreters, again);
+  }
+}
+
+
+TEST(ServerContext, LuaFilterInitialize)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  // The pool is disabled by default, as in Orthanc <= 1.7.2
+  ASSERT_EQ(1u, context.GetLuaFilterInterpretersCount());
+  ASSERT_FALSE(context.IsLuaFilterPoolEnabled());
+
+  ServerContext::LuaFilterLock filter(context);
+  LuaScripting& lua = filter.GetLuaScripting();
+
+  {
+    LuaScripting::Lock lock(lua);
+    lock.GetLua().Execute("function Initialize()\n"
+                          "  allowed = '/allowed'\n"
+                          "end\n"
+                          "function IncomingHttpRequestFilter(method, uri, ip, username, headers)\n"
+                          "  return uri == allowed\n"
+                          "end\n");
+  }
+
+  const std::map<std::string, std::string> headers;
+
+  // The global variables that are set by "Initialize()" are only
+  // available once this callback has been executed by the interpreter
+  ASSERT_FALSE(lua.FilterIncomingHttpRequest(HttpMethod_Get, "/allowed", "127.0.0.1", "alice", headers));
+
+  lua.ExecuteSynchronously("Initialize");
+  ASSERT_TRUE(lua.FilterIncomingHttpRequest(HttpMethod_Get, "/allowed", "127.0.0.1", "alice", headers));
+  ASSERT_FALSE(lua.FilterIncomingHttpRequest(HttpMethod_Get, "/other", "127.0.0.1", "alice", headers));
+}
+
+
+namespace
+{
+  void SignalChangeThread(ServerContext* context)
+  {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    context->SignalChange(ServerIndexChange(ChangeType_NewInstance, ResourceType_Instance, "instance"));
+  }
+
+
+  void WaitForChangesThread(ServerContext* context,
+                            uint64_t count,
+                            bool* changed)
+  {
+    *changed = context->WaitForChanges(count, 60000);
+  }
+}
+
+
+TEST(ServerContext, WaitForChanges)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  // Timeout, as no change is signaled
+  uint64_t count = context.GetChangesCount();
+  ASSERT_FALSE(context.WaitForChanges(count, 50));
+  ASSERT_EQ(count, context.GetChangesCount());
+
+  // Wake-up by a change that is signaled by another thread
+  {
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    boost::thread thread(SignalChangeThread, &context);
+    ASSERT_TRUE(context.WaitForChanges(count, 60000));
+    thread.join();
+    ASSERT_LT((boost::posix_time::microsec_clock::universal_time() - start).total_seconds(), 30);
+    ASSERT_EQ(count + 1, context.GetChangesCount());
+  }
+
+  // No wait if a change was signaled before "WaitForChanges()"
+  ASSERT_TRUE(context.WaitForChanges(count, 60000));
+  count = context.GetChangesCount();
+
+  // Abort of the pending waits when the context is stopped
+  {
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    bool changed = true;
+    boost::thread thread(WaitForChangesThread, &context, count, &changed);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    context.Stop();
+    thread.join();
+    ASSERT_LT((boost::posix_time::microsec_clock::universal_time() - start).total_seconds(), 30);
+    ASSERT_FALSE(changed);
+  }
+
+  // No more wait once aborted
+  ASSERT_FALSE(context.WaitForChanges(count, 60000));
+}
+
+
+TEST(ParsedDicomCache, Basic)
+{
+  ParsedDicomCache cache(30, 1 /* single shard, for the LRU order to be predictable */);
+  ASSERT_EQ(30u, cache.GetMaximumSize());
+  ASSERT_TRUE(cache.IsCacheable(30));
+  ASSERT_FALSE(cache.IsCacheable(31));
+
+  cache.Acquire("a", new ParsedDicomFile(true), 10);
+  cache.Acquire("b", new ParsedDicomFile(true), 10);
+  cache.Acquire("large", new ParsedDicomFile(true), 31);  // Discarded
+
+  uint64_t hits, misses, evictions;
+
+  {
+    ParsedDicomCache::Accessor accessor(cache, "a", true);
+    ASSERT_TRUE(accessor.IsValid());
+    ASSERT_EQ(10u, accessor.GetFileSize());
+    accessor.GetDicom().ReplacePlainString(DICOM_TAG_PATIENT_NAME, "hello");
+  }
+
+  {
+    ParsedDicomCache::Accessor accessor(cache, "large", true);
+    ASSERT_FALSE(accessor.IsValid());
+    ASSERT_THROW(accessor.GetDicom(), OrthancException);
+  }
+
+  cache.GetStatistics(hits, misses, evictions);
+  ASSERT_EQ(1u, hits);
+  ASSERT_EQ(1u, misses);
+  ASSERT_EQ(0u, evictions);
+
+  // "b" is the least recently used item, and gets recycled
+  cache.Acquire("c", new ParsedDicomFile(true), 15);
+
+  {
+    ParsedDicomCache::Accessor accessor(cache, "b", true);
+    ASSERT_FALSE(accessor.IsValid());
+  }
+
+  {
+    ParsedDicomCache::Accessor accessor(cache, "a", true);
+    ASSERT_TRUE(accessor.IsValid());
+
+    std::string s;
+    ASSERT_TRUE(accessor.GetDicom().GetTagValue(s, DICOM_TAG_PATIENT_NAME));
+    ASSERT_EQ("hello", s);
+  }
+
+  cache.GetStatistics(hits, misses, evictions);
+  ASSERT_EQ(2u, hits);
+  ASSERT_EQ(2u, misses);
+  ASSERT_EQ(1u, evictions);
+
+  // Explicit invalidations are not counted as evictions
+  cache.Invalidate("a");
+  cache.Invalidate("nope");
+
+  {
+    ParsedDicomCache::Accessor accessor(cache, "a", false);
+    ASSERT_FALSE(accessor.IsValid());
+  }
+
+  cache.GetStatistics(hits, misses, evictions);
+  ASSERT_EQ(2u, hits);
+  ASSERT_EQ(2u, misses);
+  ASSERT_EQ(1u, evictions);
+}
+
+
+TEST(DicomInstanceToStore, HeaderOnlyParsing)
+{
+  // The summary and the JSON must be the same as with the full
+  // parsing of the DICOM file
+  Image image(PixelFormat_Grayscale8, 16, 8, false);
+  ImageProcessing::Set(image, 42);
+
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    std::string dicom;
+
+    {
+      ParsedDicomFile f(true);
+      f.ReplacePlainString(DICOM_TAG_PATIENT_NAME, "Hello^World");
+
+      if (i != 2)
+      {
+        f.EmbedImage(image);
+      }
+
+      if (i == 1)
+      {
+        // Element after the pixel data, which prevents the header-only parsing
+        f.Insert(DicomTag(0xfffc, 0xfffc), "abcd", false, "");
+      }
+
+      f.SaveToMemoryBuffer(dicom);
+    }
+
+    Json::Value summary, json;
+
+    {
+      ParsedDicomFile f(dicom);
+      std::set<DicomTag> ignoreTagLength;
+
+      DicomMap tmp;
+      FromDcmtkBridge::ExtractDicomSummary(tmp, *f.GetDcmtkObject().getDataset(), ignoreTagLength);
+      tmp.Serialize(summary);
+
+      FromDcmtkBridge::ExtractDicomAsJson(json, *f.GetDcmtkObject().getDataset(), ignoreTagLength);
+    }
+
+    DicomInstanceToStore toStore;
+    toStore.SetBuffer(dicom.c_str(), dicom.size());
+
+    Json::Value summary2;
+    toStore.GetSummary().Serialize(summary2);
+
+    ASSERT_TRUE(summary == summary2);
+    ASSERT_TRUE(json == toStore.GetJson());
+    ASSERT_EQ(i != 2, json.isMember("7fe0,0010"));
+    ASSERT_EQ(i != 2, toStore.HasPixelData());
+    ASSERT_EQ(i == 1, json.isMember("fffc,fffc"));
+
+    // The full parsing is still available
+    ASSERT_EQ(i != 2, toStore.GetParsedDicomFile().HasTag(DICOM_TAG_PIXEL_DATA));
+  }
+}
+
+
+TEST(DicomInstanceToStore, DISABLED_BenchmarkHeaderOnlyParsing)
+{
+  // Large multiframe instance: 250 frames of 512x512 pixels in 16bpp (125MB)
+  static const unsigned int FRAMES = 250;
+
+  std::string dicom;
+
+  {
+    Image image(PixelFormat_Grayscale16, 512, 512 * FRAMES, false);
+    ImageProcessing::Set(image, 42);
+
+    ParsedDicomFile f(true);
+    f.EmbedImage(image);
+    f.ReplacePlainString(DICOM_TAG_ROWS, "512");
+    f.ReplacePlainString(DICOM_TAG_NUMBER_OF_FRAMES, boost::lexical_cast<std::string>(FRAMES));
+    f.SaveToMemoryBuffer(dicom);
+  }
+
+  const unsigned int count = 10;
+
+  for (unsigned int full = 0; full < 2; full++)
+  {
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+      DicomInstanceToStore toStore;
+      toStore.SetBuffer(dicom.c_str(), dicom.size());
+
+      if (full)
+      {
+        toStore.GetParsedDicomFile();
+      }
+
+      toStore.GetHasher().HashInstance();
+      toStore.GetJson();
+    }
+
+    const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+    LOG(WARNING) << (full ? "Full" : "Header-only") << " parsing of a "
+                 << (dicom.size() / (1024 * 1024)) << "MB multiframe instance: "
+                 << (static_cast<double>(count) * 1000000.0 /
+                     static_cast<double>(elapsed.total_microseconds()))
+                 << " instances/second";
+  }
+}
+
+
+TEST(DicomAsJsonCodec, Basic)
+{
+  Json::Value json = Json::objectValue;
+  json["0010,0010"]["Name"] = "PatientName";
+  json["0010,0010"]["Type"] = "String";
+  json["0010,0010"]["Value"] = "Hello^World";
+  json["0008,0005"]["Name"] = "SpecificCharacterSet";
+  json["0008,0005"]["Type"] = "Null";
+  json["0008,0005"]["Value"] = Json::nullValue;
+  json["7fe0,0010"]["Name"] = "PixelData";
+  json["7fe0,0010"]["Type"] = "TooLong";
+  json["7fe0,0010"]["Value"] = Json::nullValue;
+  json["0009,1001"]["Name"] = "Unknown Tag & Data";
+  json["0009,1001"]["PrivateCreator"] = "Creator";
+  json["0009,1001"]["Type"] = "Binary";
+  json["0009,1001"]["Value"] = "data:application/octet-stream;base64,AAEC";
+  json["0008,1140"]["Name"] = "ReferencedImageSequence";
+  json["0008,1140"]["Type"] = "Sequence";
+  json["0008,1140"]["Value"] = Json::arrayValue;
+
+  {
+    Json::Value item = Json::objectValue;
+    item["0008,1155"]["Name"] = "ReferencedSOPInstanceUID";
+    item["0008,1155"]["Type"] = "String";
+    item["0008,1155"]["Value"] = "1.2.3";
+    json["0008,1140"]["Value"].append(item);
+    json["0008,1140"]["Value"].append(Json::objectValue);
+  }
+
+  std::string binary;
+  ASSERT_TRUE(DicomAsJsonCodec::Encode(binary, json));
+  ASSERT_TRUE(DicomAsJsonCodec::IsBinary(binary));
+  ASSERT_LT(binary.size(), json.toStyledString().size());
+
+  const std::string text = json.toStyledString();
+  ASSERT_FALSE(DicomAsJsonCodec::IsBinary(text));
+
+  {
+    Json::Value decoded;
+    DicomAsJsonCodec::Decode(decoded, binary);
+    ASSERT_EQ(text, decoded.toStyledString());
+
+    // Backward compatibility with the JSON text format
+    DicomAsJsonCodec::Decode(decoded, text);
+    ASSERT_EQ(text, decoded.toStyledString());
+
+    std::string s;
+    DicomAsJsonCodec::ToJsonText(s, binary);
+    ASSERT_EQ(text, s);
+    DicomAsJsonCodec::ToJsonText(s, text);
+    ASSERT_EQ(text, s);
+  }
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    const std::string& buffer = (i == 0 ? binary : text);
+
+    std::string s;
+
+    DicomMap m;
+    m.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "Removed", false);
+    DicomAsJsonCodec::ExtractDicomMap(m, buffer);
+    ASSERT_EQ(1u, m.GetSize());
+    ASSERT_TRUE(m.LookupStringValue(s, DICOM_TAG_PATIENT_NAME, false));
+    ASSERT_EQ("Hello^World", s);
+
+    std::set<DicomTag> tags;
+    tags.insert(DICOM_TAG_PATIENT_NAME);
+    tags.insert(DicomTag(0x0008, 0x0005));  // Null value
+    tags.insert(DicomTag(0x0008, 0x1140));  // Sequence
+    tags.insert(DicomTag(0x0008, 0x1155));  // Only inside the sequence
+    tags.insert(DicomTag(0x0009, 0x1001));  // Binary value
+    tags.insert(DICOM_TAG_PATIENT_ID);      // Absent
+
+    m.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "Removed", false);
+    DicomAsJsonCodec::ExtractDicomMap(m, buffer, tags);
+    ASSERT_EQ(1u, m.GetSize());
+    ASSERT_TRUE(m.LookupStringValue(s, DICOM_TAG_PATIENT_NAME, false));
+    ASSERT_EQ("Hello^World", s);
+
+    tags.erase(DICOM_TAG_PATIENT_NAME);
+    DicomAsJsonCodec::ExtractDicomMap(m, buffer, tags);
+    ASSERT_EQ(0u, m.GetSize());
+  }
+
+  {
+    // Truncated attachments must be detected
+    Json::Value decoded;
+    ASSERT_THROW(DicomAsJsonCodec::Decode(decoded, binary.substr(0, binary.size() - 1)), OrthancException);
+    ASSERT_THROW(DicomAsJsonCodec::Decode(decoded, binary.substr(0, 10)), OrthancException);
+  }
+
+  {
+    // Layouts that cannot be converted losslessly are rejected
+    Json::Value tmp = json;
+    tmp["0010,0010"]["Extra"] = 42;
+    ASSERT_FALSE(DicomAsJsonCodec::Encode(binary, tmp));
+    ASSERT_TRUE(binary.empty());
+
+    tmp = json;
+    tmp["0010,0020"] = "Hello";
+    ASSERT_FALSE(DicomAsJsonCodec::Encode(binary, tmp));
+
+    tmp = json;
+    tmp["0010,002A"] = json["0010,0010"];
+    ASSERT_FALSE(DicomAsJsonCodec::Encode(binary, tmp));
+
+    ASSERT_TRUE(DicomAsJsonCodec::Encode(binary, Json::objectValue));
+    Json::Value decoded;
+    DicomAsJsonCodec::Decode(decoded, binary);
+    ASSERT_EQ(Json::objectValue, decoded.type());
+    ASSERT_EQ(0u, decoded.size());
+  }
+}
+
+
+namespace
+{
+  class FindVisitor : public ServerContext::ILookupVisitor
+  {
+  private:
+    bool                      isComplete_;
+    std::vector<std::string>  resources_;
+    std::vector<std::string>  comments_;
+
+  public:
+    FindVisitor() :
+      isComplete_(false)
+    {
+    }
+
+    virtual bool IsDicomAsJsonNeeded() const
+    {
+      return true;
+    }
+      
+    virtual void MarkAsComplete()
+    {
+      isComplete_ = true;
+    }
+
+    virtual void Visit(const std::string& publicId,
+                       const std::string& instanceId,
+                       const DicomMap& mainDicomTags,
+                       const Json::Value* dicomAsJson)
+    {
+      if (dicomAsJson == NULL)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      resources_.push_back(publicId);
+      comments_.push_back((*dicomAsJson) ["0010,4000"]["Value"].asString());
+    }
+
+    bool IsComplete() const
+    {
+      return isComplete_;
+    }
+
+    const std::vector<std::string>& GetResources() const
+    {
+      return resources_;
+    }
+
+    const std::vector<std::string>& GetComments() const
+    {
+      return comments_;
+    }
+  };
+
+
+  // Stores instances with a "PatientComments" (0010,4000) tag, which
+  // is not a main DICOM tag and thus requires to read the storage area
+  void PopulateForFind(ServerContext& context,
+                       unsigned int countInstances)
+  {
+    for (unsigned int i = 0; i < countInstances; i++)
+    {
+      std::string id = boost::lexical_cast<std::string>(i);
+
+      DicomMap instance;
+      CreateTestInstance(instance, id);
+      instance.SetValue(0x0010, 0x4000, (i % 3 == 0 ? "hello" : "world"), false);
+
+      ASSERT_EQ(StoreStatus_Success, StoreTestInstance(context, instance));
+    }
+  }
+}
+
+
+TEST(ServerContext, ParallelFind)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  PopulateForFind(context, 100);
+
+  DatabaseLookup lookup;
+  lookup.AddRestConstraint(DicomTag(0x0010, 0x4000), "hello", true, true);
+  ASSERT_FALSE(lookup.HasOnlyMainDicomTags());
+
+  std::vector<std::string> reference;
+
+  for (unsigned int threads = 0; threads <= 4; threads += 2)
+  {
+    context.SetFindThreadsCount(threads);
+
+    {
+      FindVisitor visitor;
+      context.Apply(visitor, lookup, ResourceType_Study, 0, 0);
+      ASSERT_TRUE(visitor.IsComplete());
+      ASSERT_EQ(34u, visitor.GetResources().size());
+
+      for (size_t i = 0; i < visitor.GetComments().size(); i++)
+      {
+        ASSERT_EQ("hello", visitor.GetComments() [i]);
+      }
+
+      if (threads == 0)
+      {
+        reference = visitor.GetResources();
+      }
+      else
+      {
+        // The answers are delivered in the same order as with a single thread
+        ASSERT_TRUE(reference == visitor.GetResources());
+      }
+    }
+
+    {
+      FindVisitor visitor;
+      context.Apply(visitor, lookup, ResourceType_Study, 5, 10);
+      ASSERT_FALSE(visitor.IsComplete());
+      ASSERT_EQ(10u, visitor.GetResources().size());
+
+      for (size_t i = 0; i < 10; i++)
+      {
+        ASSERT_EQ(reference[5 + i], visitor.GetResources() [i]);
+      }
+    }
+
+    {
+      FindVisitor visitor;
+      context.Apply(visitor, lookup, ResourceType_Study, 30, 10);
+      ASSERT_TRUE(visitor.IsComplete());
+      ASSERT_EQ(4u, visitor.GetResources().size());
+    }
+  }
+}
+
+
+static void UploadInstances(Json::Value& answer,
+                            OrthancRestApi& api,
+                            std::istream& body,
+                            uint64_t size)
+{
+  UriComponents uri;
+  uri.push_back("instances");
+
+  IHttpHandler::Arguments headers;
+  headers["content-length"] = boost::lexical_cast<std::string>(size);
+
+  std::unique_ptr<IHttpHandler::IChunkedRequestReader> reader;
+  ASSERT_TRUE(api.CreateChunkedRequestReader(reader, RequestOrigin_RestApi, "127.0.0.1",
+                                             "", HttpMethod_Post, uri, headers));
+  ASSERT_TRUE(reader.get() != NULL);
+
+  // Feed the body by small chunks, as the HTTP server does
+  std::vector<char> chunk(1000);
+  while (body.read(&chunk[0], chunk.size()) ||
+         body.gcount() > 0)
+  {
+    reader->AddBodyChunk(&chunk[0], static_cast<size_t>(body.gcount()));
+  }
+
+  StringHttpOutput stream;
+
+  {
+    HttpOutput output(stream, false);
+    reader->Execute(output);
+  }
+
+  std::string s;
+  stream.GetOutput(s);
+
+  Json::Reader parser;
+  ASSERT_TRUE(parser.parse(s, answer));
+}
+
+
+static void UploadInstances(Json::Value& answer,
+                            OrthancRestApi& api,
+                            const std::string& body)
+{
+  std::istringstream stream(body);
+  UploadInstances(answer, api, stream, body.size());
+}
+
+
+TEST(ServerContext, UploadZip)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  OrthancRestApi api(context);
+
+  std::vector<std::string> dicom(3);
+  for (size_t i = 0; i < dicom.size(); i++)
+  {
+    ParsedDicomFile f(true);
+    f.SaveToMemoryBuffer(dicom[i]);
+  }
+
+  {
+    ZipWriter w;
+    w.SetOutputPath("UnitTestsResults/upload.zip");
+    w.Open();
+    w.OpenFile("study/1.dcm");
+    w.Write(dicom[0]);
+    w.OpenFile("study/2.dcm");
+    w.Write(dicom[1]);
+    w.OpenFile("README");
+    w.Write("Hello world");
+    w.OpenFile("3.dcm");
+    w.Write(dicom[2]);
+  }
+
+  std::string zip;
+  SystemToolbox::ReadFile(zip, "UnitTestsResults/upload.zip");
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    context.SetZipUploadThreadsCount(i == 0 ? 0 : 4);
+
+    Json::Value answer;
+    UploadInstances(answer, api, zip);
+
+    ASSERT_EQ(Json::arrayValue, answer.type());
+    ASSERT_EQ(4u, answer.size());
+    ASSERT_EQ("study/1.dcm", answer[0]["Filename"].asString());
+    ASSERT_EQ("README", answer[2]["Filename"].asString());
+    ASSERT_EQ("Failure", answer[2]["Status"].asString());
+    ASSERT_FALSE(answer[2].isMember("ID"));
+
+    for (Json::Value::ArrayIndex j = 0; j < 4; j++)
+    {
+      if (j != 2)
+      {
+        ASSERT_EQ(i == 0 ? "Success" : "AlreadyStored", answer[j]["Status"].asString());
+        ASSERT_TRUE(answer[j].isMember("ParentStudy"));
+      }
+    }
+  }
+
+  {
+    // A plain DICOM file is forwarded to the "/instances" handler
+    ParsedDicomFile f(true);
+    std::string s;
+    f.SaveToMemoryBuffer(s);
+
+    Json::Value answer;
+    UploadInstances(answer, api, s);
+    ASSERT_EQ(Json::objectValue, answer.type());
+    ASSERT_EQ("Success", answer["Status"].asString());
+  }
+}
+
+
+TEST(ServerContext, UploadZipParallel)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+  context.SetZipUploadThreadsCount(4);
+
+  OrthancRestApi api(context);
+
+  static const size_t COUNT = 50;
+
+  {
+    ZipWriter w;
+    w.SetOutputPath("UnitTestsResults/upload-parallel.zip");
+    w.Open();
+
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      ParsedDicomFile f(true);
+      std::string s;
+      f.SaveToMemoryBuffer(s);
+
+      w.OpenFile(("dicom-" + boost::lexical_cast<std::string>(i) + ".dcm").c_str());
+      w.Write(s);
+    }
+  }
+
+  std::string zip;
+  SystemToolbox::ReadFile(zip, "UnitTestsResults/upload-parallel.zip");
+
+  Json::Value answer;
+  UploadInstances(answer, api, zip);
+
+  // The answers are in the order of the archive
+  ASSERT_EQ(Json::arrayValue, answer.type());
+  ASSERT_EQ(COUNT, answer.size());
+
+  std::set<std::string> ids;
+  for (Json::Value::ArrayIndex i = 0; i < COUNT; i++)
+  {
+    ASSERT_EQ("dicom-" + boost::lexical_cast<std::string>(i) + ".dcm", answer[i]["Filename"].asString());
+    ASSERT_EQ("Success", answer[i]["Status"].asString());
+    ids.insert(answer[i]["ID"].asString());
+  }
+
+  ASSERT_EQ(COUNT, ids.size());
+
+  std::list<std::string> instances;
+  context.GetIndex().GetAllUuids(instances, ResourceType_Instance);
+  ASSERT_EQ(COUNT, instances.size());
+}
+
+
+#if defined(__linux__)
+TEST(ServerContext, UploadZipBoundedMemory)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+  context.SetZipUploadThreadsCount(0);
+
+  OrthancRestApi api(context);
+
+  static const size_t ENTRY_SIZE = 8 * 1024 * 1024;
+  static const size_t COUNT = 8;
+
+  {
+    // Pseudo-random, hence incompressible, entries: The archive is
+    // as large as its content, and is written chunk by chunk
+    ZipWriter w;
+    w.SetOutputPath("UnitTestsResults/upload-memory.zip");
+    w.Open();
+
+    std::string chunk(1024 * 1024, '\0');
+    uint32_t seed = 42;
+
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      w.OpenFile(("entry-" + boost::lexical_cast<std::string>(i)).c_str());
+
+      for (size_t j = 0; j < ENTRY_SIZE / chunk.size(); j++)
+      {
+        for (size_t k = 0; k < chunk.size(); k++)
+        {
+          seed = seed * 1103515245u + 12345u;
+          chunk[k] = static_cast<char>(seed >> 24);
+        }
+
+        w.Write(chunk);
+      }
+    }
+  }
+
+  if (!PeakResidentMemory::Reset())
+  {
+    LOG(WARNING) << "Cannot reset the peak resident memory, skipping test";
+  }
+  else
+  {
+    const uint64_t before = PeakResidentMemory::Get();
+
+    Json::Value answer;
+
+    {
+      std::ifstream body("UnitTestsResults/upload-memory.zip", std::ifstream::binary);
+      UploadInstances(answer, api, body, SystemToolbox::GetFileSize("UnitTestsResults/upload-memory.zip"));
+    }
+
+    const uint64_t after = PeakResidentMemory::Get();
+
+    // These entries are not DICOM files
+    ASSERT_EQ(Json::arrayValue, answer.type());
+    ASSERT_EQ(COUNT, answer.size());
+    for (Json::Value::ArrayIndex i = 0; i < COUNT; i++)
+    {
+      ASSERT_EQ("Failure", answer[i]["Status"].asString());
+    }
+
+    // Neither the HTTP body, nor the uncompressed archive, are
+    // loaded in memory at once
+    ASSERT_LT(after - before, 3 * ENTRY_SIZE / 1024);
+  }
+}
+#endif
+
+
+TEST(ServerContext, DISABLED_BenchmarkParallelFind)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  PopulateForFind(context, 10000);
+
+  DatabaseLookup lookup;
+  lookup.AddRestConstraint(DicomTag(0x0010, 0x4000), "hello", true, true);
+
+  const unsigned int maxThreads = std::max(1u, boost::thread::hardware_concurrency());
+
+  for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    context.SetFindThreadsCount(threads - 1);
+
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    FindVisitor visitor;
+    context.Apply(visitor, lookup, ResourceType_Study, 0, 0);
+    ASSERT_EQ(3334u, visitor.GetResources().size());
+
+    const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+    LOG(WARNING) << threads << " thread(s): Lookup over 10000 studies in "
+                 << elapsed.total_milliseconds() << "ms";
+  }
+}
+
+
+
+
+namespace
+{
+  class ConcurrentIndexAccess : public boost::noncopyable
+  {
+  private:
+    ServerIndex&                     index_;
+    const std::vector<std::string>&  instances_;
+    bool                             done_;     // Protected by "mutex_"
+    boost::mutex                     mutex_;
+    uint64_t                         countReads_;
+    uint64_t                         countWrites_;
+    bool                             success_;
+
+    bool IsDone()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return done_;
+    }
+
+    void SetDone(bool done)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      done_ = done;
+    }
+
+    static void StoreInstance(ServerIndex& index,
+                              const std::string& id)
+    {
+      DicomMap instance;
+      CreateTestInstance(instance, id);
+      instance.SetValue(DICOM_TAG_PATIENT_NAME, "name-" + id, false);
+
+      std::map<MetadataType, std::string> instanceMetadata;
+      if (StoreTestInstance(instanceMetadata, index, instance) != StoreStatus_Success)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+
+    static void ReaderThread(ConcurrentIndexAccess* that,
+                             size_t seed)
+    {
+      uint64_t count = 0;
+      bool success = true;
+
+      DatabaseLookup lookup;
+      lookup.AddRestConstraint(DICOM_TAG_PATIENT_NAME, "name-*", true /* case sensitive */, true);
+
+      for (size_t i = seed; !that->IsDone(); i++)
+      {
+        const std::string& id = that->instances_[i % that->instances_.size()];
+
+        Json::Value resource;
+        DicomMap tags;
+        FileInfo attachment;
+        std::list<std::string> children;
+        std::string series;
+
+        if (!that->index_.LookupResource(resource, id, ResourceType_Instance) ||
+            !that->index_.GetMainDicomTags(tags, id, ResourceType_Instance, ResourceType_Instance) ||
+            !that->index_.LookupAttachment(attachment, id, FileContentType_Dicom) ||
+            !that->index_.LookupParent(series, id))
+        {
+          success = false;
+        }
+        else
+        {
+          that->index_.GetChildren(children, series);
+          if (children.size() != 1u)
+          {
+            success = false;
+          }
+        }
+
+        if (i % 100 == 0)
+        {
+          std::vector<std::string> resources;
+          that->index_.ApplyLookupResources(resources, NULL, lookup, ResourceType_Patient, 10);
+          if (resources.empty())
+          {
+            success = false;
+          }
+        }
+
+        count++;
+      }
+
+      boost::mutex::scoped_lock lock(that->mutex_);
+      that->countReads_ += count;
+      that->success_ &= success;
+    }
+
+    static void WriterThread(ConcurrentIndexAccess* that)
+    {
+      uint64_t count = 0;
+
+      while (!that->IsDone())
+      {
+        StoreInstance(that->index_, "written-" + Toolbox::GenerateUuid());
+        count++;
+      }
+
+      boost::mutex::scoped_lock lock(that->mutex_);
+      that->countWrites_ += count;
+    }
+
+  public:
+    ConcurrentIndexAccess(ServerIndex& index,
+                          const std::vector<std::string>& instances) :
+      index_(index),
+      instances_(instances),
+      done_(false),
+      countReads_(0),
+      countWrites_(0),
+      success_(true)
+    {
+    }
+
+    static void Populate(std::vector<std::string>& instances,
+                         ServerIndex& index,
+                         size_t count)
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        std::string id = boost::lexical_cast<std::string>(i);
+        StoreInstance(index, id);
+
+        DicomMap instance;
+        CreateTestInstance(instance, id);
+        instances.push_back(DicomInstanceHasher(instance).HashInstance());
+      }
+    }
+
+    void Run(unsigned int countReaders,
+             bool hasWriter,
+             unsigned int durationMs)
+    {
+      SetDone(false);
+      countReads_ = 0;
+      countWrites_ = 0;
+      success_ = true;
+
+      std::vector<boost::thread*> threads;
+
+      for (unsigned int i = 0; i < countReaders; i++)
+      {
+        threads.push_back(new boost::thread(ReaderThread, this, i * 37));
+      }
+
+      if (hasWriter)
+      {
+        threads.push_back(new boost::thread(WriterThread, this));
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(durationMs));
+      SetDone(true);
+
+      for (size_t i = 0; i < threads.size(); i++)
+      {
+        threads[i]->join();
+        delete threads[i];
+      }
+    }
+
+    uint64_t GetCountReads() const
+    {
+      return countReads_;
+    }
+
+    uint64_t GetCountWrites() const
+    {
+      return countWrites_;
+    }
+
+    bool IsSuccess() const
+    {
+      return success_;
+    }
+  };
+}
+
+
+TEST(ServerIndex, ConcurrentReadersAndWriter)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  std::vector<std::string> instances;
+  ConcurrentIndexAccess::Populate(instances, context.GetIndex(), 20);
+
+  ConcurrentIndexAccess access(context.GetIndex(), instances);
+  access.Run(4, true, 200);
+
+  ASSERT_TRUE(access.IsSuccess());
+  ASSERT_LT(0u, access.GetCountReads());
+
+  uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances;
+  context.GetIndex().GetGlobalStatistics(diskSize, uncompressedSize, countPatients, 
+                                         countStudies, countSeries, countInstances);
+  ASSERT_EQ(20u + access.GetCountWrites(), countInstances);
+}
+
+
+TEST(ServerIndex, DISABLED_BenchmarkConcurrentReaders)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  std::vector<std::string> instances;
+  ConcurrentIndexAccess::Populate(instances, context.GetIndex(), 1000);
+
+  const unsigned int maxReaders = std::max(1u, boost::thread::hardware_concurrency());
+  
+  for (unsigned int readers = 1; readers <= maxReaders; readers *= 2)
+  {
+    ConcurrentIndexAccess access(context.GetIndex(), instances);
+    access.Run(readers, true /* concurrent writes */, 2000);
+    ASSERT_TRUE(access.IsSuccess());
+
+    LOG(WARNING) << readers << " reader thread(s): " << (access.GetCountReads() / 2)
+                 << " reads/second, " << (access.GetCountWrites() / 2)
+                 << " concurrent stores/second";
+  }
+}
+
+
+namespace
+{
+  class ConcurrentStores : public boost::noncopyable
+  {
+  private:
+    ServerIndex&   index_;
+    boost::mutex   mutex_;
+    unsigned int   countSuccess_;
+    unsigned int   countAlreadyStored_;
+    unsigned int   countFailure_;
+
+    static void StoreThread(ConcurrentStores* that,
+                            std::string prefix,
+                            unsigned int countInstances,
+                            unsigned int brokenPeriod)
+    {
+      unsigned int success = 0, alreadyStored = 0, failure = 0;
+
+      for (unsigned int i = 0; i < countInstances; i++)
+      {
+        std::string id = prefix + boost::lexical_cast<std::string>(i);
+
+        DicomMap instance;
+        CreateTestInstance(instance, id);
+
+        if (brokenPeriod != 0 &&
+            i % brokenPeriod == 0)
+        {
+          // Without a SOPInstanceUID, the instance cannot be stored,
+          // which rolls back the transaction of its whole group
+          instance.Remove(DICOM_TAG_SOP_INSTANCE_UID);
+        }
+
+        std::map<MetadataType, std::string> instanceMetadata;
+        switch (StoreTestInstance(instanceMetadata, that->index_, instance))
+        {
+          case StoreStatus_Success:
+            if (instanceMetadata.find(MetadataType_Instance_ReceptionDate) == instanceMetadata.end())
+            {
+              failure++;
+            }
+            else
+            {
+              success++;
+            }
+            break;
+
+          case StoreStatus_AlreadyStored:
+            alreadyStored++;
+            break;
+
+          default:
+            failure++;
+            break;
+        }
+      }
+
+      boost::mutex::scoped_lock lock(that->mutex_);
+      that->countSuccess_ += success;
+      that->countAlreadyStored_ += alreadyStored;
+      that->countFailure_ += failure;
+    }
+
+  public:
+    explicit ConcurrentStores(ServerIndex& index) :
+      index_(index),
+      countSuccess_(0),
+      countAlreadyStored_(0),
+      countFailure_(0)
+    {
+    }
+
+    // If "sameInstances" is true, all the threads store the same
+    // instances, otherwise each thread stores distinct instances. If
+    // "brokenPeriod" is not zero, one instance out of "brokenPeriod"
+    // is invalid.
+    void Run(unsigned int countThreads,
+             unsigned int countInstances,
+             bool sameInstances,
+             unsigned int brokenPeriod = 0)
+    {
+      std::vector<boost::thread*> threads;
+
+      for (unsigned int i = 0; i < countThreads; i++)
+      {
+        std::string prefix = (sameInstances ? "same-" : Toolbox::GenerateUuid() + "-");
+        threads.push_back(new boost::thread(StoreThread, this, prefix, countInstances, brokenPeriod));
+      }
+
+      for (size_t i = 0; i < threads.size(); i++)
+      {
+        threads[i]->join();
+        delete threads[i];
+      }
+    }
+
+    unsigned int GetCountSuccess() const
+    {
+      return countSuccess_;
+    }
+
+    unsigned int GetCountAlreadyStored() const
+    {
+      return countAlreadyStored_;
+    }
+
+    unsigned int GetCountFailure() const
+    {
+      return countFailure_;
+    }
+  };
+}
+
+
+TEST(ServerIndex, GroupCommit)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  ServerIndex& index = context.GetIndex();
+  ASSERT_THROW(index.SetGroupCommit(0, 0), OrthancException);
+  index.SetGroupCommit(8, 20);
+
+  {
+    // Each instance must be reported as stored exactly once
+    ConcurrentStores stores(index);
+    stores.Run(8, 25, true);
+    ASSERT_EQ(25u, stores.GetCountSuccess());
+    ASSERT_EQ(7u * 25u, stores.GetCountAlreadyStored());
+    ASSERT_EQ(0u, stores.GetCountFailure());
+  }
+
+  {
+    ConcurrentStores stores(index);
+    stores.Run(8, 25, false);
+    ASSERT_EQ(8u * 25u, stores.GetCountSuccess());
+    ASSERT_EQ(0u, stores.GetCountAlreadyStored());
+    ASSERT_EQ(0u, stores.GetCountFailure());
+  }
+
+  uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances;
+  index.GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                            countStudies, countSeries, countInstances);
+  ASSERT_EQ(225u, countPatients);
+  ASSERT_EQ(225u, countInstances);
+
+  // The changes of each instance are logged in order, from the
+  // instance up to the patient, and are not interleaved with those
+  // of the other instances
+  Json::Value changes;
+  index.GetChanges(changes, 0, 10000);
+  ASSERT_EQ(4u * 225u, changes["Changes"].size());
+
+  static const char* const ORDER[] = { "NewInstance", "NewSeries", "NewStudy", "NewPatient" };
+
+  for (Json::Value::ArrayIndex i = 0; i < changes["Changes"].size(); i++)
+  {
+    ASSERT_EQ(ORDER[i % 4], changes["Changes"][i]["ChangeType"].asString());
+
+    if (i > 0)
+    {
+      ASSERT_LT(changes["Changes"][i - 1]["Seq"].asInt64(), changes["Changes"][i]["Seq"].asInt64());
+    }
+  }
+}
+
+
+TEST(ServerIndex, GroupCommitFailure)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  ServerIndex& index = context.GetIndex();
+  index.SetGroupCommit(8, 20);
+
+  {
+    // The groups that contain an invalid instance are rolled back,
+    // then their instances are stored one by one: Only the invalid
+    // instances must fail
+    ConcurrentStores stores(index);
+    stores.Run(8, 25, false, 5);
+    ASSERT_EQ(8u * 20u, stores.GetCountSuccess());
+    ASSERT_EQ(0u, stores.GetCountAlreadyStored());
+    ASSERT_EQ(8u * 5u, stores.GetCountFailure());
+  }
+
+  uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries, countInstances;
+  index.GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                            countStudies, countSeries, countInstances);
+  ASSERT_EQ(160u, countPatients);
+  ASSERT_EQ(160u, countInstances);
+
+  // No change must survive from the rolled-back transactions
+  Json::Value changes;
+  index.GetChanges(changes, 0, 10000);
+
+  unsigned int countNewInstances = 0;
+  for (Json::Value::ArrayIndex i = 0; i < changes["Changes"].size(); i++)
+  {
+    if (changes["Changes"][i]["ChangeType"].asString() == "NewInstance")
+    {
+      countNewInstances++;
+    }
+  }
+
+  ASSERT_EQ(160u, countNewInstances);
+}
+
+
+TEST(ServerIndex, DISABLED_BenchmarkGroupCommit)
+{
+  // The benefit of group commit is only visible if the database is
+  // stored on a disk, as "fsync()" is called after each transaction
+  const std::string path = "UnitTestsGroupCommit";
+  SystemToolbox::RemoveFile(path);
+
+  MemoryStorageArea storage;
+  SQLiteDatabaseWrapper db(path);
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10);
+  context.SetupJobsEngine(true, false);
+
+  const unsigned int countThreads = 8;
+  const unsigned int countInstances = 100;
+
+  static const unsigned int GROUP_SIZES[] = { 1, 4, 16, 64 };
+
+  for (size_t i = 0; i < sizeof(GROUP_SIZES) / sizeof(unsigned int); i++)
+  {
+    context.GetIndex().SetGroupCommit(GROUP_SIZES[i], 0);
+
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    ConcurrentStores stores(context.GetIndex());
+    stores.Run(countThreads, countInstances, false);
+    ASSERT_EQ(countThreads * countInstances, stores.GetCountSuccess());
+
+    const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+    LOG(WARNING) << "Group commit of up to " << GROUP_SIZES[i] << " instance(s): "
+                 << (static_cast<double>(countThreads * countInstances) * 1000000.0 /
+                     static_cast<double>(elapsed.total_microseconds()))
+                 << " instances/second with " << countThreads << " concurrent threads";
+  }
+
+  context.Stop();
+  db.Close();
+
+  SystemToolbox::RemoveFile(path);
+}
+
+
+TEST(ServerIndex, DISABLED_BenchmarkPersonNameLookup)
+{
+  TestServerContext test;
+  ServerContext& context = test.GetContext();
+
+  ServerIndex& index = context.GetIndex();
+
+  const unsigned int countStudies = 20000;
+  const unsigned int countLookups = 100;
+
+  for (unsigned int i = 0; i < countStudies; i++)
+  {
+    const std::string id = boost::lexical_cast<std::string>(i);
+    const std::string name = "Physician^" + id;
+
+    DicomMap instance;
+    CreateTestInstance(instance, id);
+    instance.SetValue(DICOM_TAG_REFERRING_PHYSICIAN_NAME, name, false);
+    instance.SetValue(DICOM_TAG_INSTITUTION_NAME, name, false);
+
+    std::map<MetadataType, std::string> instanceMetadata;
+    ASSERT_EQ(StoreStatus_Success, StoreTestInstance(instanceMetadata, index, instance));
+  }
+
+  // "InstitutionName" is a main DICOM tag that is not an identifier,
+  // which results in a sequential scan of the "MainDicomTags" table
+  static const DicomTag TAGS[] = { DICOM_TAG_REFERRING_PHYSICIAN_NAME, DICOM_TAG_INSTITUTION_NAME };
+
+  for (size_t i = 0; i < sizeof(TAGS) / sizeof(DicomTag); i++)
+  {
+    const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    for (unsigned int j = 0; j < countLookups; j++)
+    {
+      DatabaseLookup lookup;
+      lookup.AddRestConstraint(TAGS[i], "PHYSICIAN^" + boost::lexical_cast<std::string>(j * 7),
+                               false /* case insensitive */, true);
+
+      std::vector<std::string> resources;
+      index.ApplyLookupResources(resources, NULL, lookup, ResourceType_Study, 0);
+      ASSERT_EQ(1u, resources.size());
+    }
+
+    const boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+    LOG(WARNING) << "Case-insensitive lookup on " << TAGS[i].Format() << ": "
+                 << (static_cast<double>(countLookups) * 1000000.0 /
+                     static_cast<double>(elapsed.total_microseconds()))
+                 << " lookups/second over " << countStudies << " studies";
+  }
+}
@@ -35,6 +35,8 @@
 #include <gtest/gtest.h>
 
 #include "../../OrthancFramework/Sources/Compatibility.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/DicomServer.h"
+#include "../../OrthancFramework/Sources/DicomNetworking/IStoreRequestHandlerFactory.h"
 #include "../../OrthancFramework/Sources/FileStorage/MemoryStorageArea.h"
 #include "../../OrthancFramework/Sources/JobsEngine/Operations/LogJobOperation.h"
 #include "../../OrthancFramework/Sources/SerializationToolbox.h"
@@ -756,12 +758,15 @@ TEST_F(OrthancJobsSerialization, Jobs)
     ASSERT_TRUE(tmp.GetPeer().IsPkcs11Enabled());
     ASSERT_FALSE(tmp.IsTranscode());
     ASSERT_THROW(tmp.GetTransferSyntax(), OrthancException);
+    ASSERT_EQ(1u, tmp.GetConcurrency());
   }
 
   {
     OrthancPeerStoreJob job(GetContext());
     ASSERT_THROW(job.SetTranscode("nope"), OrthancException);
     job.SetTranscode("1.2.840.10008.1.2.4.50");
+    ASSERT_THROW(job.SetConcurrency(0), OrthancException);
+    job.SetConcurrency(4);
     
     ASSERT_TRUE(CheckIdempotentSetOfInstances(unserializer, job));
     ASSERT_TRUE(job.Serialize(s));
@@ -778,6 +783,7 @@ TEST_F(OrthancJobsSerialization, Jobs)
     ASSERT_FALSE(tmp.GetPeer().IsPkcs11Enabled());
     ASSERT_TRUE(tmp.IsTranscode());
     ASSERT_EQ(DicomTransferSyntax_JPEGProcess1, tmp.GetTransferSyntax());
+    ASSERT_EQ(4u, tmp.GetConcurrency());
   }
 
   // ResourceModificationJob
@@ -1097,3 +1103,167 @@ TEST_F(OrthancJobsSerialization, DicomAssociationParameters)
     ASSERT_EQ(43u, job->GetParameters().GetTimeout());
   }
 }
+
+
+namespace
+{
+  // C-STORE SCP that records the SOP instance UIDs it receives
+  class StoreScpRecorder :
+    public DicomServer::IRemoteModalities,
+    public IStoreRequestHandlerFactory
+  {
+  private:
+    class Handler : public IStoreRequestHandler
+    {
+    private:
+      StoreScpRecorder&  that_;
+
+    public:
+      explicit Handler(StoreScpRecorder& that) :
+        that_(that)
+      {
+      }
+
+      virtual void Handle(const std::string& dicomFile,
+                          const DicomMap& dicomSummary,
+                          const Json::Value& dicomJson,
+                          const std::string& remoteIp,
+                          const std::string& remoteAet,
+                          const std::string& calledAet) ORTHANC_OVERRIDE
+      {
+        std::string sopInstanceUid;
+        if (!dicomSummary.LookupStringValue(sopInstanceUid, DICOM_TAG_SOP_INSTANCE_UID, false))
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        that_.Add(sopInstanceUid);
+      }
+    };
+
+    boost::mutex              mutex_;
+    std::vector<std::string>  received_;
+
+  public:
+    virtual bool IsSameAETitle(const std::string& aet1,
+                               const std::string& aet2) ORTHANC_OVERRIDE
+    {
+      return aet1 == aet2;
+    }
+
+    virtual bool LookupAETitle(RemoteModalityParameters& modality,
+                               const std::string& aet) ORTHANC_OVERRIDE
+    {
+      return false;
+    }
+
+    virtual IStoreRequestHandler* ConstructStoreRequestHandler() ORTHANC_OVERRIDE
+    {
+      return new Handler(*this);
+    }
+
+    void Add(const std::string& sopInstanceUid)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      received_.push_back(sopInstanceUid);
+    }
+
+    void GetReceived(std::set<std::string>& target,
+                     size_t& count)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      target = std::set<std::string>(received_.begin(), received_.end());
+      count = received_.size();
+    }
+  };
+}
+
+
+TEST_F(OrthancJobsSerialization, DicomModalityStoreJobAssociations)
+{
+  static const uint16_t PORT = 15104;
+  static const size_t COUNT = 10;
+  static const size_t ASSOCIATIONS = 4;
+  static const size_t REMOVED = 5;
+
+  StoreScpRecorder recorder;
+
+  DicomServer server;
+  server.SetRemoteModalities(recorder);
+  server.SetStoreRequestHandlerFactory(recorder);
+  server.SetApplicationEntityTitle("STORESCP");
+  server.SetPortNumber(PORT);
+  server.Start();
+
+  std::vector<std::string> ids, sopInstanceUids;
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    ParsedDicomFile dicom(true);
+    dicom.Replace(DICOM_TAG_SOP_CLASS_UID, std::string("1.2.840.10008.5.1.4.1.1.7"),  // Secondary capture
+                  false, DicomReplaceMode_InsertIfAbsent, "");
+
+    std::string sopInstanceUid;
+    ASSERT_TRUE(dicom.GetTagValue(sopInstanceUid, DICOM_TAG_SOP_INSTANCE_UID));
+
+    DicomInstanceToStore toStore;
+    toStore.SetParsedDicomFile(dicom);
+
+    std::string id;
+    ASSERT_EQ(StoreStatus_Success, GetContext().Store(id, toStore, StoreInstanceMode_Default));
+
+    ids.push_back(id);
+    sopInstanceUids.push_back(sopInstanceUid);
+  }
+
+  Json::Value removed;
+  ASSERT_TRUE(GetContext().DeleteResource(removed, ids[REMOVED], ResourceType_Instance));
+
+  {
+    RemoteModalityParameters remote;
+    remote.SetApplicationEntityTitle("STORESCP");
+    remote.SetHost("127.0.0.1");
+    remote.SetPortNumber(PORT);
+    remote.SetStoreAssociationsCount(ASSOCIATIONS);
+
+    DicomModalityStoreJob job(GetContext());
+    job.SetLocalAet("ORTHANC");
+    job.SetRemoteModality(remote);
+    job.SetPermissive(true);
+
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      job.AddInstance(ids[i]);
+    }
+
+    job.Start();
+
+    for (size_t i = 0; i < COUNT; i++)
+    {
+      ASSERT_EQ(i + 1 < COUNT ? JobStepCode_Continue : JobStepCode_Success,
+                job.Step("jobId").GetCode());
+
+      // The batch that contains the current instance is sent, one
+      // instance per association, but not the next batch
+      const size_t end = std::min(COUNT, (i / ASSOCIATIONS + 1) * ASSOCIATIONS);
+
+      std::set<std::string> received;
+      size_t count;
+      recorder.GetReceived(received, count);
+
+      ASSERT_EQ(count, received.size());  // Each instance is sent once
+      ASSERT_EQ(end > REMOVED ? end - 1 : end, count);
+
+      for (size_t j = 0; j < end; j++)
+      {
+        ASSERT_EQ(j != REMOVED, received.find(sopInstanceUids[j]) != received.end());
+      }
+    }
+
+    // Only the removed instance has failed
+    ASSERT_EQ(1u, job.GetFailedInstances().size());
+    ASSERT_TRUE(job.IsFailedInstance(ids[REMOVED]));
+  }
+
+  server.Stop();
+}
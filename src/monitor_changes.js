@@ -1,16 +1,19 @@
 "use strict";
 
 const needle = require('needle')
-const cron = require("node-cron");
 
 const DICOM_SERVER="http://localhost:8042"
-const CRON_PERIOD=10
+// Duration of each long poll on /changes (seconds, at most 60)
+const WAIT_PERIOD=30
+// Delay before retrying after an error (milliseconds)
+const RETRY_DELAY=5000
 
 const reader = require('./reader')
 
 class Monitor{
     constructor(){
 	this.changes = []
+	this.last = 0
     }
 
     process_changes(instance_arr) {
@@ -35,28 +38,47 @@ class Monitor{
 	this.process_changes(id_array)
     }
 
-    get_changes(){
-	try{
-	    const query_url=`${DICOM_SERVER}/changes`
-	    console.log(`query url:${query_url}`)
-	    needle.get(query_url, (err, resp, body) => {
-		if (err) throw err;
-		console.log(body)
+    get_changes(wait){
+	// Long polling: the server answers as soon as a change after
+	// "this.last" is available, or after "wait" seconds
+	const query_url=`${DICOM_SERVER}/changes?since=${this.last}&wait=${wait}`
+	console.log(`query url:${query_url}`)
+	needle.get(query_url, (err, resp, body) => {
+	    if (err || resp.statusCode != 200) {
+		console.error(err || `HTTP status ${resp.statusCode}`)
+		setTimeout(() => this.get_changes(wait), RETRY_DELAY)
+		return
+	    }
+
+	    try{
 		this.changes = body.Changes;
+		this.last = body.Last
 		this.filter_changes()
-	    })
-	}
-	catch(err){
-	    console.error(err)
-	}
+	    }
+	    catch(err){
+		console.error(err)
+	    }
+
+	    // Immediately issue the next poll
+	    this.get_changes(wait)
+	})
     }
 
-    start(period=CRON_PERIOD){
-	// Creating a cron job which runs on every 10 second 
-	cron.schedule(`*/${period} * * * * *`, () => { 
-	    console.log(`running a task every ${CRON_PERIOD} second`); 
-	    this.get_changes()
-	}); 
+    start(wait=WAIT_PERIOD){
+	// Only monitor the changes that occur from now on: Fetch the
+	// sequence number of the last change before the first poll
+	const query_url=`${DICOM_SERVER}/changes?last`
+	console.log(`query url:${query_url}`)
+	needle.get(query_url, (err, resp, body) => {
+	    if (err || resp.statusCode != 200) {
+		console.error(err || `HTTP status ${resp.statusCode}`)
+		setTimeout(() => this.start(wait), RETRY_DELAY)
+		return
+	    }
+
+	    this.last = body.Last
+	    this.get_changes(wait)
+	})
     }
 
 }